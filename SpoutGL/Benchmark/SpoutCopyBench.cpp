@@ -0,0 +1,627 @@
+/*
+
+	SpoutCopyBench.cpp
+
+	Throughput of the spoutCopy functions for each instruction set
+
+	Each function is timed at standard broadcast resolutions for every
+	instruction set supported by the CPU, from SPOUT_SIMD_NONE up.
+	Results are bytes read and written per second and nanoseconds
+	per destination pixel, as a table or as JSON for tracking
+	regressions between releases.
+
+	Usage :
+		SpoutCopyBench [--json] [--iterations n] [--threads n]
+		               [--resolution WxH] [--filter name]
+
+		--json        JSON on stdout instead of a table
+		--iterations  timed runs of each function, the median is reported (default 10)
+		--threads     spoutCopy::SetThreads (default 1)
+		--resolution  add a resolution, replacing the defaults (1080p, 4K, 6K, 8K)
+		--filter      only functions with names containing this text
+
+	The rgba2rgba regular and streaming entries also report "probe_ms",
+	the time to read an 8 MB working set after each copy.
+	This shows the effect of streaming stores on other data in the cache.
+
+	They also report "neighbour_slowdown", for a workload running at the
+	same time as the copy. A second thread reads a working set of half
+	the last level cache, up to 8 MB, and its rate while the copy runs
+	is compared with its rate alone. Regular stores evict its data and
+	slow it down more than streaming stores, which bypass the cache.
+	It needs a second CPU and is not reported with only one.
+
+*/
+
+#include "../SpoutCopy.h"
+#include "../SpoutLUT.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Resolution {
+	const char* name;
+	unsigned int width;
+	unsigned int height;
+};
+
+// Source and destination of one timed call
+struct Frame {
+	unsigned char* src;
+	unsigned char* dst;
+	unsigned int width;
+	unsigned int height;
+	unsigned int pad; // extra bytes per line for the pitch variants
+};
+
+struct Kernel {
+	const char* name;
+	double srcBytes; // per destination pixel
+	double dstBytes;
+	std::function<void(const spoutCopy&, const Frame&)> run;
+	int stream; // -1 default, 0 regular stores, 1 streaming stores
+};
+
+const char* SIMDName(SpoutSIMD level)
+{
+	switch (level) {
+		case SPOUT_SIMD_NONE: return "none";
+		case SPOUT_SIMD_SSE2: return "sse2";
+		case SPOUT_SIMD_SSSE3: return "ssse3";
+		case SPOUT_SIMD_AVX2: return "avx2";
+		case SPOUT_SIMD_AVX512: return "avx512";
+		default: return "auto";
+	}
+}
+
+std::vector<Kernel> Kernels()
+{
+	std::vector<Kernel> k;
+	auto add = [&](const char* name, double sb, double db,
+		std::function<void(const spoutCopy&, const Frame&)> fn, int stream = -1) {
+		k.push_back({ name, sb, db, fn, stream });
+	};
+
+	//
+	// 8 bit copy and swizzle
+	//
+	add("CopyPixels", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		c.CopyPixels(f.src, f.dst, f.width, f.height); });
+	add("CopyPixels_invert", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		c.CopyPixels(f.src, f.dst, f.width, f.height, GL_RGBA, true); });
+	add("FlipBuffer", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		c.FlipBuffer(f.src, f.dst, f.width, f.height); });
+	add("RemovePadding", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		c.RemovePadding(f.src, f.dst, f.width, f.height, f.width * 4 + f.pad, GL_RGBA); });
+	add("rgba2rgba_pitch", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2rgba(f.src, f.dst, f.width, f.height, f.width * 4 + f.pad, false); });
+	add("rgba2rgba_pitch2_invert", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2rgba(f.src, f.dst, f.width, f.height, f.width * 4 + f.pad, f.width * 4 + f.pad, true); });
+	add("rgba2rgba_regular", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2rgba(f.src, f.dst, f.width, f.height, f.width * 4, f.width * 4, false); }, 0);
+	add("rgba2rgba_stream", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2rgba(f.src, f.dst, f.width, f.height, f.width * 4, f.width * 4, false); }, 1);
+	add("rgba2bgra", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2bgra(f.src, f.dst, f.width, f.height, false); });
+	add("rgba2bgra_pitch", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2bgra(f.src, f.dst, f.width, f.height, f.width * 4 + f.pad, false); });
+	add("rgba2bgra_pitch2_invert", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2bgra(f.src, f.dst, f.width, f.height, f.width * 4 + f.pad, f.width * 4 + f.pad, true); });
+
+	//
+	// 8 bit format conversion
+	//
+	add("rgb2rgba", 3, 4, [](const spoutCopy& c, const Frame& f) {
+		c.rgb2rgba(f.src, f.dst, f.width, f.height, false); });
+	add("rgb2bgra_pitch", 3, 4, [](const spoutCopy& c, const Frame& f) {
+		c.rgb2bgra(f.src, f.dst, f.width, f.height, f.width * 4 + f.pad, false); });
+	add("bgr2rgba", 3, 4, [](const spoutCopy& c, const Frame& f) {
+		c.bgr2rgba(f.src, f.dst, f.width, f.height, false); });
+	add("rgba2rgb_pitch", 4, 3, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2rgb(f.src, f.dst, f.width, f.height, f.width * 4 + f.pad, false); });
+	add("rgba2rgb_mirror_swap", 4, 3, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2rgb(f.src, f.dst, f.width, f.height, f.width * 4, false, true, true); });
+	add("rgba2bgr_pitch", 4, 3, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2bgr(f.src, f.dst, f.width, f.height, f.width * 4 + f.pad, false); });
+	add("bgra2rgb", 4, 3, [](const spoutCopy& c, const Frame& f) {
+		c.bgra2rgb(f.src, f.dst, f.width, f.height, false); });
+	add("CopyImage_bgra_rgba_mirror_invert", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		c.CopyImage(f.src, f.dst, f.width, f.height, GL_BGRA_EXT, GL_RGBA,
+			f.width * 4 + f.pad, f.width * 4 + f.pad, true, true); });
+
+	//
+	// Resample from double size and from half size
+	//
+	add("rgba2rgbaResample_down", 16, 4, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2rgbaResample(f.src, f.dst, f.width * 2, f.height * 2, f.width * 8, f.width, f.height); });
+	add("rgba2rgbaResample_up", 1, 4, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2rgbaResample(f.src, f.dst, f.width / 2, f.height / 2, f.width * 2, f.width, f.height); });
+	add("rgba2rgbResample_down", 16, 3, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2rgbResample(f.src, f.dst, f.width * 2, f.height * 2, f.width * 8, f.width, f.height); });
+	add("rgba2bgrResample_down", 16, 3, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2bgrResample(f.src, f.dst, f.width * 2, f.height * 2, f.width * 8, f.width, f.height); });
+
+	// Catmull-Rom and Lanczos-3 from 1.5 times and 2/3 of the size, set for the call and restored
+	auto filter = [](const spoutCopy& c, SpoutResample mode) {
+		const_cast<spoutCopy&>(c).SetResample(mode);
+	};
+	add("rgba2rgbaResample_catmullrom_down", 9, 4, [filter](const spoutCopy& c, const Frame& f) {
+		filter(c, SPOUT_RESAMPLE_CATMULLROM);
+		c.rgba2rgbaResample(f.src, f.dst, f.width * 3 / 2, f.height * 3 / 2, f.width * 3 / 2 * 4, f.width, f.height);
+		filter(c, SPOUT_RESAMPLE_AUTO); });
+	add("rgba2rgbaResample_catmullrom_up", 2, 4, [filter](const spoutCopy& c, const Frame& f) {
+		filter(c, SPOUT_RESAMPLE_CATMULLROM);
+		c.rgba2rgbaResample(f.src, f.dst, f.width * 2 / 3, f.height * 2 / 3, f.width * 2 / 3 * 4, f.width, f.height);
+		filter(c, SPOUT_RESAMPLE_AUTO); });
+	add("rgba2rgbaResample_lanczos3_down", 9, 4, [filter](const spoutCopy& c, const Frame& f) {
+		filter(c, SPOUT_RESAMPLE_LANCZOS3);
+		c.rgba2rgbaResample(f.src, f.dst, f.width * 3 / 2, f.height * 3 / 2, f.width * 3 / 2 * 4, f.width, f.height);
+		filter(c, SPOUT_RESAMPLE_AUTO); });
+	add("rgba2rgbaResample_lanczos3_up", 2, 4, [filter](const spoutCopy& c, const Frame& f) {
+		filter(c, SPOUT_RESAMPLE_LANCZOS3);
+		c.rgba2rgbaResample(f.src, f.dst, f.width * 2 / 3, f.height * 2 / 3, f.width * 2 / 3 * 4, f.width, f.height);
+		filter(c, SPOUT_RESAMPLE_AUTO); });
+
+	//
+	// High bit depth
+	//
+	add("float2half", 16, 8, [](const spoutCopy& c, const Frame& f) {
+		c.float2half(f.src, f.dst, f.width, f.height, f.width * 16, f.width * 8); });
+	add("half2float", 8, 16, [](const spoutCopy& c, const Frame& f) {
+		c.half2float(f.src, f.dst, f.width, f.height, f.width * 8, f.width * 16); });
+	add("float2rgba", 16, 4, [](const spoutCopy& c, const Frame& f) {
+		c.float2rgba(f.src, f.dst, f.width, f.height, f.width * 16, f.width * 4); });
+	add("rgba2float", 4, 16, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2float(f.src, f.dst, f.width, f.height, f.width * 4, f.width * 16); });
+	add("half2rgba", 8, 4, [](const spoutCopy& c, const Frame& f) {
+		c.half2rgba(f.src, f.dst, f.width, f.height, f.width * 8, f.width * 4); });
+	add("rgba2half", 4, 8, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2half(f.src, f.dst, f.width, f.height, f.width * 4, f.width * 8); });
+	add("half2ushort", 8, 8, [](const spoutCopy& c, const Frame& f) {
+		c.half2ushort(f.src, f.dst, f.width, f.height, f.width * 8, f.width * 8); });
+	add("ushort2rgba", 8, 4, [](const spoutCopy& c, const Frame& f) {
+		c.ushort2rgba(f.src, f.dst, f.width, f.height, f.width * 8, f.width * 4); });
+	add("rgb10a2toushort", 4, 8, [](const spoutCopy& c, const Frame& f) {
+		c.rgb10a2toushort(f.src, f.dst, f.width, f.height, f.width * 4, f.width * 8); });
+	add("ushorttorgb10a2", 8, 4, [](const spoutCopy& c, const Frame& f) {
+		c.ushorttorgb10a2(f.src, f.dst, f.width, f.height, f.width * 8, f.width * 4); });
+	add("floattorgb10a2", 16, 4, [](const spoutCopy& c, const Frame& f) {
+		c.floattorgb10a2(f.src, f.dst, f.width, f.height, f.width * 16, f.width * 4); });
+
+	//
+	// Color conversion, set for the call and restored
+	//
+	auto color = [](const spoutCopy& c, SpoutTransfer sourceTransfer, SpoutGamut sourceGamut,
+		SpoutTransfer destTransfer, SpoutGamut destGamut) {
+		const_cast<spoutCopy&>(c).SetColor(sourceTransfer, sourceGamut, destTransfer, destGamut);
+	};
+	add("CopyImage_rgba_bgra_linear", 4, 4, [color](const spoutCopy& c, const Frame& f) {
+		color(c, SPOUT_TRANSFER_SRGB, SPOUT_GAMUT_709, SPOUT_TRANSFER_LINEAR, SPOUT_GAMUT_709);
+		c.CopyImage(f.src, f.dst, f.width, f.height, GL_RGBA, GL_BGRA_EXT);
+		color(c, SPOUT_TRANSFER_SRGB, SPOUT_GAMUT_709, SPOUT_TRANSFER_SRGB, SPOUT_GAMUT_709); });
+	add("CopyImage_rgba_bgra_709_2020", 4, 4, [color](const spoutCopy& c, const Frame& f) {
+		color(c, SPOUT_TRANSFER_SRGB, SPOUT_GAMUT_709, SPOUT_TRANSFER_SRGB, SPOUT_GAMUT_2020);
+		c.CopyImage(f.src, f.dst, f.width, f.height, GL_RGBA, GL_BGRA_EXT);
+		color(c, SPOUT_TRANSFER_SRGB, SPOUT_GAMUT_709, SPOUT_TRANSFER_SRGB, SPOUT_GAMUT_709); });
+	add("half2float_709_2020", 8, 16, [color](const spoutCopy& c, const Frame& f) {
+		color(c, SPOUT_TRANSFER_SRGB, SPOUT_GAMUT_709, SPOUT_TRANSFER_LINEAR, SPOUT_GAMUT_2020);
+		c.half2float(f.src, f.dst, f.width, f.height, f.width * 8, f.width * 16);
+		color(c, SPOUT_TRANSFER_SRGB, SPOUT_GAMUT_709, SPOUT_TRANSFER_SRGB, SPOUT_GAMUT_709); });
+
+	//
+	// Alpha premultiply and unpremultiply, set for the call and restored
+	//
+	auto alpha = [](const spoutCopy& c, SpoutAlpha mode) {
+		const_cast<spoutCopy&>(c).SetAlpha(mode);
+	};
+	add("CopyPixels_premultiply", 4, 4, [alpha](const spoutCopy& c, const Frame& f) {
+		alpha(c, SPOUT_ALPHA_PREMULTIPLY);
+		c.CopyPixels(f.src, f.dst, f.width, f.height);
+		alpha(c, SPOUT_ALPHA_NONE); });
+	add("CopyPixels_unpremultiply", 4, 4, [alpha](const spoutCopy& c, const Frame& f) {
+		alpha(c, SPOUT_ALPHA_UNPREMULTIPLY);
+		c.CopyPixels(f.src, f.dst, f.width, f.height);
+		alpha(c, SPOUT_ALPHA_NONE); });
+	add("float2half_premultiply", 16, 8, [alpha](const spoutCopy& c, const Frame& f) {
+		alpha(c, SPOUT_ALPHA_PREMULTIPLY);
+		c.float2half(f.src, f.dst, f.width, f.height, f.width * 16, f.width * 8);
+		alpha(c, SPOUT_ALPHA_NONE); });
+
+	//
+	// Dither to 8 bit, set for the call and restored
+	//
+	auto dither = [](const spoutCopy& c, SpoutDither mode) {
+		const_cast<spoutCopy&>(c).SetDither(mode);
+	};
+	add("float2rgba_bayer", 16, 4, [dither](const spoutCopy& c, const Frame& f) {
+		dither(c, SPOUT_DITHER_BAYER);
+		c.float2rgba(f.src, f.dst, f.width, f.height, f.width * 16, f.width * 4);
+		dither(c, SPOUT_DITHER_NONE); });
+	add("float2rgba_bluenoise", 16, 4, [dither](const spoutCopy& c, const Frame& f) {
+		dither(c, SPOUT_DITHER_BLUENOISE);
+		c.float2rgba(f.src, f.dst, f.width, f.height, f.width * 16, f.width * 4);
+		dither(c, SPOUT_DITHER_NONE); });
+	add("ushort2rgba_bluenoise", 8, 4, [dither](const spoutCopy& c, const Frame& f) {
+		dither(c, SPOUT_DITHER_BLUENOISE);
+		c.ushort2rgba(f.src, f.dst, f.width, f.height, f.width * 8, f.width * 4);
+		dither(c, SPOUT_DITHER_NONE); });
+
+	//
+	// 33 x 33 x 33 lookup table, contrast curve and channel mix
+	//
+	const unsigned int size = 33;
+	std::vector<float> rgb(size * size * size * 3);
+	for (unsigned int i = 0; i < size * size * size; i++) {
+		const float r = (float)(i % size) / (size - 1);
+		const float g = (float)((i / size) % size) / (size - 1);
+		const float b = (float)(i / (size * size)) / (size - 1);
+		auto curve = [](float v) { return v * v * (3.0f - 2.0f * v); };
+		rgb[i * 3 + 0] = curve(0.9f * r + 0.1f * g);
+		rgb[i * 3 + 1] = curve(g);
+		rgb[i * 3 + 2] = curve(0.1f * g + 0.9f * b);
+	}
+	auto lut = std::make_shared<spoutLUT>();
+	lut->Set(size, rgb.data());
+	add("ApplyLUT_rgba", 4, 4, [lut](const spoutCopy& c, const Frame& f) {
+		c.ApplyLUT(*lut, f.src, f.dst, f.width, f.height, GL_UNSIGNED_BYTE); });
+	add("ApplyLUT_ushort", 8, 8, [lut](const spoutCopy& c, const Frame& f) {
+		c.ApplyLUT(*lut, f.src, f.dst, f.width, f.height, GL_UNSIGNED_SHORT); });
+	add("ApplyLUT_half", 8, 8, [lut](const spoutCopy& c, const Frame& f) {
+		c.ApplyLUT(*lut, f.src, f.dst, f.width, f.height, GL_HALF_FLOAT); });
+	add("ApplyLUT_float", 16, 16, [lut](const spoutCopy& c, const Frame& f) {
+		c.ApplyLUT(*lut, f.src, f.dst, f.width, f.height, GL_FLOAT); });
+
+	//
+	// Y'CbCr, bytes per pixel of the packed formats
+	//
+	add("rgba2yuv_uyvy", 4, 2, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2yuv(f.src, f.dst, f.width, f.height, SPOUT_YUV_UYVY); });
+	add("yuv2rgba_uyvy", 2, 4, [](const spoutCopy& c, const Frame& f) {
+		c.yuv2rgba(f.src, f.dst, f.width, f.height, SPOUT_YUV_UYVY); });
+	add("rgba2yuv_v210", 4, 8.0 / 3.0, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2yuv(f.src, f.dst, f.width, f.height, SPOUT_YUV_V210); });
+	add("yuv2rgba_v210", 8.0 / 3.0, 4, [](const spoutCopy& c, const Frame& f) {
+		c.yuv2rgba(f.src, f.dst, f.width, f.height, SPOUT_YUV_V210); });
+	add("rgba2yuv_nv12", 4, 1.5, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2yuv(f.src, f.dst, f.width, f.height, SPOUT_YUV_NV12); });
+	add("yuv2rgba_nv12", 1.5, 4, [](const spoutCopy& c, const Frame& f) {
+		c.yuv2rgba(f.src, f.dst, f.width, f.height, SPOUT_YUV_NV12); });
+	add("rgba2yuv_ayuv", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2yuv(f.src, f.dst, f.width, f.height, SPOUT_YUV_AYUV, true); });
+	add("yuv2rgba_ayuv", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		c.yuv2rgba(f.src, f.dst, f.width, f.height, SPOUT_YUV_AYUV, true); });
+
+	//
+	// Regions, a frame from the centre of a double size image
+	// and the centre quarter of a frame scaled to a frame.
+	// Only the region of the source is read.
+	//
+	add("CopyRegion_crop", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		const SpoutRegion src = { f.width / 2, f.height / 2, f.width, f.height };
+		const SpoutRegion dst = { 0, 0, f.width, f.height };
+		c.CopyRegion(f.src, f.width * 2, f.height * 2, 0, GL_BGRA_EXT, src,
+			f.dst, f.width, f.height, 0, GL_RGBA, dst); });
+	add("ConvertRegion_half_rgba", 8, 4, [](const spoutCopy& c, const Frame& f) {
+		// Double width for the size of the source buffer
+		const SpoutRegion src = { f.width / 2, 0, f.width, f.height };
+		const SpoutRegion dst = { 0, 0, f.width, f.height };
+		c.ConvertRegion(f.src, f.width * 2, f.height, 0, GL_HALF_FLOAT, src,
+			f.dst, f.width, f.height, 0, GL_UNSIGNED_BYTE, dst); });
+	add("ResampleRegion_zoom", 4, 4, [](const spoutCopy& c, const Frame& f) {
+		const SpoutRegion src = { f.width / 4, f.height / 4, f.width / 2, f.height / 2 };
+		const SpoutRegion dst = { 0, 0, f.width, f.height };
+		c.ResampleRegion(f.src, f.width, f.height, 0, GL_RGBA, src,
+			f.dst, f.width, f.height, 0, GL_BGRA_EXT, dst); });
+
+	//
+	// Content hash, read only
+	//
+	add("HashImage", 4, 0, [](const spoutCopy& c, const Frame& f) {
+		c.HashImage(f.src, f.width, f.height); });
+	add("HashImage_float_pitch", 16, 0, [](const spoutCopy& c, const Frame& f) {
+		c.HashImage(f.src, f.width, f.height, 16, f.width * 16 + f.pad); });
+
+	//
+	// Dirty tiles against a copy of the frame, unchanged or with a
+	// ticker of 640x64 pixels changed at the bottom
+	//
+	struct TileFrames {
+		std::vector<unsigned char> previous;
+		std::vector<unsigned char> ticker;
+		std::vector<unsigned char> map;
+		void Update(const Frame& f) {
+			const size_t size = (size_t)f.width * f.height * 4;
+			if (previous.size() == size)
+				return;
+			previous.assign(f.src, f.src + size);
+			ticker = previous;
+			for (unsigned int y = f.height - 64; y < f.height; y++)
+				for (unsigned int x = 0; x < 640 * 4; x++)
+					ticker[((size_t)y * f.width) * 4 + x] ^= 0x55;
+			map.assign(spoutCopy::TileMapSize(f.width, f.height), 0);
+		}
+	};
+	auto tiles = std::make_shared<TileFrames>();
+	add("DiffTiles_unchanged", 8, 0, [tiles](const spoutCopy& c, const Frame& f) {
+		tiles->Update(f);
+		c.DiffTiles(tiles->previous.data(), f.src, f.width, f.height, 4, tiles->map.data()); });
+	add("DiffTiles_ticker", 8, 0, [tiles](const spoutCopy& c, const Frame& f) {
+		tiles->Update(f);
+		c.DiffTiles(tiles->ticker.data(), f.src, f.width, f.height, 4, tiles->map.data()); });
+	add("DiffCopyTiles_ticker", 8, 0.08, [tiles](const spoutCopy& c, const Frame& f) {
+		tiles->Update(f);
+		c.DiffTiles(tiles->ticker.data(), f.src, f.width, f.height, 4, tiles->map.data());
+		c.CopyTiles(f.src, f.dst, f.width, f.height, 4, tiles->map.data()); });
+
+	//
+	// Mip pyramid, one level for a half size preview and all levels for thumbnails
+	//
+	add("MipPyramid_1", 4, 1, [](const spoutCopy& c, const Frame& f) {
+		c.MipPyramid(f.src, f.dst, f.width, f.height, 1); });
+	add("MipPyramid_all", 4, 1.33, [](const spoutCopy& c, const Frame& f) {
+		c.MipPyramid(f.src, f.dst, f.width, f.height, spoutCopy::MipLevels(f.width, f.height)); });
+	add("rgba2rgbaResample_half", 4, 1, [](const spoutCopy& c, const Frame& f) {
+		c.rgba2rgbaResample(f.src, f.dst, f.width, f.height, f.width * 4, f.width / 2, f.height / 2); });
+
+	return k;
+}
+
+// Read an 8 MB working set, one cache line at a time in random order
+// so that the time depends on how much of it is still in the cache.
+struct CacheProbe {
+	static const size_t stride = 64 / sizeof(uint32_t);
+	std::vector<uint32_t> data;
+	uint32_t index = 0;
+	explicit CacheProbe(size_t bytes = 8 * 1024 * 1024) : data(std::max(bytes, (size_t)4096) / sizeof(uint32_t)) {
+		const size_t lines = data.size() / stride;
+		std::vector<uint32_t> order(lines);
+		for (size_t i = 0; i < lines; i++) order[i] = (uint32_t)i;
+		for (size_t i = lines - 1; i > 0; i--)
+			std::swap(order[i], order[(size_t)rand() % (i + 1)]);
+		// One cycle through all lines
+		for (size_t i = 0; i < lines; i++)
+			data[order[i] * stride] = order[(i + 1) % lines];
+	}
+	void Walk() {
+		Walk(data.size() / stride);
+	}
+	// Read a number of lines, continuing from the last.
+	// The index is kept in a volatile so the reads are not optimised away.
+	void Walk(size_t lines) {
+		uint32_t next = index;
+		for (size_t i = 0; i < lines; i++)
+			next = data[next * stride];
+		index = next;
+		sink = next;
+	}
+	static volatile uint32_t sink;
+};
+
+// A second thread that reads a working set which fits the cache, as another
+// application or the receiver's own processing would while a frame is copied.
+// Lines read are counted so that the rate during a copy can be compared
+// with the rate alone.
+struct Neighbour {
+	CacheProbe probe;
+	std::atomic<bool> bRun{ false };
+	std::atomic<uint64_t> lines{ 0 };
+	std::thread thread;
+	double alone = 0.0; // Lines per ms without a copy
+	explicit Neighbour(size_t bytes) : probe(bytes) {}
+	~Neighbour() { Stop(); }
+	void Start() {
+		if (bRun.exchange(true))
+			return;
+		thread = std::thread([this] {
+			while (bRun.load(std::memory_order_relaxed)) {
+				probe.Walk(1024);
+				lines.fetch_add(1024, std::memory_order_relaxed);
+			}
+		});
+		// Rate alone, once the working set is in the cache
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		const uint64_t l0 = lines.load();
+		const auto t0 = std::chrono::steady_clock::now();
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		alone = (double)(lines.load() - l0) / std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	}
+	void Stop() {
+		if (bRun.exchange(false))
+			thread.join();
+	}
+	// Percent fewer lines read than alone, from a count and time during a copy
+	double Slowdown(uint64_t count, double ms) const {
+		if (alone <= 0.0 || ms <= 0.0)
+			return 0.0;
+		return 100.0 * (1.0 - (double)count / ms / alone);
+	}
+};
+
+volatile uint32_t CacheProbe::sink = 0;
+
+double Median(std::vector<double> v)
+{
+	std::sort(v.begin(), v.end());
+	return v[v.size() / 2];
+}
+
+} // namespace
+
+
+int main(int argc, char* argv[])
+{
+	bool bJson = false;
+	unsigned int iterations = 10;
+	unsigned int threads = 1;
+	std::string filter;
+	std::vector<Resolution> resolutions;
+	std::vector<std::string> names; // storage for --resolution names
+
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		const bool bValue = (i + 1 < argc);
+		if (arg == "--json") {
+			bJson = true;
+		}
+		else if (arg == "--iterations" && bValue) {
+			iterations = (unsigned int)std::max(1, atoi(argv[++i]));
+		}
+		else if (arg == "--threads" && bValue) {
+			threads = (unsigned int)atoi(argv[++i]);
+		}
+		else if (arg == "--filter" && bValue) {
+			filter = argv[++i];
+		}
+		else if (arg == "--resolution" && bValue) {
+			unsigned int w = 0, h = 0;
+			if (sscanf(argv[++i], "%ux%u", &w, &h) != 2 || w < 2 || h < 2) {
+				fprintf(stderr, "Invalid resolution %s\n", argv[i]);
+				return 1;
+			}
+			names.push_back(argv[i]);
+			resolutions.push_back({ nullptr, w, h });
+		}
+		else {
+			fprintf(stderr, "Usage : SpoutCopyBench [--json] [--iterations n] [--threads n] [--resolution WxH] [--filter name]\n");
+			return 1;
+		}
+	}
+	for (size_t i = 0; i < resolutions.size(); i++)
+		resolutions[i].name = names[i].c_str();
+	if (resolutions.empty()) {
+		resolutions = {
+			{ "1080p", 1920, 1080 },
+			{ "4K", 3840, 2160 },
+			{ "6K", 6144, 3456 },
+			{ "8K", 7680, 4320 },
+		};
+	}
+
+	spoutCopy probe;
+	const SpoutSIMD maxlevel = probe.GetMaxSIMD();
+	const std::vector<Kernel> kernels = Kernels();
+	CacheProbe cache;
+	Neighbour neighbour(std::min(probe.GetCacheSize() / 2, (size_t)8 * 1024 * 1024));
+	const bool bNeighbour = (std::thread::hardware_concurrency() > 1);
+
+	if (bJson) {
+		printf("{\n  \"max_simd\": \"%s\",\n  \"cache_bytes\": %zu,\n  \"threads\": %u,\n  \"iterations\": %u,\n  \"results\": [",
+			SIMDName(maxlevel), probe.GetCacheSize(), threads, iterations);
+	}
+	else {
+		printf("Max SIMD %s, last level cache %zu KB, %u thread(s), median of %u\n\n",
+			SIMDName(maxlevel), probe.GetCacheSize() / 1024, threads, iterations);
+		printf("%-36s %-7s %-10s %10s %10s %10s %10s %11s\n",
+			"function", "simd", "resolution", "ms", "GB/s", "ns/pixel", "probe ms", "neighbour %");
+	}
+
+	bool bFirst = true;
+	for (const Resolution& res : resolutions) {
+
+		// Largest source is RGBA32F or double size RGBA8, both 16 bytes per pixel,
+		// with padding for the pitch variants.
+		const unsigned int pad = 64;
+		const size_t bytes = ((size_t)res.width * 16 + pad) * (res.height + 1);
+		std::vector<unsigned char> src(bytes);
+		std::vector<unsigned char> dst(bytes);
+		for (size_t i = 0; i < bytes; i++)
+			src[i] = (unsigned char)(rand() >> 4);
+		const Frame frame = { src.data(), dst.data(), res.width, res.height, pad };
+		const double pixels = (double)res.width * res.height;
+
+		for (int level = SPOUT_SIMD_NONE; level <= (int)maxlevel; level++) {
+
+			spoutCopy copy;
+			copy.SetSIMD((SpoutSIMD)level);
+			if (threads != 1)
+				copy.SetThreads(threads);
+
+			for (const Kernel& k : kernels) {
+				if (!filter.empty() && std::string(k.name).find(filter) == std::string::npos)
+					continue;
+
+				const size_t stream = copy.GetStreamSize();
+				if (k.stream == 0) copy.SetStreamSize(SIZE_MAX);
+				if (k.stream == 1) copy.SetStreamSize(0);
+
+				k.run(copy, frame); // warm up
+
+				std::vector<double> times;
+				std::vector<double> probes;
+				for (unsigned int i = 0; i < iterations; i++) {
+					if (k.stream >= 0)
+						cache.Walk(); // load the working set
+					auto t0 = std::chrono::steady_clock::now();
+					k.run(copy, frame);
+					auto t1 = std::chrono::steady_clock::now();
+					times.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+					if (k.stream >= 0) {
+						cache.Walk(); // read it again after the copy
+						probes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t1).count());
+					}
+				}
+
+				// The same copies with the neighbour reading its working set
+				std::vector<double> slowdowns;
+				if (k.stream >= 0 && bNeighbour) {
+					neighbour.Start();
+					for (unsigned int i = 0; i < iterations; i++) {
+						const uint64_t l0 = neighbour.lines.load();
+						auto t0 = std::chrono::steady_clock::now();
+						k.run(copy, frame);
+						auto t1 = std::chrono::steady_clock::now();
+						slowdowns.push_back(neighbour.Slowdown(neighbour.lines.load() - l0,
+							std::chrono::duration<double, std::milli>(t1 - t0).count()));
+					}
+					neighbour.Stop();
+				}
+				copy.SetStreamSize(stream);
+
+				const double ms = Median(times);
+				const double gbps = pixels * (k.srcBytes + k.dstBytes) / (ms * 1.0e6);
+				const double nspp = ms * 1.0e6 / pixels;
+				const double probems = probes.empty() ? 0.0 : Median(probes);
+				const double slowdown = slowdowns.empty() ? -1.0 : Median(slowdowns);
+
+				if (bJson) {
+					printf("%s\n    {\"function\": \"%s\", \"simd\": \"%s\", \"resolution\": \"%s\", "
+						"\"width\": %u, \"height\": %u, \"ms\": %.4f, \"gbps\": %.3f, \"ns_per_pixel\": %.4f",
+						bFirst ? "" : ",", k.name, SIMDName((SpoutSIMD)level), res.name,
+						res.width, res.height, ms, gbps, nspp);
+					if (!probes.empty())
+						printf(", \"probe_ms\": %.4f", probems);
+					if (!slowdowns.empty())
+						printf(", \"neighbour_slowdown\": %.2f", slowdown);
+					printf("}");
+					bFirst = false;
+				}
+				else {
+					printf("%-36s %-7s %-10s %10.3f %10.2f %10.3f", k.name, SIMDName((SpoutSIMD)level), res.name, ms, gbps, nspp);
+					if (!probes.empty())
+						printf(" %10.3f", probems);
+					if (!slowdowns.empty())
+						printf(" %11.1f", slowdown);
+					printf("\n");
+				}
+				fflush(stdout);
+			}
+		}
+	}
+
+	if (bJson)
+		printf("\n  ]\n}\n");
+
+	return 0;
+}
@@ -0,0 +1,1312 @@
+/*
+
+	SpoutCopyVerify.cpp
+
+	Differential check of the spoutCopy functions for each instruction set
+
+	Every function is run on randomized images for every instruction set
+	supported by the CPU, single threaded, in parallel row bands and with
+	streaming stores, and the result compared with a scalar reference.
+
+	Cases include 1 pixel images, odd widths, line pitch that is not a
+	multiple of 16, pointers that are not 16 byte aligned, widths and
+	heights large enough for the SSE and AVX paths, invert and mirror.
+	Bytes outside the destination image, including line padding,
+	must not be changed.
+
+	The 8 bit copy and swizzle functions are compared with a plain
+	per-pixel copy in this file. The resample, high bit depth, color
+	and alpha conversion, dither, lookup table and Y'CbCr functions are compared with the scalar path of the library
+	(SPOUT_SIMD_NONE).
+
+	The first mismatching pixel is reported for each function with the
+	case, so that it can be repeated with the same seed.
+
+	Usage :
+		SpoutCopyVerify [--seed n] [--cases n] [--filter name]
+
+		--seed    random seed (default 1)
+		--cases   random cases for each function (default 100)
+		--filter  only functions with names containing this text
+
+	Returns 0 if all functions match, 1 otherwise.
+
+*/
+
+#include "../SpoutCopy.h"
+#include "../SpoutLUT.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::mt19937 Rng;
+
+unsigned Random(Rng& rng, unsigned lo, unsigned hi)
+{
+	return std::uniform_int_distribution<unsigned>(lo, hi)(rng);
+}
+
+bool Chance(Rng& rng, unsigned percent)
+{
+	return Random(rng, 0, 99) < percent;
+}
+
+// Image memory with guard bytes before and after
+// that must not be changed by the function tested
+struct Buffer {
+	static const size_t guard = 64;
+	std::vector<unsigned char> raw;
+	unsigned char* base = nullptr; // 64 byte aligned
+	unsigned char* data = nullptr; // base + guard + offset
+	size_t size = 0;
+	size_t span = 0; // guard to guard
+
+	void Allocate(size_t bytes, unsigned offset)
+	{
+		size = bytes;
+		span = guard + offset + bytes + guard;
+		raw.assign(span + 64, 0xCD);
+		base = reinterpret_cast<unsigned char*>((reinterpret_cast<uintptr_t>(raw.data()) + 63) & ~(uintptr_t)63);
+		data = base + guard + offset;
+	}
+	void Fill(unsigned char value)
+	{
+		memset(base, value, span);
+	}
+};
+
+// Source data
+enum SourceData {
+	SOURCE_BYTES,
+	SOURCE_FLOAT, // RGBA32F values in and out of 0-1
+	SOURCE_HALF,  // RGBA16F bit patterns without NaN
+};
+
+struct Case {
+	unsigned width = 0;
+	unsigned height = 0;
+	unsigned srcBytes = 4; // bytes per pixel
+	unsigned dstBytes = 4;
+	unsigned srcPitch = 0; // bytes
+	unsigned dstPitch = 0;
+	unsigned dstWidth = 0; // resample
+	unsigned dstHeight = 0;
+	size_t srcSize = 0; // bytes of formats without whole pixels, 0 from pitch and height
+	size_t dstSize = 0;
+	unsigned srcOffset = 0; // from 64 byte alignment
+	unsigned dstOffset = 0;
+	bool bInvert = false;
+	bool bMirror = false;
+	bool bSwap = false;
+	SourceData data = SOURCE_BYTES;
+	std::string detail; // formats or other arguments
+	// Function tested
+	std::function<void(const spoutCopy&, const unsigned char*, unsigned char*)> run;
+	// Reference, empty for the scalar path of the library
+	std::function<void(const unsigned char*, unsigned char*)> reference;
+};
+
+typedef void (*CaseSetup)(Rng& rng, Case& c);
+
+struct Test {
+	const char* name;
+	CaseSetup setup;
+};
+
+// Variations run for each instruction set
+struct Variant {
+	unsigned threads;
+	bool bStream;
+};
+
+const Variant variants[] = {
+	{ 1, false },
+	{ 1, true },
+	{ 3, false },
+};
+
+const char* SIMDName(SpoutSIMD level)
+{
+	switch (level) {
+		case SPOUT_SIMD_SSE2:   return "sse2";
+		case SPOUT_SIMD_SSSE3:  return "ssse3";
+		case SPOUT_SIMD_AVX2:   return "avx2";
+		case SPOUT_SIMD_AVX512: return "avx512";
+		default:                return "none";
+	}
+}
+
+const char* FormatName(GLenum format)
+{
+	switch (format) {
+		case GL_RGBA:      return "RGBA";
+		case GL_BGRA_EXT:  return "BGRA";
+		case GL_RGB:       return "RGB";
+		case GL_BGR_EXT:   return "BGR";
+		default:           return "LUMINANCE";
+	}
+}
+
+unsigned FormatBytes(GLenum format)
+{
+	if (format == GL_RGBA || format == GL_BGRA_EXT)
+		return 4;
+	if (format == GL_RGB || format == GL_BGR_EXT)
+		return 3;
+	return 1;
+}
+
+bool FormatBGR(GLenum format)
+{
+	return format == GL_BGRA_EXT || format == GL_BGR_EXT;
+}
+
+//
+// Reference
+//
+
+// Per-pixel copy and conversion between 8 bit formats
+void ReferenceCopy(const unsigned char* source, unsigned char* dest,
+	unsigned width, unsigned height, GLenum srcFormat, GLenum dstFormat,
+	unsigned srcPitch, unsigned dstPitch, bool bInvert, bool bMirror, bool bSwap)
+{
+	const unsigned sb = FormatBytes(srcFormat);
+	const unsigned db = FormatBytes(dstFormat);
+	const bool bSwapRB = (FormatBGR(srcFormat) != FormatBGR(dstFormat)) != bSwap;
+	for (unsigned y = 0; y < height; y++) {
+		const unsigned char* src = source + (size_t)(bInvert ? height - 1 - y : y) * srcPitch;
+		unsigned char* dst = dest + (size_t)y * dstPitch;
+		for (unsigned x = 0; x < width; x++) {
+			const unsigned char* s = src + (size_t)(bMirror ? width - 1 - x : x) * sb;
+			unsigned char* d = dst + (size_t)x * db;
+			if (sb == 1) {
+				d[0] = s[0];
+				continue;
+			}
+			unsigned char r = s[0], g = s[1], b = s[2];
+			const unsigned char a = (sb == 4) ? s[3] : 255;
+			if (bSwapRB) {
+				const unsigned char t = r;
+				r = b;
+				b = t;
+			}
+			d[0] = r;
+			d[1] = g;
+			d[2] = b;
+			if (db == 4)
+				d[3] = a;
+		}
+	}
+}
+
+//
+// Random cases
+//
+
+// Image size, mostly small with some wide enough for the SSE and
+// AVX paths and some large enough for FlipBuffer to use them
+void RandomSize(Rng& rng, Case& c)
+{
+	const unsigned n = Random(rng, 0, 99);
+	if (n < 5) {
+		c.width = 1;
+		c.height = 1;
+	}
+	else if (n < 55) {
+		c.width = Random(rng, 1, 70);
+		c.height = Random(rng, 1, 9);
+	}
+	else if (n < 90) {
+		c.width = Random(rng, 300, 700);
+		c.height = Random(rng, 1, 5);
+	}
+	else {
+		c.width = Random(rng, 320, 360);
+		c.height = Random(rng, 240, 243);
+	}
+	// Multiples of 16 for the SSE paths
+	if (c.width > 16 && Chance(rng, 25))
+		c.width &= ~15u;
+}
+
+// Line pitch, often with padding that is not a multiple of 16
+unsigned RandomPitch(Rng& rng, unsigned width, unsigned pixelBytes)
+{
+	const unsigned pitch = width * pixelBytes;
+	if (Chance(rng, 40))
+		return pitch;
+	// Whole pixel elements for formats wider than 3 bytes
+	const unsigned step = (pixelBytes >= 4) ? 4 : 1;
+	return pitch + Random(rng, 1, 17) * step;
+}
+
+// Pointer offset from 64 byte alignment
+unsigned RandomOffset(Rng& rng, unsigned pixelBytes)
+{
+	if (Chance(rng, 40))
+		return 0;
+	const unsigned step = (pixelBytes >= 4) ? 4 : 1;
+	return Random(rng, 1, 15) * step;
+}
+
+void RandomCase(Rng& rng, Case& c, unsigned srcBytes, unsigned dstBytes,
+	bool bSrcPitch, bool bDstPitch)
+{
+	RandomSize(rng, c);
+	c.srcBytes = srcBytes;
+	c.dstBytes = dstBytes;
+	c.srcPitch = bSrcPitch ? RandomPitch(rng, c.width, srcBytes) : c.width * srcBytes;
+	c.dstPitch = bDstPitch ? RandomPitch(rng, c.width, dstBytes) : c.width * dstBytes;
+	c.srcOffset = RandomOffset(rng, srcBytes);
+	c.dstOffset = RandomOffset(rng, dstBytes);
+	c.bInvert = Chance(rng, 50);
+}
+
+GLenum RandomFormat(Rng& rng)
+{
+	const GLenum formats[] = { GL_RGBA, GL_BGRA_EXT, GL_RGB, GL_BGR_EXT };
+	return formats[Random(rng, 0, 3)];
+}
+
+// Reference for the functions that are a CopyImage of the case
+void SetCopyReference(Case& c, GLenum srcFormat, GLenum dstFormat)
+{
+	const Case k = c;
+	c.reference = [k, srcFormat, dstFormat](const unsigned char* src, unsigned char* dst) {
+		ReferenceCopy(src, dst, k.width, k.height, srcFormat, dstFormat,
+			k.srcPitch, k.dstPitch, k.bInvert, k.bMirror, k.bSwap);
+	};
+}
+
+//
+// Functions tested
+//
+
+void SetupCopyPixels(Rng& rng, Case& c)
+{
+	const GLenum formats[] = { GL_RGBA, GL_BGRA_EXT, GL_RGB, GL_BGR_EXT, GL_LUMINANCE };
+	const GLenum format = formats[Random(rng, 0, 4)];
+	RandomCase(rng, c, FormatBytes(format), FormatBytes(format), false, false);
+	c.detail = FormatName(format);
+	SetCopyReference(c, format, format);
+	const Case k = c;
+	c.run = [k, format](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.CopyPixels(src, dst, k.width, k.height, format, k.bInvert);
+	};
+}
+
+void SetupFlipBuffer(Rng& rng, Case& c)
+{
+	const GLenum formats[] = { GL_RGBA, GL_RGB, GL_LUMINANCE };
+	const GLenum format = formats[Random(rng, 0, 2)];
+	RandomCase(rng, c, FormatBytes(format), FormatBytes(format), false, false);
+	c.bInvert = true;
+	c.detail = FormatName(format);
+	SetCopyReference(c, format, format);
+	const Case k = c;
+	c.run = [k, format](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.FlipBuffer(src, dst, k.width, k.height, format);
+	};
+}
+
+void SetupRemovePadding(Rng& rng, Case& c)
+{
+	const GLenum format = Chance(rng, 50) ? GL_RGBA : GL_RGB;
+	RandomCase(rng, c, FormatBytes(format), FormatBytes(format), true, false);
+	c.bInvert = false;
+	c.detail = FormatName(format);
+	SetCopyReference(c, format, format);
+	const Case k = c;
+	c.run = [k, format](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.RemovePadding(src, dst, k.width, k.height, k.srcPitch, format);
+	};
+}
+
+void SetupRgba2rgbaPitch(Rng& rng, Case& c)
+{
+	RandomCase(rng, c, 4, 4, true, false);
+	SetCopyReference(c, GL_RGBA, GL_RGBA);
+	const Case k = c;
+	c.run = [k](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.rgba2rgba(src, dst, k.width, k.height, k.srcPitch, k.bInvert);
+	};
+}
+
+void SetupRgba2rgbaPitch2(Rng& rng, Case& c)
+{
+	RandomCase(rng, c, 4, 4, true, true);
+	SetCopyReference(c, GL_RGBA, GL_RGBA);
+	const Case k = c;
+	c.run = [k](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.rgba2rgba(src, dst, k.width, k.height, k.srcPitch, k.dstPitch, k.bInvert);
+	};
+}
+
+void SetupRgba2bgra(Rng& rng, Case& c)
+{
+	RandomCase(rng, c, 4, 4, false, false);
+	SetCopyReference(c, GL_RGBA, GL_BGRA_EXT);
+	const Case k = c;
+	c.run = [k](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.rgba2bgra(src, dst, k.width, k.height, k.bInvert);
+	};
+}
+
+void SetupBgra2rgba(Rng& rng, Case& c)
+{
+	RandomCase(rng, c, 4, 4, false, false);
+	SetCopyReference(c, GL_BGRA_EXT, GL_RGBA);
+	const Case k = c;
+	c.run = [k](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.bgra2rgba(src, dst, k.width, k.height, k.bInvert);
+	};
+}
+
+void SetupRgba2bgraPitch(Rng& rng, Case& c)
+{
+	RandomCase(rng, c, 4, 4, true, false);
+	SetCopyReference(c, GL_RGBA, GL_BGRA_EXT);
+	const Case k = c;
+	c.run = [k](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.rgba2bgra(src, dst, k.width, k.height, k.srcPitch, k.bInvert);
+	};
+}
+
+void SetupRgba2bgraPitch2(Rng& rng, Case& c)
+{
+	RandomCase(rng, c, 4, 4, true, true);
+	SetCopyReference(c, GL_RGBA, GL_BGRA_EXT);
+	const Case k = c;
+	c.run = [k](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.rgba2bgra(src, dst, k.width, k.height, k.srcPitch, k.dstPitch, k.bInvert);
+	};
+}
+
+// The RGB <> RGBA wrappers
+struct Wrapper {
+	const char* name;
+	GLenum srcFormat;
+	GLenum dstFormat;
+	bool bSrcPitch;
+	bool bDstPitch;
+};
+
+const Wrapper wrappers[] = {
+	{ "rgb2rgba",       GL_RGB,      GL_RGBA,     false, false },
+	{ "bgr2rgba",       GL_BGR_EXT,  GL_RGBA,     false, false },
+	{ "rgb2bgra",       GL_RGB,      GL_BGRA_EXT, false, false },
+	{ "bgr2bgra",       GL_BGR_EXT,  GL_BGRA_EXT, false, false },
+	{ "rgba2bgr",       GL_RGBA,     GL_BGR_EXT,  false, false },
+	{ "bgra2rgb",       GL_BGRA_EXT, GL_RGB,      false, false },
+	{ "bgra2bgr",       GL_BGRA_EXT, GL_BGR_EXT,  false, false },
+	{ "rgb2rgba pitch", GL_RGB,      GL_RGBA,     false, true  },
+	{ "bgr2rgba pitch", GL_BGR_EXT,  GL_RGBA,     false, true  },
+	{ "rgb2bgra pitch", GL_RGB,      GL_BGRA_EXT, false, true  },
+	{ "rgba2rgb pitch", GL_RGBA,     GL_RGB,      true,  false },
+	{ "rgba2bgr pitch", GL_RGBA,     GL_BGR_EXT,  true,  false },
+};
+
+void SetupWrappers(Rng& rng, Case& c)
+{
+	const unsigned n = Random(rng, 0, sizeof(wrappers) / sizeof(wrappers[0]) - 1);
+	const Wrapper& w = wrappers[n];
+	RandomCase(rng, c, FormatBytes(w.srcFormat), FormatBytes(w.dstFormat), w.bSrcPitch, w.bDstPitch);
+	if (n == 10) {
+		// rgba2rgb mirror and swap for SpoutCam
+		c.bMirror = Chance(rng, 50);
+		c.bSwap = Chance(rng, 50);
+	}
+	c.detail = w.name;
+	SetCopyReference(c, w.srcFormat, w.dstFormat);
+	const Case k = c;
+	c.run = [k, n](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		switch (n) {
+			case 0:  copy.rgb2rgba(src, dst, k.width, k.height, k.bInvert); break;
+			case 1:  copy.bgr2rgba(src, dst, k.width, k.height, k.bInvert); break;
+			case 2:  copy.rgb2bgra(src, dst, k.width, k.height, k.bInvert); break;
+			case 3:  copy.bgr2bgra(src, dst, k.width, k.height, k.bInvert); break;
+			case 4:  copy.rgba2bgr(src, dst, k.width, k.height, k.bInvert); break;
+			case 5:  copy.bgra2rgb(src, dst, k.width, k.height, k.bInvert); break;
+			case 6:  copy.bgra2bgr(src, dst, k.width, k.height, k.bInvert); break;
+			case 7:  copy.rgb2rgba(src, dst, k.width, k.height, k.dstPitch, k.bInvert); break;
+			case 8:  copy.bgr2rgba(src, dst, k.width, k.height, k.dstPitch, k.bInvert); break;
+			case 9:  copy.rgb2bgra(src, dst, k.width, k.height, k.dstPitch, k.bInvert); break;
+			case 10: copy.rgba2rgb(src, dst, k.width, k.height, k.srcPitch, k.bInvert, k.bMirror, k.bSwap); break;
+			default: copy.rgba2bgr(src, dst, k.width, k.height, k.srcPitch, k.bInvert); break;
+		}
+	};
+}
+
+void SetupCopyImage(Rng& rng, Case& c)
+{
+	GLenum srcFormat = RandomFormat(rng);
+	GLenum dstFormat = RandomFormat(rng);
+	if (Chance(rng, 10))
+		srcFormat = dstFormat = GL_LUMINANCE;
+	RandomCase(rng, c, FormatBytes(srcFormat), FormatBytes(dstFormat), true, true);
+	c.bMirror = Chance(rng, 30);
+	c.bSwap = Chance(rng, 30);
+	c.detail = std::string(FormatName(srcFormat)) + " to " + FormatName(dstFormat);
+	SetCopyReference(c, srcFormat, dstFormat);
+	const Case k = c;
+	c.run = [k, srcFormat, dstFormat](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.CopyImage(src, dst, k.width, k.height, srcFormat, dstFormat,
+			k.srcPitch, k.dstPitch, k.bInvert, k.bMirror, k.bSwap);
+	};
+}
+
+void SetupResample(Rng& rng, Case& c)
+{
+	const unsigned n = Random(rng, 0, 2); // rgba, rgb, bgr
+	RandomCase(rng, c, 4, n == 0 ? 4 : 3, true, false);
+	c.dstWidth = Chance(rng, 50) ? Random(rng, 1, c.width) : Random(rng, c.width, c.width * 2);
+	c.dstHeight = Chance(rng, 50) ? Random(rng, 1, c.height) : Random(rng, c.height, c.height * 2);
+	c.dstPitch = c.dstWidth * c.dstBytes;
+	c.bMirror = (n == 1) && Chance(rng, 50);
+	c.bSwap = (n == 1) && Chance(rng, 50);
+	const SpoutResample filter = (SpoutResample)Random(rng, SPOUT_RESAMPLE_AUTO, SPOUT_RESAMPLE_LANCZOS3);
+	const char* names[] = { "rgba2rgbaResample", "rgba2rgbResample", "rgba2bgrResample" };
+	const char* filters[] = { "auto", "nearest", "bilinear", "area", "catmullrom", "lanczos3" };
+	char detail[128];
+	snprintf(detail, sizeof(detail), "%s %s to %ux%u", names[n], filters[filter], c.dstWidth, c.dstHeight);
+	c.detail = detail;
+	const Case k = c;
+	c.run = [k, n, filter](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		// The filter is state of the class
+		const_cast<spoutCopy&>(copy).SetResample(filter);
+		if (n == 0)
+			copy.rgba2rgbaResample(src, dst, k.width, k.height, k.srcPitch, k.dstWidth, k.dstHeight, k.bInvert);
+		else if (n == 1)
+			copy.rgba2rgbResample(src, dst, k.width, k.height, k.srcPitch, k.dstWidth, k.dstHeight, k.bInvert, k.bMirror, k.bSwap);
+		else
+			copy.rgba2bgrResample(src, dst, k.width, k.height, k.srcPitch, k.dstWidth, k.dstHeight, k.bInvert);
+	};
+}
+
+// High bit depth and packed conversions
+typedef void (spoutCopy::*Convert)(const void*, void*, unsigned int, unsigned int,
+	unsigned int, unsigned int, bool) const;
+
+struct Conversion {
+	const char* name;
+	Convert function;
+	unsigned srcBytes;
+	unsigned dstBytes;
+	SourceData data;
+};
+
+const Conversion conversions[] = {
+	{ "float2half",      &spoutCopy::float2half,      16,  8, SOURCE_FLOAT },
+	{ "half2float",      &spoutCopy::half2float,       8, 16, SOURCE_HALF  },
+	{ "half2ushort",     &spoutCopy::half2ushort,      8,  8, SOURCE_HALF  },
+	{ "ushort2half",     &spoutCopy::ushort2half,      8,  8, SOURCE_BYTES },
+	{ "float2ushort",    &spoutCopy::float2ushort,    16,  8, SOURCE_FLOAT },
+	{ "ushort2float",    &spoutCopy::ushort2float,     8, 16, SOURCE_BYTES },
+	{ "float2rgba",      &spoutCopy::float2rgba,      16,  4, SOURCE_FLOAT },
+	{ "rgba2float",      &spoutCopy::rgba2float,       4, 16, SOURCE_BYTES },
+	{ "half2rgba",       &spoutCopy::half2rgba,        8,  4, SOURCE_HALF  },
+	{ "rgba2half",       &spoutCopy::rgba2half,        4,  8, SOURCE_BYTES },
+	{ "ushort2rgba",     &spoutCopy::ushort2rgba,      8,  4, SOURCE_BYTES },
+	{ "rgba2ushort",     &spoutCopy::rgba2ushort,      4,  8, SOURCE_BYTES },
+	{ "rgb10a2toushort", &spoutCopy::rgb10a2toushort,  4,  8, SOURCE_BYTES },
+	{ "ushorttorgb10a2", &spoutCopy::ushorttorgb10a2,  8,  4, SOURCE_BYTES },
+	{ "rgb10a2torgba",   &spoutCopy::rgb10a2torgba,    4,  4, SOURCE_BYTES },
+	{ "rgbatorgb10a2",   &spoutCopy::rgbatorgb10a2,    4,  4, SOURCE_BYTES },
+	{ "rgb10a2tofloat",  &spoutCopy::rgb10a2tofloat,   4, 16, SOURCE_BYTES },
+	{ "floattorgb10a2",  &spoutCopy::floattorgb10a2,  16,  4, SOURCE_FLOAT },
+};
+
+template<int n>
+void SetupConversion(Rng& rng, Case& c)
+{
+	const Conversion& conversion = conversions[n];
+	RandomCase(rng, c, conversion.srcBytes, conversion.dstBytes, true, true);
+	c.data = conversion.data;
+	const Case k = c;
+	const Convert function = conversion.function;
+	c.run = [k, function](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		(copy.*function)(src, dst, k.width, k.height, k.srcPitch, k.dstPitch, k.bInvert);
+	};
+}
+
+// Color conversion, set for the call and restored
+struct ColorCase {
+	SpoutTransfer sourceTransfer;
+	SpoutGamut sourceGamut;
+	SpoutTransfer destTransfer;
+	SpoutGamut destGamut;
+};
+
+ColorCase RandomColor(Rng& rng, std::string& detail)
+{
+	ColorCase color;
+	do {
+		color.sourceTransfer = (SpoutTransfer)Random(rng, SPOUT_TRANSFER_SRGB, SPOUT_TRANSFER_LINEAR);
+		color.sourceGamut = (SpoutGamut)Random(rng, SPOUT_GAMUT_709, SPOUT_GAMUT_P3);
+		color.destTransfer = (SpoutTransfer)Random(rng, SPOUT_TRANSFER_SRGB, SPOUT_TRANSFER_LINEAR);
+		color.destGamut = (SpoutGamut)Random(rng, SPOUT_GAMUT_709, SPOUT_GAMUT_P3);
+	} while (color.sourceTransfer == color.destTransfer && color.sourceGamut == color.destGamut);
+	const char* transfers[] = { "sRGB", "linear" };
+	const char* gamuts[] = { "709", "2020", "P3" };
+	detail += std::string(", color ") + transfers[color.sourceTransfer] + " " + gamuts[color.sourceGamut]
+		+ " to " + transfers[color.destTransfer] + " " + gamuts[color.destGamut];
+	return color;
+}
+
+void RunColor(const spoutCopy& copy, const ColorCase& color, const std::function<void()>& run)
+{
+	auto& c = const_cast<spoutCopy&>(copy); // Color is state of the class
+	c.SetColor(color.sourceTransfer, color.sourceGamut, color.destTransfer, color.destGamut);
+	run();
+	c.SetColor(SPOUT_TRANSFER_SRGB, SPOUT_GAMUT_709, SPOUT_TRANSFER_SRGB, SPOUT_GAMUT_709);
+}
+
+void SetupCopyImageColor(Rng& rng, Case& c)
+{
+	const GLenum srcFormat = RandomFormat(rng);
+	const GLenum dstFormat = RandomFormat(rng);
+	RandomCase(rng, c, FormatBytes(srcFormat), FormatBytes(dstFormat), true, true);
+	c.bMirror = Chance(rng, 30);
+	c.bSwap = Chance(rng, 30);
+	c.detail = std::string(FormatName(srcFormat)) + " to " + FormatName(dstFormat);
+	const ColorCase color = RandomColor(rng, c.detail);
+	const Case k = c;
+	c.run = [k, srcFormat, dstFormat, color](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		RunColor(copy, color, [&]() {
+			copy.CopyImage(src, dst, k.width, k.height, srcFormat, dstFormat,
+				k.srcPitch, k.dstPitch, k.bInvert, k.bMirror, k.bSwap);
+		});
+	};
+}
+
+void SetupConversionColor(Rng& rng, Case& c)
+{
+	const unsigned n = Random(rng, 0, sizeof(conversions) / sizeof(conversions[0]) - 1);
+	const Conversion& conversion = conversions[n];
+	RandomCase(rng, c, conversion.srcBytes, conversion.dstBytes, true, true);
+	c.data = conversion.data;
+	c.detail = conversion.name;
+	const ColorCase color = RandomColor(rng, c.detail);
+	const Case k = c;
+	const Convert function = conversion.function;
+	c.run = [k, function, color](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		RunColor(copy, color, [&]() {
+			(copy.*function)(src, dst, k.width, k.height, k.srcPitch, k.dstPitch, k.bInvert);
+		});
+	};
+}
+
+// Alpha premultiply or unpremultiply, set for the call and restored
+SpoutAlpha RandomAlpha(Rng& rng, std::string& detail)
+{
+	const SpoutAlpha mode = Chance(rng, 50) ? SPOUT_ALPHA_PREMULTIPLY : SPOUT_ALPHA_UNPREMULTIPLY;
+	detail += (mode == SPOUT_ALPHA_PREMULTIPLY) ? ", premultiply" : ", unpremultiply";
+	return mode;
+}
+
+void RunAlpha(const spoutCopy& copy, SpoutAlpha mode, const std::function<void()>& run)
+{
+	auto& c = const_cast<spoutCopy&>(copy); // Alpha is state of the class
+	c.SetAlpha(mode);
+	run();
+	c.SetAlpha(SPOUT_ALPHA_NONE);
+}
+
+void SetupCopyPixelsAlpha(Rng& rng, Case& c)
+{
+	const GLenum format = Chance(rng, 50) ? GL_RGBA : GL_BGRA_EXT;
+	RandomCase(rng, c, 4, 4, false, false);
+	c.detail = FormatName(format);
+	const SpoutAlpha mode = RandomAlpha(rng, c.detail);
+	const Case k = c;
+	c.run = [k, format, mode](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		RunAlpha(copy, mode, [&]() {
+			copy.CopyPixels(src, dst, k.width, k.height, format, k.bInvert);
+		});
+	};
+}
+
+void SetupRgba2rgbaAlpha(Rng& rng, Case& c)
+{
+	RandomCase(rng, c, 4, 4, true, true);
+	const SpoutAlpha mode = RandomAlpha(rng, c.detail);
+	const Case k = c;
+	c.run = [k, mode](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		RunAlpha(copy, mode, [&]() {
+			copy.rgba2rgba(src, dst, k.width, k.height, k.srcPitch, k.dstPitch, k.bInvert);
+		});
+	};
+}
+
+// With color conversion for a third of the cases
+void SetupCopyImageAlpha(Rng& rng, Case& c)
+{
+	const GLenum srcFormat = Chance(rng, 80) ? (Chance(rng, 50) ? GL_RGBA : GL_BGRA_EXT) : RandomFormat(rng);
+	const GLenum dstFormat = Chance(rng, 80) ? (Chance(rng, 50) ? GL_RGBA : GL_BGRA_EXT) : RandomFormat(rng);
+	RandomCase(rng, c, FormatBytes(srcFormat), FormatBytes(dstFormat), true, true);
+	c.bMirror = Chance(rng, 30);
+	c.bSwap = Chance(rng, 30);
+	c.detail = std::string(FormatName(srcFormat)) + " to " + FormatName(dstFormat);
+	const SpoutAlpha mode = RandomAlpha(rng, c.detail);
+	const bool bColor = Chance(rng, 33);
+	const ColorCase color = bColor ? RandomColor(rng, c.detail) : ColorCase();
+	const Case k = c;
+	c.run = [k, srcFormat, dstFormat, mode, bColor, color](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		auto run = [&]() {
+			copy.CopyImage(src, dst, k.width, k.height, srcFormat, dstFormat,
+				k.srcPitch, k.dstPitch, k.bInvert, k.bMirror, k.bSwap);
+		};
+		RunAlpha(copy, mode, [&]() {
+			if (bColor)
+				RunColor(copy, color, run);
+			else
+				run();
+		});
+	};
+}
+
+void SetupConversionAlpha(Rng& rng, Case& c)
+{
+	const unsigned n = Random(rng, 0, sizeof(conversions) / sizeof(conversions[0]) - 1);
+	const Conversion& conversion = conversions[n];
+	RandomCase(rng, c, conversion.srcBytes, conversion.dstBytes, true, true);
+	c.data = conversion.data;
+	c.detail = conversion.name;
+	const SpoutAlpha mode = RandomAlpha(rng, c.detail);
+	const Case k = c;
+	const Convert function = conversion.function;
+	c.run = [k, function, mode](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		RunAlpha(copy, mode, [&]() {
+			(copy.*function)(src, dst, k.width, k.height, k.srcPitch, k.dstPitch, k.bInvert);
+		});
+	};
+}
+
+// High bit depth to 8 bit with dither, set for the call and restored
+void SetupConversionDither(Rng& rng, Case& c)
+{
+	const unsigned int toByte[] = { 6, 8, 10, 14 }; // float2rgba, half2rgba, ushort2rgba, rgb10a2torgba
+	const Conversion& conversion = conversions[toByte[Random(rng, 0, 3)]];
+	RandomCase(rng, c, conversion.srcBytes, conversion.dstBytes, true, true);
+	c.data = conversion.data;
+	const SpoutDither mode = Chance(rng, 50) ? SPOUT_DITHER_BAYER : SPOUT_DITHER_BLUENOISE;
+	c.detail = std::string(conversion.name) + (mode == SPOUT_DITHER_BAYER ? ", bayer" : ", blue noise");
+	const Case k = c;
+	const Convert function = conversion.function;
+	c.run = [k, function, mode](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		auto& d = const_cast<spoutCopy&>(copy); // Dither is state of the class
+		d.SetDither(mode);
+		(copy.*function)(src, dst, k.width, k.height, k.srcPitch, k.dstPitch, k.bInvert);
+		d.SetDither(SPOUT_DITHER_NONE);
+	};
+}
+
+// 3D lookup table of random size, values and domain for each case
+void SetupApplyLUT(Rng& rng, Case& c)
+{
+	struct LutType {
+		GLenum type;
+		unsigned bytes;
+		SourceData data;
+		const char* name;
+	};
+	const LutType types[] = {
+		{ GL_UNSIGNED_BYTE,   4, SOURCE_BYTES, "ubyte"  },
+		{ GL_UNSIGNED_SHORT,  8, SOURCE_BYTES, "ushort" },
+		{ GL_HALF_FLOAT,      8, SOURCE_HALF,  "half"   },
+		{ GL_FLOAT,          16, SOURCE_FLOAT, "float"  },
+	};
+	const LutType& type = types[Random(rng, 0, 3)];
+	RandomCase(rng, c, type.bytes, type.bytes, true, true);
+	c.data = type.data;
+
+	const unsigned size = Random(rng, 2, 33);
+	std::vector<float> rgb((size_t)size * size * size * 3);
+	std::uniform_real_distribution<float> value(-0.25f, 1.25f);
+	for (auto& v : rgb)
+		v = value(rng);
+	float domainMin[3]{};
+	float domainMax[3] = { 1.0f, 1.0f, 1.0f };
+	if (Chance(rng, 30)) {
+		for (int i = 0; i < 3; i++) {
+			domainMin[i] = std::uniform_real_distribution<float>(-0.5f, 0.25f)(rng);
+			domainMax[i] = std::uniform_real_distribution<float>(0.5f, 2.0f)(rng);
+		}
+	}
+	auto lut = std::make_shared<spoutLUT>();
+	lut->Set(size, rgb.data(), domainMin, domainMax);
+	c.detail = std::string(type.name) + ", size " + std::to_string(size);
+
+	const Case k = c;
+	const GLenum dataType = type.type;
+	c.run = [k, lut, dataType](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.ApplyLUT(*lut, src, dst, k.width, k.height, dataType, k.srcPitch, k.dstPitch, k.bInvert);
+	};
+}
+
+// Y'CbCr image of random format, range and pitch
+//   The image is described as bytes, with the size of all lines of both
+//   NV12 planes, the last without padding
+struct YUVCase {
+	SpoutYUV format;
+	bool bFullRange;
+	GLenum glFormat;
+};
+
+YUVCase RandomYUV(Rng& rng, Case& c, unsigned& pitch, size_t& size, bool bSource)
+{
+	const SpoutYUV formats[] = { SPOUT_YUV_UYVY, SPOUT_YUV_V210, SPOUT_YUV_NV12, SPOUT_YUV_AYUV };
+	const char* names[] = { "UYVY", "v210", "NV12", "AYUV" };
+	const unsigned n = Random(rng, 0, 3);
+	YUVCase yuv;
+	yuv.format = formats[n];
+	yuv.bFullRange = Chance(rng, 50);
+	yuv.glFormat = RandomFormat(rng);
+	const unsigned minPitch = spoutCopy::YUVPitch(c.width, yuv.format);
+	pitch = minPitch + (Chance(rng, 50) ? Random(rng, 1, 17) : 0);
+	size = spoutCopy::YUVSize(c.width, c.height, yuv.format, pitch) - (pitch - minPitch);
+	c.detail = std::string(bSource ? names[n] : FormatName(yuv.glFormat)) + " to "
+		+ (bSource ? FormatName(yuv.glFormat) : names[n])
+		+ (yuv.bFullRange ? ", full range" : ", video range");
+	return yuv;
+}
+
+void SetupRgba2yuv(Rng& rng, Case& c)
+{
+	RandomCase(rng, c, 1, 1, false, false);
+	const YUVCase yuv = RandomYUV(rng, c, c.dstPitch, c.dstSize, false);
+	c.srcBytes = FormatBytes(yuv.glFormat);
+	c.srcPitch = RandomPitch(rng, c.width, c.srcBytes);
+	c.srcOffset = RandomOffset(rng, c.srcBytes);
+	const Case k = c;
+	c.run = [k, yuv](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.rgba2yuv(src, dst, k.width, k.height, yuv.format, yuv.bFullRange, yuv.glFormat,
+			k.srcPitch, k.dstPitch, k.bInvert);
+	};
+}
+
+void SetupYuv2rgba(Rng& rng, Case& c)
+{
+	RandomCase(rng, c, 1, 1, false, false);
+	const YUVCase yuv = RandomYUV(rng, c, c.srcPitch, c.srcSize, true);
+	c.dstBytes = FormatBytes(yuv.glFormat);
+	c.dstPitch = RandomPitch(rng, c.width, c.dstBytes);
+	c.dstOffset = RandomOffset(rng, c.dstBytes);
+	const Case k = c;
+	c.run = [k, yuv](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.yuv2rgba(src, dst, k.width, k.height, yuv.format, yuv.bFullRange, yuv.glFormat,
+			k.srcPitch, k.dstPitch, k.bInvert);
+	};
+}
+
+// Region of an image, sometimes extending past the right or bottom
+SpoutRegion RandomRegion(Rng& rng, unsigned width, unsigned height)
+{
+	SpoutRegion region;
+	region.x = Random(rng, 0, width - 1);
+	region.y = Random(rng, 0, height - 1);
+	region.width = Chance(rng, 20) ? width : Random(rng, 1, width - region.x);
+	region.height = Chance(rng, 20) ? height : Random(rng, 1, height - region.y);
+	return region;
+}
+
+// Source and destination images of different size and pitch with a region of each
+void RandomRegionCase(Rng& rng, Case& c, unsigned srcBytes, unsigned dstBytes,
+	SpoutRegion& srcRegion, SpoutRegion& dstRegion)
+{
+	RandomCase(rng, c, srcBytes, dstBytes, true, false);
+	c.dstWidth = Random(rng, 1, c.width + 40);
+	c.dstHeight = Random(rng, 1, c.height + 4);
+	c.dstPitch = RandomPitch(rng, c.dstWidth, dstBytes);
+	srcRegion = RandomRegion(rng, c.width, c.height);
+	dstRegion = RandomRegion(rng, c.dstWidth, c.dstHeight);
+	char detail[128];
+	snprintf(detail, sizeof(detail), "region %u,%u %ux%u to %ux%u image region %u,%u %ux%u",
+		srcRegion.x, srcRegion.y, srcRegion.width, srcRegion.height, c.dstWidth, c.dstHeight,
+		dstRegion.x, dstRegion.y, dstRegion.width, dstRegion.height);
+	c.detail = detail;
+}
+
+void SetupCopyRegion(Rng& rng, Case& c)
+{
+	GLenum srcFormat = RandomFormat(rng);
+	GLenum dstFormat = RandomFormat(rng);
+	if (Chance(rng, 10))
+		srcFormat = dstFormat = GL_LUMINANCE;
+	SpoutRegion srcRegion, dstRegion;
+	RandomRegionCase(rng, c, FormatBytes(srcFormat), FormatBytes(dstFormat), srcRegion, dstRegion);
+	c.bMirror = Chance(rng, 30);
+	c.bSwap = Chance(rng, 30);
+	c.detail = std::string(FormatName(srcFormat)) + " to " + FormatName(dstFormat) + ", " + c.detail;
+	const Case k = c;
+	c.reference = [k, srcFormat, dstFormat, srcRegion, dstRegion](const unsigned char* src, unsigned char* dst) {
+		const unsigned width = std::min(std::min(srcRegion.width, k.width - srcRegion.x),
+			std::min(dstRegion.width, k.dstWidth - dstRegion.x));
+		const unsigned height = std::min(std::min(srcRegion.height, k.height - srcRegion.y),
+			std::min(dstRegion.height, k.dstHeight - dstRegion.y));
+		ReferenceCopy(src + (size_t)srcRegion.y * k.srcPitch + (size_t)srcRegion.x * k.srcBytes,
+			dst + (size_t)dstRegion.y * k.dstPitch + (size_t)dstRegion.x * k.dstBytes,
+			width, height, srcFormat, dstFormat, k.srcPitch, k.dstPitch, k.bInvert, k.bMirror, k.bSwap);
+	};
+	c.run = [k, srcFormat, dstFormat, srcRegion, dstRegion](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.CopyRegion(src, k.width, k.height, k.srcPitch, srcFormat, srcRegion,
+			dst, k.dstWidth, k.dstHeight, k.dstPitch, dstFormat, dstRegion, k.bInvert, k.bMirror, k.bSwap);
+	};
+}
+
+void SetupResampleRegion(Rng& rng, Case& c)
+{
+	const GLenum srcFormat = Chance(rng, 50) ? GL_RGBA : GL_BGRA_EXT;
+	const GLenum dstFormat = RandomFormat(rng);
+	SpoutRegion srcRegion, dstRegion;
+	RandomRegionCase(rng, c, 4, FormatBytes(dstFormat), srcRegion, dstRegion);
+	c.bMirror = Chance(rng, 30);
+	c.bSwap = Chance(rng, 30);
+	const SpoutResample filter = (SpoutResample)Random(rng, SPOUT_RESAMPLE_AUTO, SPOUT_RESAMPLE_LANCZOS3);
+	const char* filters[] = { "auto", "nearest", "bilinear", "area", "catmullrom", "lanczos3" };
+	c.detail = std::string(FormatName(srcFormat)) + " to " + FormatName(dstFormat) + " "
+		+ filters[filter] + ", " + c.detail;
+	const Case k = c;
+	c.run = [k, srcFormat, dstFormat, srcRegion, dstRegion, filter](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		// The filter is state of the class
+		const_cast<spoutCopy&>(copy).SetResample(filter);
+		copy.ResampleRegion(src, k.width, k.height, k.srcPitch, srcFormat, srcRegion,
+			dst, k.dstWidth, k.dstHeight, k.dstPitch, dstFormat, dstRegion, k.bInvert, k.bMirror, k.bSwap);
+	};
+}
+
+void SetupConvertRegion(Rng& rng, Case& c)
+{
+	const GLenum types[] = { GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_HALF_FLOAT, GL_FLOAT };
+	const unsigned bytes[] = { 4, 8, 8, 16 };
+	const SourceData data[] = { SOURCE_BYTES, SOURCE_BYTES, SOURCE_HALF, SOURCE_FLOAT };
+	const char* names[] = { "RGBA8", "RGBA16", "RGBA16F", "RGBA32F" };
+	const unsigned s = Random(rng, 0, 3);
+	const unsigned d = Random(rng, 0, 3);
+	SpoutRegion srcRegion, dstRegion;
+	RandomRegionCase(rng, c, bytes[s], bytes[d], srcRegion, dstRegion);
+	c.data = data[s];
+	c.detail = std::string(names[s]) + " to " + names[d] + ", " + c.detail;
+	const Case k = c;
+	const GLenum srcType = types[s];
+	const GLenum dstType = types[d];
+	c.run = [k, srcType, dstType, srcRegion, dstRegion](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.ConvertRegion(src, k.width, k.height, k.srcPitch, srcType, srcRegion,
+			dst, k.dstWidth, k.dstHeight, k.dstPitch, dstType, dstRegion, k.bInvert);
+	};
+}
+
+// Hash of an image of any pixel size, written to the destination
+void SetupHashImage(Rng& rng, Case& c)
+{
+	const unsigned pixelBytes[] = { 1, 3, 4, 8, 16 };
+	const unsigned bytes = pixelBytes[Random(rng, 0, 4)];
+	RandomCase(rng, c, bytes, 1, true, false);
+	c.dstSize = sizeof(uint64_t);
+	c.detail = std::to_string(bytes) + " bytes per pixel";
+	const Case k = c;
+	c.run = [k](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		const uint64_t hash = copy.HashImage(src, k.width, k.height, k.srcBytes, k.srcPitch);
+		memcpy(dst, &hash, sizeof(hash));
+	};
+}
+
+// Tile size, mostly small so that the images have several
+unsigned RandomTileSize(Rng& rng)
+{
+	const unsigned sizes[] = { 1, 8, 16, 64 };
+	return Chance(rng, 25) ? Random(rng, 2, 70) : sizes[Random(rng, 0, 3)];
+}
+
+// Current image for DiffTiles, a copy of the previous with a few changes
+std::vector<unsigned char> ChangedImage(const unsigned char* previous, size_t size, unsigned seed)
+{
+	std::vector<unsigned char> current(previous, previous + size);
+	Rng rng(seed);
+	const unsigned changes = Chance(rng, 20) ? 0 : Random(rng, 1, 6);
+	for (unsigned i = 0; i < changes && size > 0; i++)
+		current[Random(rng, 0, (unsigned)size - 1)] ^= (unsigned char)Random(rng, 1, 255);
+	return current;
+}
+
+bool TileSet(const unsigned char* map, unsigned mapPitch, unsigned tx, unsigned ty)
+{
+	return (map[ty * mapPitch + tx / 8] & (1 << (tx % 8))) != 0;
+}
+
+// Map, count and stats, each tile compared byte by byte
+void ReferenceDiffTiles(const unsigned char* previous, const unsigned char* current,
+	const Case& k, unsigned tileSize, unsigned char* dst)
+{
+	const unsigned tilesX = (k.width + tileSize - 1) / tileSize;
+	const unsigned tilesY = (k.height + tileSize - 1) / tileSize;
+	const unsigned mapPitch = (tilesX + 7) / 8;
+	unsigned char* map = dst;
+	memset(map, 0, (size_t)mapPitch * tilesY);
+	unsigned dirty = 0;
+	double area = 0.0;
+	for (unsigned ty = 0; ty < tilesY; ty++) {
+		for (unsigned tx = 0; tx < tilesX; tx++) {
+			const unsigned w = std::min(tileSize, k.width - tx * tileSize);
+			const unsigned h = std::min(tileSize, k.height - ty * tileSize);
+			bool bDiffer = false;
+			for (unsigned y = 0; y < h && !bDiffer; y++) {
+				const size_t offset = (size_t)(ty * tileSize + y) * k.srcPitch + (size_t)tx * tileSize * k.srcBytes;
+				bDiffer = memcmp(previous + offset, current + offset, (size_t)w * k.srcBytes) != 0;
+			}
+			if (bDiffer) {
+				map[ty * mapPitch + tx / 8] |= (unsigned char)(1 << (tx % 8));
+				dirty++;
+				area += (double)w * h;
+			}
+		}
+	}
+	SpoutTileStats stats = { tilesX * tilesY, dirty, area / ((double)k.width * k.height) };
+	memcpy(dst + (size_t)mapPitch * tilesY, &dirty, sizeof(dirty));
+	memcpy(dst + (size_t)mapPitch * tilesY + sizeof(dirty), &stats, sizeof(stats));
+}
+
+void SetupDiffTiles(Rng& rng, Case& c)
+{
+	const unsigned pixelBytes[] = { 1, 3, 4, 8, 16 };
+	const unsigned bytes = pixelBytes[Random(rng, 0, 4)];
+	RandomCase(rng, c, bytes, 1, true, false);
+	const unsigned tileSize = RandomTileSize(rng);
+	const unsigned seed = Random(rng, 0, 0xFFFFFF);
+	const size_t mapSize = spoutCopy::TileMapSize(c.width, c.height, tileSize);
+	c.dstSize = mapSize + sizeof(unsigned) + sizeof(SpoutTileStats);
+	c.bInvert = false;
+	c.detail = std::to_string(bytes) + " bytes per pixel, tile " + std::to_string(tileSize);
+	const Case k = c;
+	const size_t srcSize = (size_t)k.srcPitch * (k.height - 1) + (size_t)k.width * k.srcBytes;
+	c.reference = [k, tileSize, seed, srcSize](const unsigned char* src, unsigned char* dst) {
+		const std::vector<unsigned char> current = ChangedImage(src, srcSize, seed);
+		ReferenceDiffTiles(src, current.data(), k, tileSize, dst);
+	};
+	c.run = [k, tileSize, seed, srcSize, mapSize](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		const std::vector<unsigned char> current = ChangedImage(src, srcSize, seed);
+		SpoutTileStats stats;
+		const unsigned dirty = copy.DiffTiles(src, current.data(), k.width, k.height, k.srcBytes,
+			dst, tileSize, k.srcPitch, k.srcPitch, &stats);
+		memcpy(dst + mapSize, &dirty, sizeof(dirty));
+		memcpy(dst + mapSize + sizeof(dirty), &stats, sizeof(stats));
+	};
+}
+
+void SetupCopyTiles(Rng& rng, Case& c)
+{
+	const unsigned pixelBytes[] = { 1, 3, 4, 8, 16 };
+	const unsigned bytes = pixelBytes[Random(rng, 0, 4)];
+	RandomCase(rng, c, bytes, bytes, true, true);
+	c.bInvert = false;
+	const unsigned tileSize = RandomTileSize(rng);
+	auto map = std::make_shared<std::vector<unsigned char>>(spoutCopy::TileMapSize(c.width, c.height, tileSize));
+	const unsigned density = Random(rng, 0, 100);
+	for (unsigned char& b : *map) {
+		for (int i = 0; i < 8; i++) {
+			if (Chance(rng, density))
+				b |= (unsigned char)(1 << i);
+		}
+	}
+	c.detail = std::to_string(bytes) + " bytes per pixel, tile " + std::to_string(tileSize)
+		+ ", " + std::to_string(density) + "% set";
+	const Case k = c;
+	c.reference = [k, tileSize, map](const unsigned char* src, unsigned char* dst) {
+		const unsigned mapPitch = ((k.width + tileSize - 1) / tileSize + 7) / 8;
+		for (unsigned y = 0; y < k.height; y++) {
+			for (unsigned x = 0; x < k.width; x++) {
+				if (TileSet(map->data(), mapPitch, x / tileSize, y / tileSize))
+					memcpy(dst + (size_t)y * k.dstPitch + (size_t)x * k.dstBytes,
+						src + (size_t)y * k.srcPitch + (size_t)x * k.srcBytes, k.srcBytes);
+			}
+		}
+	};
+	c.run = [k, tileSize, map](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.CopyTiles(src, dst, k.width, k.height, k.srcBytes, map->data(), tileSize, k.srcPitch, k.dstPitch);
+	};
+}
+
+// Mip levels packed in the destination, checked against each level made from the last
+void SetupMipPyramid(Rng& rng, Case& c)
+{
+	RandomCase(rng, c, 4, 4, true, false);
+	c.bInvert = false;
+	const unsigned maxLevels = spoutCopy::MipLevels(c.width, c.height);
+	const unsigned levels = Chance(rng, 30) ? maxLevels + 1 : Random(rng, 1, std::max(maxLevels, 1u));
+	c.dstSize = spoutCopy::MipOffset(c.width, c.height, std::min(levels, maxLevels) + 1);
+	if (c.dstSize == 0)
+		c.dstSize = 4; // 1x1 has no levels
+	c.detail = std::to_string(levels) + " levels";
+	const Case k = c;
+	c.reference = [k, levels, maxLevels](const unsigned char* src, unsigned char* dst) {
+		const unsigned char* parent = src;
+		size_t pitch = k.srcPitch;
+		unsigned pw = k.width, ph = k.height;
+		for (unsigned level = 1; level <= std::min(levels, maxLevels); level++) {
+			unsigned w, h;
+			unsigned char* out = dst + spoutCopy::MipOffset(k.width, k.height, level, &w, &h);
+			for (unsigned y = 0; y < h; y++) {
+				const unsigned char* l0 = parent + (size_t)(2 * y) * pitch;
+				const unsigned char* l1 = parent + (size_t)std::min(2 * y + 1, ph - 1) * pitch;
+				for (unsigned x = 0; x < w; x++) {
+					const unsigned a = 2 * x * 4;
+					const unsigned b = std::min(2 * x + 1, pw - 1) * 4;
+					for (unsigned i = 0; i < 4; i++)
+						out[((size_t)y * w + x) * 4 + i] = (unsigned char)((l0[a + i] + l0[b + i] + l1[a + i] + l1[b + i] + 2) / 4);
+				}
+			}
+			parent = out;
+			pitch = (size_t)w * 4;
+			pw = w;
+			ph = h;
+		}
+	};
+	c.run = [k, levels](const spoutCopy& copy, const unsigned char* src, unsigned char* dst) {
+		copy.MipPyramid(src, dst, k.width, k.height, levels, k.srcPitch);
+	};
+}
+
+const Test tests[] = {
+	{ "CopyPixels",         SetupCopyPixels },
+	{ "FlipBuffer",         SetupFlipBuffer },
+	{ "RemovePadding",      SetupRemovePadding },
+	{ "rgba2rgba_pitch",    SetupRgba2rgbaPitch },
+	{ "rgba2rgba_pitch2",   SetupRgba2rgbaPitch2 },
+	{ "rgba2bgra",          SetupRgba2bgra },
+	{ "bgra2rgba",          SetupBgra2rgba },
+	{ "rgba2bgra_pitch",    SetupRgba2bgraPitch },
+	{ "rgba2bgra_pitch2",   SetupRgba2bgraPitch2 },
+	{ "rgb_rgba_wrappers",  SetupWrappers },
+	{ "CopyImage",          SetupCopyImage },
+	{ "Resample",           SetupResample },
+	{ "float2half",         SetupConversion<0> },
+	{ "half2float",         SetupConversion<1> },
+	{ "half2ushort",        SetupConversion<2> },
+	{ "ushort2half",        SetupConversion<3> },
+	{ "float2ushort",       SetupConversion<4> },
+	{ "ushort2float",       SetupConversion<5> },
+	{ "float2rgba",         SetupConversion<6> },
+	{ "rgba2float",         SetupConversion<7> },
+	{ "half2rgba",          SetupConversion<8> },
+	{ "rgba2half",          SetupConversion<9> },
+	{ "ushort2rgba",        SetupConversion<10> },
+	{ "rgba2ushort",        SetupConversion<11> },
+	{ "rgb10a2toushort",    SetupConversion<12> },
+	{ "ushorttorgb10a2",    SetupConversion<13> },
+	{ "rgb10a2torgba",      SetupConversion<14> },
+	{ "rgbatorgb10a2",      SetupConversion<15> },
+	{ "rgb10a2tofloat",     SetupConversion<16> },
+	{ "floattorgb10a2",     SetupConversion<17> },
+	{ "CopyImage_color",    SetupCopyImageColor },
+	{ "Conversion_color",   SetupConversionColor },
+	{ "ApplyLUT",           SetupApplyLUT },
+	{ "CopyPixels_alpha",   SetupCopyPixelsAlpha },
+	{ "rgba2rgba_alpha",    SetupRgba2rgbaAlpha },
+	{ "CopyImage_alpha",    SetupCopyImageAlpha },
+	{ "Conversion_alpha",   SetupConversionAlpha },
+	{ "Conversion_dither",  SetupConversionDither },
+	{ "rgba2yuv",           SetupRgba2yuv },
+	{ "yuv2rgba",           SetupYuv2rgba },
+	{ "CopyRegion",         SetupCopyRegion },
+	{ "ResampleRegion",     SetupResampleRegion },
+	{ "ConvertRegion",      SetupConvertRegion },
+	{ "HashImage",          SetupHashImage },
+	{ "DiffTiles",          SetupDiffTiles },
+	{ "CopyTiles",          SetupCopyTiles },
+	{ "MipPyramid",         SetupMipPyramid },
+};
+
+//
+// Checking
+//
+
+void FillSource(Rng& rng, const Case& c, Buffer& source)
+{
+	unsigned char* p = source.data;
+	if (c.data == SOURCE_FLOAT) {
+		std::uniform_real_distribution<float> unit(-0.1f, 1.1f);
+		std::uniform_real_distribution<float> wide(-70000.0f, 70000.0f);
+		const float special[] = { 0.0f, -0.0f, 1.0f, 0.5f, 1e-6f, 1.0f / 65535.0f, 0.5f / 255.0f };
+		for (size_t i = 0; i + 4 <= source.size; i += 4) {
+			const unsigned n = Random(rng, 0, 99);
+			const float f = (n < 80) ? unit(rng) : (n < 90) ? wide(rng) : special[n % 7];
+			memcpy(p + i, &f, 4);
+		}
+	}
+	else if (c.data == SOURCE_HALF) {
+		for (size_t i = 0; i + 2 <= source.size; i += 2) {
+			uint16_t h = (uint16_t)Random(rng, 0, 0xFFFF);
+			if ((h & 0x7C00) == 0x7C00)
+				h &= 0xFC00; // Infinity instead of NaN
+			memcpy(p + i, &h, 2);
+		}
+	}
+	else {
+		for (size_t i = 0; i < source.size; i++)
+			p[i] = (unsigned char)Random(rng, 0, 255);
+	}
+}
+
+std::string Describe(const Case& c)
+{
+	char text[256];
+	snprintf(text, sizeof(text),
+		"%ux%u src pitch %u offset %u, dst pitch %u offset %u%s%s%s",
+		c.width, c.height, c.srcPitch, c.srcOffset, c.dstPitch, c.dstOffset,
+		c.bInvert ? ", invert" : "", c.bMirror ? ", mirror" : "", c.bSwap ? ", swap" : "");
+	std::string s = text;
+	if (!c.detail.empty())
+		s += ", " + c.detail;
+	return s;
+}
+
+// The first byte that differs, reported as a pixel of the destination image
+void ReportMismatch(const Case& c, const Buffer& expected, const Buffer& actual,
+	size_t index, const char* simd, const Variant& variant)
+{
+	const unsigned dstWidth = c.dstWidth ? c.dstWidth : c.width;
+	const size_t start = Buffer::guard + c.dstOffset;
+	printf("    %s, %u thread(s)%s\n", simd, variant.threads, variant.bStream ? ", streaming" : "");
+	if (index < start || index >= start + actual.size) {
+		printf("    write outside the image at byte %ld\n", (long)index - (long)start);
+		return;
+	}
+	const size_t offset = index - start;
+	const unsigned y = (unsigned)(offset / c.dstPitch);
+	const unsigned xbyte = (unsigned)(offset % c.dstPitch);
+	if (xbyte >= dstWidth * c.dstBytes) {
+		printf("    write to line padding at line %u byte %u\n", y, xbyte);
+		return;
+	}
+	const unsigned x = xbyte / c.dstBytes;
+	const size_t pixel = start + (size_t)y * c.dstPitch + (size_t)x * c.dstBytes;
+	printf("    pixel %u, %u byte %u\n    expected", x, y, xbyte % c.dstBytes);
+	for (unsigned i = 0; i < c.dstBytes; i++)
+		printf(" %02X", expected.base[pixel + i]);
+	printf("\n    got     ");
+	for (unsigned i = 0; i < c.dstBytes; i++)
+		printf(" %02X", actual.base[pixel + i]);
+	printf("\n");
+}
+
+// Case being run, for a crash
+std::string g_running;
+
+extern "C" void OnCrash(int)
+{
+	fputs("\nCrashed running ", stderr);
+	fputs(g_running.c_str(), stderr);
+	fputs("\n", stderr);
+	_Exit(2);
+}
+
+} // namespace
+
+
+int main(int argc, char* argv[])
+{
+	unsigned seed = 1;
+	unsigned cases = 100;
+	std::string filter;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+			seed = (unsigned)atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--cases") && i + 1 < argc) {
+			cases = (unsigned)atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+			filter = argv[++i];
+		}
+		else {
+			fprintf(stderr, "Usage : SpoutCopyVerify [--seed n] [--cases n] [--filter name]\n");
+			return 1;
+		}
+	}
+
+	signal(SIGSEGV, OnCrash);
+#if defined(SIGBUS)
+	signal(SIGBUS, OnCrash);
+#endif
+
+	spoutCopy copy;
+	spoutCopy scalar;
+	scalar.SetSIMD(SPOUT_SIMD_NONE);
+	const SpoutSIMD maxSIMD = copy.GetMaxSIMD();
+
+	printf("Max SIMD %s, seed %u, %u cases\n\n", SIMDName(maxSIMD), seed, cases);
+
+	unsigned failed = 0;
+	for (const Test& test : tests) {
+		if (!filter.empty() && std::string(test.name).find(filter) == std::string::npos)
+			continue;
+
+		// Each function has its own sequence so that it can be run alone
+		Rng rng(seed * 1000003u + (unsigned)std::hash<std::string>()(test.name));
+		bool bPass = true;
+		for (unsigned n = 0; n < cases && bPass; n++) {
+			Case c;
+			test.setup(rng, c);
+			const unsigned dstWidth = c.dstWidth ? c.dstWidth : c.width;
+			const unsigned dstHeight = c.dstHeight ? c.dstHeight : c.height;
+
+			Buffer source, expected, actual;
+			source.Allocate(c.srcSize ? c.srcSize : (size_t)c.srcPitch * (c.height - 1) + (size_t)c.width * c.srcBytes, c.srcOffset);
+			FillSource(rng, c, source);
+			const size_t dstSize = c.dstSize ? c.dstSize : (size_t)c.dstPitch * (dstHeight - 1) + (size_t)dstWidth * c.dstBytes;
+			expected.Allocate(dstSize, c.dstOffset);
+			actual.Allocate(dstSize, c.dstOffset);
+
+			g_running = std::string(test.name) + " reference, " + Describe(c);
+			if (c.reference)
+				c.reference(source.data, expected.data);
+			else
+				c.run(scalar, source.data, expected.data);
+
+			for (int level = SPOUT_SIMD_NONE; level <= maxSIMD && bPass; level++) {
+				for (const Variant& variant : variants) {
+					copy.SetSIMD((SpoutSIMD)level);
+					copy.SetThreads(variant.threads, 0);
+					copy.SetStreamSize(variant.bStream ? 0 : SIZE_MAX);
+
+					g_running = std::string(test.name) + " " + SIMDName((SpoutSIMD)level) + ", " + Describe(c);
+					actual.Fill(0xCD);
+					c.run(copy, source.data, actual.data);
+
+					if (memcmp(expected.base, actual.base, actual.span) != 0) {
+						size_t i = 0;
+						while (expected.base[i] == actual.base[i])
+							i++;
+						printf("%-22s FAIL case %u : %s\n", test.name, n, Describe(c).c_str());
+						ReportMismatch(c, expected, actual, i, SIMDName((SpoutSIMD)level), variant);
+						bPass = false;
+						break;
+					}
+				}
+			}
+		}
+		if (bPass)
+			printf("%-22s ok\n", test.name);
+		else
+			failed++;
+	}
+
+	if (failed) {
+		printf("\n%u function(s) failed\n", failed);
+		return 1;
+	}
+	printf("\nAll functions match\n");
+	return 0;
+}
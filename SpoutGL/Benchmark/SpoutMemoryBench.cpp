@@ -0,0 +1,592 @@
+/*
+
+	SpoutMemoryBench.cpp
+
+	Soak test and throughput of the memory share path on Linux
+
+	A sender process writes frames to a SpoutSharedMemory map and receiver
+	processes read them, each with Lock and Unlock around a spoutCopy of the
+	whole frame as spoutGL does for CPU sharing. The map uses the POSIX
+	backend of SpoutSharedMemory (shm_open, mmap and a robust mutex).
+
+	With --ring the map is a spoutFrameRing of slots instead. The sender
+	writes each frame to a free slot and the receivers copy the newest
+	frame from the slot they pin, without the lock. Frames the sender
+	drops because no slot is free are shown as timeouts. With --lease as
+	well, the receivers lease the newest frame and read it in place with
+	a checksum of the pixels instead of copying it.
+
+	With --large the sender creates the map with huge pages, a file on a
+	hugetlbfs mount with pages reserved in /proc/sys/vm/nr_hugepages,
+	or transparent huge pages if they are not available. The pages
+	column shows what each process has mapped.
+
+	With --restart the sender closes and creates the map again for the
+	whole run while the receivers open and close it, so the sender often
+	creates it as the last receiver closes it. After each create, a new
+	object opens the map by name and must find the one created. A map that
+	cannot be found, or that is another one, is counted as orphaned.
+
+	Each frame has its number at the start and at the end of the pixels.
+	A receiver that finds different numbers has read a torn frame, which
+	is counted as an error. Lock wait times show the contention between
+	the sender and the receivers.
+
+	Usage :
+		SpoutMemoryBench [--resolution WxH] [--bytes n] [--receivers n]
+		                 [--seconds n] [--threads n] [--ring n] [--lease] [--large]
+		                 [--restart]
+
+		--resolution  frame size (default 1920x1080)
+		--bytes       bytes per pixel, 4 for RGBA8 or 16 for RGBA32F (default 4)
+		--receivers   receiver processes (default 2)
+		--seconds     duration (default 5)
+		--threads     spoutCopy::SetThreads for each process (default 1)
+		--ring        slots of a frame ring, 0 for the locked map (default 0)
+		--lease       ring receivers read frames in place through a spoutFrameLease
+		--large       create the map with huge pages if available
+		--restart     create the map again while receivers open and close it
+
+	Returns 1 if a torn frame or an orphaned map is found.
+
+*/
+
+#include "../SpoutSharedMemory.h"
+#include "../SpoutCopy.h"
+#include "../SpoutFrameRing.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Start of the map
+struct FrameHeader {
+	uint64_t frame; // 0 before the first frame
+	uint32_t width;
+	uint32_t height;
+	uint32_t pixelBytes;
+	uint32_t reserved[3];
+};
+
+// Results of one process, sent to the sender through a pipe
+struct Result {
+	uint64_t frames;
+	uint64_t skipped; // receiver found no new frame
+	uint64_t timeouts; // Lock failed or no free slot
+	uint64_t torn; // frame numbers at the start and end differ
+	double seconds;
+	double waitTotal; // seconds waiting for Lock
+	double waitMax;
+	int pageMode; // SpoutPageMode of the map
+};
+
+double Seconds(Clock::time_point t0, Clock::time_point t1)
+{
+	return std::chrono::duration<double>(t1 - t0).count();
+}
+
+const char* PageName(int mode)
+{
+	if (mode == SPOUT_PAGES_LARGE)
+		return "huge";
+	if (mode == SPOUT_PAGES_ADVISED)
+		return "advised";
+	return "default";
+}
+
+void Print(const char* role, const Result& r, size_t frameBytes)
+{
+	const double locks = (double)(r.frames + r.skipped);
+	printf("%-12s %10llu %9.1f %9.2f %12.1f %10.1f %9llu %6llu %8s\n", role,
+		(unsigned long long)r.frames, r.frames / r.seconds,
+		r.frames * (double)frameBytes / r.seconds / 1e9,
+		locks > 0 ? r.waitTotal / locks * 1e6 : 0.0, r.waitMax * 1e6,
+		(unsigned long long)r.timeouts, (unsigned long long)r.torn, PageName(r.pageMode));
+}
+
+Result Send(SpoutSharedMemory& map, const spoutCopy& copy, const FrameHeader& format, double seconds)
+{
+	const size_t frameBytes = (size_t)format.width * format.height * format.pixelBytes;
+	std::vector<unsigned char> pixels(frameBytes, 0x80);
+	Result r = {};
+	uint64_t frame = 0;
+	const Clock::time_point start = Clock::now();
+	Clock::time_point now = start;
+	while (Seconds(start, now) < seconds) {
+		const Clock::time_point t0 = Clock::now();
+		char* buffer = map.Lock();
+		const double wait = Seconds(t0, Clock::now());
+		r.waitTotal += wait;
+		r.waitMax = std::max(r.waitMax, wait);
+		if (!buffer) {
+			r.timeouts++;
+		}
+		else {
+			frame++;
+			unsigned char* dst = reinterpret_cast<unsigned char *>(buffer) + sizeof(FrameHeader);
+			memcpy(pixels.data(), &frame, sizeof(frame));
+			memcpy(pixels.data() + frameBytes - sizeof(frame), &frame, sizeof(frame));
+			copy.CopyPixels(pixels.data(), dst, format.width * format.pixelBytes / 4, format.height);
+			FrameHeader header = format;
+			header.frame = frame;
+			memcpy(buffer, &header, sizeof(header));
+			map.Unlock();
+			r.frames++;
+		}
+		now = Clock::now();
+	}
+	r.seconds = Seconds(start, now);
+	return r;
+}
+
+Result Receive(SpoutSharedMemory& map, const spoutCopy& copy, double seconds)
+{
+	std::vector<unsigned char> pixels;
+	Result r = {};
+	uint64_t last = 0;
+	const Clock::time_point start = Clock::now();
+	Clock::time_point now = start;
+	while (Seconds(start, now) < seconds) {
+		const Clock::time_point t0 = Clock::now();
+		char* buffer = map.Lock();
+		const double wait = Seconds(t0, Clock::now());
+		r.waitTotal += wait;
+		r.waitMax = std::max(r.waitMax, wait);
+		if (!buffer) {
+			r.timeouts++;
+			now = Clock::now();
+			continue;
+		}
+		FrameHeader header;
+		memcpy(&header, buffer, sizeof(header));
+		if (header.frame == 0 || header.frame == last) {
+			map.Unlock();
+			r.skipped++;
+			std::this_thread::yield();
+			now = Clock::now();
+			continue;
+		}
+		const size_t frameBytes = (size_t)header.width * header.height * header.pixelBytes;
+		pixels.resize(frameBytes);
+		copy.CopyPixels(reinterpret_cast<unsigned char *>(buffer) + sizeof(FrameHeader), pixels.data(), header.width * header.pixelBytes / 4, header.height);
+		map.Unlock();
+		uint64_t first = 0, end = 0;
+		memcpy(&first, pixels.data(), sizeof(first));
+		memcpy(&end, pixels.data() + frameBytes - sizeof(end), sizeof(end));
+		if (first != header.frame || end != header.frame)
+			r.torn++;
+		last = header.frame;
+		r.frames++;
+		now = Clock::now();
+	}
+	r.seconds = Seconds(start, now);
+	return r;
+}
+
+// Ring sender - claim a free slot, write the frame and publish it
+Result SendRing(spoutFrameRing& ring, const spoutCopy& copy, const FrameHeader& format, double seconds)
+{
+	const size_t frameBytes = (size_t)format.width * format.height * format.pixelBytes;
+	std::vector<unsigned char> pixels(frameBytes, 0x80);
+	Result r = {};
+	uint64_t frame = 0;
+	const Clock::time_point start = Clock::now();
+	Clock::time_point now = start;
+	while (Seconds(start, now) < seconds) {
+		const Clock::time_point t0 = Clock::now();
+		unsigned char* dst = ring.BeginWrite();
+		const double wait = Seconds(t0, Clock::now());
+		r.waitTotal += wait;
+		r.waitMax = std::max(r.waitMax, wait);
+		if (!dst) {
+			r.timeouts++;
+			std::this_thread::yield();
+		}
+		else {
+			frame++;
+			memcpy(pixels.data(), &frame, sizeof(frame));
+			memcpy(pixels.data() + frameBytes - sizeof(frame), &frame, sizeof(frame));
+			copy.CopyPixels(pixels.data(), dst, format.width * format.pixelBytes / 4, format.height);
+			ring.EndWrite(format.width, format.height, format.width * format.pixelBytes, format.pixelBytes);
+			r.frames++;
+		}
+		now = Clock::now();
+	}
+	r.seconds = Seconds(start, now);
+	return r;
+}
+
+// Sum of the 64 bit words of a frame, read in place
+uint64_t Checksum(const unsigned char* pixels, size_t bytes)
+{
+	uint64_t sum = 0;
+	for (size_t i = 0; i + 8 <= bytes; i += 8) {
+		uint64_t word;
+		memcpy(&word, pixels + i, sizeof(word));
+		sum += word;
+	}
+	return sum;
+}
+
+// Lease receiver - lease the newest frame and read it in place
+Result ReceiveLease(spoutFrameRing& ring, double seconds)
+{
+	Result r = {};
+	uint64_t last = 0;
+	volatile uint64_t checksum = 0;
+	spoutFrameLease lease;
+	const Clock::time_point start = Clock::now();
+	Clock::time_point now = start;
+	while (Seconds(start, now) < seconds) {
+		const Clock::time_point t0 = Clock::now();
+		const bool bLeased = ring.Acquire(last, lease);
+		const double wait = Seconds(t0, Clock::now());
+		r.waitTotal += wait;
+		r.waitMax = std::max(r.waitMax, wait);
+		if (!bLeased) {
+			r.skipped++;
+			std::this_thread::yield();
+			now = Clock::now();
+			continue;
+		}
+		const SpoutRingFrame& info = lease.Frame();
+		const size_t frameBytes = (size_t)info.pitch * info.height;
+		const unsigned char* pixels = lease.Pixels();
+		checksum = checksum + Checksum(pixels, frameBytes);
+		uint64_t first = 0, end = 0;
+		memcpy(&first, pixels, sizeof(first));
+		memcpy(&end, pixels + frameBytes - sizeof(end), sizeof(end));
+		lease.Release();
+		if (first != info.frame || end != info.frame)
+			r.torn++;
+		last = info.frame;
+		r.frames++;
+		now = Clock::now();
+	}
+	r.seconds = Seconds(start, now);
+	return r;
+}
+
+// Ring receiver - pin the newest frame and copy it without the lock
+Result ReceiveRing(spoutFrameRing& ring, const spoutCopy& copy, double seconds)
+{
+	std::vector<unsigned char> pixels;
+	Result r = {};
+	uint64_t last = 0;
+	const Clock::time_point start = Clock::now();
+	Clock::time_point now = start;
+	while (Seconds(start, now) < seconds) {
+		const Clock::time_point t0 = Clock::now();
+		SpoutRingFrame info = {};
+		const int slot = ring.Acquire(last, &info);
+		const double wait = Seconds(t0, Clock::now());
+		r.waitTotal += wait;
+		r.waitMax = std::max(r.waitMax, wait);
+		if (slot < 0) {
+			r.skipped++;
+			std::this_thread::yield();
+			now = Clock::now();
+			continue;
+		}
+		const size_t frameBytes = (size_t)info.pitch * info.height;
+		pixels.resize(frameBytes);
+		copy.CopyPixels(ring.Pixels(slot), pixels.data(), info.pitch / 4, info.height);
+		ring.Release(slot);
+		uint64_t first = 0, end = 0;
+		memcpy(&first, pixels.data(), sizeof(first));
+		memcpy(&end, pixels.data() + frameBytes - sizeof(end), sizeof(end));
+		if (first != info.frame || end != info.frame)
+			r.torn++;
+		last = info.frame;
+		r.frames++;
+		now = Clock::now();
+	}
+	r.seconds = Seconds(start, now);
+	return r;
+}
+
+// Restart sender - close and create the map again, and check that
+// a new receiver finds the map created each time
+int Restart(const std::string& name, size_t mapSize, unsigned int receivers, double seconds, bool bLarge)
+{
+	std::vector<pid_t> children;
+	std::vector<int> pipes;
+	for (unsigned int i = 0; i < receivers; i++) {
+		int fd[2];
+		if (pipe(fd) != 0)
+			break;
+		const pid_t pid = fork();
+		if (pid == 0) {
+			close(fd[0]);
+			// Open the map, read a byte of each page and close it.
+			// Pages mapped make the unmap in Close take longer.
+			uint64_t opens = 0;
+			volatile unsigned char sink = 0;
+			const Clock::time_point start = Clock::now();
+			while (Seconds(start, Clock::now()) < seconds) {
+				SpoutSharedMemory receiver;
+				if (receiver.Open(name.c_str())) {
+					opens++;
+					const unsigned char* pixels = reinterpret_cast<const unsigned char *>(receiver.Buffer());
+					for (size_t p = 0; p < mapSize; p += 4096)
+						sink = sink + pixels[p];
+					receiver.Close();
+				}
+			}
+			const ssize_t n = write(fd[1], &opens, sizeof(opens));
+			close(fd[1]);
+			_exit(n == (ssize_t)sizeof(opens) ? 0 : 1);
+		}
+		close(fd[1]);
+		if (pid < 0) {
+			close(fd[0]);
+			break;
+		}
+		children.push_back(pid);
+		pipes.push_back(fd[0]);
+	}
+
+	uint64_t restarts = 0;
+	uint64_t existing = 0; // a receiver still had the map open
+	uint64_t failed = 0;
+	uint64_t orphaned = 0;
+	const Clock::time_point start = Clock::now();
+	while (Seconds(start, Clock::now()) < seconds) {
+		SpoutSharedMemory map;
+		map.SetLargePages(bLarge);
+		const SpoutCreateResult result = map.Create(name.c_str(), (int)mapSize);
+		if (result == SPOUT_CREATE_FAILED) {
+			failed++;
+			continue;
+		}
+		if (result == SPOUT_ALREADY_EXISTS)
+			existing++;
+		restarts++;
+		// Mark the map and look for it by name as a new receiver would
+		memcpy(map.Buffer(), &restarts, sizeof(restarts));
+		SpoutSharedMemory check;
+		uint64_t found = 0;
+		if (check.Open(name.c_str())) {
+			memcpy(&found, check.Buffer(), sizeof(found));
+			check.Close();
+		}
+		if (found != restarts)
+			orphaned++;
+		map.Close();
+	}
+
+	uint64_t opens = 0;
+	for (size_t i = 0; i < children.size(); i++) {
+		uint64_t n = 0;
+		if (read(pipes[i], &n, sizeof(n)) == (ssize_t)sizeof(n))
+			opens += n;
+		close(pipes[i]);
+		int status = 0;
+		waitpid(children[i], &status, 0);
+	}
+
+	printf("%zu receiver(s), %.1f s, sender restarted while receivers open and close the map\n\n",
+		children.size(), seconds);
+	printf("restarts %llu (%llu with the map open by a receiver), create failed %llu, orphaned %llu, receiver opens %llu\n",
+		(unsigned long long)restarts, (unsigned long long)existing, (unsigned long long)failed,
+		(unsigned long long)orphaned, (unsigned long long)opens);
+
+	return (orphaned > 0 || failed > 0) ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	unsigned int width = 1920;
+	unsigned int height = 1080;
+	unsigned int pixelBytes = 4;
+	unsigned int receivers = 2;
+	double seconds = 5.0;
+	unsigned int threads = 1;
+	unsigned int slots = 0;
+	bool bLease = false;
+	bool bLarge = false;
+	bool bRestart = false;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		const bool bValue = (i + 1 < argc);
+		if (arg == "--resolution" && bValue) {
+			if (sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width < 2 || height < 2) {
+				fprintf(stderr, "Invalid resolution %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (arg == "--bytes" && bValue) {
+			pixelBytes = (unsigned int)atoi(argv[++i]);
+			if (pixelBytes == 0 || pixelBytes % 4 != 0) {
+				fprintf(stderr, "Bytes per pixel must be a multiple of 4\n");
+				return 1;
+			}
+		}
+		else if (arg == "--receivers" && bValue) {
+			receivers = (unsigned int)atoi(argv[++i]);
+		}
+		else if (arg == "--seconds" && bValue) {
+			seconds = std::max(0.1, atof(argv[++i]));
+		}
+		else if (arg == "--threads" && bValue) {
+			threads = (unsigned int)atoi(argv[++i]);
+		}
+		else if (arg == "--ring" && bValue) {
+			slots = (unsigned int)atoi(argv[++i]);
+			if (slots == 1 || slots > SPOUT_RING_MAXSLOTS) {
+				fprintf(stderr, "Ring slots must be 0 or 2 to %d\n", SPOUT_RING_MAXSLOTS);
+				return 1;
+			}
+		}
+		else if (arg == "--lease") {
+			bLease = true;
+		}
+		else if (arg == "--large") {
+			bLarge = true;
+		}
+		else if (arg == "--restart") {
+			bRestart = true;
+		}
+		else {
+			fprintf(stderr, "Usage : SpoutMemoryBench [--resolution WxH] [--bytes n] [--receivers n] [--seconds n] [--threads n] [--ring n] [--lease] [--large] [--restart]\n");
+			return 1;
+		}
+	}
+
+	if (bLease && slots == 0) {
+		fprintf(stderr, "--lease needs a ring\n");
+		return 1;
+	}
+
+	const size_t frameBytes = (size_t)width * height * pixelBytes;
+	const size_t mapSize = slots > 0 ? spoutFrameRing::MapSize(slots, frameBytes) : sizeof(FrameHeader) + frameBytes;
+	if (mapSize > 0x7FFFFFFF) {
+		fprintf(stderr, "Frame too large for a map\n");
+		return 1;
+	}
+	const std::string name = "SpoutMemoryBench_" + std::to_string(getpid());
+
+	if (bRestart)
+		return Restart(name, mapSize, receivers, seconds, bLarge);
+
+	// The sender creates the map and the ring before the receivers start
+	SpoutSharedMemory map;
+	map.SetLargePages(bLarge);
+	if (map.Create(name.c_str(), (int)mapSize) == SPOUT_CREATE_FAILED) {
+		fprintf(stderr, "Could not create shared memory %s\n", name.c_str());
+		return 1;
+	}
+	spoutFrameRing ring;
+	if (slots > 0 && !ring.Create(map.Buffer(), mapSize, slots)) {
+		fprintf(stderr, "Could not create a ring of %u slots\n", slots);
+		map.Close();
+		return 1;
+	}
+
+	std::vector<pid_t> children;
+	std::vector<int> pipes;
+	for (unsigned int i = 0; i < receivers; i++) {
+		int fd[2];
+		if (pipe(fd) != 0)
+			break;
+		const pid_t pid = fork();
+		if (pid == 0) {
+			close(fd[0]);
+			spoutCopy copy;
+			copy.SetThreads(threads);
+			SpoutSharedMemory receiver;
+			Result r = {};
+			if (!receiver.Open(name.c_str())) {
+				r.timeouts = 1;
+			}
+			else if (slots > 0) {
+				spoutFrameRing reader;
+				if (!reader.Attach(receiver.Buffer()))
+					r.timeouts = 1;
+				else if (bLease)
+					r = ReceiveLease(reader, seconds);
+				else
+					r = ReceiveRing(reader, copy, seconds);
+				reader.Detach();
+			}
+			else {
+				r = Receive(receiver, copy, seconds);
+			}
+			r.pageMode = receiver.GetPageMode();
+			receiver.Close();
+			const ssize_t n = write(fd[1], &r, sizeof(r));
+			close(fd[1]);
+			_exit(n == (ssize_t)sizeof(r) ? 0 : 1);
+		}
+		close(fd[1]);
+		if (pid < 0) {
+			close(fd[0]);
+			break;
+		}
+		children.push_back(pid);
+		pipes.push_back(fd[0]);
+	}
+
+	spoutCopy copy;
+	copy.SetThreads(threads);
+	FrameHeader format = {};
+	format.width = width;
+	format.height = height;
+	format.pixelBytes = pixelBytes;
+	Result sent = slots > 0 ? SendRing(ring, copy, format, seconds) : Send(map, copy, format, seconds);
+	sent.pageMode = map.GetPageMode();
+
+	printf("%ux%u, %u bytes per pixel, %.1f MB frames, %zu receiver(s), %.1f s, ",
+		width, height, pixelBytes, frameBytes / 1e6, children.size(), seconds);
+	if (slots > 0)
+		printf("ring of %u slots\n\n", slots);
+	else
+		printf("locked map\n\n");
+	printf("%-12s %10s %9s %9s %12s %10s %9s %6s %8s\n",
+		"process", "frames", "fps", "GB/s", "wait_us_avg", "wait_us_max", "timeouts", "torn", "pages");
+	Print("sender", sent, frameBytes);
+
+	uint64_t torn = 0;
+	for (size_t i = 0; i < children.size(); i++) {
+		Result r = {};
+		const bool bRead = read(pipes[i], &r, sizeof(r)) == (ssize_t)sizeof(r);
+		close(pipes[i]);
+		int status = 0;
+		waitpid(children[i], &status, 0);
+		const std::string role = "receiver " + std::to_string(i + 1);
+		if (!bRead) {
+			printf("%-12s failed\n", role.c_str());
+			continue;
+		}
+		Print(role.c_str(), r, frameBytes);
+		torn += r.torn;
+	}
+
+	if (bLarge) {
+		SpoutPageStats stats;
+		SpoutSharedMemory::GetPageStats(stats);
+		printf("\nSegments created : %u huge, %u advised, %u default, %u without the huge pages requested\n",
+			stats.largePages, stats.advisedPages, stats.defaultPages, stats.fallback);
+	}
+
+	ring.Detach();
+	map.Close();
+	return torn > 0 ? 1 : 0;
+}
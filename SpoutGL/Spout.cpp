@@ -217,6 +217,7 @@
 //					  Adapter index and name are retrieved with Get functions
 //		20.12.21	- Restore log notice for ReleaseSender
 //		24.02.22	- Restore GetSenderAdpater for testing
+//		17.10.26	- Add ReceiveImage overload to lease memoryshare ring frames in place
 //
 // ====================================================================================
 /*
@@ -394,6 +395,7 @@ void Spout::ReleaseSender()
 	}
 
 	// Close shared memory and sync event if used
+	memoryring.Detach();
 	memoryshare.Close();
 	frame.CloseFrameSync();
 
@@ -706,6 +708,7 @@ void Spout::ReleaseReceiver()
 	m_NextIndex = 0;
 
 	// Close shared memory and sync event if used
+	memoryring.Detach();
 	memoryshare.Close();
 	frame.CloseFrameSync();
 	
@@ -1558,6 +1561,47 @@ bool Spout::ReceiveImage(unsigned char *pixels, GLenum glFormat, bool bInvert, G
 
 } // end ReceiveImage
 
+//---------------------------------------------------------
+// Function: ReceiveImage
+// Receive a memory share frame in place
+//
+// The lease keeps the frame slot of the sender ring until it is released,
+// so the pixels can be used directly without a copy to a receiving buffer.
+bool Spout::ReceiveImage(spoutFrameLease& lease)
+{
+	lease.Release();
+
+	// Return if flagged for update
+	// The update flag is reset when the receiving application calls IsUpdated()
+	if (m_bUpdated) {
+		return true;
+	}
+
+	// Make sure OpenGL and DirectX are initialized
+	if (!OpenSpout())
+		return false;
+
+	// Try to receive texture details from a sender
+	if (ReceiveSenderData()) {
+		// If the sender is new or changed, return for the application
+		// to detect the change with IsUpdated(). There is no receiving
+		// buffer to update, the lease has the frame size.
+		// Only a memory share sender has a map to lease from.
+		if (!m_bUpdated && (!m_dxShareHandle || m_bMemoryShare))
+			ReadMemoryLease(m_SenderName, lease);
+		m_bConnected = true;
+	}
+	else {
+		// There is no sender or the connected sender closed.
+		ReleaseReceiver();
+		// Let the application know.
+		m_bConnected = false;
+	}
+
+	return m_bConnected;
+
+} // end ReceiveImage lease
+
 //---------------------------------------------------------
 // Function: SelectSenderPanel
 // Open dialog for the user to select a sender
@@ -109,6 +109,14 @@ class SPOUT_DLLEXP Spout : public spoutGL {
 	//   For no change, copy the sender shared texture to the pixel buffer
 	//   The receiving image can be RGBA, BGRA, RGB or BGR formats of dimension (width * height) 
 	bool ReceiveImage(unsigned char* pixels, GLenum glFormat = GL_RGBA, bool bInvert = false, GLuint HostFbo = 0);
+	// Receive a memory share frame in place
+	//   Connect to a sender and lease the newest frame of its memory share ring
+	//   The lease is a read-only view of the frame pixels, size, pitch, format
+	//   and frame number, kept until it is released, so no copy is made.
+	//   The lease is empty if there is no new frame or the sender does not use
+	//   a ring (see SetMemoryShareRing). Releasing the receiver, or destroying
+	//   it, releases the frame and the lease is then no longer valid.
+	bool ReceiveImage(spoutFrameLease& lease);
 	// Query whether the sender has changed
 	//   Checked at every cycle before receiving data
 	bool IsUpdated();
@@ -54,10 +54,266 @@
 	13.03.21 - Change CopyPixels and FlipBuffer to accept GL_LUMINANCE
 	09.07.21 - memcpy_sse2 - return for null dst or src
 	21.02.22 - use std:: prefix for floor in rgba2rgbResample for Clang compatibility. PR#81
+	17.10.26 - Add AVX2 and AVX-512 detection and kernels for memcpy and rgba-bgra
+			   Kernel dispatch table selected at construction. Add SetSIMD/GetSIMD.
+			   memcpy_sse2 - copy the remainder of sizes not a multiple of 128 bytes
+			 - Add SetThreads for parallel row band copy with a persistent worker pool
+			   CopyPixels, rgba2rgba and rgba2bgra split large images into row bands
+			 - Resample functions use a separable filter with weights calculated once per image
+			   Add SetResample for bilinear and area average, nearest neighbour from tables
+			 - Add F16C detection and RGBA32F, RGBA16F, RGBA16 and RGBA8 conversion
+			 - Add R10G10B10A2 pack and unpack
+			 - Add SetStreamSize for streaming stores with large images
+			   memcpy_sse2 - sfence after streaming stores
+			 - Add CopyImage for single pass format conversion, pitch, invert and mirror
+			 - Templated pixel format conversion with SSSE3 and AVX2 for all RGBA, BGRA, RGB, BGR pairs
+			   rgb2rgba, bgr2rgba etc. use CopyImage
+			 - Build without Windows headers for benchmark and test tools
+			 - SSE2 and SSSE3 memcpy and rgba-bgra used only for 16 byte aligned pointers
+			   in FlipBuffer, RemovePadding and rgba2bgra. Found by SpoutCopyVerify.
+			   Scalar resample rounds to nearest even as SSE2
+			 - Add SetColor for sRGB/linear and Rec.709/Rec.2020/Display P3 conversion
+			   by CopyImage and the high bit depth functions in the same pass
+			 - Add ApplyLUT for 3D lookup tables (SpoutLUT) with 8 bit, 16 bit and float images
+			 - Add SetAlpha for premultiply or unpremultiply by CopyPixels, rgba2rgba,
+			   CopyImage and the high bit depth functions in the same pass
+			 - Add SetDither for Bayer or blue noise dither of high bit depth to 8 bit
+			 - Add rgba2yuv and yuv2rgba for UYVY, v210, NV12 and AYUV with BT.709
+			   video or full range
+			 - Add CopyRegion, ResampleRegion and ConvertRegion for clipped source and destination
+			   rectangles with pitch. Resample allows destination pitch and BGRA.
+			 - Add HashImage for a 64 bit content hash with SSE2 and AVX2
+			 - Add DiffTiles and CopyTiles for a map of the tiles that change between frames
+			 - Add Catmull-Rom and Lanczos-3 resample filters. Resample weights are kept
+			   between frames. AVX2 combines two destination pixels at a time.
+			 - Add MipPyramid for 2x2 box filter levels made in one pass with SSE2 and AVX2
 
 
 */
 #include "SpoutCopy.h"
+#include "SpoutLUT.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include <algorithm>
+#include <memory>
+
+#if !defined(_WIN32)
+// Equivalents of the Microsoft intrinsics for other platforms
+#include <cpuid.h>
+#define __int32 int
+static inline void __movsd(unsigned long* dst, const unsigned long* src, size_t n)
+{
+	memcpy(dst, src, n * 4); // n 32 bit values
+}
+static inline void spoutCpuid(int* info, int leaf, int subleaf)
+{
+	unsigned int a = 0, b = 0, c = 0, d = 0;
+	__cpuid_count(leaf, subleaf, a, b, c, d);
+	info[0] = (int)a; info[1] = (int)b; info[2] = (int)c; info[3] = (int)d;
+}
+#define __cpuidex(info, leaf, subleaf) spoutCpuid(info, leaf, subleaf)
+#undef __cpuid
+#define __cpuid(info, leaf) spoutCpuid(info, leaf, 0)
+#endif
+
+//
+// MSVC compiles AVX intrinsics without architecture options.
+// GCC and Clang require the target attribute on functions that use them
+// so that the rest of the library can still run on older processors.
+//
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SPOUT_TARGET_AVX2
+#define SPOUT_TARGET_AVX512
+#define SPOUT_TARGET_F16C
+#else
+#define SPOUT_TARGET_AVX2 __attribute__((target("avx2")))
+#define SPOUT_TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512bw")))
+#define SPOUT_TARGET_F16C __attribute__((target("avx2,f16c")))
+#endif
+
+//
+// Worker threads for parallel row copy
+//
+// The threads are created once by SetThreads and wait for jobs.
+// A job divides the image rows into one band per thread.
+// The calling thread copies the first band and waits for the others.
+// Only one job runs at a time. A call from another thread while a job
+// is running, or from within a job, returns false and the caller
+// copies the image itself.
+//
+
+// Set for pool threads and for a caller while it runs a job
+static thread_local bool t_bPoolThread = false;
+
+class spoutCopyPool {
+
+public:
+
+	spoutCopyPool(unsigned int nWorkers)
+	{
+		m_pJob = nullptr;
+		m_nRows = 0;
+		m_generation = 0;
+		m_pending = 0;
+		m_bQuit = false;
+		for (unsigned int i = 0; i < nWorkers; i++)
+			m_threads.emplace_back(&spoutCopyPool::Worker, this, i + 1);
+	}
+
+	~spoutCopyPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bQuit = true;
+		}
+		m_start.notify_all();
+		for (auto &t : m_threads)
+			t.join();
+	}
+
+	// Number of bands, including the caller
+	unsigned int Bands() const
+	{
+		return (unsigned int)m_threads.size() + 1;
+	}
+
+	// Run a job for rows [y0, y1) of each band
+	bool Run(unsigned int nRows, const std::function<void(unsigned int, unsigned int)>& job)
+	{
+		if (t_bPoolThread)
+			return false;
+
+		std::unique_lock<std::mutex> joblock(m_jobmutex, std::try_to_lock);
+		if (!joblock.owns_lock())
+			return false;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_pJob = &job;
+			m_nRows = nRows;
+			m_pending = (unsigned int)m_threads.size();
+			m_generation++;
+		}
+		m_start.notify_all();
+
+		// The caller copies the first band
+		t_bPoolThread = true;
+		RunBand(job, nRows, 0);
+		t_bPoolThread = false;
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this] { return m_pending == 0; });
+		m_pJob = nullptr;
+
+		return true;
+	}
+
+private:
+
+	void RunBand(const std::function<void(unsigned int, unsigned int)>& job, unsigned int nRows, unsigned int band)
+	{
+		const unsigned int y0 = (unsigned int)((unsigned long long)nRows * band / Bands());
+		const unsigned int y1 = (unsigned int)((unsigned long long)nRows * (band + 1) / Bands());
+		if (y1 > y0)
+			job(y0, y1);
+	}
+
+	void Worker(unsigned int band)
+	{
+		t_bPoolThread = true;
+		unsigned long long generation = 0;
+		for (;;) {
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_start.wait(lock, [&] { return m_bQuit || m_generation != generation; });
+			if (m_bQuit)
+				return;
+			generation = m_generation;
+			const std::function<void(unsigned int, unsigned int)>* pJob = m_pJob;
+			const unsigned int nRows = m_nRows;
+			lock.unlock();
+
+			RunBand(*pJob, nRows, band);
+
+			lock.lock();
+			if (--m_pending == 0)
+				m_done.notify_one();
+		}
+	}
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_jobmutex; // One job at a time
+	std::mutex m_mutex; // Job state
+	std::condition_variable m_start;
+	std::condition_variable m_done;
+	const std::function<void(unsigned int, unsigned int)>* m_pJob;
+	unsigned int m_nRows;
+	unsigned long long m_generation;
+	unsigned int m_pending;
+	bool m_bQuit;
+
+};
+
+//
+// Run a line copy in parallel row bands
+//
+// The copy function receives the source and destination for the band
+// and the number of rows. For invert, the band source is taken
+// from the opposite end of the image and the copy function inverts
+// within the band.
+//
+template<typename CopyRows>
+static bool RunRows(spoutCopyPool* pPool, const void* source, void* dest, unsigned int height,
+	size_t sourcePitch, size_t destPitch, bool bInvert, CopyRows copyrows)
+{
+	auto src = static_cast<const unsigned char *>(source);
+	auto dst = static_cast<unsigned char *>(dest);
+	return pPool->Run(height, [&](unsigned int y0, unsigned int y1) {
+		if (bInvert)
+			copyrows(src + (size_t)(height - y1) * sourcePitch, dst + (size_t)y0 * destPitch, y1 - y0);
+		else
+			copyrows(src + (size_t)y0 * sourcePitch, dst + (size_t)y0 * destPitch, y1 - y0);
+	});
+}
+
+// Color conversion tables and matrix, see SetColor
+static const unsigned int spoutColorTableSize = 16384;
+
+struct spoutColor {
+	SpoutTransfer sourceTransfer;
+	SpoutTransfer destTransfer;
+	bool bMatrix; // Primaries differ
+	float matrix[9]; // Linear source RGB to linear destination RGB, row major
+	unsigned char table[256]; // 8 bit to 8 bit without matrix
+	float decode[256]; // 8 bit source to linear
+	unsigned char encode[spoutColorTableSize]; // Linear 0-1 to 8 bit destination
+};
+
+// Filter weights for one axis
+struct spoutResampleTaps {
+	std::vector<unsigned int> start; // First source index for each destination index
+	std::vector<unsigned int> count; // Number of source indices
+	std::vector<unsigned int> offset; // Index of the first weight
+	std::vector<float> weight;
+};
+
+// Weights of the last horizontal and vertical resample
+struct spoutResampleCache {
+	struct Entry {
+		unsigned int srcSize = 0;
+		unsigned int dstSize = 0;
+		SpoutResample filter = SPOUT_RESAMPLE_AUTO;
+		std::shared_ptr<const spoutResampleTaps> taps;
+	};
+	std::mutex mutex;
+	Entry entry[2]; // x, y
+};
 
 //
 // Class: spoutCopy
@@ -71,17 +327,105 @@ spoutCopy::spoutCopy() {
 	m_bSSE2 = false;
 	m_bSSE3 = false;
 	m_bSSSE3 = false;
-	CheckSSE(); // SSE available - sets m_bSSE2, m_bSSE3, m_bSSSE3
+	m_bAVX2 = false;
+	m_bAVX512BW = false;
+	m_bF16C = false;
+	m_pPool = nullptr;
+	m_ThreadSize = 0;
+	m_CacheSize = 0;
+	m_Resample = SPOUT_RESAMPLE_AUTO;
+	m_pResampleCache = new spoutResampleCache;
+	m_ColorSourceTransfer = SPOUT_TRANSFER_SRGB;
+	m_ColorDestTransfer = SPOUT_TRANSFER_SRGB;
+	m_ColorSourceGamut = SPOUT_GAMUT_709;
+	m_ColorDestGamut = SPOUT_GAMUT_709;
+	m_pColor = nullptr;
+	m_Alpha = SPOUT_ALPHA_NONE;
+	m_Dither = SPOUT_DITHER_NONE;
+	m_pDither = nullptr;
+	m_DitherSize = 0;
+	CheckSSE(); // SSE available - sets m_bSSE2, m_bSSE3, m_bSSSE3, m_bAVX2, m_bAVX512BW, m_CacheSize
+	SetSIMD(); // Kernel dispatch table for the best instruction set
+	// Stream if source and destination together exceed the last level cache
+	m_StreamSize = m_CacheSize > 0 ? m_CacheSize / 2 : 8*1024*1024;
 }
 
 
 spoutCopy::~spoutCopy() {
+	delete m_pPool;
+	delete m_pColor;
+	delete m_pResampleCache;
+}
+
+
+//
+// Parallel row band copy
+//
+// Large copies in CPU share mode are made while the shared memory or
+// staging texture is locked. Dividing the rows between threads reduces
+// the time for which the lock is held. Memory bandwidth is shared,
+// so the gain depends on the system. Disabled by default.
+//
+void spoutCopy::SetThreads(unsigned int nThreads, size_t minSize)
+{
+	if (nThreads == 0)
+		nThreads = std::thread::hardware_concurrency();
+
+	if (m_pPool) {
+		delete m_pPool;
+		m_pPool = nullptr;
+	}
+
+	if (nThreads > 1)
+		m_pPool = new spoutCopyPool(nThreads - 1);
+
+	m_ThreadSize = minSize;
+}
+
+unsigned int spoutCopy::GetThreads() const
+{
+	if (m_pPool)
+		return m_pPool->Bands();
+	return 1;
+}
+
+bool spoutCopy::UseThreads(size_t size, unsigned int height) const
+{
+	return (m_pPool && height > 1 && size >= m_ThreadSize);
+}
+
+void spoutCopy::SetStreamSize(size_t minSize)
+{
+	m_StreamSize = minSize;
+}
+
+size_t spoutCopy::GetStreamSize() const
+{
+	return m_StreamSize;
+}
 
+size_t spoutCopy::GetCacheSize() const
+{
+	return m_CacheSize;
 }
 
 void spoutCopy::CopyPixels(const unsigned char *source, unsigned char *dest,
-	unsigned int width, unsigned int height, 
+	unsigned int width, unsigned int height,
 	GLenum glFormat, bool bInvert) const
+{
+	size_t Size = (size_t)width*height; // GL_LUMINANCE default
+	if (glFormat == GL_RGBA || glFormat == GL_BGRA_EXT)
+		Size *= 4;
+	else if (glFormat == GL_RGB || glFormat == GL_BGR_EXT)
+		Size *= 3;
+
+	// The decision is made for the whole image before it is divided into bands
+	CopyPixels(source, dest, width, height, glFormat, bInvert, Size >= m_StreamSize);
+}
+
+void spoutCopy::CopyPixels(const unsigned char *source, unsigned char *dest,
+	unsigned int width, unsigned int height, 
+	GLenum glFormat, bool bInvert, bool bStream) const
 {
 	unsigned int Size = width*height; // GL_LUMINANCE default
 
@@ -90,16 +434,37 @@ void spoutCopy::CopyPixels(const unsigned char *source, unsigned char *dest,
 	else if (glFormat == GL_RGB || glFormat == GL_BGR_EXT)
 		Size = width*height * 3;
 
+	// Parallel row bands for large images
+	if (UseThreads(Size, height)) {
+		const unsigned int pitch = Size / height;
+		if (RunRows(m_pPool, source, dest, height, pitch, pitch, bInvert,
+			[&](const unsigned char* src, unsigned char* dst, unsigned int rows) {
+				CopyPixels(src, dst, width, rows, glFormat, bInvert, bStream);
+			}))
+			return;
+	}
+
+	// Alpha premultiply or unpremultiply as the pixels are copied
+	if (m_Alpha != SPOUT_ALPHA_NONE && (glFormat == GL_RGBA || glFormat == GL_BGRA_EXT)) {
+		for (unsigned int y = 0; y < height; y++) {
+			AlphaLine(source + (size_t)(bInvert ? (height - 1 - y) : y) * width * 4,
+				dest + (size_t)y * width * 4, width);
+		}
+		return;
+	}
+
 	if (bInvert) {
-		FlipBuffer(source, dest, width, height, glFormat);
+		FlipBuffer(source, dest, width, height, glFormat, bStream);
 	}
 	else {
 		if (width < 320) { // Too small for assembler
 			memcpy(reinterpret_cast<void *>(dest),
 				reinterpret_cast<const void *>(source), Size);
 		}
-		else if ((Size % 16) == 0 && m_bSSE2) { // 16 byte aligned SSE assembler
-			memcpy_sse2(reinterpret_cast<void *>(dest),
+		else if (m_SIMD >= SPOUT_SIMD_AVX2 // AVX any size and alignment
+			|| ((Size % 16) == 0 && m_SIMD >= SPOUT_SIMD_SSE2 // 16 byte aligned SSE assembler
+				&& ((reinterpret_cast<uintptr_t>(source) | reinterpret_cast<uintptr_t>(dest)) & 15) == 0)) {
+			(this->*(bStream ? m_pMemcpyStream : m_pMemcpy))(reinterpret_cast<void *>(dest),
 				reinterpret_cast<const void *>(source), Size);
 		}
 		else if ((Size % 4) == 0) { // 4 byte aligned assembler
@@ -118,6 +483,21 @@ void spoutCopy::FlipBuffer(const unsigned char *src,
 	unsigned int width,
 	unsigned int height,
 	GLenum glFormat) const
+{
+	size_t Size = (size_t)width*height; // GL_LUMINANCE default
+	if (glFormat == GL_RGBA || glFormat == GL_BGRA_EXT)
+		Size *= 4;
+	else if (glFormat == GL_RGB || glFormat == GL_BGR_EXT)
+		Size *= 3;
+
+	FlipBuffer(src, dst, width, height, glFormat, Size >= m_StreamSize);
+}
+
+void spoutCopy::FlipBuffer(const unsigned char *src,
+	unsigned char *dst,
+	unsigned int width,
+	unsigned int height,
+	GLenum glFormat, bool bStream) const
 {
 	unsigned int pitch = width; // GL_LUMINANCE default
 	if (glFormat == GL_RGBA || glFormat == GL_BGRA_EXT)
@@ -132,8 +512,10 @@ void spoutCopy::FlipBuffer(const unsigned char *src,
 		if (width < 320 || height < 240) // too small for assembler
 			memcpy(reinterpret_cast<void *>(dst + line_t),
 				reinterpret_cast<const void *>(src + line_s), pitch);
-		else if ((pitch % 16) == 0 && m_bSSE2) // use sse assembler function
-			memcpy_sse2(reinterpret_cast<void *>(dst + line_t),
+		else if (m_SIMD >= SPOUT_SIMD_AVX2
+			|| ((pitch % 16) == 0 && m_SIMD >= SPOUT_SIMD_SSE2 // use sse or avx function
+				&& ((reinterpret_cast<uintptr_t>(src) | reinterpret_cast<uintptr_t>(dst)) & 15) == 0))
+			(this->*(bStream ? m_pMemcpyStream : m_pMemcpy))(reinterpret_cast<void *>(dst + line_t),
 				reinterpret_cast<const void *>(src + line_s), pitch);
 		else if ((pitch % 4) == 0) // use 4 byte move assembler function
 			__movsd(reinterpret_cast<unsigned long *>(dst + line_t),
@@ -163,8 +545,10 @@ void spoutCopy::RemovePadding(const unsigned char *source, unsigned char *dest,
 		if (pitch < 320 || stride < 320) { // too small for assembler
 			memcpy(reinterpret_cast<void *>(dest), reinterpret_cast<const void *>(source), pitch);
 		}
-		else if ((pitch % 16) == 0 && (stride % 16) == 0 && m_bSSE2) { // use sse
-			memcpy_sse2(reinterpret_cast<void *>(dest), reinterpret_cast<const void *>(source), pitch);
+		else if (m_SIMD >= SPOUT_SIMD_AVX2
+			|| ((pitch % 16) == 0 && (stride % 16) == 0 && m_SIMD >= SPOUT_SIMD_SSE2 // use sse or avx
+				&& ((reinterpret_cast<uintptr_t>(source) | reinterpret_cast<uintptr_t>(dest)) & 15) == 0)) {
+			(this->*m_pMemcpy)(reinterpret_cast<void *>(dest), reinterpret_cast<const void *>(source), pitch);
 		}
 		else if ((pitch % 4) == 0 && (stride % 4) == 0) { // 4 byte move
 			__movsd(reinterpret_cast<unsigned long *>(dest), reinterpret_cast<const unsigned long *>(source), pitch/4);
@@ -242,6 +626,285 @@ void spoutCopy::memcpy_sse2(void* dst, const void* src, size_t Size) const
 		pDst += 128;
 	}
 
+	// Copy any remaining bytes
+	if ((Size & 127) != 0)
+		memcpy(pDst, pSrc, Size & 127);
+
+	// Streaming stores are weakly ordered.
+	// Complete them before the buffer is used by another thread or process.
+	_mm_sfence();
+
+}
+
+
+//
+// AVX2 memcpy
+//
+// 128 bytes per cycle (4 * 256bit registers).
+// Unaligned loads and stores, so there is no restriction on size or alignment.
+//
+SPOUT_TARGET_AVX2
+void spoutCopy::memcpy_avx2(void* dst, const void* src, size_t Size) const
+{
+	if (!dst || !src)
+		return;
+
+	auto pSrc = static_cast<const char *>(src);
+	auto pDst = static_cast<char *>(dst);
+	size_t n = Size >> 7; // Counter = size divided by 128 (4 * 256bit registers)
+
+	__m256i Reg0, Reg1, Reg2, Reg3;
+	for (size_t Index = n; Index > 0; --Index) {
+		_mm_prefetch(pSrc + 512, _MM_HINT_NTA);
+		_mm_prefetch(pSrc + 512 + 64, _MM_HINT_NTA);
+		Reg0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pSrc));
+		Reg1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pSrc + 32));
+		Reg2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pSrc + 64));
+		Reg3 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pSrc + 96));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(pDst), Reg0);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(pDst + 32), Reg1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(pDst + 64), Reg2);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(pDst + 96), Reg3);
+		pSrc += 128;
+		pDst += 128;
+	}
+
+	// Remainder in 32 byte steps, then bytes
+	Size &= 127;
+	for (; Size >= 32; Size -= 32) {
+		Reg0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pSrc));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(pDst), Reg0);
+		pSrc += 32;
+		pDst += 32;
+	}
+	if (Size > 0)
+		memcpy(pDst, pSrc, Size);
+
+}
+
+
+//
+// AVX-512 memcpy
+//
+// 256 bytes per cycle (4 * 512bit registers).
+// The remainder uses a byte masked load and store (AVX-512BW).
+//
+SPOUT_TARGET_AVX512
+void spoutCopy::memcpy_avx512(void* dst, const void* src, size_t Size) const
+{
+	if (!dst || !src)
+		return;
+
+	auto pSrc = static_cast<const char *>(src);
+	auto pDst = static_cast<char *>(dst);
+	size_t n = Size >> 8; // Counter = size divided by 256 (4 * 512bit registers)
+
+	__m512i Reg0, Reg1, Reg2, Reg3;
+	for (size_t Index = n; Index > 0; --Index) {
+		_mm_prefetch(pSrc + 1024, _MM_HINT_NTA);
+		_mm_prefetch(pSrc + 1024 + 64, _MM_HINT_NTA);
+		Reg0 = _mm512_loadu_si512(reinterpret_cast<const void *>(pSrc));
+		Reg1 = _mm512_loadu_si512(reinterpret_cast<const void *>(pSrc + 64));
+		Reg2 = _mm512_loadu_si512(reinterpret_cast<const void *>(pSrc + 128));
+		Reg3 = _mm512_loadu_si512(reinterpret_cast<const void *>(pSrc + 192));
+		_mm512_storeu_si512(reinterpret_cast<void *>(pDst), Reg0);
+		_mm512_storeu_si512(reinterpret_cast<void *>(pDst + 64), Reg1);
+		_mm512_storeu_si512(reinterpret_cast<void *>(pDst + 128), Reg2);
+		_mm512_storeu_si512(reinterpret_cast<void *>(pDst + 192), Reg3);
+		pSrc += 256;
+		pDst += 256;
+	}
+
+	// Remainder in 64 byte steps, then a masked copy of the last bytes
+	Size &= 255;
+	for (; Size >= 64; Size -= 64) {
+		Reg0 = _mm512_loadu_si512(reinterpret_cast<const void *>(pSrc));
+		_mm512_storeu_si512(reinterpret_cast<void *>(pDst), Reg0);
+		pSrc += 64;
+		pDst += 64;
+	}
+	if (Size > 0) {
+		const __mmask64 mask = (1ULL << Size) - 1; // Size < 64
+		Reg0 = _mm512_maskz_loadu_epi8(mask, pSrc);
+		_mm512_mask_storeu_epi8(pDst, mask, Reg0);
+	}
+
+}
+
+
+//
+// Streaming memcpy
+//
+// Non-temporal stores write to memory without reading the destination
+// into the cache, so a copy larger than the cache does not evict data
+// in use by the application. The destination is brought to a register
+// boundary first because streaming stores must be aligned.
+//
+SPOUT_TARGET_AVX2
+void spoutCopy::memcpy_avx2_stream(void* dst, const void* src, size_t Size) const
+{
+	if (!dst || !src)
+		return;
+
+	auto pSrc = static_cast<const char *>(src);
+	auto pDst = static_cast<char *>(dst);
+
+	// Unaligned head to a 32 byte destination boundary
+	size_t head = (32 - (reinterpret_cast<uintptr_t>(pDst) & 31)) & 31;
+	if (head > Size) head = Size;
+	if (head > 0) {
+		memcpy(pDst, pSrc, head);
+		pSrc += head;
+		pDst += head;
+		Size -= head;
+	}
+
+	size_t n = Size >> 7; // Counter = size divided by 128 (4 * 256bit registers)
+	__m256i Reg0, Reg1, Reg2, Reg3;
+	for (size_t Index = n; Index > 0; --Index) {
+		_mm_prefetch(pSrc + 512, _MM_HINT_NTA);
+		_mm_prefetch(pSrc + 512 + 64, _MM_HINT_NTA);
+		Reg0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pSrc));
+		Reg1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pSrc + 32));
+		Reg2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pSrc + 64));
+		Reg3 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pSrc + 96));
+		_mm256_stream_si256(reinterpret_cast<__m256i *>(pDst), Reg0);
+		_mm256_stream_si256(reinterpret_cast<__m256i *>(pDst + 32), Reg1);
+		_mm256_stream_si256(reinterpret_cast<__m256i *>(pDst + 64), Reg2);
+		_mm256_stream_si256(reinterpret_cast<__m256i *>(pDst + 96), Reg3);
+		pSrc += 128;
+		pDst += 128;
+	}
+
+	// Remainder
+	Size &= 127;
+	if (Size > 0)
+		memcpy(pDst, pSrc, Size);
+
+	_mm_sfence();
+}
+
+SPOUT_TARGET_AVX512
+void spoutCopy::memcpy_avx512_stream(void* dst, const void* src, size_t Size) const
+{
+	if (!dst || !src)
+		return;
+
+	auto pSrc = static_cast<const char *>(src);
+	auto pDst = static_cast<char *>(dst);
+
+	// Masked head to a 64 byte destination boundary
+	size_t head = (64 - (reinterpret_cast<uintptr_t>(pDst) & 63)) & 63;
+	if (head > Size) head = Size;
+	if (head > 0) {
+		const __mmask64 mask = (1ULL << head) - 1; // head < 64
+		_mm512_mask_storeu_epi8(pDst, mask, _mm512_maskz_loadu_epi8(mask, pSrc));
+		pSrc += head;
+		pDst += head;
+		Size -= head;
+	}
+
+	size_t n = Size >> 8; // Counter = size divided by 256 (4 * 512bit registers)
+	__m512i Reg0, Reg1, Reg2, Reg3;
+	for (size_t Index = n; Index > 0; --Index) {
+		_mm_prefetch(pSrc + 1024, _MM_HINT_NTA);
+		_mm_prefetch(pSrc + 1024 + 64, _MM_HINT_NTA);
+		Reg0 = _mm512_loadu_si512(reinterpret_cast<const void *>(pSrc));
+		Reg1 = _mm512_loadu_si512(reinterpret_cast<const void *>(pSrc + 64));
+		Reg2 = _mm512_loadu_si512(reinterpret_cast<const void *>(pSrc + 128));
+		Reg3 = _mm512_loadu_si512(reinterpret_cast<const void *>(pSrc + 192));
+		_mm512_stream_si512(reinterpret_cast<__m512i *>(pDst), Reg0);
+		_mm512_stream_si512(reinterpret_cast<__m512i *>(pDst + 64), Reg1);
+		_mm512_stream_si512(reinterpret_cast<__m512i *>(pDst + 128), Reg2);
+		_mm512_stream_si512(reinterpret_cast<__m512i *>(pDst + 192), Reg3);
+		pSrc += 256;
+		pDst += 256;
+	}
+
+	// Remainder in 64 byte streaming steps, then a masked copy of the last bytes
+	Size &= 255;
+	for (; Size >= 64; Size -= 64) {
+		Reg0 = _mm512_loadu_si512(reinterpret_cast<const void *>(pSrc));
+		_mm512_stream_si512(reinterpret_cast<__m512i *>(pDst), Reg0);
+		pSrc += 64;
+		pDst += 64;
+	}
+	if (Size > 0) {
+		const __mmask64 mask = (1ULL << Size) - 1; // Size < 64
+		_mm512_mask_storeu_epi8(pDst, mask, _mm512_maskz_loadu_epi8(mask, pSrc));
+	}
+
+	_mm_sfence();
+}
+
+
+//
+// Select the instruction set and build the kernel dispatch table.
+//
+// Called by the constructor for the best instruction set available.
+// Can be called again to force a lower level for testing or comparison.
+//
+bool spoutCopy::SetSIMD(SpoutSIMD level)
+{
+	bool bRet = true;
+	const SpoutSIMD maxlevel = GetMaxSIMD();
+
+	if (level == SPOUT_SIMD_AUTO) {
+		level = maxlevel;
+	}
+	else if (level > maxlevel) {
+		level = maxlevel; // Not supported by this CPU
+		bRet = false;
+	}
+	m_SIMD = level;
+
+	switch (m_SIMD) {
+		case SPOUT_SIMD_AVX512:
+			m_pMemcpy = &spoutCopy::memcpy_avx512;
+			m_pMemcpyStream = &spoutCopy::memcpy_avx512_stream;
+			m_pSwapRB = &spoutCopy::rgba_bgra_avx512;
+			break;
+		case SPOUT_SIMD_AVX2:
+			m_pMemcpy = &spoutCopy::memcpy_avx2;
+			m_pMemcpyStream = &spoutCopy::memcpy_avx2_stream;
+			m_pSwapRB = &spoutCopy::rgba_bgra_avx2;
+			break;
+		case SPOUT_SIMD_SSSE3:
+			m_pMemcpy = &spoutCopy::memcpy_sse2;
+			m_pMemcpyStream = &spoutCopy::memcpy_sse2;
+			m_pSwapRB = &spoutCopy::rgba_bgra_sse3;
+			break;
+		case SPOUT_SIMD_SSE2:
+			m_pMemcpy = &spoutCopy::memcpy_sse2;
+			m_pMemcpyStream = &spoutCopy::memcpy_sse2;
+			m_pSwapRB = &spoutCopy::rgba_bgra_sse2;
+			break;
+		default: // No SSE - m_pMemcpy is not used
+			m_pMemcpy = nullptr;
+			m_pMemcpyStream = nullptr;
+			m_pSwapRB = &spoutCopy::rgba_bgra;
+			break;
+	}
+
+	return bRet;
+}
+
+SpoutSIMD spoutCopy::GetSIMD() const
+{
+	return m_SIMD;
+}
+
+SpoutSIMD spoutCopy::GetMaxSIMD() const
+{
+	if (m_bAVX512BW)
+		return SPOUT_SIMD_AVX512;
+	if (m_bAVX2)
+		return SPOUT_SIMD_AVX2;
+	if (m_bSSE2 && m_bSSSE3)
+		return SPOUT_SIMD_SSSE3;
+	if (m_bSSE2)
+		return SPOUT_SIMD_SSE2;
+	return SPOUT_SIMD_NONE;
 }
 
 
@@ -279,6 +942,26 @@ void spoutCopy::memcpy_sse2(void* dst, const void* src, size_t Size) const
 // SSE42 | [bit 20] ECX
 // SSE42 = (cpuid02 & (0x1 << 20))
 //
+// AVX2 and AVX-512 :
+//
+// The processor support bits are returned by CPUID with EAX = 7, ECX = 0.
+// The operating system must also save the extended register state.
+// OSXSAVE [bit 27] ECX of CPUID 1 allows XGETBV to read XCR0 which must have
+// bits 1 and 2 (SSE and AVX state) and for AVX-512 bits 5, 6 and 7 (opmask and ZMM state).
+//
+// AVX2 | [bit 5] EBX
+// AVX2 = (cpuid7_1 & (0x1 << 5))
+//
+// AVX512F | [bit 16] EBX
+// AVX512F = (cpuid7_1 & (0x1 << 16))
+//
+// AVX512BW | [bit 30] EBX
+// AVX512BW = (cpuid7_1 & (0x1 << 30))
+//
+// F16C half float conversion also requires AVX register state
+// F16C | [bit 29] ECX
+// F16C = (cpuid02 & (0x1 << 29))
+//
 // EAX - CPUInfo[0]
 // EBX - CPUInfo[1]
 // ECX - CPUInfo[2]
@@ -286,11 +969,25 @@ void spoutCopy::memcpy_sse2(void* dst, const void* src, size_t Size) const
 //
 // For intrinsics and SSE : https://software.intel.com/sites/landingpage/IntrinsicsGuide/
 //
+
+// Read XCR0 for the register state saved by the operating system
+static unsigned long long GetXCR0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int eax = 0, edx = 0;
+	__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
 void spoutCopy::CheckSSE()
 {
 	// An array of four integers that contains the information returned
 	// in EAX (0), EBX (1), ECX (2), and EDX (3) about supported features of the CPU.
 	int CPUInfo[4] = { -1, -1, -1, -1 };
+	unsigned long long xcr0 = 0; // Extended control register
 
 	//-- Get number of valid info ids
 	__cpuid(CPUInfo, 0);
@@ -308,6 +1005,57 @@ void spoutCopy::CheckSSE()
 		// SSSE3 | [bit 9] ECX
 		// SSSE3 = (cpuid02 & (0x1 << 9)
 		m_bSSSE3 = ((CPUInfo[2] & (0x1 << 9)) || false);
+
+		// OSXSAVE | [bit 27] ECX, AVX | [bit 28] ECX
+		if ((CPUInfo[2] & (0x1 << 27)) && (CPUInfo[2] & (0x1 << 28)))
+			xcr0 = GetXCR0();
+		// F16C | [bit 29] ECX
+		// with SSE and AVX register state
+		m_bF16C = ((xcr0 & 0x6) == 0x6) && ((CPUInfo[2] & (0x1 << 29)) || false);
+	}
+
+	//-- Get info for id "7"
+	if (nIds >= 7) {
+		__cpuidex(CPUInfo, 7, 0);
+		// AVX2 | [bit 5] EBX
+		// with SSE and AVX register state
+		m_bAVX2 = ((xcr0 & 0x6) == 0x6) && ((CPUInfo[1] & (0x1 << 5)) || false);
+		// AVX512F | [bit 16] EBX and AVX512BW | [bit 30] EBX
+		// with opmask and ZMM register state
+		m_bAVX512BW = m_bAVX2 && ((xcr0 & 0xE0) == 0xE0)
+			&& ((CPUInfo[1] & (0x1 << 16)) || false)
+			&& ((CPUInfo[1] & (0x1 << 30)) || false);
+	}
+
+	//-- Last level cache size from the deterministic cache parameters
+	// Leaf 4 (Intel) or 0x8000001D (AMD) with one sub-leaf for each cache
+	// Size = ways * partitions * line size * sets
+	int leaf = 0;
+	if (nIds >= 4) {
+		__cpuidex(CPUInfo, 4, 0);
+		if ((CPUInfo[0] & 0x1f) != 0)
+			leaf = 4;
+	}
+	if (leaf == 0) {
+		__cpuid(CPUInfo, 0x80000000);
+		if ((unsigned int)CPUInfo[0] >= 0x8000001D)
+			leaf = (int)0x8000001D;
+	}
+	m_CacheSize = 0;
+	if (leaf != 0) {
+		for (int i = 0; i < 16; i++) {
+			__cpuidex(CPUInfo, leaf, i);
+			if ((CPUInfo[0] & 0x1f) == 0) // No more caches
+				break;
+			if ((CPUInfo[0] & 0x1f) == 2) // Instruction cache
+				continue;
+			const size_t size = (size_t)(((unsigned int)CPUInfo[1] >> 22) + 1) // ways
+				* ((((unsigned int)CPUInfo[1] >> 12) & 0x3ff) + 1) // partitions
+				* (((unsigned int)CPUInfo[1] & 0xfff) + 1) // line size
+				* ((unsigned int)CPUInfo[2] + 1); // sets
+			if (size > m_CacheSize)
+				m_CacheSize = size;
+		}
 	}
 
 }
@@ -318,11 +1066,16 @@ void spoutCopy::CheckSSE()
 void spoutCopy::rgba2bgra(const void *rgba_source, void *bgra_dest,
 	unsigned int width, unsigned int height, bool bInvert) const
 {
-	if ((width % 16) == 0) { // 16 byte aligned width
-		if (m_bSSE2 && m_bSSSE3) // SSE3 available
-			rgba_bgra_sse3(rgba_source, bgra_dest, width, height, bInvert);
-		else if (m_bSSE2) // SSE2 available
-			rgba_bgra_sse2(rgba_source, bgra_dest, width, height, bInvert);
+	if (UseThreads((size_t)width * height * 4, height)) {
+		if (RunRows(m_pPool, rgba_source, bgra_dest, height, width * 4, width * 4, bInvert,
+			[&](const unsigned char* src, unsigned char* dst, unsigned int rows) {
+				rgba2bgra(src, dst, width, rows, bInvert);
+			}))
+			return;
+	}
+
+	if (SwapRBSIMD(rgba_source, bgra_dest, width)) {
+		(this->*m_pSwapRB)(rgba_source, bgra_dest, width, height, bInvert);
 	}
 	else {
 		rgba_bgra(rgba_source, bgra_dest, width, height, bInvert);
@@ -334,6 +1087,14 @@ void spoutCopy::rgba2bgra(const void *rgba_source, void *bgra_dest,
 void spoutCopy::rgba2bgra(const void *rgba_source, void *bgra_dest,
 	unsigned int width, unsigned int height, unsigned int sourcePitch, bool bInvert) const
 {
+	if (UseThreads((size_t)width * height * 4, height)) {
+		if (RunRows(m_pPool, rgba_source, bgra_dest, height, sourcePitch, width * 4, bInvert,
+			[&](const unsigned char* src, unsigned char* dst, unsigned int rows) {
+				rgba2bgra(src, dst, width, rows, sourcePitch, bInvert);
+			}))
+			return;
+	}
+
 	for (unsigned int y = 0; y < height; y++) {
 		// Start of buffer
 		auto source = static_cast<const unsigned __int32 *>(rgba_source); // unsigned int = 4 bytes
@@ -350,11 +1111,8 @@ void spoutCopy::rgba2bgra(const void *rgba_source, void *bgra_dest,
 			dest += (unsigned long)(y * width);
 		}
 		// Copy the line
-		if ((width % 16) == 0) { // 16 byte aligned width
-			if (m_bSSE2 && m_bSSSE3) // SSE3 available
-				rgba_bgra_sse3(source, dest, width, 1, bInvert);
-			else if (m_bSSE2) // SSE2 available
-				rgba_bgra_sse2(source, dest, width, 1, bInvert);
+		if (SwapRBSIMD(source, dest, width)) {
+			(this->*m_pSwapRB)(source, dest, width, 1, bInvert);
 		}
 		else {
 			rgba_bgra(source, dest, width, 1, bInvert);
@@ -368,6 +1126,14 @@ void spoutCopy::rgba2bgra(const void* rgba_source, void* bgra_dest,
 	unsigned int width, unsigned int height,
 	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
 {
+	if (UseThreads((size_t)width * height * 4, height)) {
+		if (RunRows(m_pPool, rgba_source, bgra_dest, height, sourcePitch, destPitch, bInvert,
+			[&](const unsigned char* src, unsigned char* dst, unsigned int rows) {
+				rgba2bgra(src, dst, width, rows, sourcePitch, destPitch, bInvert);
+			}))
+			return;
+	}
+
 	for (unsigned int y = 0; y < height; y++) {
 		// Start of buffer
 		auto source = static_cast<const unsigned __int32 *>(rgba_source); // unsigned int = 4 bytes
@@ -384,11 +1150,8 @@ void spoutCopy::rgba2bgra(const void* rgba_source, void* bgra_dest,
 			dest   += (unsigned long)(y * destPitch / 4);
 		}
 		// Copy the line
-		if ((width % 16) == 0) { // 16 byte aligned width
-			if (m_bSSE2 && m_bSSSE3) // SSE3 available
-				rgba_bgra_sse3(source, dest, width, 1, bInvert);
-			else if (m_bSSE2) // SSE2 available
-				rgba_bgra_sse2(source, dest, width, 1, bInvert);
+		if (SwapRBSIMD(source, dest, width)) {
+			(this->*m_pSwapRB)(source, dest, width, 1, bInvert);
 		}
 		else {
 			rgba_bgra(source, dest, width, 1, bInvert);
@@ -397,6 +1160,13 @@ void spoutCopy::rgba2bgra(const void* rgba_source, void* bgra_dest,
 }
 
 
+// The SSE red/blue swap requires 16 byte aligned width and lines, AVX any width
+bool spoutCopy::SwapRBSIMD(const void* source, const void* dest, unsigned int width) const
+{
+	return m_SIMD >= SPOUT_SIMD_AVX2 || ((width % 16) == 0
+		&& ((reinterpret_cast<uintptr_t>(source) | reinterpret_cast<uintptr_t>(dest)) & 15) == 0);
+}
+
 // Both are swapping red and blue, so use the same function
 void spoutCopy::bgra2rgba(const void *bgra_source, void *rgba_dest, unsigned int width, unsigned int height, bool bInvert) const
 {
@@ -551,569 +1321,3763 @@ void spoutCopy::rgba_bgra_sse3(const void* rgba_source,  void *bgra_dest, unsign
 
 
 //
-// rgb2rgba, bgr2rgba, rgba2rgb, rgba2bgr, rgb2bgra
+// AVX2 version of rgba_bgra_sse3
 //
-
-void spoutCopy::rgb2rgba(const void *rgb_source, void *rgba_dest, unsigned int width, unsigned int height, bool bInvert) const
+// 32 pixels per cycle (4 * 256bit registers) with unaligned loads and stores.
+// Any width or alignment. The remainder uses 8 pixel steps and then single pixels.
+//
+SPOUT_TARGET_AVX2
+void spoutCopy::rgba_bgra_avx2(const void* rgba_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert) const
 {
-	const unsigned long rgbsize = width * height * 3;
-	const unsigned long rgbpitch = width * 3;
+	// Shuffling mask (RGBA -> BGRA) for each 128 bit lane
+	const __m256i m = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+									   2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+	for (unsigned int y = 0; y < height; y++) {
 
-	// Start of buffers
-	auto rgb = static_cast<const unsigned char *>(rgb_source); // RGB
-	auto rgba = static_cast<unsigned char *>(rgba_dest); // RGBA
+		// Start of buffer
+		auto source = static_cast<const unsigned __int32 *>(rgba_source); // unsigned int = 4 bytes
+		auto dest = static_cast<unsigned __int32 *>(bgra_dest);
 
-	if (bInvert) {
-		rgb += rgbsize; // end of rgb buffer
-		rgb -= rgbpitch; // beginning of the last rgb line
-	}
+		// Increment to current line
+		if (bInvert)
+			source += (unsigned long)((height - 1 - y)*width);
+		else
+			source += (unsigned long)(y * width);
+		dest += (unsigned long)(y * width); // dest is not inverted
 
-	for (unsigned int y = 0; y < height; y++) {
-		for (unsigned int x = 0; x < width; x++) {
-			// rgb source - rgba dest
-			*(rgba + 0) = *(rgb + 0); // red
-			*(rgba + 1) = *(rgb + 1); // grn
-			*(rgba + 2) = *(rgb + 2); // blu
-			*(rgba + 3) = (unsigned char)255; // alpha
-			rgb += 3;
-			rgba += 4;
+		unsigned int x = 0;
+		for (; x + 32 <= width; x += 32) {
+			__m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + x));
+			__m256i p2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + x + 8));
+			__m256i p3 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + x + 16));
+			__m256i p4 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + x + 24));
+
+			p1 = _mm256_shuffle_epi8(p1, m);
+			p2 = _mm256_shuffle_epi8(p2, m);
+			p3 = _mm256_shuffle_epi8(p3, m);
+			p4 = _mm256_shuffle_epi8(p4, m);
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + x), p1);
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + x + 8), p2);
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + x + 16), p3);
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + x + 24), p4);
+		}
+
+		for (; x + 8 <= width; x += 8) {
+			__m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + x));
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + x), _mm256_shuffle_epi8(p1, m));
+		}
+
+		// Perform leftover writes
+		for (; x < width; x++) {
+			auto rgbapix = source[x];
+			dest[x] = (_rotl(rgbapix, 16) & 0x00ff00ff) | (rgbapix & 0xff00ff00);
 		}
-		if (bInvert)
-			rgb -= rgbpitch * 2; // move up a line for invert
 	}
 
-} // end rgb2rgba
+} // end rgba_bgra_avx2
 
 
-void spoutCopy::rgb2rgba(const void *rgb_source, void *rgba_dest,
-	unsigned int width, unsigned int height,
-	unsigned int dest_pitch, bool bInvert) const
+//
+// AVX-512 version of rgba_bgra_sse3
+//
+// 64 pixels per cycle (4 * 512bit registers).
+// The remainder uses 16 pixel masked loads and stores so there are no scalar writes.
+//
+SPOUT_TARGET_AVX512
+void spoutCopy::rgba_bgra_avx512(const void* rgba_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert) const
 {
-	// RGB dest does not have padding
-	const unsigned long rgbsize = width * height * 3;
-	const unsigned long rgbpitch = width * 3;
-	const unsigned long rgba_padding = dest_pitch - (width * 4);
+	// Shuffling mask (RGBA -> BGRA) for each 128 bit lane
+	const __m512i m = _mm512_broadcast_i32x4(
+		_mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15));
 
-	// RGBA dest may have padding 
-	// Dest and source must be the same dimensions otherwise
+	for (unsigned int y = 0; y < height; y++) {
 
-	// Start of buffers
-	auto rgb = static_cast<const unsigned char *>(rgb_source); // rgb/bgr
-	auto rgba = static_cast<unsigned char *>(rgba_dest); // rgba/bgra
-	if (bInvert) {
-		rgb += rgbsize; // end of rgb buffer
-		rgb -= rgbpitch; // beginning of the last rgb line
-	}
+		// Start of buffer
+		auto source = static_cast<const unsigned __int32 *>(rgba_source); // unsigned int = 4 bytes
+		auto dest = static_cast<unsigned __int32 *>(bgra_dest);
 
-	for (unsigned int y = 0; y < height; y++) {
-		for (unsigned int x = 0; x < width; x++) {
-			*(rgba + 0) = *(rgb + 0); // red
-			*(rgba + 1) = *(rgb + 1); // grn
-			*(rgba + 2) = *(rgb + 2); // blu
-			rgb += 3;
-			rgba += 4;
+		// Increment to current line
+		if (bInvert)
+			source += (unsigned long)((height - 1 - y)*width);
+		else
+			source += (unsigned long)(y * width);
+		dest += (unsigned long)(y * width); // dest is not inverted
+
+		unsigned int x = 0;
+		for (; x + 64 <= width; x += 64) {
+			__m512i p1 = _mm512_loadu_si512(reinterpret_cast<const void *>(source + x));
+			__m512i p2 = _mm512_loadu_si512(reinterpret_cast<const void *>(source + x + 16));
+			__m512i p3 = _mm512_loadu_si512(reinterpret_cast<const void *>(source + x + 32));
+			__m512i p4 = _mm512_loadu_si512(reinterpret_cast<const void *>(source + x + 48));
+
+			p1 = _mm512_shuffle_epi8(p1, m); // AVX-512BW
+			p2 = _mm512_shuffle_epi8(p2, m);
+			p3 = _mm512_shuffle_epi8(p3, m);
+			p4 = _mm512_shuffle_epi8(p4, m);
+
+			_mm512_storeu_si512(reinterpret_cast<void *>(dest + x), p1);
+			_mm512_storeu_si512(reinterpret_cast<void *>(dest + x + 16), p2);
+			_mm512_storeu_si512(reinterpret_cast<void *>(dest + x + 32), p3);
+			_mm512_storeu_si512(reinterpret_cast<void *>(dest + x + 48), p4);
 		}
-		rgba += rgba_padding;
 
-		if (bInvert)
-			rgb -= rgbpitch * 2; // move up a line for invert
+		for (; x < width; x += 16) {
+			// One bit per remaining pixel
+			const unsigned int n = (width - x < 16) ? (width - x) : 16;
+			const __mmask16 mask = (__mmask16)((1u << n) - 1);
+			__m512i p1 = _mm512_maskz_loadu_epi32(mask, source + x);
+			_mm512_mask_storeu_epi32(dest + x, mask, _mm512_shuffle_epi8(p1, m));
+		}
 	}
 
-} // end rgb2rgba
+} // end rgba_bgra_avx512
 
 
-void spoutCopy::bgr2rgba(const void *bgr_source, void *rgba_dest, unsigned int width, unsigned int height, bool bInvert) const
-{
+//
+// rgb2rgba, bgr2rgba, rgba2rgb, rgba2bgr, rgb2bgra
+//
+// Conversions between 8 bit RGBA, BGRA, RGB and BGR use CopyImage
+//
+
+void spoutCopy::rgb2rgba(const void *rgb_source, void *rgba_dest, unsigned int width, unsigned int height, bool bInvert) const
+{
+	CopyImage(rgb_source, rgba_dest, width, height, GL_RGB, GL_RGBA, 0, 0, bInvert);
+}
+
+void spoutCopy::rgb2rgba(const void *rgb_source, void *rgba_dest,
+	unsigned int width, unsigned int height,
+	unsigned int dest_pitch, bool bInvert) const
+{
+	CopyImage(rgb_source, rgba_dest, width, height, GL_RGB, GL_RGBA, 0, dest_pitch, bInvert);
+}
+
+void spoutCopy::bgr2rgba(const void *bgr_source, void *rgba_dest, unsigned int width, unsigned int height, bool bInvert) const
+{
+	CopyImage(bgr_source, rgba_dest, width, height, GL_BGR_EXT, GL_RGBA, 0, 0, bInvert);
+}
+
+void spoutCopy::bgr2rgba(const void *bgr_source, void *rgba_dest,
+	unsigned int width, unsigned int height,
+	unsigned int dest_pitch, bool bInvert) const
+{
+	CopyImage(bgr_source, rgba_dest, width, height, GL_BGR_EXT, GL_RGBA, 0, dest_pitch, bInvert);
+}
+
+void spoutCopy::rgb2bgra(const void *rgb_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert) const
+{
+	CopyImage(rgb_source, bgra_dest, width, height, GL_RGB, GL_BGRA_EXT, 0, 0, bInvert);
+}
+
+void spoutCopy::rgb2bgra(const void *rgb_source, void *bgra_dest,
+	unsigned int width, unsigned int height,
+	unsigned int dest_pitch, bool bInvert) const
+{
+	CopyImage(rgb_source, bgra_dest, width, height, GL_RGB, GL_BGRA_EXT, 0, dest_pitch, bInvert);
+}
+
+void spoutCopy::bgr2bgra(const void *bgr_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert) const
+{
+	CopyImage(bgr_source, bgra_dest, width, height, GL_BGR_EXT, GL_BGRA_EXT, 0, 0, bInvert);
+}
+
+void spoutCopy::rgba2rgb(const void *rgba_source, void *rgb_dest,
+	unsigned int width, unsigned int height,
+	unsigned int rgba_pitch, bool bInvert, bool bMirror, bool bSwapRB) const
+{
+	CopyImage(rgba_source, rgb_dest, width, height, GL_RGBA, GL_RGB, rgba_pitch, 0, bInvert, bMirror, bSwapRB);
+}
+
+void spoutCopy::rgba2bgr(const void *rgba_source, void *bgr_dest, unsigned int width, unsigned int height, bool bInvert) const
+{
+	CopyImage(rgba_source, bgr_dest, width, height, GL_RGBA, GL_BGR_EXT, 0, 0, bInvert);
+}
+
+void spoutCopy::rgba2bgr(const void *rgba_source, void *bgr_dest,
+	unsigned int width, unsigned int height,
+	unsigned int rgba_pitch, bool bInvert) const
+{
+	CopyImage(rgba_source, bgr_dest, width, height, GL_RGBA, GL_BGR_EXT, rgba_pitch, 0, bInvert);
+}
+
+void spoutCopy::bgra2rgb(const void *bgra_source, void *rgb_dest, unsigned int width, unsigned int height, bool bInvert) const
+{
+	CopyImage(bgra_source, rgb_dest, width, height, GL_BGRA_EXT, GL_RGB, 0, 0, bInvert);
+}
+
+void spoutCopy::bgra2bgr(const void *bgra_source, void *bgr_dest, unsigned int width, unsigned int height, bool bInvert) const
+{
+	CopyImage(bgra_source, bgr_dest, width, height, GL_BGRA_EXT, GL_BGR_EXT, 0, 0, bInvert);
+}
+
+
+void spoutCopy::rgba2rgba(const void* rgba_source, void* rgba_dest,
+	unsigned int width, unsigned int height, unsigned int sourcePitch, bool bInvert) const
+{
+	CopyLines(rgba_source, rgba_dest, width, height, sourcePitch, width * 4, bInvert,
+		(size_t)width * height * 4 >= m_StreamSize);
+}
+
+void spoutCopy::rgba2rgba(const void* rgba_source, void* rgba_dest,
+	unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	CopyLines(rgba_source, rgba_dest, width, height, sourcePitch, destPitch, bInvert,
+		(size_t)width * height * 4 >= m_StreamSize);
+}
+
+void spoutCopy::CopyLines(const void* rgba_source, void* rgba_dest,
+	unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert, bool bStream) const
+{
+	if (UseThreads((size_t)width * height * 4, height)) {
+		if (RunRows(m_pPool, rgba_source, rgba_dest, height, sourcePitch, destPitch, bInvert,
+			[&](const unsigned char* src, unsigned char* dst, unsigned int rows) {
+				CopyLines(src, dst, width, rows, sourcePitch, destPitch, bInvert, bStream);
+			}))
+			return;
+	}
+
+	// For all rows
+	for (unsigned int y = 0; y < height; y++) {
+		// Start of buffers
+		auto source = static_cast<const unsigned __int32 *>(rgba_source); // unsigned int = 4 bytes
+		auto dest   = static_cast<unsigned __int32 *>(rgba_dest);
+		// Increment to current line
+		// Pitch is line length in bytes. Divide by 4 to get the width in rgba pixels.
+		if (bInvert) {
+			source += (unsigned long)((height - 1 - y)*sourcePitch / 4);
+			dest   += (unsigned long)(y * destPitch / 4); // dest is not inverted
+		}
+		else {
+			source += (unsigned long)(y * sourcePitch / 4);
+			dest   += (unsigned long)(y * destPitch / 4);
+		}
+		// Copy the line as fast as possible
+		CopyPixels((const unsigned char *)source, (unsigned char *)dest, width, 1, GL_RGBA, false, bStream);
+	}
+}
+
+//
+// Copy and convert an image in a single pass
+//
+// Source and destination are read and written once, with invert, mirror,
+// line pitch and channel order handled for each line.
+//
+
+// Pixel format descriptor
+// Bytes per pixel and the byte offset of each channel, -1 if not present
+template<unsigned int Bytes, int R, int G, int B, int A>
+struct spoutPixelFormat {
+	static const unsigned int bytes = Bytes;
+	static int Offset(int c) {
+		return c == 0 ? R : c == 1 ? G : c == 2 ? B : A;
+	}
+};
+typedef spoutPixelFormat<4, 0, 1, 2, 3> spoutPixelRGBA;
+typedef spoutPixelFormat<4, 2, 1, 0, 3> spoutPixelBGRA;
+typedef spoutPixelFormat<3, 0, 1, 2, -1> spoutPixelRGB;
+typedef spoutPixelFormat<3, 2, 1, 0, -1> spoutPixelBGR;
+
+// Byte shuffle and alpha fill for four pixels of Src to four pixels of Dst
+// Source bytes beyond the four pixels and destination bytes beyond
+// four pixels of Dst are ignored.
+template<class Src, class Dst>
+static void PixelShuffle(bool bMirror, __m128i& shuffle, __m128i& alpha)
+{
+	alignas(16) unsigned char m[16];
+	alignas(16) unsigned char a[16];
+	for (unsigned int i = 0; i < 16; i++) {
+		m[i] = 0x80; // zero
+		a[i] = 0;
+	}
+	for (unsigned int j = 0; j < 4; j++) {
+		const unsigned int s = (bMirror ? 3 - j : j) * Src::bytes;
+		for (int c = 0; c < 4; c++) {
+			const int d = Dst::Offset(c);
+			if (d < 0)
+				continue;
+			if (Src::Offset(c) >= 0)
+				m[j * Dst::bytes + d] = (unsigned char)(s + Src::Offset(c));
+			else
+				a[j * Dst::bytes + d] = 0xff; // Opaque alpha
+		}
+	}
+	shuffle = _mm_load_si128(reinterpret_cast<const __m128i *>(m));
+	alpha = _mm_load_si128(reinterpret_cast<const __m128i *>(a));
+}
+
+template<class Src, class Dst>
+static void ConvertPixel(const unsigned char* s, unsigned char* d)
+{
+	for (int c = 0; c < 4; c++) {
+		if (Dst::Offset(c) >= 0)
+			d[Dst::Offset(c)] = (Src::Offset(c) >= 0) ? s[Src::Offset(c)] : (unsigned char)255;
+	}
+}
+
+// Pixels of a line are converted in blocks of N pixels.
+// A block loads 16 bytes for each group of four source pixels and stores
+// 16 bytes for each group of four destination pixels, so a block is only
+// used where the extra bytes of a 3 byte format are inside the line.
+// Other pixels are converted one at a time.
+template<class Src, class Dst, unsigned int N>
+static bool PixelBlock(unsigned int x, unsigned int width, bool bMirror, size_t& p)
+{
+	if (x + N > width)
+		return false;
+	p = bMirror ? (size_t)width - x - N : x; // First source pixel of the block
+	return (p + N - 4) * Src::bytes + 16 <= (size_t)width * Src::bytes
+		&& ((size_t)x + N - 4) * Dst::bytes + 16 <= (size_t)width * Dst::bytes;
+}
+
+template<class Src, class Dst>
+static void ConvertPixelsScalar(const unsigned char* src, unsigned char* dst, unsigned int width, bool bMirror)
+{
+	for (unsigned int x = 0; x < width; x++) {
+		const size_t xs = bMirror ? (size_t)width - 1 - x : x;
+		ConvertPixel<Src, Dst>(src + xs * Src::bytes, dst + (size_t)x * Dst::bytes);
+	}
+}
+
+// SSSE3 - four pixels with one byte shuffle
+template<class Src, class Dst>
+static void ConvertPixelsSSSE3(const unsigned char* src, unsigned char* dst, unsigned int width, bool bMirror)
+{
+	__m128i shuffle, alpha;
+	PixelShuffle<Src, Dst>(bMirror, shuffle, alpha);
+
+	size_t p = 0;
+	unsigned int x = 0;
+	while (x < width) {
+		if (PixelBlock<Src, Dst, 4>(x, width, bMirror, p)) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + p * Src::bytes));
+			v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + (size_t)x * Dst::bytes), v);
+			x += 4;
+		}
+		else {
+			ConvertPixel<Src, Dst>(src + (bMirror ? (size_t)width - 1 - x : x) * Src::bytes, dst + (size_t)x * Dst::bytes);
+			x++;
+		}
+	}
+}
+
+// AVX2 - eight pixels, four in each 128 bit lane
+template<class Src, class Dst>
+SPOUT_TARGET_AVX2
+static void ConvertPixelsAVX2(const unsigned char* src, unsigned char* dst, unsigned int width, bool bMirror)
+{
+	__m128i shuffle128, alpha128;
+	PixelShuffle<Src, Dst>(bMirror, shuffle128, alpha128);
+	const __m256i shuffle = _mm256_broadcastsi128_si256(shuffle128);
+	const __m256i alpha = _mm256_broadcastsi128_si256(alpha128);
+
+	size_t p = 0;
+	unsigned int x = 0;
+	while (x < width) {
+		if (PixelBlock<Src, Dst, 8>(x, width, bMirror, p)) {
+			const unsigned char* s = src + p * Src::bytes;
+			unsigned char* d = dst + (size_t)x * Dst::bytes;
+			// For mirror the first four destination pixels are the last four source pixels
+			const __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+			const __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 4 * Src::bytes));
+			__m256i v = bMirror ? _mm256_inserti128_si256(_mm256_castsi128_si256(p1), p0, 1)
+				: _mm256_inserti128_si256(_mm256_castsi128_si256(p0), p1, 1);
+			v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha);
+			if (Dst::bytes == 4) {
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(d), v);
+			}
+			else {
+				// The second lane overwrites the unused bytes of the first
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(d), _mm256_castsi256_si128(v));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(d + 4 * Dst::bytes), _mm256_extracti128_si256(v, 1));
+			}
+			x += 8;
+		}
+		else {
+			ConvertPixel<Src, Dst>(src + (bMirror ? (size_t)width - 1 - x : x) * Src::bytes, dst + (size_t)x * Dst::bytes);
+			x++;
+		}
+	}
+}
+
+// Line conversion for a pair of formats
+typedef void (*spoutPixelConvert)(const unsigned char* src, unsigned char* dst, unsigned int width, bool bMirror);
+
+template<class Src, class Dst>
+static spoutPixelConvert PixelConvert(SpoutSIMD level)
+{
+	if (level >= SPOUT_SIMD_AVX2)
+		return ConvertPixelsAVX2<Src, Dst>;
+	if (level >= SPOUT_SIMD_SSSE3)
+		return ConvertPixelsSSSE3<Src, Dst>;
+	return ConvertPixelsScalar<Src, Dst>;
+}
+
+// The source is taken as RGBA or RGB and bSwap selects BGRA or BGR for the destination
+static spoutPixelConvert PixelConvert(SpoutSIMD level, unsigned int sourceBytes, unsigned int destBytes, bool bSwap)
+{
+	if (sourceBytes == 4) {
+		if (destBytes == 4)
+			return bSwap ? PixelConvert<spoutPixelRGBA, spoutPixelBGRA>(level) : PixelConvert<spoutPixelRGBA, spoutPixelRGBA>(level);
+		return bSwap ? PixelConvert<spoutPixelRGBA, spoutPixelBGR>(level) : PixelConvert<spoutPixelRGBA, spoutPixelRGB>(level);
+	}
+	if (destBytes == 4)
+		return bSwap ? PixelConvert<spoutPixelRGB, spoutPixelBGRA>(level) : PixelConvert<spoutPixelRGB, spoutPixelRGBA>(level);
+	return bSwap ? PixelConvert<spoutPixelRGB, spoutPixelBGR>(level) : PixelConvert<spoutPixelRGB, spoutPixelRGB>(level);
+}
+
+// Bytes per pixel and red/blue order of an 8 bit format
+static bool ImageFormat(GLenum glFormat, unsigned int& bytes, bool& bBGR)
+{
+	bBGR = (glFormat == GL_BGRA_EXT || glFormat == GL_BGR_EXT);
+	if (glFormat == GL_RGBA || glFormat == GL_BGRA_EXT)
+		bytes = 4;
+	else if (glFormat == GL_RGB || glFormat == GL_BGR_EXT)
+		bytes = 3;
+	else if (glFormat == GL_LUMINANCE)
+		bytes = 1;
+	else
+		return false;
+	return true;
+}
+
+bool spoutCopy::CopyImage(const void* source, void* dest, unsigned int width, unsigned int height,
+	GLenum sourceFormat, GLenum destFormat,
+	unsigned int sourcePitch, unsigned int destPitch,
+	bool bInvert, bool bMirror, bool bSwapRB) const
+{
+	if (!source || !dest || width == 0 || height == 0)
+		return false;
+
+	unsigned int sourceBytes = 0;
+	unsigned int destBytes = 0;
+	bool bSourceBGR = false;
+	bool bDestBGR = false;
+	if (!ImageFormat(sourceFormat, sourceBytes, bSourceBGR)
+		|| !ImageFormat(destFormat, destBytes, bDestBGR))
+		return false;
+
+	// Luminance is copied without conversion
+	if ((sourceBytes == 1 || destBytes == 1) && sourceBytes != destBytes)
+		return false;
+
+	if (sourcePitch == 0) sourcePitch = width * sourceBytes;
+	if (destPitch == 0) destPitch = width * destBytes;
+
+	const bool bSwap = (bSourceBGR != bDestBGR) != bSwapRB;
+	const size_t size = (size_t)width * height * destBytes;
+
+	// Color and alpha conversion read back each line after it is written
+	const bool bStream = size >= m_StreamSize && !m_pColor && m_Alpha == SPOUT_ALPHA_NONE;
+
+	CopyImageLines(static_cast<const unsigned char *>(source), static_cast<unsigned char *>(dest),
+		width, height, sourceBytes, destBytes, sourcePitch, destPitch,
+		bInvert, bMirror, bSwap && destBytes > 1, bDestBGR, bStream);
+
+	return true;
+}
+
+void spoutCopy::CopyImageLines(const unsigned char* source, unsigned char* dest,
+	unsigned int width, unsigned int height,
+	unsigned int sourceBytes, unsigned int destBytes,
+	unsigned int sourcePitch, unsigned int destPitch,
+	bool bInvert, bool bMirror, bool bSwap, bool bDestBGR, bool bStream) const
+{
+	if (UseThreads((size_t)width * height * destBytes, height)) {
+		if (RunRows(m_pPool, source, dest, height, sourcePitch, destPitch, bInvert,
+			[&](const unsigned char* src, unsigned char* dst, unsigned int rows) {
+				CopyImageLines(src, dst, width, rows, sourceBytes, destBytes,
+					sourcePitch, destPitch, bInvert, bMirror, bSwap, bDestBGR, bStream);
+			}))
+			return;
+	}
+
+	// Pixel conversion for the formats and instruction set
+	const spoutPixelConvert convert = (sourceBytes > 1) ? PixelConvert(m_SIMD, sourceBytes, destBytes, bSwap) : nullptr;
+
+	for (unsigned int y = 0; y < height; y++) {
+		// dest is not inverted
+		const unsigned char* src = source + (size_t)(bInvert ? (height - 1 - y) : y) * sourcePitch;
+		unsigned char* dst = dest + (size_t)y * destPitch;
+
+		if (sourceBytes == destBytes && !bSwap && !bMirror) {
+			// Straight copy
+			CopyPixels(src, dst, width * sourceBytes, 1, GL_LUMINANCE, false, bStream);
+		}
+		else if (sourceBytes == 4 && destBytes == 4 && bSwap && !bMirror) {
+			if (SwapRBSIMD(src, dst, width))
+				(this->*m_pSwapRB)(src, dst, width, 1, false);
+			else
+				rgba_bgra(src, dst, width, 1, false);
+		}
+		else if (sourceBytes == 1) {
+			// Luminance mirror
+			for (unsigned int x = 0; x < width; x++)
+				dst[x] = src[width - 1 - x];
+		}
+		else {
+			convert(src, dst, width, bMirror);
+		}
+
+		// Color and alpha conversion of the line while it is in the cache.
+		// Colors are converted without premultiplied alpha.
+		const bool bAlpha = (m_Alpha != SPOUT_ALPHA_NONE && sourceBytes == 4 && destBytes == 4);
+		if (bAlpha && m_Alpha == SPOUT_ALPHA_UNPREMULTIPLY)
+			AlphaLine(dst, dst, width);
+		if (m_pColor && destBytes > 1)
+			ColorLine(dst, width, destBytes, bDestBGR);
+		if (bAlpha && m_Alpha == SPOUT_ALPHA_PREMULTIPLY)
+			AlphaLine(dst, dst, width);
+	}
+}
+
+//
+// Resample
+//
+// rgba2rgbaResample, rgba2rgbResample and rgba2bgrResample share a separable
+// filter selected by SetResample. The weights for each axis are calculated
+// once for the image and not for each pixel.
+//
+// Each destination row is made in two passes :
+//   1) Source rows covered by the vertical weights are combined into a float row.
+//      (AVX2 8 channels or SSE2 4 channels at a time)
+//   2) Each destination pixel combines the float row pixels covered by the
+//      horizontal weights (AVX2 two or SSE2 one RGBA pixel at a time)
+//      and is converted to bytes with saturation.
+// Destination rows are divided between threads if SetThreads is active.
+//
+// Catmull-Rom and Lanczos-3 are centred on the destination pixel and
+// widened by the ratio to reduce, so that every source pixel contributes.
+// Taps beyond the edge are added to the edge pixel and the weights are
+// normalised. The weights of the last size and filter for each axis are
+// kept, so that a stream of frames of the same size does not repeat them.
+//
+// Nearest neighbour uses the same source pixel as previous versions
+// from a table of source columns.
+//
+// Nearest neighbour adapted from :
+// http://tech-algorithm.com/articles/nearest-neighbor-image-scaling/
+// http://www.cplusplus.com/forum/general/2615/#msg10482
+//
+
+// Catmull-Rom (B = 0, C = 0.5) or Lanczos-3 at distance x
+static double ResampleKernel(SpoutResample filter, double x)
+{
+	x = std::fabs(x);
+	if (filter == SPOUT_RESAMPLE_CATMULLROM) {
+		if (x < 1.0) return (1.5*x - 2.5)*x*x + 1.0;
+		if (x < 2.0) return ((-0.5*x + 2.5)*x - 4.0)*x + 2.0;
+		return 0.0;
+	}
+	if (x < 1e-9) return 1.0;
+	if (x >= 3.0) return 0.0;
+	if (std::fabs(x - std::nearbyint(x)) < 1e-9) return 0.0; // zero crossings exactly
+	const double px = 3.14159265358979323846 * x;
+	return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+}
+
+static void MakeResampleTaps(spoutResampleTaps& taps, unsigned int srcSize, unsigned int dstSize, SpoutResample filter)
+{
+	const double ratio = (double)srcSize / (double)dstSize;
+
+	if (filter == SPOUT_RESAMPLE_AUTO)
+		filter = (dstSize < srcSize) ? SPOUT_RESAMPLE_AREA : SPOUT_RESAMPLE_BILINEAR;
+
+	taps.start.resize(dstSize);
+	taps.count.resize(dstSize);
+	taps.offset.resize(dstSize);
+	taps.weight.clear();
+	std::vector<double> kernel; // Catmull-Rom and Lanczos weights before normalising
+
+	for (unsigned int j = 0; j < dstSize; j++) {
+		taps.offset[j] = (unsigned int)taps.weight.size();
+		if (filter == SPOUT_RESAMPLE_AREA) {
+			// Source interval covered by the destination pixel
+			// weighted by the overlap with each source pixel
+			const double x0 = j * ratio;
+			const double x1 = (j + 1) * ratio;
+			const unsigned int i0 = (unsigned int)x0;
+			unsigned int i1 = (unsigned int)std::ceil(x1);
+			if (i1 > srcSize) i1 = srcSize;
+			if (i1 <= i0) i1 = i0 + 1;
+			for (unsigned int i = i0; i < i1; i++) {
+				const double w = ((x1 < i + 1.0 ? x1 : i + 1.0) - (x0 > i ? x0 : (double)i)) / ratio;
+				taps.weight.push_back(w > 0.0 ? (float)w : 0.0f);
+			}
+			taps.start[j] = i0;
+			taps.count[j] = i1 - i0;
+		}
+		else if (filter == SPOUT_RESAMPLE_CATMULLROM || filter == SPOUT_RESAMPLE_LANCZOS3) {
+			// Kernel widened by the ratio to reduce
+			const double scale = ratio > 1.0 ? ratio : 1.0;
+			const double support = (filter == SPOUT_RESAMPLE_LANCZOS3 ? 3.0 : 2.0) * scale;
+			const double x = (j + 0.5) * ratio - 0.5;
+			const int lo = (int)std::floor(x - support) + 1;
+			const int hi = (int)std::ceil(x + support) - 1;
+			const int last = (int)srcSize - 1;
+			const int i0 = lo < 0 ? 0 : (lo > last ? last : lo);
+			const int i1 = hi > last ? last : (hi < i0 ? i0 : hi);
+			// Taps beyond the edges are added to the edge pixels
+			kernel.assign(i1 - i0 + 1, 0.0);
+			double* pw = kernel.data();
+			double sum = 0.0;
+			for (int i = lo; i <= hi; i++) {
+				const double k = ResampleKernel(filter, (i - x) / scale);
+				pw[(i < i0 ? i0 : (i > i1 ? i1 : i)) - i0] += k;
+				sum += k;
+			}
+			// Remove zero weights at each end
+			int k0 = 0;
+			int k1 = i1 - i0;
+			while (k0 < k1 && pw[k0] == 0.0) k0++;
+			while (k1 > k0 && pw[k1] == 0.0) k1--;
+			for (int k = k0; k <= k1; k++)
+				taps.weight.push_back((float)(pw[k] / sum));
+			taps.start[j] = (unsigned int)(i0 + k0);
+			taps.count[j] = (unsigned int)(k1 - k0 + 1);
+		}
+		else {
+			// Bilinear between the two source pixels nearest the destination pixel centre
+			double x = (j + 0.5) * ratio - 0.5;
+			if (x < 0.0) x = 0.0;
+			unsigned int i0 = (unsigned int)x;
+			double f = x - i0;
+			if (i0 >= srcSize - 1) {
+				i0 = srcSize - 1;
+				f = 0.0;
+			}
+			taps.start[j] = i0;
+			if (f > 0.0) {
+				taps.weight.push_back((float)(1.0 - f));
+				taps.weight.push_back((float)f);
+				taps.count[j] = 2;
+			}
+			else {
+				taps.weight.push_back(1.0f);
+				taps.count[j] = 1;
+			}
+		}
+	}
+}
+
+// Weights for an axis from the cache or made again
+static std::shared_ptr<const spoutResampleTaps> GetResampleTaps(spoutResampleCache* cache, unsigned int axis,
+	unsigned int srcSize, unsigned int dstSize, SpoutResample filter)
+{
+	if (cache) {
+		std::lock_guard<std::mutex> lock(cache->mutex);
+		const spoutResampleCache::Entry& e = cache->entry[axis];
+		if (e.taps && e.srcSize == srcSize && e.dstSize == dstSize && e.filter == filter)
+			return e.taps;
+	}
+	auto taps = std::make_shared<spoutResampleTaps>();
+	MakeResampleTaps(*taps, srcSize, dstSize, filter);
+	if (cache) {
+		std::lock_guard<std::mutex> lock(cache->mutex);
+		spoutResampleCache::Entry& e = cache->entry[axis];
+		e.srcSize = srcSize;
+		e.dstSize = dstSize;
+		e.filter = filter;
+		e.taps = taps;
+	}
+	return taps;
+}
+
+// Combine source rows into a float row - no SSE
+static void ResampleRows(const unsigned char* src, size_t pitch,
+	unsigned int count, const float* weight, unsigned int nChannels, float* row)
+{
+	for (unsigned int i = 0; i < nChannels; i++)
+		row[i] = src[i] * weight[0];
+	for (unsigned int k = 1; k < count; k++) {
+		const unsigned char* line = src + k * pitch;
+		for (unsigned int i = 0; i < nChannels; i++)
+			row[i] += line[i] * weight[k];
+	}
+}
+
+// Combine source rows into a float row - 4 channels at a time
+static void ResampleRowsSSE2(const unsigned char* src, size_t pitch,
+	unsigned int count, const float* weight, unsigned int nChannels, float* row)
+{
+	const __m128i zero = _mm_setzero_si128();
+	for (unsigned int k = 0; k < count; k++) {
+		const unsigned char* line = src + k * pitch;
+		const __m128 w = _mm_set1_ps(weight[k]);
+		unsigned int i = 0;
+		for (; i + 4 <= nChannels; i += 4) {
+			int bytes;
+			memcpy(&bytes, line + i, 4);
+			__m128i b = _mm_cvtsi32_si128(bytes);
+			b = _mm_unpacklo_epi16(_mm_unpacklo_epi8(b, zero), zero);
+			__m128 v = _mm_mul_ps(_mm_cvtepi32_ps(b), w);
+			if (k > 0)
+				v = _mm_add_ps(v, _mm_loadu_ps(row + i));
+			_mm_storeu_ps(row + i, v);
+		}
+		for (; i < nChannels; i++)
+			row[i] = (k > 0 ? row[i] : 0.0f) + line[i] * weight[k];
+	}
+}
+
+// Combine source rows into a float row - 8 channels at a time
+SPOUT_TARGET_AVX2
+static void ResampleRowsAVX2(const unsigned char* src, size_t pitch,
+	unsigned int count, const float* weight, unsigned int nChannels, float* row)
+{
+	for (unsigned int k = 0; k < count; k++) {
+		const unsigned char* line = src + k * pitch;
+		const __m256 w = _mm256_set1_ps(weight[k]);
+		unsigned int i = 0;
+		for (; i + 8 <= nChannels; i += 8) {
+			__m128i b = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(line + i));
+			__m256 v = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(b)), w);
+			if (k > 0)
+				v = _mm256_add_ps(v, _mm256_loadu_ps(row + i));
+			_mm256_storeu_ps(row + i, v);
+		}
+		for (; i < nChannels; i++)
+			row[i] = (k > 0 ? row[i] : 0.0f) + line[i] * weight[k];
+	}
+}
+
+// Write an RGBA pixel as RGBA, BGRA, RGB or BGR
+static inline void ResampleStore(const unsigned char* rgba, unsigned char* d, unsigned int destBytes, bool bSwapRB)
+{
+	if (destBytes == 4 && !bSwapRB) {
+		memcpy(d, rgba, 4);
+	}
+	else {
+		if (destBytes == 4)
+			d[3] = rgba[3]; // alpha
+		d[bSwapRB ? 2 : 0] = rgba[0]; // red
+		d[1]  = rgba[1]; // grn
+		d[bSwapRB ? 0 : 2] = rgba[2]; // blu
+	}
+}
+
+// Combine float row pixels into destination pixels from the first index
+static void ResampleColumns(const float* row, const spoutResampleTaps& taps,
+	unsigned int destWidth, unsigned char* dst, unsigned int destBytes,
+	bool bMirror, bool bSwapRB, bool bSSE2, unsigned int first = 0)
+{
+	for (unsigned int j = first; j < destWidth; j++) {
+		const float* pix = row + taps.start[j] * 4;
+		const float* weight = &taps.weight[taps.offset[j]];
+		const unsigned int count = taps.count[j];
+		unsigned char rgba[4];
+		if (bSSE2) {
+			__m128 acc = _mm_mul_ps(_mm_loadu_ps(pix), _mm_set1_ps(weight[0]));
+			for (unsigned int k = 1; k < count; k++)
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(pix + k * 4), _mm_set1_ps(weight[k])));
+			__m128i i32 = _mm_cvtps_epi32(acc); // round to nearest
+			__m128i i16 = _mm_packs_epi32(i32, i32);
+			const int packed = _mm_cvtsi128_si32(_mm_packus_epi16(i16, i16)); // saturate 0-255
+			memcpy(rgba, &packed, 4);
+		}
+		else {
+			for (unsigned int c = 0; c < 4; c++) {
+				float v = 0.0f;
+				for (unsigned int k = 0; k < count; k++)
+					v += pix[k * 4 + c] * weight[k];
+				v = std::nearbyint(v); // round to nearest even as SSE2
+				rgba[c] = (unsigned char)(v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v));
+			}
+		}
+		ResampleStore(rgba, dst + (bMirror ? (destWidth - j - 1) : j) * destBytes, destBytes, bSwapRB);
+	}
+}
+
+// Combine float row pixels into destination pixels - two pixels at a time
+//   The pixel with fewer taps adds zero weights to the edge pixel,
+//   which leaves the sum unchanged, so the result is the same as SSE2.
+SPOUT_TARGET_AVX2
+static void ResampleColumnsAVX2(const float* row, const spoutResampleTaps& taps,
+	unsigned int destWidth, unsigned char* dst, unsigned int destBytes,
+	bool bMirror, bool bSwapRB)
+{
+	unsigned int j = 0;
+	for (; j + 2 <= destWidth; j += 2) {
+		const float* pa = row + taps.start[j] * 4;
+		const float* pb = row + taps.start[j + 1] * 4;
+		const float* wa = &taps.weight[taps.offset[j]];
+		const float* wb = &taps.weight[taps.offset[j + 1]];
+		const unsigned int ca = taps.count[j];
+		const unsigned int cb = taps.count[j + 1];
+		const unsigned int count = ca > cb ? ca : cb;
+		__m256 acc = _mm256_mul_ps(
+			_mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(pa)), _mm_loadu_ps(pb), 1),
+			_mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(wa[0])), _mm_set1_ps(wb[0]), 1));
+		for (unsigned int k = 1; k < count; k++) {
+			const __m128 a = _mm_loadu_ps(k < ca ? pa + k * 4 : pa);
+			const __m128 b = _mm_loadu_ps(k < cb ? pb + k * 4 : pb);
+			const __m128 x = _mm_set1_ps(k < ca ? wa[k] : 0.0f);
+			const __m128 y = _mm_set1_ps(k < cb ? wb[k] : 0.0f);
+			acc = _mm256_add_ps(acc, _mm256_mul_ps(
+				_mm256_insertf128_ps(_mm256_castps128_ps256(a), b, 1),
+				_mm256_insertf128_ps(_mm256_castps128_ps256(x), y, 1)));
+		}
+		const __m256i i32 = _mm256_cvtps_epi32(acc); // round to nearest
+		const __m128i i16 = _mm_packs_epi32(_mm256_castsi256_si128(i32), _mm256_extracti128_si256(i32, 1));
+		unsigned char rgba[8];
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(rgba), _mm_packus_epi16(i16, i16)); // saturate 0-255
+		if (!bMirror && destBytes == 4 && !bSwapRB) {
+			memcpy(dst + j * 4, rgba, 8);
+		}
+		else {
+			ResampleStore(rgba,     dst + (bMirror ? (destWidth - j - 1) : j) * destBytes, destBytes, bSwapRB);
+			ResampleStore(rgba + 4, dst + (bMirror ? (destWidth - j - 2) : j + 1) * destBytes, destBytes, bSwapRB);
+		}
+	}
+	if (j < destWidth)
+		ResampleColumns(row, taps, destWidth, dst, destBytes, bMirror, bSwapRB, true, j);
+}
+
+void spoutCopy::SetResample(SpoutResample filter)
+{
+	m_Resample = filter;
+}
+
+SpoutResample spoutCopy::GetResample() const
+{
+	return m_Resample;
+}
+
+void spoutCopy::Resample(const void* source, void* dest,
+	unsigned int sourceWidth, unsigned int sourceHeight, unsigned int sourcePitch,
+	unsigned int destWidth, unsigned int destHeight, unsigned int destBytes,
+	bool bInvert, bool bMirror, bool bSwapRB, unsigned int destLinePitch) const
+{
+	if (!source || !dest || sourceWidth == 0 || sourceHeight == 0 || destWidth == 0 || destHeight == 0)
+		return;
+
+	auto srcBuffer = static_cast<const unsigned char *>(source); // rgba source
+	auto dstBuffer = static_cast<unsigned char *>(dest); // rgba, bgra, rgb or bgr dest
+	const size_t destPitch = destLinePitch ? destLinePitch : (size_t)destWidth * destBytes;
+	const int ir = bSwapRB ? 2 : 0;
+	const int ib = bSwapRB ? 0 : 2;
+
+	std::function<void(unsigned int, unsigned int)> rows;
+
+	// Source columns and rows for nearest neighbour
+	std::vector<unsigned int> xtable;
+	std::vector<unsigned int> ytable;
+	// Weights for filtered resample
+	std::shared_ptr<const spoutResampleTaps> xtaps;
+	std::shared_ptr<const spoutResampleTaps> ytaps;
+
+	if (m_Resample == SPOUT_RESAMPLE_NEAREST) {
+		const float x_ratio = (float)sourceWidth / (float)destWidth;
+		const float y_ratio = (float)sourceHeight / (float)destHeight;
+		xtable.resize(destWidth);
+		ytable.resize(destHeight);
+		for (unsigned int j = 0; j < destWidth; j++)
+			xtable[j] = (unsigned int)std::floor((float)j*x_ratio) * 4;
+		for (unsigned int i = 0; i < destHeight; i++)
+			ytable[i] = (unsigned int)std::floor((float)i*y_ratio);
+
+		rows = [&](unsigned int i0, unsigned int i1) {
+			for (unsigned int i = i0; i < i1; i++) {
+				const unsigned char* src = srcBuffer + (size_t)ytable[i] * sourcePitch;
+				unsigned char* dst = dstBuffer + (bInvert ? (destHeight - i - 1) : i) * destPitch;
+				for (unsigned int j = 0; j < destWidth; j++) {
+					const unsigned char* s = src + xtable[j];
+					unsigned char* d = dst + (bMirror ? (destWidth - j - 1) : j) * destBytes;
+					if (destBytes == 4 && !bSwapRB) {
+						memcpy(d, s, 4);
+					}
+					else {
+						if (destBytes == 4)
+							d[3] = s[3]; // alpha
+						d[ir] = s[0]; // red
+						d[1]  = s[1]; // grn
+						d[ib] = s[2]; // blu
+					}
+				}
+			}
+		};
+	}
+	else {
+		// Weights are kept for the next image of the same size
+		xtaps = GetResampleTaps(m_pResampleCache, 0, sourceWidth, destWidth, m_Resample);
+		ytaps = GetResampleTaps(m_pResampleCache, 1, sourceHeight, destHeight, m_Resample);
+		const spoutResampleTaps& xt = *xtaps;
+		const spoutResampleTaps& yt = *ytaps;
+
+		const SpoutSIMD simd = m_SIMD;
+		rows = [&, simd](unsigned int i0, unsigned int i1) {
+			// Float row for each band
+			std::vector<float> row((size_t)sourceWidth * 4);
+			for (unsigned int i = i0; i < i1; i++) {
+				const unsigned char* src = srcBuffer + (size_t)yt.start[i] * sourcePitch;
+				const float* weight = &yt.weight[yt.offset[i]];
+				if (simd >= SPOUT_SIMD_AVX2)
+					ResampleRowsAVX2(src, sourcePitch, yt.count[i], weight, sourceWidth * 4, row.data());
+				else if (simd >= SPOUT_SIMD_SSE2)
+					ResampleRowsSSE2(src, sourcePitch, yt.count[i], weight, sourceWidth * 4, row.data());
+				else
+					ResampleRows(src, sourcePitch, yt.count[i], weight, sourceWidth * 4, row.data());
+				unsigned char* dst = dstBuffer + (bInvert ? (destHeight - i - 1) : i) * destPitch;
+				if (simd >= SPOUT_SIMD_AVX2)
+					ResampleColumnsAVX2(row.data(), xt, destWidth, dst, destBytes, bMirror, bSwapRB);
+				else
+					ResampleColumns(row.data(), xt, destWidth, dst, destBytes, bMirror, bSwapRB, simd >= SPOUT_SIMD_SSE2);
+			}
+		};
+	}
+
+	// Divide destination rows between threads
+	if (UseThreads(destPitch * destHeight, destHeight) && m_pPool->Run(destHeight, rows))
+		return;
+
+	rows(0, destHeight);
+}
+
+void spoutCopy::rgba2rgbaResample(const void* source, void* dest,
+	unsigned int sourceWidth, unsigned int sourceHeight, unsigned int sourcePitch,
+	unsigned int destWidth, unsigned int destHeight, bool bInvert) const
+{
+	Resample(source, dest, sourceWidth, sourceHeight, sourcePitch,
+		destWidth, destHeight, 4, bInvert, false, false);
+}
+
+
+void spoutCopy::rgba2rgbResample(const void* source, void* dest,
+	unsigned int sourceWidth, unsigned int sourceHeight, unsigned int sourcePitch,
+	unsigned int destWidth, unsigned int destHeight, bool bInvert, bool bMirror, bool bSwapRB) const
+{
+	Resample(source, dest, sourceWidth, sourceHeight, sourcePitch,
+		destWidth, destHeight, 3, bInvert, bMirror, bSwapRB);
+}
+
+void spoutCopy::rgba2bgrResample(const void* source, void* dest,
+	unsigned int sourceWidth, unsigned int sourceHeight, unsigned int sourcePitch,
+	unsigned int destWidth, unsigned int destHeight, bool bInvert) const
+{
+	Resample(source, dest, sourceWidth, sourceHeight, sourcePitch,
+		destWidth, destHeight, 3, bInvert, false, true);
+}
+
+
+//
+// High bit depth conversion
+//
+// Each channel is loaded as a normalized float and stored with clamping
+// for the destination type. Unsigned normalized values are rounded to nearest.
+//
+// AVX2 converts 8 channels (2 RGBA pixels) at a time, with F16C for half floats.
+// The scalar functions give the same result and are used for the remainder
+// of each line and when AVX2 or F16C are not available.
+//
+
+// IEEE 754 half to float
+static float HalfToFloat(unsigned short h)
+{
+	const unsigned int sign = (unsigned int)(h & 0x8000) << 16;
+	unsigned int e = (h >> 10) & 0x1f;
+	unsigned int m = h & 0x3ff;
+	unsigned int x = sign;
+
+	if (e == 0x1f) { // Inf or NaN
+		x |= 0x7f800000 | (m << 13);
+	}
+	else if (e != 0) { // Normal
+		x |= ((e + 112) << 23) | (m << 13);
+	}
+	else if (m != 0) { // Subnormal - normalize
+		e = 113;
+		while ((m & 0x400) == 0) {
+			m <<= 1;
+			e--;
+		}
+		x |= (e << 23) | ((m & 0x3ff) << 13);
+	}
+
+	float f;
+	memcpy(&f, &x, 4);
+	return f;
+}
+
+// Float to IEEE 754 half with round to nearest even (as F16C)
+static unsigned short FloatToHalf(float f)
+{
+	unsigned int x;
+	memcpy(&x, &f, 4);
+	const unsigned int sign = (x >> 16) & 0x8000;
+	x &= 0x7fffffff;
+
+	if (x >= 0x7f800000) // Inf or NaN
+		return (unsigned short)(sign | 0x7c00 | (x > 0x7f800000 ? 0x200 : 0));
+	if (x >= 0x477ff000) // 65520 and above round to Inf
+		return (unsigned short)(sign | 0x7c00);
+
+	unsigned int h = 0;
+	unsigned int rem = 0;
+	unsigned int half = 0;
+	if (x < 0x38800000) { // Below the smallest normal half (2^-14)
+		if (x < 0x33000000) // Below half the smallest subnormal (2^-25)
+			return (unsigned short)sign;
+		const unsigned int shift = 126 - (x >> 23);
+		const unsigned int m = (x & 0x7fffff) | 0x800000;
+		h = m >> shift;
+		rem = m & ((1u << shift) - 1);
+		half = 1u << (shift - 1);
+	}
+	else {
+		h = (x - 0x38000000) >> 13; // Rebias exponent from 127 to 15
+		rem = x & 0x1fff;
+		half = 0x1000;
+	}
+	if (rem > half || (rem == half && (h & 1)))
+		h++; // Carries into the exponent if necessary
+
+	return (unsigned short)(sign | h);
+}
+
+// Channel access by channel index from the start of the line.
+// Load returns a normalized float and Store clamps for the type.
+// Load8 and Store8 convert 8 channels with AVX2.
+
+// RGBA32F channel
+struct spoutChannelFloat {
+	typedef float type;
+	static float Load(const float* p, unsigned int i) {
+		return p[i];
+	}
+	static void Store(float* p, unsigned int i, float v) {
+		p[i] = v;
+	}
+	SPOUT_TARGET_F16C static __m256 Load8(const float* p, unsigned int i) {
+		return _mm256_loadu_ps(p + i);
+	}
+	SPOUT_TARGET_F16C static void Store8(float* p, unsigned int i, __m256 v) {
+		_mm256_storeu_ps(p + i, v);
+	}
+};
+
+// RGBA16F channel
+struct spoutChannelHalf {
+	typedef unsigned short type;
+	static float Load(const unsigned short* p, unsigned int i) {
+		return HalfToFloat(p[i]);
+	}
+	static void Store(unsigned short* p, unsigned int i, float v) {
+		if (!(v >= -65504.0f)) v = -65504.0f; // and NaN
+		if (v > 65504.0f) v = 65504.0f;
+		p[i] = FloatToHalf(v);
+	}
+	SPOUT_TARGET_F16C static __m256 Load8(const unsigned short* p, unsigned int i) {
+		return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i)));
+	}
+	SPOUT_TARGET_F16C static void Store8(unsigned short* p, unsigned int i, __m256 v) {
+		v = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-65504.0f)), _mm256_set1_ps(65504.0f));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), _mm256_cvtps_ph(v, 0)); // round to nearest
+	}
+};
+
+// RGBA16 unsigned normalized channel
+struct spoutChannelUshort {
+	typedef unsigned short type;
+	static float Load(const unsigned short* p, unsigned int i) {
+		return (float)p[i] * (1.0f / 65535.0f);
+	}
+	static void Store(unsigned short* p, unsigned int i, float v) {
+		if (!(v >= 0.0f)) v = 0.0f; // and NaN
+		if (v > 1.0f) v = 1.0f;
+		p[i] = (unsigned short)std::lrint(v * 65535.0f);
+	}
+	SPOUT_TARGET_F16C static __m256 Load8(const unsigned short* p, unsigned int i) {
+		__m256i i32 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i)));
+		return _mm256_mul_ps(_mm256_cvtepi32_ps(i32), _mm256_set1_ps(1.0f / 65535.0f));
+	}
+	SPOUT_TARGET_F16C static void Store8(unsigned short* p, unsigned int i, __m256 v) {
+		v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+		__m256i i32 = _mm256_cvtps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(65535.0f)));
+		__m128i i16 = _mm_packus_epi32(_mm256_castsi256_si128(i32), _mm256_extracti128_si256(i32, 1));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), i16);
+	}
+};
+
+// RGBA8 unsigned normalized channel
+struct spoutChannelUbyte {
+	typedef unsigned char type;
+	static float Load(const unsigned char* p, unsigned int i) {
+		return (float)p[i] * (1.0f / 255.0f);
+	}
+	static void Store(unsigned char* p, unsigned int i, float v) {
+		if (!(v >= 0.0f)) v = 0.0f; // and NaN
+		if (v > 1.0f) v = 1.0f;
+		p[i] = (unsigned char)std::lrint(v * 255.0f);
+	}
+	SPOUT_TARGET_F16C static __m256 Load8(const unsigned char* p, unsigned int i) {
+		__m256i i32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p + i)));
+		return _mm256_mul_ps(_mm256_cvtepi32_ps(i32), _mm256_set1_ps(1.0f / 255.0f));
+	}
+	SPOUT_TARGET_F16C static void Store8(unsigned char* p, unsigned int i, __m256 v) {
+		v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+		__m256i i32 = _mm256_cvtps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(255.0f)));
+		__m128i i16 = _mm_packus_epi32(_mm256_castsi256_si128(i32), _mm256_extracti128_si256(i32, 1));
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(p + i), _mm_packus_epi16(i16, i16));
+	}
+};
+
+// R10G10B10A2 unsigned normalized channel
+// Four channels share each 32 bit pixel. Store of a single channel
+// keeps the other bits so that the scalar remainder can complete a pixel.
+struct spoutChannelRGB10A2 {
+	typedef unsigned int type;
+	static unsigned int Shift(unsigned int i) {
+		return (i & 3) * 10;
+	}
+	static unsigned int Max(unsigned int i) {
+		return (i & 3) == 3 ? 3 : 1023;
+	}
+	static float Load(const unsigned int* p, unsigned int i) {
+		return (float)((p[i >> 2] >> Shift(i)) & Max(i)) * (1.0f / (float)Max(i));
+	}
+	static void Store(unsigned int* p, unsigned int i, float v) {
+		if (!(v >= 0.0f)) v = 0.0f; // and NaN
+		if (v > 1.0f) v = 1.0f;
+		const unsigned int c = (unsigned int)std::lrint(v * (float)Max(i));
+		p[i >> 2] = (p[i >> 2] & ~(Max(i) << Shift(i))) | (c << Shift(i));
+	}
+	SPOUT_TARGET_F16C static __m256 Load8(const unsigned int* p, unsigned int i) {
+		// Two pixels, each broadcast to four lanes, then shift and mask the channels
+		__m256i px = _mm256_permutevar8x32_epi32(
+			_mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p + (i >> 2)))),
+			_mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1));
+		px = _mm256_srlv_epi32(px, _mm256_setr_epi32(0, 10, 20, 30, 0, 10, 20, 30));
+		px = _mm256_and_si256(px, _mm256_setr_epi32(1023, 1023, 1023, 3, 1023, 1023, 1023, 3));
+		return _mm256_mul_ps(_mm256_cvtepi32_ps(px),
+			_mm256_setr_ps(1.0f / 1023.0f, 1.0f / 1023.0f, 1.0f / 1023.0f, 1.0f / 3.0f,
+				1.0f / 1023.0f, 1.0f / 1023.0f, 1.0f / 1023.0f, 1.0f / 3.0f));
+	}
+	SPOUT_TARGET_F16C static void Store8(unsigned int* p, unsigned int i, __m256 v) {
+		v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+		__m256i px = _mm256_cvtps_epi32(_mm256_mul_ps(v,
+			_mm256_setr_ps(1023.0f, 1023.0f, 1023.0f, 3.0f, 1023.0f, 1023.0f, 1023.0f, 3.0f)));
+		px = _mm256_sllv_epi32(px, _mm256_setr_epi32(0, 10, 20, 30, 0, 10, 20, 30));
+		// OR the four channels of each pixel into the first lane
+		px = _mm256_or_si256(px, _mm256_shuffle_epi32(px, _MM_SHUFFLE(2, 3, 0, 1)));
+		px = _mm256_or_si256(px, _mm256_shuffle_epi32(px, _MM_SHUFFLE(1, 0, 3, 2)));
+		px = _mm256_permutevar8x32_epi32(px, _mm256_setr_epi32(0, 4, 0, 4, 0, 4, 0, 4));
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(p + (i >> 2)), _mm256_castsi256_si128(px));
+	}
+};
+
+template<class Src, class Dst>
+static void ConvertChannels(const unsigned char* source, unsigned char* dest, unsigned int nChannels)
+{
+	auto src = reinterpret_cast<const typename Src::type *>(source);
+	auto dst = reinterpret_cast<typename Dst::type *>(dest);
+	for (unsigned int i = 0; i < nChannels; i++)
+		Dst::Store(dst, i, Src::Load(src, i));
+}
+
+template<class Src, class Dst>
+SPOUT_TARGET_F16C
+static void ConvertChannelsAVX2(const unsigned char* source, unsigned char* dest, unsigned int nChannels)
+{
+	auto src = reinterpret_cast<const typename Src::type *>(source);
+	auto dst = reinterpret_cast<typename Dst::type *>(dest);
+	unsigned int i = 0;
+	for (; i + 8 <= nChannels; i += 8)
+		Dst::Store8(dst, i, Src::Load8(src, i));
+	for (; i < nChannels; i++)
+		Dst::Store(dst, i, Src::Load(src, i));
+}
+
+// Line conversion functions for a pair of formats.
+// With color conversion each line is converted to float, color converted
+// and converted to the destination format, in a line buffer in the cache.
+typedef void (*spoutConvertChannels)(const unsigned char* source, unsigned char* dest, unsigned int nChannels);
+
+struct spoutLineConvert {
+	spoutConvertChannels avx2;
+	spoutConvertChannels scalar;
+	spoutConvertChannels toFloatAVX2;
+	spoutConvertChannels toFloat;
+	spoutConvertChannels fromFloatAVX2;
+	spoutConvertChannels fromFloat;
+	bool bDither; // High bit depth to 8 bit
+};
+
+template<class Src, class Dst>
+static const spoutLineConvert& LineConverter()
+{
+	static const spoutLineConvert convert = {
+		ConvertChannelsAVX2<Src, Dst>, ConvertChannels<Src, Dst>,
+		ConvertChannelsAVX2<Src, spoutChannelFloat>, ConvertChannels<Src, spoutChannelFloat>,
+		ConvertChannelsAVX2<spoutChannelFloat, Dst>, ConvertChannels<spoutChannelFloat, Dst>,
+		std::is_same<Dst, spoutChannelUbyte>::value && !std::is_same<Src, spoutChannelUbyte>::value
+	};
+	return convert;
+}
+
+void spoutCopy::ConvertLines(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert,
+	const spoutLineConvert& convert, unsigned int firstRow) const
+{
+	if (!source || !dest)
+		return;
+
+	if (UseThreads((size_t)destPitch * height, height)) {
+		if (RunRows(m_pPool, source, dest, height, sourcePitch, destPitch, bInvert,
+			[&](const unsigned char* src, unsigned char* dst, unsigned int rows) {
+				// Destination row of the band for the dither pattern
+				const unsigned int row = destPitch ? (unsigned int)((dst - static_cast<unsigned char *>(dest)) / destPitch) : 0;
+				ConvertLines(src, dst, width, rows, sourcePitch, destPitch, bInvert, convert, firstRow + row);
+			}))
+			return;
+	}
+
+	const bool bAVX2 = (m_SIMD >= SPOUT_SIMD_AVX2 && m_bF16C);
+	auto src = static_cast<const unsigned char *>(source);
+	auto dst = static_cast<unsigned char *>(dest);
+
+	const bool bDither = (m_pDither && convert.bDither);
+	if (m_pColor || m_Alpha != SPOUT_ALPHA_NONE || bDither) {
+		const spoutConvertChannels toFloat = bAVX2 ? convert.toFloatAVX2 : convert.toFloat;
+		const spoutConvertChannels fromFloat = bAVX2 ? convert.fromFloatAVX2 : convert.fromFloat;
+		std::vector<float> line((size_t)width * 4);
+		auto buffer = reinterpret_cast<unsigned char *>(line.data());
+		for (unsigned int y = 0; y < height; y++) {
+			toFloat(src + (size_t)(bInvert ? (height - 1 - y) : y) * sourcePitch, buffer, width * 4);
+			// Colors are converted without premultiplied alpha
+			if (m_Alpha == SPOUT_ALPHA_UNPREMULTIPLY)
+				AlphaLine(line.data(), width);
+			if (m_pColor)
+				ColorLine(line.data(), width);
+			if (m_Alpha == SPOUT_ALPHA_PREMULTIPLY)
+				AlphaLine(line.data(), width);
+			if (bDither)
+				DitherLine(line.data(), dst + (size_t)y * destPitch, width, firstRow + y);
+			else
+				fromFloat(buffer, dst + (size_t)y * destPitch, width * 4);
+		}
+		return;
+	}
+
+	const spoutConvertChannels lineConvert = bAVX2 ? convert.avx2 : convert.scalar;
+	for (unsigned int y = 0; y < height; y++) {
+		// dest is not inverted
+		const unsigned char* line = src + (size_t)(bInvert ? (height - 1 - y) : y) * sourcePitch;
+		lineConvert(line, dst + (size_t)y * destPitch, width * 4);
+	}
+}
+
+// RGBA32F to RGBA16F
+void spoutCopy::float2half(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelFloat, spoutChannelHalf>());
+}
+
+// RGBA16F to RGBA32F
+void spoutCopy::half2float(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelHalf, spoutChannelFloat>());
+}
+
+// RGBA16F to RGBA16
+void spoutCopy::half2ushort(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelHalf, spoutChannelUshort>());
+}
+
+// RGBA16 to RGBA16F
+void spoutCopy::ushort2half(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelUshort, spoutChannelHalf>());
+}
+
+// RGBA32F to RGBA16
+void spoutCopy::float2ushort(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelFloat, spoutChannelUshort>());
+}
+
+// RGBA16 to RGBA32F
+void spoutCopy::ushort2float(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelUshort, spoutChannelFloat>());
+}
+
+// RGBA32F to RGBA8
+void spoutCopy::float2rgba(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelFloat, spoutChannelUbyte>());
+}
+
+// RGBA8 to RGBA32F
+void spoutCopy::rgba2float(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelUbyte, spoutChannelFloat>());
+}
+
+// RGBA16F to RGBA8
+void spoutCopy::half2rgba(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelHalf, spoutChannelUbyte>());
+}
+
+// RGBA8 to RGBA16F
+void spoutCopy::rgba2half(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelUbyte, spoutChannelHalf>());
+}
+
+// RGBA16 to RGBA8
+void spoutCopy::ushort2rgba(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelUshort, spoutChannelUbyte>());
+}
+
+// RGBA8 to RGBA16
+void spoutCopy::rgba2ushort(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelUbyte, spoutChannelUshort>());
+}
+
+// R10G10B10A2 to RGBA16
+void spoutCopy::rgb10a2toushort(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelRGB10A2, spoutChannelUshort>());
+}
+
+// RGBA16 to R10G10B10A2
+void spoutCopy::ushorttorgb10a2(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelUshort, spoutChannelRGB10A2>());
+}
+
+// R10G10B10A2 to RGBA8
+void spoutCopy::rgb10a2torgba(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelRGB10A2, spoutChannelUbyte>());
+}
+
+// RGBA8 to R10G10B10A2
+void spoutCopy::rgbatorgb10a2(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelUbyte, spoutChannelRGB10A2>());
+}
+
+// R10G10B10A2 to RGBA32F
+void spoutCopy::rgb10a2tofloat(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelRGB10A2, spoutChannelFloat>());
+}
+
+// RGBA32F to R10G10B10A2
+void spoutCopy::floattorgb10a2(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	ConvertLines(source, dest, width, height, sourcePitch, destPitch, bInvert,
+		LineConverter<spoutChannelFloat, spoutChannelRGB10A2>());
+}
+
+
+//
+// Color conversion
+//
+// SetColor selects the transfer function and primaries of the source and
+// destination. Pixels are converted from the source transfer function to linear,
+// by a 3x3 matrix from the source to the destination primaries
+// and to the destination transfer function. Alpha is not changed.
+//
+// 8 bit images (CopyImage)
+//   Without a change of primaries each channel is converted by a 256 entry table.
+//   Otherwise channels are converted to linear float by a 256 entry table,
+//   the matrix is applied to 4 pixels at a time with SSE2, and the result
+//   is converted to 8 bits by a table of 16384 linear values.
+//   Each line is converted after it is copied, while it is still in the cache.
+//
+// High bit depth
+//   Lines are converted to float, color converted and converted to the
+//   destination format in a line buffer. The sRGB transfer function uses
+//   a power function made from log2 and exp2 polynomials, with a relative
+//   error of about 1e-6. AVX2 converts 2 pixels at a time.
+//   The AVX2 and scalar functions give the same result.
+//   sRGB is extended to negative values by symmetry, as for scRGB.
+//
+
+static double SrgbToLinear(double v)
+{
+	return v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+}
+
+static double LinearToSrgb(double v)
+{
+	return v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+}
+
+static void Invert3(const double m[9], double r[9])
+{
+	const double c0 = m[4] * m[8] - m[5] * m[7];
+	const double c1 = m[5] * m[6] - m[3] * m[8];
+	const double c2 = m[3] * m[7] - m[4] * m[6];
+	const double d = 1.0 / (m[0] * c0 + m[1] * c1 + m[2] * c2);
+	r[0] = c0 * d;
+	r[1] = (m[2] * m[7] - m[1] * m[8]) * d;
+	r[2] = (m[1] * m[5] - m[2] * m[4]) * d;
+	r[3] = c1 * d;
+	r[4] = (m[0] * m[8] - m[2] * m[6]) * d;
+	r[5] = (m[2] * m[3] - m[0] * m[5]) * d;
+	r[6] = c2 * d;
+	r[7] = (m[1] * m[6] - m[0] * m[7]) * d;
+	r[8] = (m[0] * m[4] - m[1] * m[3]) * d;
+}
+
+static void Multiply3(const double a[9], const double b[9], double r[9])
+{
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++)
+			r[i * 3 + j] = a[i * 3] * b[j] + a[i * 3 + 1] * b[3 + j] + a[i * 3 + 2] * b[6 + j];
+	}
+}
+
+// Linear RGB to CIE XYZ for the primaries, D65 white
+static void ColorPrimaries(SpoutGamut gamut, double m[9])
+{
+	// x, y chromaticity of red, green and blue
+	static const double primaries[3][6] = {
+		{ 0.640, 0.330, 0.300, 0.600, 0.150, 0.060 }, // Rec.709
+		{ 0.708, 0.292, 0.170, 0.797, 0.131, 0.046 }, // Rec.2020
+		{ 0.680, 0.320, 0.265, 0.690, 0.150, 0.060 }, // Display P3
+	};
+	const double* p = primaries[gamut];
+	const double wx = 0.3127;
+	const double wy = 0.3290;
+
+	// XYZ of each primary with Y = 1 in the columns
+	double c[9];
+	for (int i = 0; i < 3; i++) {
+		const double x = p[i * 2];
+		const double y = p[i * 2 + 1];
+		c[i] = x / y;
+		c[3 + i] = 1.0;
+		c[6 + i] = (1.0 - x - y) / y;
+	}
 
-	const unsigned long bgrsize = width * height * 3;
-	const unsigned long bgrpitch = width * 3;
+	// Scale the columns so that RGB 1, 1, 1 is the white point
+	const double white[3] = { wx / wy, 1.0, (1.0 - wx - wy) / wy };
+	double inverse[9];
+	Invert3(c, inverse);
+	for (int i = 0; i < 3; i++) {
+		const double scale = inverse[i * 3] * white[0] + inverse[i * 3 + 1] * white[1] + inverse[i * 3 + 2] * white[2];
+		for (int r = 0; r < 3; r++)
+			m[r * 3 + i] = c[r * 3 + i] * scale;
+	}
+}
 
-	// Start of buffers
-	auto bgr = static_cast<const unsigned char *>(bgr_source); // BGR
-	auto rgba = static_cast<unsigned char *>(rgba_dest); // RGBA
+void spoutCopy::SetColor(SpoutTransfer sourceTransfer, SpoutGamut sourceGamut,
+	SpoutTransfer destTransfer, SpoutGamut destGamut)
+{
+	m_ColorSourceTransfer = sourceTransfer;
+	m_ColorSourceGamut = sourceGamut;
+	m_ColorDestTransfer = destTransfer;
+	m_ColorDestGamut = destGamut;
+
+	delete m_pColor;
+	m_pColor = nullptr;
+
+	if (sourceTransfer == destTransfer && sourceGamut == destGamut)
+		return; // No conversion
+
+	auto color = new spoutColor;
+	color->sourceTransfer = sourceTransfer;
+	color->destTransfer = destTransfer;
+	color->bMatrix = (sourceGamut != destGamut);
+
+	// Source to XYZ to destination
+	double source[9];
+	double dest[9];
+	double inverse[9];
+	double matrix[9];
+	ColorPrimaries(sourceGamut, source);
+	ColorPrimaries(destGamut, dest);
+	Invert3(dest, inverse);
+	Multiply3(inverse, source, matrix);
+	for (int i = 0; i < 9; i++)
+		color->matrix[i] = color->bMatrix ? (float)matrix[i] : (i % 4 == 0 ? 1.0f : 0.0f);
+
+	for (unsigned int i = 0; i < 256; i++) {
+		const double linear = (sourceTransfer == SPOUT_TRANSFER_SRGB) ? SrgbToLinear(i / 255.0) : i / 255.0;
+		const double v = (destTransfer == SPOUT_TRANSFER_SRGB) ? LinearToSrgb(linear) : linear;
+		color->decode[i] = (float)linear;
+		color->table[i] = (unsigned char)std::lrint(v * 255.0);
+	}
 
-	if (bInvert) {
-		bgr += bgrsize; // end of rgb buffer
-		bgr -= bgrpitch; // beginning of the last rgb line
+	for (unsigned int i = 0; i < spoutColorTableSize; i++) {
+		const double linear = i / (double)(spoutColorTableSize - 1);
+		const double v = (destTransfer == SPOUT_TRANSFER_SRGB) ? LinearToSrgb(linear) : linear;
+		color->encode[i] = (unsigned char)std::lrint(v * 255.0);
 	}
 
-	for (unsigned int y = 0; y < height; y++) {
+	m_pColor = color;
+}
+
+void spoutCopy::GetColor(SpoutTransfer& sourceTransfer, SpoutGamut& sourceGamut,
+	SpoutTransfer& destTransfer, SpoutGamut& destGamut) const
+{
+	sourceTransfer = m_ColorSourceTransfer;
+	sourceGamut = m_ColorSourceGamut;
+	destTransfer = m_ColorDestTransfer;
+	destGamut = m_ColorDestGamut;
+}
+
+// Color conversion of an 8 bit RGBA, BGRA, RGB or BGR line in place
+void spoutCopy::ColorLine(unsigned char* line, unsigned int width, unsigned int pixelBytes, bool bBGR) const
+{
+	const spoutColor& color = *m_pColor;
+
+	if (!color.bMatrix) {
 		for (unsigned int x = 0; x < width; x++) {
-			// bgr source - rgba dest
-			*(rgba + 0) = *(bgr + 2); // red
-			*(rgba + 1) = *(bgr + 1); // grn
-			*(rgba + 2) = *(bgr + 0); // blu
-			*(rgba + 3) = (unsigned char)255; // alpha
-			bgr += 3;
-			rgba += 4;
+			unsigned char* p = line + (size_t)x * pixelBytes;
+			p[0] = color.table[p[0]];
+			p[1] = color.table[p[1]];
+			p[2] = color.table[p[2]];
 		}
-		if (bInvert)
-			bgr -= bgrpitch * 2; // move up a line for invert
+		return;
+	}
+
+	const unsigned int ir = bBGR ? 2 : 0;
+	const unsigned int ib = bBGR ? 0 : 2;
+	const float* m = color.matrix;
+	const float* decode = color.decode;
+	const float scale = (float)(spoutColorTableSize - 1);
+	unsigned int x = 0;
+
+	// 4 pixels at a time with one channel in each register
+	if (m_SIMD >= SPOUT_SIMD_SSE2) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 s = _mm_set1_ps(scale);
+		alignas(16) int ri[4];
+		alignas(16) int gi[4];
+		alignas(16) int bi[4];
+		for (; x + 4 <= width; x += 4) {
+			unsigned char* p0 = line + (size_t)x * pixelBytes;
+			unsigned char* p1 = p0 + pixelBytes;
+			unsigned char* p2 = p1 + pixelBytes;
+			unsigned char* p3 = p2 + pixelBytes;
+			const __m128 r = _mm_setr_ps(decode[p0[ir]], decode[p1[ir]], decode[p2[ir]], decode[p3[ir]]);
+			const __m128 g = _mm_setr_ps(decode[p0[1]], decode[p1[1]], decode[p2[1]], decode[p3[1]]);
+			const __m128 b = _mm_setr_ps(decode[p0[ib]], decode[p1[ib]], decode[p2[ib]], decode[p3[ib]]);
+			__m128 lr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0]), r), _mm_mul_ps(_mm_set1_ps(m[1]), g)), _mm_mul_ps(_mm_set1_ps(m[2]), b));
+			__m128 lg = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[3]), r), _mm_mul_ps(_mm_set1_ps(m[4]), g)), _mm_mul_ps(_mm_set1_ps(m[5]), b));
+			__m128 lb = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[6]), r), _mm_mul_ps(_mm_set1_ps(m[7]), g)), _mm_mul_ps(_mm_set1_ps(m[8]), b));
+			// Clamp 0-1 and round to the table index
+			lr = _mm_mul_ps(_mm_min_ps(_mm_max_ps(lr, zero), one), s);
+			lg = _mm_mul_ps(_mm_min_ps(_mm_max_ps(lg, zero), one), s);
+			lb = _mm_mul_ps(_mm_min_ps(_mm_max_ps(lb, zero), one), s);
+			_mm_store_si128(reinterpret_cast<__m128i *>(ri), _mm_cvtps_epi32(lr));
+			_mm_store_si128(reinterpret_cast<__m128i *>(gi), _mm_cvtps_epi32(lg));
+			_mm_store_si128(reinterpret_cast<__m128i *>(bi), _mm_cvtps_epi32(lb));
+			unsigned char* p[4] = { p0, p1, p2, p3 };
+			for (int k = 0; k < 4; k++) {
+				p[k][ir] = color.encode[ri[k]];
+				p[k][1] = color.encode[gi[k]];
+				p[k][ib] = color.encode[bi[k]];
+			}
+		}
+	}
+
+	for (; x < width; x++) {
+		unsigned char* p = line + (size_t)x * pixelBytes;
+		const float r = decode[p[ir]];
+		const float g = decode[p[1]];
+		const float b = decode[p[ib]];
+		float v[3];
+		for (int c = 0; c < 3; c++) {
+			v[c] = (m[c * 3] * r + m[c * 3 + 1] * g) + m[c * 3 + 2] * b;
+			if (v[c] < 0.0f) v[c] = 0.0f;
+			if (v[c] > 1.0f) v[c] = 1.0f;
+		}
+		p[ir] = color.encode[std::lrint(v[0] * scale)];
+		p[1] = color.encode[std::lrint(v[1] * scale)];
+		p[ib] = color.encode[std::lrint(v[2] * scale)];
+	}
+}
+
+// log2 of a positive number from the exponent and a series for the mantissa
+static float ColorLog2(float x)
+{
+	unsigned int i;
+	memcpy(&i, &x, 4);
+	float e = (float)((int)((i >> 23) & 255) - 127);
+	i = (i & 0x007fffff) | 0x3f800000;
+	float m;
+	memcpy(&m, &i, 4);
+	if (m > 1.41421356f) { // Mantissa 0.707 to 1.414
+		m = m * 0.5f;
+		e = e + 1.0f;
+	}
+	const float t = (m - 1.0f) / (m + 1.0f);
+	const float t2 = t * t;
+	float p = 1.0f / 9.0f;
+	p = p * t2 + 1.0f / 7.0f;
+	p = p * t2 + 1.0f / 5.0f;
+	p = p * t2 + 1.0f / 3.0f;
+	p = p * t2 + 1.0f;
+	return e + (p * t) * 2.88539008f; // 2 / ln(2)
+}
+
+// 2 to the power y, from the integer part and a polynomial for the fraction
+static float ColorExp2(float y)
+{
+	if (y < -126.0f) y = -126.0f;
+	if (y > 127.0f) y = 127.0f;
+	const float n = std::nearbyint(y);
+	const float f = y - n; // -0.5 to 0.5
+	float p = 1.52527338e-05f;
+	p = p * f + 1.54035304e-04f;
+	p = p * f + 1.33335581e-03f;
+	p = p * f + 9.61812911e-03f;
+	p = p * f + 5.55041087e-02f;
+	p = p * f + 2.40226507e-01f;
+	p = p * f + 6.93147181e-01f;
+	p = p * f + 1.0f;
+	const unsigned int i = (unsigned int)((int)n + 127) << 23;
+	float s;
+	memcpy(&s, &i, 4);
+	return p * s;
+}
+
+static float ColorSrgbToLinear(float v)
+{
+	const float a = std::fabs(v);
+	const float r = (a <= 0.04045f) ? a / 12.92f : ColorExp2(2.4f * ColorLog2((a + 0.055f) / 1.055f));
+	return std::copysign(r, v);
+}
+
+static float ColorLinearToSrgb(float v)
+{
+	const float a = std::fabs(v);
+	const float r = (a <= 0.0031308f) ? a * 12.92f : 1.055f * ColorExp2((1.0f / 2.4f) * ColorLog2(a)) - 0.055f;
+	return std::copysign(r, v);
+}
+
+SPOUT_TARGET_AVX2
+static __m256 ColorLog2AVX2(__m256 x)
+{
+	const __m256i i = _mm256_castps_si256(x);
+	__m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(
+		_mm256_and_si256(_mm256_srli_epi32(i, 23), _mm256_set1_epi32(255)), _mm256_set1_epi32(127)));
+	__m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+		_mm256_and_si256(i, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+	const __m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+	m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+	e = _mm256_add_ps(e, _mm256_and_ps(big, _mm256_set1_ps(1.0f)));
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 t = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+	const __m256 t2 = _mm256_mul_ps(t, t);
+	__m256 p = _mm256_set1_ps(1.0f / 9.0f);
+	p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(1.0f / 7.0f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(1.0f / 5.0f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(1.0f / 3.0f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, t2), one);
+	return _mm256_add_ps(e, _mm256_mul_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(2.88539008f)));
+}
+
+SPOUT_TARGET_AVX2
+static __m256 ColorExp2AVX2(__m256 y)
+{
+	y = _mm256_min_ps(_mm256_max_ps(y, _mm256_set1_ps(-126.0f)), _mm256_set1_ps(127.0f));
+	const __m256 n = _mm256_round_ps(y, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	const __m256 f = _mm256_sub_ps(y, n);
+	__m256 p = _mm256_set1_ps(1.52527338e-05f);
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.54035304e-04f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.33335581e-03f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(9.61812911e-03f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(5.55041087e-02f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(2.40226507e-01f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(6.93147181e-01f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.0f));
+	const __m256i i = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+	return _mm256_mul_ps(p, _mm256_castsi256_ps(i));
+}
+
+SPOUT_TARGET_AVX2
+static __m256 ColorSrgbToLinearAVX2(__m256 v)
+{
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	const __m256 a = _mm256_andnot_ps(sign, v);
+	const __m256 low = _mm256_div_ps(a, _mm256_set1_ps(12.92f));
+	const __m256 high = ColorExp2AVX2(_mm256_mul_ps(_mm256_set1_ps(2.4f), ColorLog2AVX2(
+		_mm256_div_ps(_mm256_add_ps(a, _mm256_set1_ps(0.055f)), _mm256_set1_ps(1.055f)))));
+	const __m256 r = _mm256_blendv_ps(high, low, _mm256_cmp_ps(a, _mm256_set1_ps(0.04045f), _CMP_LE_OQ));
+	return _mm256_or_ps(r, _mm256_and_ps(sign, v));
+}
+
+SPOUT_TARGET_AVX2
+static __m256 ColorLinearToSrgbAVX2(__m256 v)
+{
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	const __m256 a = _mm256_andnot_ps(sign, v);
+	const __m256 low = _mm256_mul_ps(a, _mm256_set1_ps(12.92f));
+	const __m256 high = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(1.055f),
+		ColorExp2AVX2(_mm256_mul_ps(_mm256_set1_ps(1.0f / 2.4f), ColorLog2AVX2(a)))), _mm256_set1_ps(0.055f));
+	const __m256 r = _mm256_blendv_ps(high, low, _mm256_cmp_ps(a, _mm256_set1_ps(0.0031308f), _CMP_LE_OQ));
+	return _mm256_or_ps(r, _mm256_and_ps(sign, v));
+}
+
+// RGBA float pixels, 2 at a time. Returns the number of pixels converted.
+SPOUT_TARGET_AVX2
+static unsigned int ColorPixelsAVX2(float* line, unsigned int width, const spoutColor& color)
+{
+	const float* m = color.matrix;
+	const __m256 c0 = _mm256_setr_ps(m[0], m[3], m[6], 0.0f, m[0], m[3], m[6], 0.0f);
+	const __m256 c1 = _mm256_setr_ps(m[1], m[4], m[7], 0.0f, m[1], m[4], m[7], 0.0f);
+	const __m256 c2 = _mm256_setr_ps(m[2], m[5], m[8], 0.0f, m[2], m[5], m[8], 0.0f);
+	unsigned int x = 0;
+	for (; x + 2 <= width; x += 2) {
+		const __m256 pixels = _mm256_loadu_ps(line + x * 4);
+		__m256 v = pixels;
+		if (color.sourceTransfer == SPOUT_TRANSFER_SRGB)
+			v = ColorSrgbToLinearAVX2(v);
+		if (color.bMatrix) {
+			// Red, green and blue of each pixel in all its lanes
+			v = _mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(c0, _mm256_permute_ps(v, 0x00)),
+				_mm256_mul_ps(c1, _mm256_permute_ps(v, 0x55))),
+				_mm256_mul_ps(c2, _mm256_permute_ps(v, 0xAA)));
+		}
+		if (color.destTransfer == SPOUT_TRANSFER_SRGB)
+			v = ColorLinearToSrgbAVX2(v);
+		_mm256_storeu_ps(line + x * 4, _mm256_blend_ps(v, pixels, 0x88)); // Alpha unchanged
+	}
+	return x;
+}
+
+// Color conversion of an RGBA float line in place
+void spoutCopy::ColorLine(float* line, unsigned int width) const
+{
+	const spoutColor& color = *m_pColor;
+	const float* m = color.matrix;
+
+	unsigned int x = 0;
+	if (m_SIMD >= SPOUT_SIMD_AVX2)
+		x = ColorPixelsAVX2(line, width, color);
+
+	for (; x < width; x++) {
+		float* p = line + x * 4;
+		float r = p[0];
+		float g = p[1];
+		float b = p[2];
+		if (color.sourceTransfer == SPOUT_TRANSFER_SRGB) {
+			r = ColorSrgbToLinear(r);
+			g = ColorSrgbToLinear(g);
+			b = ColorSrgbToLinear(b);
+		}
+		if (color.bMatrix) {
+			const float lr = (m[0] * r + m[1] * g) + m[2] * b;
+			const float lg = (m[3] * r + m[4] * g) + m[5] * b;
+			const float lb = (m[6] * r + m[7] * g) + m[8] * b;
+			r = lr;
+			g = lg;
+			b = lb;
+		}
+		if (color.destTransfer == SPOUT_TRANSFER_SRGB) {
+			r = ColorLinearToSrgb(r);
+			g = ColorLinearToSrgb(g);
+			b = ColorLinearToSrgb(b);
+		}
+		p[0] = r;
+		p[1] = g;
+		p[2] = b;
+	}
+}
+
+//
+// Alpha premultiply and unpremultiply
+//
+// 8 bit premultiply is c * a / 255 rounded to nearest with integers.
+// Unpremultiply is c * (255 / a) in float, limited to 255 and rounded
+// to nearest even. Float is c * a and c / a. Pixels with zero alpha are
+// not changed by unpremultiply. Alpha is not changed.
+// The SIMD and scalar functions give the same result.
+//
+
+void spoutCopy::SetAlpha(SpoutAlpha mode)
+{
+	m_Alpha = mode;
+}
+
+SpoutAlpha spoutCopy::GetAlpha() const
+{
+	return m_Alpha;
+}
+
+static inline unsigned char PremultiplyByte(unsigned int c, unsigned int a)
+{
+	const unsigned int t = c * a + 128;
+	return (unsigned char)((t + (t >> 8)) >> 8);
+}
+
+static inline unsigned char UnpremultiplyByte(unsigned int c, unsigned int a)
+{
+	if (a == 0)
+		return (unsigned char)c;
+	float v = (float)c * (255.0f / (float)a);
+	v = v < 255.0f ? v : 255.0f;
+	return (unsigned char)std::lrint(v);
+}
+
+// 4 pixels
+static inline __m128i PremultiplySSE2(__m128i p)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rgb = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+	const __m128i alpha = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+	const __m128i half = _mm_set1_epi16(128);
+	__m128i c[2] = { _mm_unpacklo_epi8(p, zero), _mm_unpackhi_epi8(p, zero) };
+	for (int i = 0; i < 2; i++) {
+		// Alpha of each pixel in its channels and 255 for alpha itself
+		__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c[i], 0xFF), 0xFF);
+		a = _mm_or_si128(_mm_and_si128(a, rgb), alpha);
+		const __m128i t = _mm_add_epi16(_mm_mullo_epi16(c[i], a), half);
+		c[i] = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+	}
+	return _mm_packus_epi16(c[0], c[1]);
+}
+
+static inline __m128i UnpremultiplySSE2(__m128i p)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+	const __m128 full = _mm_set1_ps(255.0f);
+	const __m128i c16[2] = { _mm_unpacklo_epi8(p, zero), _mm_unpackhi_epi8(p, zero) };
+	__m128i c[4];
+	for (int i = 0; i < 4; i++) {
+		const __m128i c32 = (i & 1) ? _mm_unpackhi_epi16(c16[i >> 1], zero) : _mm_unpacklo_epi16(c16[i >> 1], zero);
+		const __m128 f = _mm_cvtepi32_ps(c32);
+		const __m128 a = _mm_shuffle_ps(f, f, 0xFF);
+		const __m128 v = _mm_min_ps(_mm_mul_ps(f, _mm_div_ps(full, a)), full);
+		c[i] = _mm_cvtps_epi32(v);
+	}
+	__m128i q = _mm_packus_epi16(_mm_packs_epi32(c[0], c[1]), _mm_packs_epi32(c[2], c[3]));
+	// Source alpha, and the source pixel if alpha is zero
+	const __m128i a = _mm_and_si128(p, alpha);
+	const __m128i keep = _mm_or_si128(_mm_cmpeq_epi32(a, zero), alpha);
+	q = _mm_or_si128(_mm_and_si128(keep, p), _mm_andnot_si128(keep, q));
+	return q;
+}
+
+// 8 pixels
+SPOUT_TARGET_AVX2
+static inline __m256i PremultiplyAVX2(__m256i p)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i rgb = _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1);
+	const __m256i alpha = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+	const __m256i half = _mm256_set1_epi16(128);
+	__m256i c[2] = { _mm256_unpacklo_epi8(p, zero), _mm256_unpackhi_epi8(p, zero) };
+	for (int i = 0; i < 2; i++) {
+		__m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(c[i], 0xFF), 0xFF);
+		a = _mm256_or_si256(_mm256_and_si256(a, rgb), alpha);
+		const __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(c[i], a), half);
+		c[i] = _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+	}
+	return _mm256_packus_epi16(c[0], c[1]);
+}
+
+SPOUT_TARGET_AVX2
+static inline __m256i UnpremultiplyAVX2(__m256i p)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+	const __m256 full = _mm256_set1_ps(255.0f);
+	const __m256i c16[2] = { _mm256_unpacklo_epi8(p, zero), _mm256_unpackhi_epi8(p, zero) };
+	__m256i c[4];
+	for (int i = 0; i < 4; i++) {
+		const __m256i c32 = (i & 1) ? _mm256_unpackhi_epi16(c16[i >> 1], zero) : _mm256_unpacklo_epi16(c16[i >> 1], zero);
+		const __m256 f = _mm256_cvtepi32_ps(c32);
+		const __m256 a = _mm256_shuffle_ps(f, f, 0xFF);
+		const __m256 v = _mm256_min_ps(_mm256_mul_ps(f, _mm256_div_ps(full, a)), full);
+		c[i] = _mm256_cvtps_epi32(v);
+	}
+	const __m256i q = _mm256_packus_epi16(_mm256_packs_epi32(c[0], c[1]), _mm256_packs_epi32(c[2], c[3]));
+	const __m256i a = _mm256_and_si256(p, alpha);
+	const __m256i keep = _mm256_or_si256(_mm256_cmpeq_epi32(a, zero), alpha);
+	return _mm256_blendv_epi8(q, p, keep);
+}
+
+SPOUT_TARGET_AVX2
+static unsigned int AlphaPixelsAVX2(const unsigned char* source, unsigned char* dest, unsigned int width, bool bPremultiply)
+{
+	unsigned int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + x * 4));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + x * 4),
+			bPremultiply ? PremultiplyAVX2(p) : UnpremultiplyAVX2(p));
+	}
+	return x;
+}
+
+void spoutCopy::AlphaLine(const unsigned char* source, unsigned char* dest, unsigned int width) const
+{
+	const bool bPremultiply = (m_Alpha == SPOUT_ALPHA_PREMULTIPLY);
+	unsigned int x = 0;
+	if (m_SIMD >= SPOUT_SIMD_AVX2) {
+		x = AlphaPixelsAVX2(source, dest, width, bPremultiply);
+	}
+	else if (m_SIMD >= SPOUT_SIMD_SSE2) {
+		for (; x + 4 <= width; x += 4) {
+			const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + x * 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dest + x * 4),
+				bPremultiply ? PremultiplySSE2(p) : UnpremultiplySSE2(p));
+		}
+	}
+	for (; x < width; x++) {
+		const unsigned char* s = source + x * 4;
+		unsigned char* d = dest + x * 4;
+		const unsigned int a = s[3];
+		for (int c = 0; c < 3; c++)
+			d[c] = bPremultiply ? PremultiplyByte(s[c], a) : UnpremultiplyByte(s[c], a);
+		d[3] = (unsigned char)a;
+	}
+}
+
+// 2 pixels at a time
+SPOUT_TARGET_AVX2
+static unsigned int AlphaPixelsAVX2(float* line, unsigned int width, bool bPremultiply)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	unsigned int x = 0;
+	for (; x + 2 <= width; x += 2) {
+		const __m256 v = _mm256_loadu_ps(line + x * 4);
+		const __m256 a = _mm256_shuffle_ps(v, v, 0xFF);
+		__m256 q;
+		if (bPremultiply) {
+			q = _mm256_mul_ps(v, a);
+		}
+		else {
+			q = _mm256_div_ps(v, a);
+			q = _mm256_blendv_ps(q, v, _mm256_cmp_ps(a, zero, _CMP_EQ_OQ));
+		}
+		_mm256_storeu_ps(line + x * 4, _mm256_blend_ps(q, v, 0x88));
+	}
+	return x;
+}
+
+void spoutCopy::AlphaLine(float* line, unsigned int width) const
+{
+	const bool bPremultiply = (m_Alpha == SPOUT_ALPHA_PREMULTIPLY);
+	unsigned int x = 0;
+	if (m_SIMD >= SPOUT_SIMD_AVX2) {
+		x = AlphaPixelsAVX2(line, width, bPremultiply);
+	}
+	else if (m_SIMD >= SPOUT_SIMD_SSE2) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 rgb = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		for (; x < width; x++) {
+			const __m128 v = _mm_loadu_ps(line + x * 4);
+			const __m128 a = _mm_shuffle_ps(v, v, 0xFF);
+			__m128 q;
+			if (bPremultiply) {
+				q = _mm_mul_ps(v, a);
+			}
+			else {
+				const __m128 keep = _mm_cmpeq_ps(a, zero);
+				q = _mm_or_ps(_mm_and_ps(keep, v), _mm_andnot_ps(keep, _mm_div_ps(v, a)));
+			}
+			_mm_storeu_ps(line + x * 4, _mm_or_ps(_mm_and_ps(rgb, q), _mm_andnot_ps(rgb, v)));
+		}
+	}
+	for (; x < width; x++) {
+		float* p = line + x * 4;
+		const float a = p[3];
+		for (int c = 0; c < 3; c++) {
+			if (bPremultiply)
+				p[c] = p[c] * a;
+			else if (a != 0.0f)
+				p[c] = p[c] / a;
+		}
+	}
+}
+
+//
+// Dither
+//
+// Red, green and blue are converted to 8 bit with a threshold from the
+// pattern in place of rounding : (int)(v * 255 + threshold). Thresholds
+// are between 0 and 1 and average 0.5, so that gradients change between
+// adjacent values in proportion instead of in steps. Alpha is rounded.
+//
+// The Bayer matrix is the 8x8 ordered dither. The blue noise mask is made
+// by the void and cluster method (Ulichney 1993) on a 64x64 torus, so that
+// it tiles without seams and has no low frequency pattern.
+//
+// Each threshold entry is 4 floats, the same for red, green and blue,
+// so that two pixels are a single AVX2 load.
+//
+
+static void MakeDitherTable(const std::vector<unsigned int>& rank, std::vector<float>& table)
+{
+	const float count = (float)rank.size();
+	table.resize(rank.size() * 4);
+	for (size_t i = 0; i < rank.size(); i++) {
+		const float t = ((float)rank[i] + 0.5f) / count;
+		table[i * 4 + 0] = t;
+		table[i * 4 + 1] = t;
+		table[i * 4 + 2] = t;
+		table[i * 4 + 3] = 0.0f;
+	}
+}
+
+static const std::vector<float>& BayerTable()
+{
+	static const std::vector<float> table = []() {
+		// Each 2x2 step is 4 x the smaller matrix plus 0, 2, 3, 1
+		std::vector<unsigned int> rank(64, 0);
+		for (unsigned int n = 1; n < 8; n *= 2) {
+			for (unsigned int y = 0; y < n; y++) {
+				for (unsigned int x = 0; x < n; x++) {
+					const unsigned int v = rank[y * 8 + x] * 4;
+					rank[y * 8 + x] = v;
+					rank[y * 8 + x + n] = v + 2;
+					rank[(y + n) * 8 + x] = v + 3;
+					rank[(y + n) * 8 + x + n] = v + 1;
+				}
+			}
+		}
+		std::vector<float> t;
+		MakeDitherTable(rank, t);
+		return t;
+	}();
+	return table;
+}
+
+static const std::vector<float>& BlueNoiseTable()
+{
+	static const std::vector<float> table = []() {
+		const unsigned int size = 64;
+		const unsigned int n = size * size;
+
+		// Gaussian energy of each pixel on the torus, sigma 1.5
+		std::vector<float> filter(n);
+		for (unsigned int y = 0; y < size; y++) {
+			for (unsigned int x = 0; x < size; x++) {
+				const float dx = (float)std::min(x, size - x);
+				const float dy = (float)std::min(y, size - y);
+				filter[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * 1.5f * 1.5f));
+			}
+		}
+
+		std::vector<unsigned char> pattern(n, 0);
+		std::vector<float> energy(n, 0.0f);
+		auto toggle = [&](unsigned int p, bool bOn) {
+			pattern[p] = bOn ? 1 : 0;
+			const float sign = bOn ? 1.0f : -1.0f;
+			const unsigned int py = p / size;
+			const unsigned int px = p % size;
+			for (unsigned int y = 0; y < size; y++) {
+				const float* row = filter.data() + ((y + size - py) % size) * size;
+				float* e = energy.data() + y * size;
+				for (unsigned int x = 0; x < size; x++)
+					e[x] += sign * row[(x + size - px) % size];
+			}
+		};
+		// Tightest cluster is the 1 with the most energy,
+		// largest void the 0 with the least
+		auto tightest = [&]() {
+			unsigned int best = 0;
+			float most = -1.0f;
+			for (unsigned int p = 0; p < n; p++) {
+				if (pattern[p] && energy[p] > most) {
+					most = energy[p];
+					best = p;
+				}
+			}
+			return best;
+		};
+		auto largest = [&]() {
+			unsigned int best = 0;
+			float least = 1e30f;
+			for (unsigned int p = 0; p < n; p++) {
+				if (!pattern[p] && energy[p] < least) {
+					least = energy[p];
+					best = p;
+				}
+			}
+			return best;
+		};
+
+		// Initial pattern of 10% random points, then move points
+		// from clusters to voids until it is evenly spread
+		const unsigned int ones = n / 10;
+		unsigned int seed = 1;
+		for (unsigned int count = 0; count < ones; ) {
+			seed = seed * 1664525u + 1013904223u;
+			const unsigned int p = (seed >> 8) % n;
+			if (!pattern[p]) {
+				toggle(p, true);
+				count++;
+			}
+		}
+		for (unsigned int i = 0; i < n; i++) {
+			const unsigned int c = tightest();
+			toggle(c, false);
+			const unsigned int v = largest();
+			toggle(v, true);
+			if (v == c)
+				break;
+		}
+		const std::vector<unsigned char> initialPattern = pattern;
+		const std::vector<float> initialEnergy = energy;
+
+		// Rank the initial points by removing the tightest clusters
+		std::vector<unsigned int> rank(n, 0);
+		for (unsigned int r = ones; r-- > 0; ) {
+			const unsigned int c = tightest();
+			toggle(c, false);
+			rank[c] = r;
+		}
+		// Rank the rest by filling the largest voids. Past half, the largest
+		// void of the 1s is also the tightest cluster of the 0s.
+		pattern = initialPattern;
+		energy = initialEnergy;
+		for (unsigned int r = ones; r < n; r++) {
+			const unsigned int v = largest();
+			toggle(v, true);
+			rank[v] = r;
+		}
+
+		std::vector<float> t;
+		MakeDitherTable(rank, t);
+		return t;
+	}();
+	return table;
+}
+
+void spoutCopy::SetDither(SpoutDither mode)
+{
+	if (mode == SPOUT_DITHER_BAYER) {
+		m_pDither = BayerTable().data();
+		m_DitherSize = 8;
+	}
+	else if (mode == SPOUT_DITHER_BLUENOISE) {
+		m_pDither = BlueNoiseTable().data();
+		m_DitherSize = 64;
+	}
+	else {
+		mode = SPOUT_DITHER_NONE;
+		m_pDither = nullptr;
+		m_DitherSize = 0;
+	}
+	m_Dither = mode;
+}
+
+SpoutDither spoutCopy::GetDither() const
+{
+	return m_Dither;
+}
+
+// 8 pixels at a time. The pattern size is a multiple of 8.
+SPOUT_TARGET_AVX2
+static unsigned int DitherPixelsAVX2(const float* line, unsigned char* dest, unsigned int width,
+	const float* row, unsigned int size)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 full = _mm256_set1_ps(255.0f);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	unsigned int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		const float* t = row + (x % size) * 4;
+		__m256i q[4];
+		for (unsigned int n = 0; n < 4; n++) {
+			__m256 v = _mm256_loadu_ps(line + (x + n * 2) * 4);
+			v = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(v, zero), one), full); // max returns 0 for NaN
+			const __m256i d = _mm256_cvttps_epi32(_mm256_add_ps(v, _mm256_loadu_ps(t + n * 8)));
+			q[n] = _mm256_blend_epi32(d, _mm256_cvtps_epi32(v), 0x88); // Alpha rounded
+		}
+		// Pixels 0, 2, 4, 6 in the low lane and 1, 3, 5, 7 in the high lane
+		__m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(q[0], q[1]), _mm256_packus_epi32(q[2], q[3]));
+		bytes = _mm256_permutevar8x32_epi32(bytes, order);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + x * 4), bytes);
+	}
+	return x;
+}
+
+void spoutCopy::DitherLine(const float* line, unsigned char* dest, unsigned int width, unsigned int y) const
+{
+	const float* row = m_pDither + (size_t)(y % m_DitherSize) * m_DitherSize * 4;
+	unsigned int x = 0;
+	if (m_SIMD >= SPOUT_SIMD_AVX2) {
+		x = DitherPixelsAVX2(line, dest, width, row, m_DitherSize);
+	}
+	else if (m_SIMD >= SPOUT_SIMD_SSE2) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 full = _mm_set1_ps(255.0f);
+		const __m128i rgb = _mm_set_epi32(0, -1, -1, -1);
+		for (; x + 4 <= width; x += 4) {
+			__m128i q[4];
+			for (unsigned int n = 0; n < 4; n++) {
+				__m128 v = _mm_loadu_ps(line + (x + n) * 4);
+				v = _mm_mul_ps(_mm_min_ps(_mm_max_ps(v, zero), one), full);
+				const __m128i d = _mm_cvttps_epi32(_mm_add_ps(v, _mm_loadu_ps(row + ((x + n) % m_DitherSize) * 4)));
+				q[n] = _mm_or_si128(_mm_and_si128(rgb, d), _mm_andnot_si128(rgb, _mm_cvtps_epi32(v)));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dest + x * 4),
+				_mm_packus_epi16(_mm_packs_epi32(q[0], q[1]), _mm_packs_epi32(q[2], q[3])));
+		}
+	}
+	for (; x < width; x++) {
+		const float* t = row + (x % m_DitherSize) * 4;
+		for (unsigned int c = 0; c < 4; c++) {
+			float v = line[x * 4 + c];
+			if (!(v >= 0.0f)) v = 0.0f; // and NaN
+			if (v > 1.0f) v = 1.0f;
+			v *= 255.0f;
+			dest[x * 4 + c] = (unsigned char)(c < 3 ? (int)(v + t[c]) : std::lrint(v));
+		}
+	}
+}
+
+//
+// 3D lookup table
+//
+// 8 bit and float lines are converted directly by the table.
+// RGBA16 and RGBA16F lines are converted to float in a line buffer
+// in the cache and back to the source format.
+//
+
+bool spoutCopy::ApplyLUT(const spoutLUT& lut, const void* source, void* dest,
+	unsigned int width, unsigned int height, GLenum dataType,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	unsigned int pixelBytes = 0;
+	switch (dataType) {
+		case GL_UNSIGNED_BYTE:
+			pixelBytes = 4;
+			break;
+		case GL_UNSIGNED_SHORT:
+		case GL_HALF_FLOAT:
+			pixelBytes = 8;
+			break;
+		case GL_FLOAT:
+			pixelBytes = 16;
+			break;
+		default:
+			return false;
+	}
+
+	if (!source || !dest || !lut.IsLoaded())
+		return false;
+
+	// Rows cannot be inverted in place
+	if (bInvert && source == dest)
+		return false;
+
+	if (sourcePitch == 0) sourcePitch = width * pixelBytes;
+	if (destPitch == 0) destPitch = width * pixelBytes;
+
+	ApplyLUTLines(lut, source, dest, width, height, sourcePitch, destPitch, bInvert, dataType);
+
+	return true;
+}
+
+void spoutCopy::ApplyLUTLines(const spoutLUT& lut, const void* source, void* dest,
+	unsigned int width, unsigned int height,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert, GLenum dataType) const
+{
+	if (UseThreads((size_t)destPitch * height, height)) {
+		if (RunRows(m_pPool, source, dest, height, sourcePitch, destPitch, bInvert,
+			[&](const unsigned char* src, unsigned char* dst, unsigned int rows) {
+				ApplyLUTLines(lut, src, dst, width, rows, sourcePitch, destPitch, bInvert, dataType);
+			}))
+			return;
+	}
+
+	const bool bAVX2 = (m_SIMD >= SPOUT_SIMD_AVX2);
+	auto src = static_cast<const unsigned char *>(source);
+	auto dst = static_cast<unsigned char *>(dest);
+
+	if (dataType == GL_UNSIGNED_BYTE) {
+		for (unsigned int y = 0; y < height; y++) {
+			lut.ApplyLine(src + (size_t)(bInvert ? (height - 1 - y) : y) * sourcePitch,
+				dst + (size_t)y * destPitch, width, bAVX2);
+		}
+		return;
+	}
+
+	if (dataType == GL_FLOAT) {
+		for (unsigned int y = 0; y < height; y++) {
+			lut.ApplyLine(reinterpret_cast<const float *>(src + (size_t)(bInvert ? (height - 1 - y) : y) * sourcePitch),
+				reinterpret_cast<float *>(dst + (size_t)y * destPitch), width, bAVX2);
+		}
+		return;
+	}
+
+	const spoutLineConvert& convert = (dataType == GL_HALF_FLOAT)
+		? LineConverter<spoutChannelHalf, spoutChannelHalf>()
+		: LineConverter<spoutChannelUshort, spoutChannelUshort>();
+	const bool bF16C = (bAVX2 && m_bF16C);
+	const spoutConvertChannels toFloat = bF16C ? convert.toFloatAVX2 : convert.toFloat;
+	const spoutConvertChannels fromFloat = bF16C ? convert.fromFloatAVX2 : convert.fromFloat;
+	std::vector<float> line((size_t)width * 4);
+	auto buffer = reinterpret_cast<unsigned char *>(line.data());
+	for (unsigned int y = 0; y < height; y++) {
+		toFloat(src + (size_t)(bInvert ? (height - 1 - y) : y) * sourcePitch, buffer, width * 4);
+		lut.ApplyLine(line.data(), line.data(), width, bAVX2);
+		fromFloat(buffer, dst + (size_t)y * destPitch, width * 4);
+	}
+}
+
+//
+// Regions
+//
+// A region is copied by offsetting the image pointers to the top left
+// of the clipped region and keeping the image pitch, so the same
+// functions, threads and SIMD dispatch are used as for a whole image.
+//
+
+bool spoutCopy::ClipRegion(const SpoutRegion& region, unsigned int width, unsigned int height,
+	SpoutRegion& clipped)
+{
+	if (region.x >= width || region.y >= height || region.width == 0 || region.height == 0)
+		return false;
+	clipped.x = region.x;
+	clipped.y = region.y;
+	clipped.width = std::min(region.width, width - region.x);
+	clipped.height = std::min(region.height, height - region.y);
+	return true;
+}
+
+bool spoutCopy::CopyRegion(const void* source, unsigned int sourceWidth, unsigned int sourceHeight,
+	unsigned int sourcePitch, GLenum sourceFormat, const SpoutRegion& sourceRegion,
+	void* dest, unsigned int destWidth, unsigned int destHeight,
+	unsigned int destPitch, GLenum destFormat, const SpoutRegion& destRegion,
+	bool bInvert, bool bMirror, bool bSwapRB) const
+{
+	unsigned int sourceBytes = 0;
+	unsigned int destBytes = 0;
+	bool bSourceBGR = false;
+	bool bDestBGR = false;
+	if (!source || !dest
+		|| !ImageFormat(sourceFormat, sourceBytes, bSourceBGR)
+		|| !ImageFormat(destFormat, destBytes, bDestBGR))
+		return false;
+
+	if (sourcePitch == 0) sourcePitch = sourceWidth * sourceBytes;
+	if (destPitch == 0) destPitch = destWidth * destBytes;
+	if (sourcePitch < sourceWidth * sourceBytes || destPitch < destWidth * destBytes)
+		return false;
+
+	SpoutRegion src = {};
+	SpoutRegion dst = {};
+	if (!ClipRegion(sourceRegion, sourceWidth, sourceHeight, src)
+		|| !ClipRegion(destRegion, destWidth, destHeight, dst))
+		return false;
+
+	return CopyImage(
+		static_cast<const unsigned char *>(source) + (size_t)src.y * sourcePitch + (size_t)src.x * sourceBytes,
+		static_cast<unsigned char *>(dest) + (size_t)dst.y * destPitch + (size_t)dst.x * destBytes,
+		std::min(src.width, dst.width), std::min(src.height, dst.height),
+		sourceFormat, destFormat, sourcePitch, destPitch, bInvert, bMirror, bSwapRB);
+}
+
+bool spoutCopy::ResampleRegion(const void* source, unsigned int sourceWidth, unsigned int sourceHeight,
+	unsigned int sourcePitch, GLenum sourceFormat, const SpoutRegion& sourceRegion,
+	void* dest, unsigned int destWidth, unsigned int destHeight,
+	unsigned int destPitch, GLenum destFormat, const SpoutRegion& destRegion,
+	bool bInvert, bool bMirror, bool bSwapRB) const
+{
+	unsigned int sourceBytes = 0;
+	unsigned int destBytes = 0;
+	bool bSourceBGR = false;
+	bool bDestBGR = false;
+	if (!source || !dest
+		|| !ImageFormat(sourceFormat, sourceBytes, bSourceBGR) || sourceBytes != 4
+		|| !ImageFormat(destFormat, destBytes, bDestBGR) || destBytes < 3)
+		return false;
+
+	if (sourcePitch == 0) sourcePitch = sourceWidth * sourceBytes;
+	if (destPitch == 0) destPitch = destWidth * destBytes;
+	if (sourcePitch < sourceWidth * sourceBytes || destPitch < destWidth * destBytes)
+		return false;
+
+	SpoutRegion src = {};
+	SpoutRegion dst = {};
+	if (!ClipRegion(sourceRegion, sourceWidth, sourceHeight, src)
+		|| !ClipRegion(destRegion, destWidth, destHeight, dst))
+		return false;
+
+	const bool bSwap = (bSourceBGR != bDestBGR) != bSwapRB;
+
+	Resample(static_cast<const unsigned char *>(source) + (size_t)src.y * sourcePitch + (size_t)src.x * sourceBytes,
+		static_cast<unsigned char *>(dest) + (size_t)dst.y * destPitch + (size_t)dst.x * destBytes,
+		src.width, src.height, sourcePitch, dst.width, dst.height, destBytes,
+		bInvert, bMirror, bSwap, destPitch);
+
+	return true;
+}
+
+// Bytes per RGBA pixel of a high bit depth data type
+static unsigned int RegionPixelBytes(GLenum dataType)
+{
+	switch (dataType) {
+		case GL_UNSIGNED_BYTE:
+			return 4;
+		case GL_UNSIGNED_SHORT:
+		case GL_HALF_FLOAT:
+			return 8;
+		case GL_FLOAT:
+			return 16;
+		default:
+			return 0;
+	}
+}
+
+// Index of a high bit depth data type in the conversion table
+static int RegionTypeIndex(GLenum dataType)
+{
+	switch (dataType) {
+		case GL_UNSIGNED_BYTE:
+			return 0;
+		case GL_UNSIGNED_SHORT:
+			return 1;
+		case GL_HALF_FLOAT:
+			return 2;
+		default:
+			return 3; // GL_FLOAT
+	}
+}
+
+bool spoutCopy::ConvertRegion(const void* source, unsigned int sourceWidth, unsigned int sourceHeight,
+	unsigned int sourcePitch, GLenum sourceType, const SpoutRegion& sourceRegion,
+	void* dest, unsigned int destWidth, unsigned int destHeight,
+	unsigned int destPitch, GLenum destType, const SpoutRegion& destRegion,
+	bool bInvert) const
+{
+	const unsigned int sourceBytes = RegionPixelBytes(sourceType);
+	const unsigned int destBytes = RegionPixelBytes(destType);
+	if (!source || !dest || sourceBytes == 0 || destBytes == 0)
+		return false;
+
+	if (sourcePitch == 0) sourcePitch = sourceWidth * sourceBytes;
+	if (destPitch == 0) destPitch = destWidth * destBytes;
+	if (sourcePitch < sourceWidth * sourceBytes || destPitch < destWidth * destBytes)
+		return false;
+
+	SpoutRegion src = {};
+	SpoutRegion dst = {};
+	if (!ClipRegion(sourceRegion, sourceWidth, sourceHeight, src)
+		|| !ClipRegion(destRegion, destWidth, destHeight, dst))
+		return false;
+
+	auto srcBuffer = static_cast<const unsigned char *>(source) + (size_t)src.y * sourcePitch + (size_t)src.x * sourceBytes;
+	auto dstBuffer = static_cast<unsigned char *>(dest) + (size_t)dst.y * destPitch + (size_t)dst.x * destBytes;
+	const unsigned int width = std::min(src.width, dst.width);
+	const unsigned int height = std::min(src.height, dst.height);
+
+	// The same type is copied as bytes
+	if (sourceType == destType)
+		return CopyImage(srcBuffer, dstBuffer, width * sourceBytes, height,
+			GL_LUMINANCE, GL_LUMINANCE, sourcePitch, destPitch, bInvert);
+
+	typedef void (spoutCopy::*spoutRegionConvert)(const void*, void*, unsigned int, unsigned int,
+		unsigned int, unsigned int, bool) const;
+	// [source][dest] ubyte, ushort, half, float
+	static const spoutRegionConvert convert[4][4] = {
+		{ nullptr, &spoutCopy::rgba2ushort, &spoutCopy::rgba2half, &spoutCopy::rgba2float },
+		{ &spoutCopy::ushort2rgba, nullptr, &spoutCopy::ushort2half, &spoutCopy::ushort2float },
+		{ &spoutCopy::half2rgba, &spoutCopy::half2ushort, nullptr, &spoutCopy::half2float },
+		{ &spoutCopy::float2rgba, &spoutCopy::float2ushort, &spoutCopy::float2half, nullptr },
+	};
+
+	(this->*convert[RegionTypeIndex(sourceType)][RegionTypeIndex(destType)])(
+		srcBuffer, dstBuffer, width, height, sourcePitch, destPitch, bInvert);
+
+	return true;
+}
+
+//
+// Y'CbCr
+//
+// BT.709 coefficients with video (limited) or full range.
+// Each line is converted to 16 bit Y, Cb and Cr lines and then packed
+// for the format. Cb and Cr of the 4:2:2 formats are calculated from
+// the sum of each pair of pixels, and for NV12 two lines are averaged.
+// Converting back, the lines are unpacked and chroma is repeated for
+// each pair of pixels and for both lines of NV12.
+//
+// AVX2 converts 8 pixels at a time. The scalar functions give the same
+// result and are used for the remainder. UYVY, NV12 and AYUV are packed with SSE2.
+//
+
+// Coefficients of channels 0, 1, 2 and the offset for each result
+//   rgba2yuv - Y, Cb, Cr and Cb, Cr from the sum of two pixels
+//   yuv2rgba - channels 0, 1, 2 from Y, Cb, Cr
+struct spoutYUVMatrix {
+	float row[5][4];
+	int maxValue;
+};
+
+// Scale and offset of Y and chroma
+static void YUVRange(unsigned int bits, bool bFullRange, double& ys, double& yo, double& cs, double& co)
+{
+	const double scale = (double)(1 << (bits - 8));
+	if (bFullRange) {
+		ys = (double)((1 << bits) - 1);
+		yo = 0.0;
+		cs = ys;
+		co = (double)(1 << (bits - 1));
+	}
+	else {
+		ys = 219.0 * scale;
+		yo = 16.0 * scale;
+		cs = 224.0 * scale;
+		co = 128.0 * scale;
+	}
+}
+
+static const double spoutKr = 0.2126; // BT.709
+static const double spoutKb = 0.0722;
+
+static void YUVEncodeMatrix(spoutYUVMatrix& m, unsigned int bits, bool bFullRange, bool bBGR)
+{
+	const double Kr = spoutKr;
+	const double Kb = spoutKb;
+	const double Kg = 1.0 - Kr - Kb;
+	// Y', Pb and Pr from red, green and blue
+	const double ky[3] = { Kr, Kg, Kb };
+	const double kb[3] = { -Kr / (2.0 * (1.0 - Kb)), -Kg / (2.0 * (1.0 - Kb)), 0.5 };
+	const double kr[3] = { 0.5, -Kg / (2.0 * (1.0 - Kr)), -Kb / (2.0 * (1.0 - Kr)) };
+	double ys, yo, cs, co;
+	YUVRange(bits, bFullRange, ys, yo, cs, co);
+	for (int c = 0; c < 3; c++) {
+		const int i = bBGR ? 2 - c : c; // channel of red, green or blue
+		m.row[0][i] = (float)(ky[c] * ys / 255.0);
+		m.row[1][i] = (float)(kb[c] * cs / 255.0);
+		m.row[2][i] = (float)(kr[c] * cs / 255.0);
+		m.row[3][i] = m.row[1][i] * 0.5f;
+		m.row[4][i] = m.row[2][i] * 0.5f;
+	}
+	m.row[0][3] = (float)yo;
+	m.row[1][3] = m.row[3][3] = (float)co;
+	m.row[2][3] = m.row[4][3] = (float)co;
+	m.maxValue = (1 << bits) - 1;
+}
+
+static void YUVDecodeMatrix(spoutYUVMatrix& m, unsigned int bits, bool bFullRange, bool bBGR)
+{
+	const double Kr = spoutKr;
+	const double Kb = spoutKb;
+	const double Kg = 1.0 - Kr - Kb;
+	// Red, green and blue from Pb and Pr
+	const double kb[3] = { 0.0, -2.0 * Kb * (1.0 - Kb) / Kg, 2.0 * (1.0 - Kb) };
+	const double kr[3] = { 2.0 * (1.0 - Kr), -2.0 * Kr * (1.0 - Kr) / Kg, 0.0 };
+	double ys, yo, cs, co;
+	YUVRange(bits, bFullRange, ys, yo, cs, co);
+	for (int c = 0; c < 3; c++) {
+		float* k = m.row[bBGR ? 2 - c : c];
+		k[0] = (float)(255.0 / ys);
+		k[1] = (float)(255.0 * kb[c] / cs);
+		k[2] = (float)(255.0 * kr[c] / cs);
+		k[3] = (float)(-255.0 * (yo / ys + (kb[c] + kr[c]) * co / cs));
 	}
+	m.maxValue = 255;
+}
 
-} // end bgr2rgba
+static inline unsigned short YUVValue(const float* k, float c0, float c1, float c2, int maxValue)
+{
+	const int v = (int)std::lrint(((c0 * k[0] + c1 * k[1]) + c2 * k[2]) + k[3]);
+	return (unsigned short)std::min(std::max(v, 0), maxValue);
+}
 
-void spoutCopy::bgr2rgba(const void *bgr_source, void *rgba_dest,
-	unsigned int width, unsigned int height,
-	unsigned int dest_pitch, bool bInvert) const
+SPOUT_TARGET_AVX2
+static inline __m256i YUVValuesAVX2(__m256 c0, __m256 c1, __m256 c2, const __m256* k, __m256i maxValue)
 {
-	// BGR buffer dest does not have padding
-	const unsigned long bgrsize = width * height * 3;
-	const unsigned long bgrpitch = width * 3;
-	const unsigned long rgba_padding = dest_pitch - (width * 4);
+	const __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+		_mm256_mul_ps(c0, k[0]), _mm256_mul_ps(c1, k[1])), _mm256_mul_ps(c2, k[2])), k[3]);
+	return _mm256_min_epi32(_mm256_max_epi32(_mm256_cvtps_epi32(v), _mm256_setzero_si256()), maxValue);
+}
 
-	// RGBA dest may have padding 
-	// Dest and source must be the same dimensions otherwise
+// 8 values to 16 bit
+SPOUT_TARGET_AVX2
+static inline __m128i YUVPack16AVX2(__m256i v)
+{
+	return _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi32(v, v), 0x08));
+}
 
-	// Start of buffers
-	auto bgr = static_cast<const unsigned char *>(bgr_source); // rgb/bgr
-	auto rgba = static_cast<unsigned char *>(rgba_dest); // rgba/bgra
-	if (bInvert) {
-		bgr += bgrsize; // end of rgb buffer
-		bgr -= bgrpitch; // beginning of the last rgb line
+SPOUT_TARGET_AVX2
+static unsigned int YUVPixelsAVX2(const unsigned char* rgba, unsigned short* y, unsigned short* u, unsigned short* v,
+	unsigned int width, const spoutYUVMatrix& m, bool b422)
+{
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	const __m256i maxValue = _mm256_set1_epi32(m.maxValue);
+	const __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+	__m256 ky[4], kb[4], kr[4], kc[4];
+	for (int i = 0; i < 4; i++) {
+		ky[i] = _mm256_set1_ps(m.row[0][i]);
+		kb[i] = _mm256_set1_ps(m.row[1][i]);
+		kr[i] = _mm256_set1_ps(m.row[2][i]);
+		// Cb of pairs in the low lane and Cr in the high lane
+		kc[i] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(m.row[3][i])), _mm_set1_ps(m.row[4][i]), 1);
 	}
+	unsigned int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rgba + x * 4));
+		const __m256i i0 = _mm256_and_si256(p, mask);
+		const __m256i i1 = _mm256_and_si256(_mm256_srli_epi32(p, 8), mask);
+		const __m256i i2 = _mm256_and_si256(_mm256_srli_epi32(p, 16), mask);
+		const __m256 c0 = _mm256_cvtepi32_ps(i0);
+		const __m256 c1 = _mm256_cvtepi32_ps(i1);
+		const __m256 c2 = _mm256_cvtepi32_ps(i2);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(y + x), YUVPack16AVX2(YUVValuesAVX2(c0, c1, c2, ky, maxValue)));
+		if (b422) {
+			// Sums of pairs : channel 0 in the low lane and 1 in the high lane, channel 2 in both
+			const __m256i s01 = _mm256_permutevar8x32_epi32(_mm256_hadd_epi32(i0, i1), order);
+			const __m256i s2 = _mm256_permutevar8x32_epi32(_mm256_hadd_epi32(i2, i2), order);
+			const __m256 s0 = _mm256_cvtepi32_ps(_mm256_permute2x128_si256(s01, s01, 0x00));
+			const __m256 s1 = _mm256_cvtepi32_ps(_mm256_permute2x128_si256(s01, s01, 0x11));
+			const __m256i c = YUVValuesAVX2(s0, s1, _mm256_cvtepi32_ps(s2), kc, maxValue);
+			const __m256i c16 = _mm256_packus_epi32(c, c);
+			_mm_storel_epi64(reinterpret_cast<__m128i *>(u + x / 2), _mm256_castsi256_si128(c16));
+			_mm_storel_epi64(reinterpret_cast<__m128i *>(v + x / 2), _mm256_extracti128_si256(c16, 1));
+		}
+		else {
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(u + x), YUVPack16AVX2(YUVValuesAVX2(c0, c1, c2, kb, maxValue)));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(v + x), YUVPack16AVX2(YUVValuesAVX2(c0, c1, c2, kr, maxValue)));
+		}
+	}
+	return x;
+}
 
-	for (unsigned int y = 0; y < height; y++) {
-		for (unsigned int x = 0; x < width; x++) {
-			*(rgba + 0) = *(bgr + 0); // blu
-			*(rgba + 1) = *(bgr + 1); // grn
-			*(rgba + 2) = *(bgr + 2); // red
-			bgr += 3;
-			rgba += 4;
+// RGBA line to Y, Cb and Cr lines, chroma for each pixel or each pair of pixels.
+// For an odd width with 4:2:2, Y of the last pixel is repeated after the line.
+static void YUVLine(const unsigned char* rgba, unsigned short* y, unsigned short* u, unsigned short* v,
+	unsigned int width, const spoutYUVMatrix& m, bool b422, bool bAVX2)
+{
+	unsigned int x = bAVX2 ? YUVPixelsAVX2(rgba, y, u, v, width, m, b422) : 0;
+	for (; x < width; x++) {
+		const unsigned char* p = rgba + x * 4;
+		y[x] = YUVValue(m.row[0], p[0], p[1], p[2], m.maxValue);
+		if (!b422) {
+			u[x] = YUVValue(m.row[1], p[0], p[1], p[2], m.maxValue);
+			v[x] = YUVValue(m.row[2], p[0], p[1], p[2], m.maxValue);
 		}
-		rgba += rgba_padding;
+		else if ((x & 1) == 0) {
+			const unsigned char* q = (x + 1 < width) ? p + 4 : p;
+			const float s0 = (float)(p[0] + q[0]);
+			const float s1 = (float)(p[1] + q[1]);
+			const float s2 = (float)(p[2] + q[2]);
+			u[x / 2] = YUVValue(m.row[3], s0, s1, s2, m.maxValue);
+			v[x / 2] = YUVValue(m.row[4], s0, s1, s2, m.maxValue);
+		}
+	}
+	if (b422 && (width & 1))
+		y[width] = y[width - 1];
+}
 
-		if (bInvert)
-			bgr -= bgrpitch * 2; // move up a line for invert
+SPOUT_TARGET_AVX2
+static unsigned int RGBAPixelsAVX2(const unsigned short* y, const unsigned short* u, const unsigned short* v,
+	const unsigned short* a, unsigned char* rgba, unsigned int width, const spoutYUVMatrix& m, bool b422)
+{
+	const __m256i maxValue = _mm256_set1_epi32(m.maxValue);
+	const __m256i repeat = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+	__m256 k[3][4];
+	for (int c = 0; c < 3; c++) {
+		for (int i = 0; i < 4; i++)
+			k[c][i] = _mm256_set1_ps(m.row[c][i]);
+	}
+	unsigned int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		const __m256 fy = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x))));
+		__m256i iu, iv;
+		if (b422) {
+			iu = _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_cvtepu16_epi32(
+				_mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x / 2)))), repeat);
+			iv = _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_cvtepu16_epi32(
+				_mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + x / 2)))), repeat);
+		}
+		else {
+			iu = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(u + x)));
+			iv = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(v + x)));
+		}
+		const __m256 fu = _mm256_cvtepi32_ps(iu);
+		const __m256 fv = _mm256_cvtepi32_ps(iv);
+		__m256i p = _mm256_or_si256(YUVValuesAVX2(fy, fu, fv, k[0], maxValue),
+			_mm256_or_si256(_mm256_slli_epi32(YUVValuesAVX2(fy, fu, fv, k[1], maxValue), 8),
+				_mm256_slli_epi32(YUVValuesAVX2(fy, fu, fv, k[2], maxValue), 16)));
+		if (a)
+			p = _mm256_or_si256(p, _mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + x))), 24));
+		else
+			p = _mm256_or_si256(p, opaque);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(rgba + x * 4), p);
 	}
+	return x;
+}
 
-} // end bgr2rgba with dest pitch
+// Y, Cb, Cr and alpha lines to an RGBA line, alpha 255 without an alpha line
+static void RGBALine(const unsigned short* y, const unsigned short* u, const unsigned short* v,
+	const unsigned short* a, unsigned char* rgba, unsigned int width, const spoutYUVMatrix& m, bool b422, bool bAVX2)
+{
+	unsigned int x = bAVX2 ? RGBAPixelsAVX2(y, u, v, a, rgba, width, m, b422) : 0;
+	for (; x < width; x++) {
+		const unsigned int c = b422 ? x / 2 : x;
+		const float fy = (float)y[x];
+		const float fu = (float)u[c];
+		const float fv = (float)v[c];
+		unsigned char* p = rgba + x * 4;
+		p[0] = (unsigned char)YUVValue(m.row[0], fy, fu, fv, m.maxValue);
+		p[1] = (unsigned char)YUVValue(m.row[1], fy, fu, fv, m.maxValue);
+		p[2] = (unsigned char)YUVValue(m.row[2], fy, fu, fv, m.maxValue);
+		p[3] = a ? (unsigned char)a[x] : 255;
+	}
+}
 
+// 8 bit lines
 
-void spoutCopy::rgb2bgra(const void *rgb_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert) const
+static void PackBytes(const unsigned short* source, unsigned char* dest, unsigned int n, bool bSSE2)
 {
-	const unsigned long rgbsize = width * height * 3;
-	const unsigned long rgbpitch = width * 3;
-
-	// Start of buffers
-	auto rgb = static_cast<const unsigned char *>(rgb_source); // RGB
-	auto bgra = static_cast<unsigned char *>(bgra_dest); // BGRA
-	if (bInvert) {
-		rgb += rgbsize; // end of rgb buffer
-		rgb -= rgbpitch; // beginning of the last rgb line
+	unsigned int i = 0;
+	if (bSSE2) {
+		for (; i + 16 <= n; i += 16) {
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), _mm_packus_epi16(
+				_mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i + 8))));
+		}
 	}
+	for (; i < n; i++)
+		dest[i] = (unsigned char)source[i];
+}
 
-	for (unsigned int y = 0; y < height; y++) {
-		for (unsigned int x = 0; x < width; x++) {
-			// rgb source - bgra dest
-			*(bgra + 0) = *(rgb + 2); // blu
-			*(bgra + 1) = *(rgb + 1); // grn
-			*(bgra + 2) = *(rgb + 0); // red
-			*(bgra + 3) = (unsigned char)255; // alpha
-			rgb += 3;
-			bgra += 4;
+static void UnpackBytes(const unsigned char* source, unsigned short* dest, unsigned int n, bool bSSE2)
+{
+	unsigned int i = 0;
+	if (bSSE2) {
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 16 <= n; i += 16) {
+			const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), _mm_unpacklo_epi8(p, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i + 8), _mm_unpackhi_epi8(p, zero));
 		}
-		if (bInvert)
-			rgb -= rgbpitch * 2; // move up a line for invert
 	}
+	for (; i < n; i++)
+		dest[i] = source[i];
+}
 
-} // end rgb2bgra
+// Alternate 8 bit values, even to 0 and odd to 1
+static inline void Deinterleave16(__m128i lo, __m128i hi, __m128i& v0, __m128i& v1)
+{
+	const __m128i low = _mm_set1_epi32(0xFFFF);
+	v0 = _mm_packs_epi32(_mm_and_si128(lo, low), _mm_and_si128(hi, low));
+	v1 = _mm_packs_epi32(_mm_srli_epi32(lo, 16), _mm_srli_epi32(hi, 16));
+}
 
+// UYVY - U Y0 V Y1 for each pair
 
-void spoutCopy::rgb2bgra(const void *rgb_source, void *bgra_dest,
-	unsigned int width, unsigned int height,
-	unsigned int dest_pitch, bool bInvert) const
+static void PackUYVY(const unsigned short* y, const unsigned short* u, const unsigned short* v,
+	unsigned char* dest, unsigned int pairs, bool bSSE2)
 {
-	// RGB source does not have padding
-	const unsigned long rgbsize = width * height * 3;
-	const unsigned long rgbpitch = width * 3;
-	// BGRA dest may have padding 
-	const unsigned long bgra_padding = dest_pitch - (width * 4);
-	// Dest and source must be the same dimensions otherwise
-
-	// Start of buffers
-	auto rgb = static_cast<const unsigned char *>(rgb_source); // rgb/bgr
-	auto bgra = static_cast<unsigned char *>(bgra_dest); // rgba/bgra
-	if (bInvert) {
-		rgb += rgbsize; // end of rgb buffer
-		rgb -= rgbpitch; // beginning of the last rgb line
+	unsigned int i = 0;
+	if (bSSE2) {
+		for (; i + 4 <= pairs; i += 4) {
+			const __m128i uv = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + i)),
+				_mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + i)));
+			const __m128i yy = _mm_loadu_si128(reinterpret_cast<const __m128i *>(y + i * 2));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i * 4),
+				_mm_packus_epi16(_mm_unpacklo_epi16(uv, yy), _mm_unpackhi_epi16(uv, yy)));
+		}
 	}
+	for (; i < pairs; i++) {
+		unsigned char* d = dest + i * 4;
+		d[0] = (unsigned char)u[i];
+		d[1] = (unsigned char)y[i * 2];
+		d[2] = (unsigned char)v[i];
+		d[3] = (unsigned char)y[i * 2 + 1];
+	}
+}
 
-	for (unsigned int y = 0; y < height; y++) {
-		for (unsigned int x = 0; x < width; x++) {
-			*(bgra + 0) = *(rgb + 2); // blu
-			*(bgra + 1) = *(rgb + 1); // grn
-			*(bgra + 2) = *(rgb + 0); // red
-			rgb += 3;
-			bgra += 4;
+static void UnpackUYVY(const unsigned char* source, unsigned short* y, unsigned short* u, unsigned short* v,
+	unsigned int pairs, bool bSSE2)
+{
+	unsigned int i = 0;
+	if (bSSE2) {
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 4 <= pairs; i += 4) {
+			const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i * 4));
+			__m128i uv, yy, cu, cv;
+			Deinterleave16(_mm_unpacklo_epi8(p, zero), _mm_unpackhi_epi8(p, zero), uv, yy);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(y + i * 2), yy);
+			Deinterleave16(uv, zero, cu, cv);
+			_mm_storel_epi64(reinterpret_cast<__m128i *>(u + i), cu);
+			_mm_storel_epi64(reinterpret_cast<__m128i *>(v + i), cv);
 		}
-		bgra += bgra_padding;
-
-		if (bInvert)
-			rgb -= rgbpitch * 2; // move up a line for invert
 	}
+	for (; i < pairs; i++) {
+		const unsigned char* s = source + i * 4;
+		u[i] = s[0];
+		y[i * 2] = s[1];
+		v[i] = s[2];
+		y[i * 2 + 1] = s[3];
+	}
+}
 
-} // end rgb2bgra
-
-
+// NV12 - U V for each pair, averaged from two lines
 
-void spoutCopy::bgr2bgra(const void *bgr_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert) const
+static void PackNV12(const unsigned short* u0, const unsigned short* v0,
+	const unsigned short* u1, const unsigned short* v1,
+	unsigned char* dest, unsigned int pairs, bool bSSE2)
 {
-	const unsigned long bgrsize = width * height * 3;
-	const unsigned long bgrpitch = width * 3;
-
-	// Start of buffers
-	auto bgr = static_cast<const unsigned char *>(bgr_source); // BGR
-	auto bgra = static_cast<unsigned char *>(bgra_dest); // BGRA
-	if (bInvert) {
-		bgr += bgrsize; // end of rgb buffer
-		bgr -= bgrpitch; // beginning of the last rgb line
+	unsigned int i = 0;
+	if (bSSE2) {
+		for (; i + 8 <= pairs; i += 8) {
+			const __m128i u = _mm_avg_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(u0 + i)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i *>(u1 + i)));
+			const __m128i v = _mm_avg_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(v0 + i)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i *>(v1 + i)));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i * 2),
+				_mm_packus_epi16(_mm_unpacklo_epi16(u, v), _mm_unpackhi_epi16(u, v)));
+		}
+	}
+	for (; i < pairs; i++) {
+		dest[i * 2] = (unsigned char)((u0[i] + u1[i] + 1) >> 1);
+		dest[i * 2 + 1] = (unsigned char)((v0[i] + v1[i] + 1) >> 1);
 	}
+}
 
-	for (unsigned int y = 0; y < height; y++) {
-		for (unsigned int x = 0; x < width; x++) {
-			// bgr source - bgra dest
-			*(bgra + 0) = *(bgr + 0); // blu
-			*(bgra + 1) = *(bgr + 1); // grn
-			*(bgra + 2) = *(bgr + 2); // red
-			*(bgra + 3) = (unsigned char)255; // alpha
-			bgr += 3;
-			bgra += 4;
+static void UnpackNV12(const unsigned char* source, unsigned short* u, unsigned short* v,
+	unsigned int pairs, bool bSSE2)
+{
+	unsigned int i = 0;
+	if (bSSE2) {
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 8 <= pairs; i += 8) {
+			const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i * 2));
+			__m128i cu, cv;
+			Deinterleave16(_mm_unpacklo_epi8(p, zero), _mm_unpackhi_epi8(p, zero), cu, cv);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(u + i), cu);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(v + i), cv);
 		}
-		if (bInvert)
-			bgr -= bgrpitch * 2; // move up a line for invert
 	}
+	for (; i < pairs; i++) {
+		u[i] = source[i * 2];
+		v[i] = source[i * 2 + 1];
+	}
+}
 
-} // end bgr2bgra
+// v210 - 6 pixels in 4 little endian 32 bit words of three 10 bit values
+//   U0 Y0 V0, Y1 U2 Y2, V2 Y3 U4, Y4 V4 Y5
 
+static void PackV210(const unsigned short* y, const unsigned short* u, const unsigned short* v,
+	unsigned char* dest, unsigned int groups)
+{
+	for (unsigned int g = 0; g < groups; g++) {
+		const unsigned short* yy = y + g * 6;
+		const unsigned short* uu = u + g * 3;
+		const unsigned short* vv = v + g * 3;
+		const uint32_t w[4] = {
+			(uint32_t)uu[0] | ((uint32_t)yy[0] << 10) | ((uint32_t)vv[0] << 20),
+			(uint32_t)yy[1] | ((uint32_t)uu[1] << 10) | ((uint32_t)yy[2] << 20),
+			(uint32_t)vv[1] | ((uint32_t)yy[3] << 10) | ((uint32_t)uu[2] << 20),
+			(uint32_t)yy[4] | ((uint32_t)vv[2] << 10) | ((uint32_t)yy[5] << 20) };
+		memcpy(dest + g * 16, w, 16);
+	}
+}
 
-void spoutCopy::rgba2rgb(const void *rgba_source, void *rgb_dest,
-	unsigned int width, unsigned int height,
-	unsigned int rgba_pitch, bool bInvert, bool bMirror, bool bSwapRB) const
+static void UnpackV210(const unsigned char* source, unsigned short* y, unsigned short* u, unsigned short* v,
+	unsigned int groups)
 {
-	// RGB dest does not have padding
-	const unsigned long rgbsize = width * height * 3;
-	const unsigned long rgbpitch = width * 3;
-	const unsigned long rgba_padding = rgba_pitch-(width * 4);
+	for (unsigned int g = 0; g < groups; g++) {
+		uint32_t w[4];
+		memcpy(w, source + g * 16, 16);
+		unsigned short* yy = y + g * 6;
+		unsigned short* uu = u + g * 3;
+		unsigned short* vv = v + g * 3;
+		uu[0] = (unsigned short)(w[0] & 0x3FF); yy[0] = (unsigned short)((w[0] >> 10) & 0x3FF); vv[0] = (unsigned short)((w[0] >> 20) & 0x3FF);
+		yy[1] = (unsigned short)(w[1] & 0x3FF); uu[1] = (unsigned short)((w[1] >> 10) & 0x3FF); yy[2] = (unsigned short)((w[1] >> 20) & 0x3FF);
+		vv[1] = (unsigned short)(w[2] & 0x3FF); yy[3] = (unsigned short)((w[2] >> 10) & 0x3FF); uu[2] = (unsigned short)((w[2] >> 20) & 0x3FF);
+		yy[4] = (unsigned short)(w[3] & 0x3FF); vv[2] = (unsigned short)((w[3] >> 10) & 0x3FF); yy[5] = (unsigned short)((w[3] >> 20) & 0x3FF);
+	}
+}
 
-	// RGBA source may have padding 
-	// Dest and source must be the same dimensions otherwise
+// AYUV - V U Y A for each pixel
 
-	// Start of buffers
-	auto rgba = static_cast<const unsigned char *>(rgba_source); // rgba/bgra
-	auto rgb = static_cast<unsigned char *>(rgb_dest); // rgb/bgr
-	if (bInvert) {
-		rgb += rgbsize; // end of rgb buffer
-		rgb -= rgbpitch; // beginning of the last rgb line
+static void PackAYUV(const unsigned short* y, const unsigned short* u, const unsigned short* v,
+	const unsigned char* rgba, unsigned char* dest, unsigned int width, bool bSSE2)
+{
+	unsigned int x = 0;
+	if (bSSE2) {
+		for (; x + 8 <= width; x += 8) {
+			const __m128i a = _mm_packs_epi32(
+				_mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + x * 4)), 24),
+				_mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + x * 4 + 16)), 24));
+			const __m128i yy = _mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x));
+			const __m128i uu = _mm_loadu_si128(reinterpret_cast<const __m128i *>(u + x));
+			const __m128i vv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(v + x));
+			const __m128i vu0 = _mm_unpacklo_epi16(vv, uu);
+			const __m128i vu1 = _mm_unpackhi_epi16(vv, uu);
+			const __m128i ya0 = _mm_unpacklo_epi16(yy, a);
+			const __m128i ya1 = _mm_unpackhi_epi16(yy, a);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dest + x * 4),
+				_mm_packus_epi16(_mm_unpacklo_epi32(vu0, ya0), _mm_unpackhi_epi32(vu0, ya0)));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dest + x * 4 + 16),
+				_mm_packus_epi16(_mm_unpacklo_epi32(vu1, ya1), _mm_unpackhi_epi32(vu1, ya1)));
+		}
+	}
+	for (; x < width; x++) {
+		unsigned char* d = dest + x * 4;
+		d[0] = (unsigned char)v[x];
+		d[1] = (unsigned char)u[x];
+		d[2] = (unsigned char)y[x];
+		d[3] = rgba[x * 4 + 3];
+	}
+}
+
+static void UnpackAYUV(const unsigned char* source, unsigned short* y, unsigned short* u, unsigned short* v,
+	unsigned short* a, unsigned int width, bool bSSE2)
+{
+	unsigned int x = 0;
+	if (bSSE2) {
+		const __m128i zero = _mm_setzero_si128();
+		for (; x + 8 <= width; x += 8) {
+			const __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + x * 4));
+			const __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + x * 4 + 16));
+			__m128i vy0, ua0, vy1, ua1, vv, yy, uu, aa;
+			Deinterleave16(_mm_unpacklo_epi8(p0, zero), _mm_unpackhi_epi8(p0, zero), vy0, ua0);
+			Deinterleave16(_mm_unpacklo_epi8(p1, zero), _mm_unpackhi_epi8(p1, zero), vy1, ua1);
+			Deinterleave16(vy0, vy1, vv, yy);
+			Deinterleave16(ua0, ua1, uu, aa);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(y + x), yy);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(u + x), uu);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(v + x), vv);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(a + x), aa);
+		}
 	}
+	for (; x < width; x++) {
+		const unsigned char* s = source + x * 4;
+		v[x] = s[0];
+		u[x] = s[1];
+		y[x] = s[2];
+		a[x] = s[3];
+	}
+}
 
-	// Swap red and blue option
-	int ir = 0; int ig = 1; int ib = 2;
-	if(bSwapRB)	{
-		ir = 2; ib = 0;
+unsigned int spoutCopy::YUVPitch(unsigned int width, SpoutYUV format)
+{
+	switch (format) {
+		case SPOUT_YUV_UYVY:
+			return ((width + 1) / 2) * 4;
+		case SPOUT_YUV_V210:
+			return ((width + 47) / 48) * 128;
+		case SPOUT_YUV_NV12:
+			return (width + 1) & ~1u;
+		case SPOUT_YUV_AYUV:
+			return width * 4;
+		default:
+			return 0;
 	}
+}
 
-	unsigned int z = 0;
-	for (unsigned int y = 0; y < height; y++) {
-		for (unsigned int x = 0; x < width; x++) {
-			if (bMirror) {
-				z = (width - x - 1)*3;
-				*(rgb + z + ir) = *(rgba + 0); // red
-				*(rgb + z + ig) = *(rgba + 1); // grn
-				*(rgb + z + ib) = *(rgba + 2); // blu
+size_t spoutCopy::YUVSize(unsigned int width, unsigned int height, SpoutYUV format, unsigned int pitch)
+{
+	if (pitch == 0) pitch = YUVPitch(width, format);
+	size_t size = (size_t)pitch * height;
+	if (format == SPOUT_YUV_NV12)
+		size += (size_t)pitch * ((height + 1) / 2);
+	return size;
+}
+
+bool spoutCopy::rgba2yuv(const void* source, void* dest, unsigned int width, unsigned int height,
+	SpoutYUV format, bool bFullRange, GLenum glFormat,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+{
+	unsigned int pixelBytes = 0;
+	bool bBGR = false;
+	if (!source || !dest || width == 0 || height == 0
+		|| !ImageFormat(glFormat, pixelBytes, bBGR) || pixelBytes < 3)
+		return false;
+
+	const unsigned int minPitch = YUVPitch(width, format);
+	if (minPitch == 0)
+		return false;
+	if (sourcePitch == 0) sourcePitch = width * pixelBytes;
+	if (destPitch == 0) destPitch = minPitch;
+	if (sourcePitch < width * pixelBytes || destPitch < minPitch)
+		return false;
+
+	spoutYUVMatrix m;
+	YUVEncodeMatrix(m, (format == SPOUT_YUV_V210) ? 10 : 8, bFullRange, bBGR);
+
+	const bool b422 = (format != SPOUT_YUV_AYUV);
+	const bool bAVX2 = (m_SIMD >= SPOUT_SIMD_AVX2);
+	const bool bSSE2 = (m_SIMD >= SPOUT_SIMD_SSE2);
+	// RGB and BGR lines are converted to RGBA and BGRA first
+	const spoutPixelConvert toRGBA = (pixelBytes == 3) ? PixelConvert(m_SIMD, 3, 4, false) : nullptr;
+	const unsigned int pairs = (width + 1) / 2;
+	const unsigned int groups = (width + 5) / 6; // v210
+	const size_t lineSize = (size_t)groups * 6 + 8;
+	auto src = static_cast<const unsigned char *>(source);
+	auto dst = static_cast<unsigned char *>(dest);
+	unsigned char* uvPlane = dst + (size_t)destPitch * height; // NV12
+
+	// NV12 lines are converted in pairs for each chroma line
+	const unsigned int nRows = (format == SPOUT_YUV_NV12) ? (height + 1) / 2 : height;
+
+	auto lines = [&](unsigned int r0, unsigned int r1) {
+		std::vector<unsigned short> buffer(lineSize * 5);
+		unsigned short* yl = buffer.data();
+		unsigned short* u0 = yl + lineSize;
+		unsigned short* v0 = u0 + lineSize;
+		unsigned short* u1 = v0 + lineSize;
+		unsigned short* v1 = u1 + lineSize;
+		std::vector<unsigned char> rgba(toRGBA ? (size_t)width * 4 : 0);
+
+		// Image line to Y, Cb and Cr, returns the RGBA line
+		auto convert = [&](unsigned int y, unsigned short* u, unsigned short* v) {
+			const unsigned char* s = src + (size_t)(bInvert ? (height - 1 - y) : y) * sourcePitch;
+			if (toRGBA) {
+				toRGBA(s, rgba.data(), width, false);
+				s = rgba.data();
 			}
-			else {
-				z = x * 3;
-				*(rgb + z + ir) = *(rgba + 0); // red
-				*(rgb + z + ig) = *(rgba + 1); // grn
-				*(rgb + z + ib) = *(rgba + 2); // blu
+			YUVLine(s, yl, u, v, width, m, b422, bAVX2);
+			return s;
+		};
+
+		for (unsigned int r = r0; r < r1; r++) {
+			unsigned char* d = dst + (size_t)r * destPitch;
+			switch (format) {
+				case SPOUT_YUV_UYVY:
+					convert(r, u0, v0);
+					PackUYVY(yl, u0, v0, d, pairs, bSSE2);
+					break;
+				case SPOUT_YUV_V210:
+					convert(r, u0, v0);
+					// Complete the last group with the last pixel
+					for (unsigned int x = width; x < groups * 6; x++)
+						yl[x] = yl[width - 1];
+					for (unsigned int x = pairs; x < groups * 3; x++) {
+						u0[x] = u0[pairs - 1];
+						v0[x] = v0[pairs - 1];
+					}
+					PackV210(yl, u0, v0, d, groups);
+					memset(d + groups * 16, 0, minPitch - groups * 16);
+					break;
+				case SPOUT_YUV_NV12:
+					convert(r * 2, u0, v0);
+					PackBytes(yl, dst + (size_t)(r * 2) * destPitch, pairs * 2, bSSE2);
+					if (r * 2 + 1 < height) {
+						convert(r * 2 + 1, u1, v1);
+						PackBytes(yl, dst + (size_t)(r * 2 + 1) * destPitch, pairs * 2, bSSE2);
+						PackNV12(u0, v0, u1, v1, uvPlane + (size_t)r * destPitch, pairs, bSSE2);
+					}
+					else {
+						PackNV12(u0, v0, u0, v0, uvPlane + (size_t)r * destPitch, pairs, bSSE2);
+					}
+					break;
+				case SPOUT_YUV_AYUV:
+					PackAYUV(yl, u0, v0, convert(r, u0, v0), d, width, bSSE2);
+					break;
+				default:
+					break;
 			}
-			rgba += 4;
 		}
-		rgb += width * 3;
-		rgba += rgba_padding;
-		
-		if (bInvert)
-			rgb -= rgbpitch * 2; // move up a line for invert
-	}
+	};
 
-} // end rgba2rgb
+	if (!(UseThreads(YUVSize(width, height, format, destPitch), height) && m_pPool->Run(nRows, lines)))
+		lines(0, nRows);
 
+	return true;
+}
 
-void spoutCopy::rgba2bgr(const void *rgba_source, void *bgr_dest, unsigned int width, unsigned int height, bool bInvert) const
+bool spoutCopy::yuv2rgba(const void* source, void* dest, unsigned int width, unsigned int height,
+	SpoutYUV format, bool bFullRange, GLenum glFormat,
+	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
 {
-	const unsigned long bgrsize = width * height * 3;
-	const unsigned long bgrpitch = width * 3;
+	unsigned int pixelBytes = 0;
+	bool bBGR = false;
+	if (!source || !dest || width == 0 || height == 0
+		|| !ImageFormat(glFormat, pixelBytes, bBGR) || pixelBytes < 3)
+		return false;
+
+	const unsigned int minPitch = YUVPitch(width, format);
+	if (minPitch == 0)
+		return false;
+	if (sourcePitch == 0) sourcePitch = minPitch;
+	if (destPitch == 0) destPitch = width * pixelBytes;
+	if (sourcePitch < minPitch || destPitch < width * pixelBytes)
+		return false;
+
+	spoutYUVMatrix m;
+	YUVDecodeMatrix(m, (format == SPOUT_YUV_V210) ? 10 : 8, bFullRange, bBGR);
+
+	const bool b422 = (format != SPOUT_YUV_AYUV);
+	const bool bAVX2 = (m_SIMD >= SPOUT_SIMD_AVX2);
+	const bool bSSE2 = (m_SIMD >= SPOUT_SIMD_SSE2);
+	// RGBA and BGRA lines are converted to RGB and BGR
+	const spoutPixelConvert fromRGBA = (pixelBytes == 3) ? PixelConvert(m_SIMD, 4, 3, false) : nullptr;
+	const unsigned int pairs = (width + 1) / 2;
+	const unsigned int groups = (width + 5) / 6; // v210
+	const size_t lineSize = (size_t)groups * 6 + 8;
+	auto src = static_cast<const unsigned char *>(source);
+	auto dst = static_cast<unsigned char *>(dest);
+	const unsigned char* uvPlane = src + (size_t)sourcePitch * height; // NV12
+
+	const unsigned int nRows = (format == SPOUT_YUV_NV12) ? (height + 1) / 2 : height;
+
+	auto lines = [&](unsigned int r0, unsigned int r1) {
+		std::vector<unsigned short> buffer(lineSize * 4);
+		unsigned short* yl = buffer.data();
+		unsigned short* u = yl + lineSize;
+		unsigned short* v = u + lineSize;
+		unsigned short* a = v + lineSize;
+		std::vector<unsigned char> rgba(fromRGBA ? (size_t)width * 4 : 0);
+
+		// Y, Cb and Cr to an image line
+		auto convert = [&](unsigned int y, const unsigned short* alpha) {
+			unsigned char* d = dst + (size_t)(bInvert ? (height - 1 - y) : y) * destPitch;
+			RGBALine(yl, u, v, alpha, fromRGBA ? rgba.data() : d, width, m, b422, bAVX2);
+			if (fromRGBA)
+				fromRGBA(rgba.data(), d, width, false);
+		};
+
+		for (unsigned int r = r0; r < r1; r++) {
+			const unsigned char* s = src + (size_t)r * sourcePitch;
+			switch (format) {
+				case SPOUT_YUV_UYVY:
+					UnpackUYVY(s, yl, u, v, pairs, bSSE2);
+					convert(r, nullptr);
+					break;
+				case SPOUT_YUV_V210:
+					UnpackV210(s, yl, u, v, groups);
+					convert(r, nullptr);
+					break;
+				case SPOUT_YUV_NV12:
+					UnpackNV12(uvPlane + (size_t)r * sourcePitch, u, v, pairs, bSSE2);
+					UnpackBytes(src + (size_t)(r * 2) * sourcePitch, yl, width, bSSE2);
+					convert(r * 2, nullptr);
+					if (r * 2 + 1 < height) {
+						UnpackBytes(src + (size_t)(r * 2 + 1) * sourcePitch, yl, width, bSSE2);
+						convert(r * 2 + 1, nullptr);
+					}
+					break;
+				case SPOUT_YUV_AYUV:
+					UnpackAYUV(s, yl, u, v, a, width, bSSE2);
+					convert(r, a);
+					break;
+				default:
+					break;
+			}
+		}
+	};
 
-	// Start of buffers
-	auto rgba = static_cast<const unsigned char *>(rgba_source); // RGBA
-	auto bgr = static_cast<unsigned char *>(bgr_dest); // BGR
-	if (bInvert) {
-		bgr += bgrsize; // end of rgb buffer
-		bgr -= bgrpitch; // beginning of the last bgr line
-	}
+	if (!(UseThreads((size_t)destPitch * height, height) && m_pPool->Run(nRows, lines)))
+		lines(0, nRows);
 
-	for (unsigned int y = 0; y < height; y++) {
-		for (unsigned int x = 0; x < width; x++) {
-			// rgba source - bgr dest
-			*(bgr + 0) = *(rgba + 2); // blu
-			*(bgr + 1) = *(rgba + 1); // grn
-			*(bgr + 2) = *(rgba + 0); // red
-			bgr += 3;
-			rgba += 4;
-		}
-		if (bInvert)
-			bgr -= bgrpitch * 2; // move up a line for invert
+	return true;
+}
+
+//
+// Image hash
+//
+// Each line is hashed in stripes of 64 bytes by eight 64 bit accumulators
+// in the same way as XXH3. A lane adds the product of the low and high
+// halves of the data mixed with a key, and its neighbour adds the data.
+// The accumulators are scrambled after every 8 stripes and merged with a
+// 128 bit multiply. The line hashes are combined in order, so the result
+// does not depend on how the lines are divided between threads.
+// The SIMD and scalar functions use only integer operations and give the same result.
+//
+
+static const uint64_t HashPrime64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t HashPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t HashPrime64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t HashPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t HashPrime64_5 = 0x27D4EB2F165667C5ULL;
+static const uint32_t HashPrime32_1 = 0x9E3779B1U;
+
+// Keys of stripe s start at entry s of the first 15
+// and the last 8 are for the scramble
+static const uint64_t HashSecret[16] = {
+	0xE01197400D4246AFULL, 0x3F585B5F35BA9235ULL, 0x547C5277D23D9E2EULL, 0xA056E7D02F269120ULL,
+	0x2DCF91E0A2A461C4ULL, 0x8DDD343CAC56E3ADULL, 0x080064B03812A00BULL, 0x7CA2A73E50491178ULL,
+	0x13512AE6953BFEB5ULL, 0xF1772A8EC549A55BULL, 0x3C311B6ED0691F0EULL, 0x4A4999C2F37F190EULL,
+	0x5BF5469C2A986899ULL, 0x23D8A388ABA49815ULL, 0x2E2D54F211D34AD0ULL, 0x357E8298B2A0D39DULL,
+};
+
+static const unsigned int HashStripe = 64; // bytes
+static const unsigned int HashBlock = 8; // stripes between scrambles
+
+static void HashStripeScalar(uint64_t* acc, const unsigned char* data, const uint64_t* key)
+{
+	for (unsigned int i = 0; i < 8; i++) {
+		uint64_t v;
+		memcpy(&v, data + i * 8, 8);
+		const uint64_t k = v ^ key[i];
+		acc[i ^ 1] += v;
+		acc[i] += (k & 0xFFFFFFFFULL) * (k >> 32);
 	}
+}
 
-} // end rgba2bgr
+static void HashScrambleScalar(uint64_t* acc)
+{
+	for (unsigned int i = 0; i < 8; i++)
+		acc[i] = (acc[i] ^ (acc[i] >> 47) ^ HashSecret[8 + i]) * HashPrime32_1;
+}
 
+static void HashStripesScalar(uint64_t* acc, const unsigned char* data, size_t stripes, size_t first)
+{
+	for (size_t s = 0; s < stripes; s++) {
+		const size_t n = (first + s) % HashBlock;
+		HashStripeScalar(acc, data + s * HashStripe, HashSecret + n);
+		if (n == HashBlock - 1)
+			HashScrambleScalar(acc);
+	}
+}
 
-void spoutCopy::rgba2bgr(const void *rgba_source, void *bgr_dest,
-	unsigned int width, unsigned int height,
-	unsigned int rgba_pitch, bool bInvert) const
+static inline __m128i HashLaneSSE2(__m128i acc, __m128i v, __m128i key)
 {
-	// RGB dest does not have padding
-	const unsigned long rgbsize = width * height * 3;
-	const unsigned long rgbpitch = width * 3;
-	const unsigned long rgba_padding = rgba_pitch - (width * 4);
+	const __m128i k = _mm_xor_si128(v, key);
+	const __m128i product = _mm_mul_epu32(k, _mm_srli_epi64(k, 32));
+	// Data to the other lane of each pair
+	const __m128i swap = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+	return _mm_add_epi64(acc, _mm_add_epi64(swap, product));
+}
 
-	// RGBA source may have padding 
-	// Dest and source must be the same dimensions otherwise
+static inline __m128i HashScrambleSSE2(__m128i acc, __m128i key)
+{
+	const __m128i prime = _mm_set1_epi32((int)HashPrime32_1);
+	const __m128i a = _mm_xor_si128(_mm_xor_si128(acc, _mm_srli_epi64(acc, 47)), key);
+	// 64 x 32 bit multiply from the low and high halves
+	const __m128i lo = _mm_mul_epu32(a, prime);
+	const __m128i hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+	return _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+}
 
-	// Start of buffers
-	auto rgba = static_cast<const unsigned char *>(rgba_source); // rgba/bgra
-	auto bgr = static_cast<unsigned char *>(bgr_dest); // rgb/bgr
-	if (bInvert) {
-		bgr += rgbsize; // end of rgb buffer
-		bgr -= rgbpitch; // beginning of the last rgb line
+static void HashStripesSSE2(uint64_t* acc, const unsigned char* data, size_t stripes, size_t first)
+{
+	__m128i a[4];
+	for (unsigned int j = 0; j < 4; j++)
+		a[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(acc + j * 2));
+	for (size_t s = 0; s < stripes; s++) {
+		const size_t n = (first + s) % HashBlock;
+		const unsigned char* p = data + s * HashStripe;
+		for (unsigned int j = 0; j < 4; j++)
+			a[j] = HashLaneSSE2(a[j], _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + j * 16)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i *>(HashSecret + n + j * 2)));
+		if (n == HashBlock - 1) {
+			for (unsigned int j = 0; j < 4; j++)
+				a[j] = HashScrambleSSE2(a[j], _mm_loadu_si128(reinterpret_cast<const __m128i *>(HashSecret + 8 + j * 2)));
+		}
 	}
+	for (unsigned int j = 0; j < 4; j++)
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(acc + j * 2), a[j]);
+}
 
-	for (unsigned int y = 0; y < height; y++) {
-		for (unsigned int x = 0; x < width; x++) {
-			*(bgr + 2) = *(rgba + 0); // red
-			*(bgr + 1) = *(rgba + 1); // grn
-			*(bgr + 0) = *(rgba + 2); // blu
-			bgr += 3;
-			rgba += 4;
+SPOUT_TARGET_AVX2
+static void HashStripesAVX2(uint64_t* acc, const unsigned char* data, size_t stripes, size_t first)
+{
+	const __m256i prime = _mm256_set1_epi32((int)HashPrime32_1);
+	__m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(acc));
+	__m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(acc + 4));
+	for (size_t s = 0; s < stripes; s++) {
+		const size_t n = (first + s) % HashBlock;
+		const unsigned char* p = data + s * HashStripe;
+		const __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		const __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+		const __m256i k0 = _mm256_xor_si256(v0, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(HashSecret + n)));
+		const __m256i k1 = _mm256_xor_si256(v1, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(HashSecret + n + 4)));
+		a0 = _mm256_add_epi64(a0, _mm256_add_epi64(_mm256_shuffle_epi32(v0, _MM_SHUFFLE(1, 0, 3, 2)),
+			_mm256_mul_epu32(k0, _mm256_srli_epi64(k0, 32))));
+		a1 = _mm256_add_epi64(a1, _mm256_add_epi64(_mm256_shuffle_epi32(v1, _MM_SHUFFLE(1, 0, 3, 2)),
+			_mm256_mul_epu32(k1, _mm256_srli_epi64(k1, 32))));
+		if (n == HashBlock - 1) {
+			__m256i x0 = _mm256_xor_si256(_mm256_xor_si256(a0, _mm256_srli_epi64(a0, 47)),
+				_mm256_loadu_si256(reinterpret_cast<const __m256i *>(HashSecret + 8)));
+			__m256i x1 = _mm256_xor_si256(_mm256_xor_si256(a1, _mm256_srli_epi64(a1, 47)),
+				_mm256_loadu_si256(reinterpret_cast<const __m256i *>(HashSecret + 12)));
+			a0 = _mm256_add_epi64(_mm256_mul_epu32(x0, prime),
+				_mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x0, 32), prime), 32));
+			a1 = _mm256_add_epi64(_mm256_mul_epu32(x1, prime),
+				_mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x1, 32), prime), 32));
 		}
-		rgba += rgba_padding;
-
-		if (bInvert)
-			bgr -= rgbpitch * 2; // move up a line for invert
 	}
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(acc), a0);
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(acc + 4), a1);
+}
 
-} // end rgba2bgr
-
+// Low and high 64 bits of a 128 bit product, folded together
+static uint64_t HashFold64(uint64_t a, uint64_t b)
+{
+	const uint64_t lolo = (a & 0xFFFFFFFFULL) * (b & 0xFFFFFFFFULL);
+	const uint64_t hilo = (a >> 32) * (b & 0xFFFFFFFFULL);
+	const uint64_t lohi = (a & 0xFFFFFFFFULL) * (b >> 32);
+	const uint64_t hihi = (a >> 32) * (b >> 32);
+	const uint64_t cross = (lolo >> 32) + (hilo & 0xFFFFFFFFULL) + lohi;
+	const uint64_t upper = (hilo >> 32) + (cross >> 32) + hihi;
+	const uint64_t lower = (cross << 32) | (lolo & 0xFFFFFFFFULL);
+	return lower ^ upper;
+}
 
-void spoutCopy::bgra2rgb(const void *bgra_source, void *rgb_dest, unsigned int width, unsigned int height, bool bInvert) const
+static uint64_t HashAvalanche(uint64_t h)
 {
-	const unsigned long rgbsize = width * height * 3;
-	const unsigned long rgbpitch = width * 3;
+	h ^= h >> 37;
+	h *= 0x165667919E3779F9ULL;
+	h ^= h >> 32;
+	return h;
+}
 
-	// Start of buffers
-	auto bgra = static_cast<const unsigned char *>(bgra_source); // BGRA
-	auto rgb = static_cast<unsigned char *>(rgb_dest); // RGB
-	if (bInvert) {
-		rgb += rgbsize; // end of rgb buffer
-		rgb -= rgbpitch; // beginning of the last rgb line
+static uint64_t HashLine(const unsigned char* data, size_t length, SpoutSIMD simd)
+{
+	uint64_t acc[8] = {
+		HashPrime32_1, HashPrime64_1, HashPrime64_2, HashPrime64_3,
+		HashPrime64_4, HashPrime32_1 ^ HashPrime64_2, HashPrime64_2 >> 1, HashPrime64_5,
+	};
+
+	// Whole stripes and the remainder padded with zero
+	const size_t stripes = length / HashStripe;
+	const size_t remainder = length % HashStripe;
+	unsigned char last[HashStripe] = {};
+	if (remainder)
+		memcpy(last, data + stripes * HashStripe, remainder);
+
+	if (simd >= SPOUT_SIMD_AVX2) {
+		HashStripesAVX2(acc, data, stripes, 0);
+		if (remainder) HashStripesAVX2(acc, last, 1, stripes);
 	}
-
-	for (unsigned int y = 0; y < height; y++) {
-		for (unsigned int x = 0; x < width; x++) {
-			// bgra source - rgb dest
-			*(rgb + 0) = *(bgra + 2); // red
-			*(rgb + 1) = *(bgra + 1); // grn
-			*(rgb + 2) = *(bgra + 0); // blu
-			rgb += 3;
-			bgra += 4;
-		}
-		if (bInvert)
-			rgb -= rgbpitch * 2; // move up a line for invert
+	else if (simd >= SPOUT_SIMD_SSE2) {
+		HashStripesSSE2(acc, data, stripes, 0);
+		if (remainder) HashStripesSSE2(acc, last, 1, stripes);
+	}
+	else {
+		HashStripesScalar(acc, data, stripes, 0);
+		if (remainder) HashStripesScalar(acc, last, 1, stripes);
 	}
 
-} // end bgra2rgb
-
+	uint64_t h = (uint64_t)length * HashPrime64_1;
+	for (unsigned int i = 0; i < 8; i += 2)
+		h += HashFold64(acc[i] ^ HashSecret[i + 1], acc[i + 1] ^ HashSecret[i + 2]);
+	return HashAvalanche(h);
+}
 
-void spoutCopy::bgra2bgr(const void *bgra_source, void *bgr_dest, unsigned int width, unsigned int height, bool bInvert) const
+uint64_t spoutCopy::HashImage(const void* source, unsigned int width, unsigned int height,
+	unsigned int pixelBytes, unsigned int sourcePitch) const
 {
-	const unsigned long bgrsize = width * height * 3;
-	const unsigned long bgrpitch = width * 3;
+	if (!source || width == 0 || height == 0 || pixelBytes == 0)
+		return 0;
 
-	// Start of buffers
-	auto bgra = static_cast<const unsigned char *>(bgra_source); // BGRA
-	auto bgr = static_cast<unsigned char *>(bgr_dest); // BGR
-	if (bInvert) {
-		bgr += bgrsize; // end of bgr buffer
-		bgr -= bgrpitch; // beginning of the last bgr line
-	}
+	const size_t lineBytes = (size_t)width * pixelBytes;
+	if (sourcePitch == 0) sourcePitch = (unsigned int)lineBytes;
+
+	auto src = static_cast<const unsigned char *>(source);
+	std::vector<uint64_t> lineHash(height);
+	const SpoutSIMD simd = m_SIMD;
+	const std::function<void(unsigned int, unsigned int)> lines = [&](unsigned int y0, unsigned int y1) {
+		for (unsigned int y = y0; y < y1; y++)
+			lineHash[y] = HashLine(src + (size_t)y * sourcePitch, lineBytes, simd);
+	};
 
+	if (!(UseThreads(lineBytes * height, height) && m_pPool->Run(height, lines)))
+		lines(0, height);
+
+	// Combine the lines in order
+	uint64_t h = HashPrime64_5 ^ ((uint64_t)lineBytes * HashPrime64_2);
 	for (unsigned int y = 0; y < height; y++) {
-		for (unsigned int x = 0; x < width; x++) {
-			// bgra source - bgr dest
-			*(bgr + 2) = *(bgra + 2); // red
-			*(bgr + 1) = *(bgra + 1); // grn
-			*(bgr + 0) = *(bgra + 0); // blu
-			bgr += 3;
-			bgra += 4;
-		}
-		if (bInvert)
-			bgr -= bgrpitch * 2; // move up a line for invert
+		h ^= lineHash[y];
+		h *= HashPrime64_1;
+		h ^= h >> 29;
 	}
-} // end bgra2bgr
+	h ^= (uint64_t)height * HashPrime64_3;
+	return HashAvalanche(h);
+}
 
+//
+// Dirty tiles
+//
+// Each row of tiles is compared line by line, so that the lines of both
+// images are read in order. A tile is skipped on the remaining lines
+// once it is known to differ. Each row of tiles has its own bytes of
+// the map so that the rows can be divided between threads.
+//
 
-void spoutCopy::rgba2rgba(const void* rgba_source, void* rgba_dest,
-	unsigned int width, unsigned int height, unsigned int sourcePitch, bool bInvert) const
+static bool EqualBytesScalar(const unsigned char* a, const unsigned char* b, size_t size)
 {
-	for (unsigned int y = 0; y < height; y++) {
-		// Start of buffer
-		auto source = static_cast<const unsigned __int32 *>(rgba_source); // unsigned int = 4 bytes
-		auto dest   = static_cast<unsigned __int32 *>(rgba_dest);
-		// Increment to current line
-		// pitch is line length in bytes. Divide by 4 to get the width in rgba pixels.
-		if (bInvert) {
-			source += (unsigned long)((height - 1 - y)*sourcePitch/4);
-			dest   += (unsigned long)(y * width); // dest is not inverted
-		}
-		else {
-			source += (unsigned long)(y * sourcePitch/4);
-			dest   += (unsigned long)(y * width);
-		}
-		// Copy the line as fast as possible
-		CopyPixels((const unsigned char *)source, (unsigned char *)dest, width, 1);
-	}
+	return memcmp(a, b, size) == 0;
 }
 
-void spoutCopy::rgba2rgba(const void* rgba_source, void* rgba_dest,
-	unsigned int width, unsigned int height,
-	unsigned int sourcePitch, unsigned int destPitch, bool bInvert) const
+static bool EqualBytesSSE2(const unsigned char* a, const unsigned char* b, size_t size)
 {
-	// For all rows
-	for (unsigned int y = 0; y < height; y++) {
-		// Start of buffers
-		auto source = static_cast<const unsigned __int32 *>(rgba_source); // unsigned int = 4 bytes
-		auto dest   = static_cast<unsigned __int32 *>(rgba_dest);
-		// Increment to current line
-		// Pitch is line length in bytes. Divide by 4 to get the width in rgba pixels.
-		if (bInvert) {
-			source += (unsigned long)((height - 1 - y)*sourcePitch / 4);
-			dest   += (unsigned long)(y * destPitch / 4); // dest is not inverted
-		}
-		else {
-			source += (unsigned long)(y * sourcePitch / 4);
-			dest   += (unsigned long)(y * destPitch / 4);
-		}
-		// Copy the line as fast as possible
-		CopyPixels((const unsigned char *)source, (unsigned char *)dest, width, 1);
+	size_t i = 0;
+	for (; i + 64 <= size; i += 64) {
+		__m128i d = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+		for (size_t j = 16; j < 64; j += 16)
+			d = _mm_or_si128(d, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i + j)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + j))));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(d, _mm_setzero_si128())) != 0xFFFF)
+			return false;
 	}
+	return memcmp(a + i, b + i, size - i) == 0;
 }
 
-// Adapted from :
-// http://tech-algorithm.com/articles/nearest-neighbor-image-scaling/
-// http://www.cplusplus.com/forum/general/2615/#msg10482
-void spoutCopy::rgba2rgbaResample(const void* source, void* dest,
-	unsigned int sourceWidth, unsigned int sourceHeight, unsigned int sourcePitch,
-	unsigned int destWidth, unsigned int destHeight, bool bInvert) const
+SPOUT_TARGET_AVX2
+static bool EqualBytesAVX2(const unsigned char* a, const unsigned char* b, size_t size)
 {
-	unsigned char *srcBuffer = (unsigned char *)source; // bgra source
-	unsigned char *dstBuffer = (unsigned char *)dest; // bgr dest
-
-	// horizontal and vertical ratios between the original image and the to be scaled image
-	float x_ratio = (float)sourceWidth / (float)destWidth;
-	float y_ratio = (float)sourceHeight / (float)destHeight;
-	float px, py;
-	unsigned int i, j;
-	unsigned int pixel, nearestMatch;
-	for (i = 0; i < destHeight; i++) {
-		for (j = 0; j < destWidth; j++) {
-			px = floor((float)j*x_ratio);
-			py = floor((float)i*y_ratio);
-			if (bInvert)
-				pixel = (destHeight - i - 1)*destWidth * 4 + j * 4; // flip vertically
-			else
-				pixel = i * destWidth * 4 + j * 4;
-			nearestMatch = (unsigned int)(py*sourcePitch + px * 4);
-			dstBuffer[pixel + 0] = srcBuffer[nearestMatch + 0];
-			dstBuffer[pixel + 1] = srcBuffer[nearestMatch + 1];
-			dstBuffer[pixel + 2] = srcBuffer[nearestMatch + 2];
-			dstBuffer[pixel + 3] = srcBuffer[nearestMatch + 3];
-		}
+	size_t i = 0;
+	for (; i + 128 <= size; i += 128) {
+		__m256i d = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i)),
+			_mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i)));
+		for (size_t j = 32; j < 128; j += 32)
+			d = _mm256_or_si256(d, _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i + j)),
+				_mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i + j))));
+		if (!_mm256_testz_si256(d, d))
+			return false;
 	}
+	return EqualBytesSSE2(a + i, b + i, size - i);
 }
 
-
-void spoutCopy::rgba2rgbResample(const void* source, void* dest,
-	unsigned int sourceWidth, unsigned int sourceHeight, unsigned int sourcePitch,
-	unsigned int destWidth, unsigned int destHeight, bool bInvert, bool bMirror, bool bSwapRB) const
+size_t spoutCopy::TileMapSize(unsigned int width, unsigned int height, unsigned int tileSize)
 {
-	unsigned char *srcBuffer = (unsigned char *)source; // bgra source
-	unsigned char *dstBuffer = (unsigned char *)dest; // bgr dest
-
-	float x_ratio = (float)sourceWidth / (float)destWidth;
-	float y_ratio = (float)sourceHeight / (float)destHeight;
+	if (tileSize == 0)
+		return 0;
+	const size_t tilesX = (width + tileSize - 1) / tileSize;
+	const size_t tilesY = (height + tileSize - 1) / tileSize;
+	return ((tilesX + 7) / 8) * tilesY;
+}
 
-	// Swap red and blue option
-	int ir = 0; int ig = 1; int ib = 2;
-	if (bSwapRB) {
-		ir = 2; ib = 0;
+unsigned int spoutCopy::DiffTiles(const void* previous, const void* current,
+	unsigned int width, unsigned int height, unsigned int pixelBytes,
+	unsigned char* tileMap, unsigned int tileSize,
+	unsigned int previousPitch, unsigned int currentPitch,
+	SpoutTileStats* stats) const
+{
+	if (stats)
+		*stats = SpoutTileStats{};
+
+	if (!previous || !current || !tileMap || width == 0 || height == 0 || pixelBytes == 0 || tileSize == 0)
+		return 0;
+
+	if (previousPitch == 0) previousPitch = width * pixelBytes;
+	if (currentPitch == 0) currentPitch = width * pixelBytes;
+
+	const unsigned int tilesX = (width + tileSize - 1) / tileSize;
+	const unsigned int tilesY = (height + tileSize - 1) / tileSize;
+	const size_t mapPitch = (tilesX + 7) / 8;
+	memset(tileMap, 0, mapPitch * tilesY);
+
+	auto prev = static_cast<const unsigned char *>(previous);
+	auto curr = static_cast<const unsigned char *>(current);
+	const size_t tileBytes = (size_t)tileSize * pixelBytes;
+	const size_t lineBytes = (size_t)width * pixelBytes;
+
+	bool (*equal)(const unsigned char*, const unsigned char*, size_t) = EqualBytesScalar;
+	if (m_SIMD >= SPOUT_SIMD_AVX2)
+		equal = EqualBytesAVX2;
+	else if (m_SIMD >= SPOUT_SIMD_SSE2)
+		equal = EqualBytesSSE2;
+
+	// Tiles that differ in each row of tiles
+	std::vector<unsigned int> dirtyRow(tilesY, 0);
+
+	const std::function<void(unsigned int, unsigned int)> rows = [&](unsigned int ty0, unsigned int ty1) {
+		for (unsigned int ty = ty0; ty < ty1; ty++) {
+			unsigned char* map = tileMap + ty * mapPitch;
+			const unsigned int y0 = ty * tileSize;
+			const unsigned int y1 = std::min(y0 + tileSize, height);
+			unsigned int dirty = 0;
+			for (unsigned int y = y0; y < y1 && dirty < tilesX; y++) {
+				const unsigned char* p = prev + (size_t)y * previousPitch;
+				const unsigned char* c = curr + (size_t)y * currentPitch;
+				for (unsigned int tx = 0; tx < tilesX; tx++) {
+					if (map[tx / 8] & (1 << (tx % 8)))
+						continue;
+					const size_t offset = (size_t)tx * tileBytes;
+					const size_t size = std::min(tileBytes, lineBytes - offset);
+					if (!equal(p + offset, c + offset, size)) {
+						map[tx / 8] |= (unsigned char)(1 << (tx % 8));
+						dirty++;
+					}
+				}
+			}
+			dirtyRow[ty] = dirty;
+		}
+	};
+
+	if (!(UseThreads(lineBytes * height, tilesY) && m_pPool->Run(tilesY, rows)))
+		rows(0, tilesY);
+
+	unsigned int dirtyTiles = 0;
+	for (unsigned int ty = 0; ty < tilesY; ty++)
+		dirtyTiles += dirtyRow[ty];
+
+	if (stats) {
+		// Area of the tiles that differ, allowing for the smaller edge tiles
+		double area = 0.0;
+		for (unsigned int ty = 0; ty < tilesY && dirtyTiles > 0; ty++) {
+			const unsigned char* map = tileMap + ty * mapPitch;
+			const unsigned int th = std::min(tileSize, height - ty * tileSize);
+			for (unsigned int tx = 0; tx < tilesX; tx++) {
+				if (map[tx / 8] & (1 << (tx % 8)))
+					area += (double)std::min(tileSize, width - tx * tileSize) * th;
+			}
+		}
+		stats->tiles = tilesX * tilesY;
+		stats->dirtyTiles = dirtyTiles;
+		stats->dirtyArea = area / ((double)width * height);
 	}
 
-	float px, py;
-	unsigned int i, j;
-	unsigned int pixel, nearestMatch;
-	for (i = 0; i < destHeight; i++) {
-		for (j = 0; j < destWidth; j++) {
-			px = floor((float)j*x_ratio);
-			py = floor((float)i*y_ratio);
+	return dirtyTiles;
+}
 
-			if (bMirror) {
-				if (bInvert)
-					pixel = (destHeight - i - 1)*destWidth * 3 + (destWidth - j - 1) * 3; // flip vertically
-				else
-					pixel = i * destWidth * 3 + (destWidth - j - 1) * 3;
-			}
-			else {
-				if (bInvert)
-					pixel = (destHeight - i - 1)*destWidth * 3 + j * 3; // flip vertically
-				else
-					pixel = i * destWidth * 3 + j * 3;
+bool spoutCopy::CopyTiles(const void* source, void* dest,
+	unsigned int width, unsigned int height, unsigned int pixelBytes,
+	const unsigned char* tileMap, unsigned int tileSize,
+	unsigned int sourcePitch, unsigned int destPitch) const
+{
+	if (!source || !dest || !tileMap || width == 0 || height == 0 || pixelBytes == 0 || tileSize == 0)
+		return false;
+
+	if (sourcePitch == 0) sourcePitch = width * pixelBytes;
+	if (destPitch == 0) destPitch = width * pixelBytes;
+
+	const unsigned int tilesX = (width + tileSize - 1) / tileSize;
+	const unsigned int tilesY = (height + tileSize - 1) / tileSize;
+	const size_t mapPitch = (tilesX + 7) / 8;
+
+	auto src = static_cast<const unsigned char *>(source);
+	auto dst = static_cast<unsigned char *>(dest);
+	const size_t lineBytes = (size_t)width * pixelBytes;
+
+	const std::function<void(unsigned int, unsigned int)> rows = [&](unsigned int ty0, unsigned int ty1) {
+		for (unsigned int ty = ty0; ty < ty1; ty++) {
+			const unsigned char* map = tileMap + ty * mapPitch;
+			const unsigned int y0 = ty * tileSize;
+			const unsigned int y1 = std::min(y0 + tileSize, height);
+			unsigned int tx = 0;
+			while (tx < tilesX) {
+				if (!(map[tx / 8] & (1 << (tx % 8)))) {
+					tx++;
+					continue;
+				}
+				// Adjacent tiles to copy together
+				unsigned int end = tx + 1;
+				while (end < tilesX && (map[end / 8] & (1 << (end % 8))))
+					end++;
+				const size_t offset = (size_t)tx * tileSize * pixelBytes;
+				const size_t size = std::min((size_t)end * tileSize * pixelBytes, lineBytes) - offset;
+				for (unsigned int y = y0; y < y1; y++)
+					memcpy(dst + (size_t)y * destPitch + offset, src + (size_t)y * sourcePitch + offset, size);
+				tx = end;
 			}
+		}
+	};
+
+	if (!(UseThreads(lineBytes * height, tilesY) && m_pPool->Run(tilesY, rows)))
+		rows(0, tilesY);
+
+	return true;
+}
+
+//
+// Mip pyramid
+//
+// Level 1 lines are made from pairs of source lines. When a line of a level
+// completes a pair, the line of the level below is made from it and the
+// line before, which are both still in the cache. The source is read once
+// and each level is written in order. A band of 2^(levels - 1) lines of
+// level 1 makes whole lines of every level, so bands are independent and
+// are divided between threads.
+//
+// Sums of four 8 bit values are made with 16 bit lanes, so the average is
+// rounded once and SSE2, AVX2 and scalar give the same result.
+//
 
-			nearestMatch = (unsigned int)(py*sourcePitch + px * 4);
+// Average 2x2 pixels of two lines from the first destination pixel
+static void MipLineScalar(const unsigned char* line0, const unsigned char* line1,
+	unsigned int parentWidth, unsigned char* dst, unsigned int width, unsigned int first = 0)
+{
+	for (unsigned int x = first; x < width; x++) {
+		const unsigned int a = 2 * x * 4;
+		const unsigned int b = std::min(2 * x + 1, parentWidth - 1) * 4;
+		for (unsigned int c = 0; c < 4; c++)
+			dst[x * 4 + c] = (unsigned char)((line0[a + c] + line0[b + c] + line1[a + c] + line1[b + c] + 2) >> 2);
+	}
+}
 
-			dstBuffer[pixel + ir] = srcBuffer[nearestMatch + 0];
-			dstBuffer[pixel + ig] = srcBuffer[nearestMatch + 1];
-			dstBuffer[pixel + ib] = srcBuffer[nearestMatch + 2];
+// Two destination pixels at a time
+static void MipLineSSE2(const unsigned char* line0, const unsigned char* line1,
+	unsigned int parentWidth, unsigned char* dst, unsigned int width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i two = _mm_set1_epi16(2);
+	unsigned int x = 0;
+	if (parentWidth >= 2) {
+		for (; x + 2 <= width; x += 2) {
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(line0 + x * 8));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(line1 + x * 8));
+			// Vertical sums of source pixels 0-1 and 2-3
+			const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+			const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+			// Horizontal sums in the low half of each
+			const __m128i p0 = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+			const __m128i p1 = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+			const __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(p0, p1), two), 2);
+			_mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x * 4), _mm_packus_epi16(sum, sum));
 		}
 	}
+	MipLineScalar(line0, line1, parentWidth, dst, width, x);
 }
 
-void spoutCopy::rgba2bgrResample(const void* source, void* dest,
-	unsigned int sourceWidth, unsigned int sourceHeight, unsigned int sourcePitch,
-	unsigned int destWidth, unsigned int destHeight, bool bInvert) const
+// Four destination pixels at a time
+SPOUT_TARGET_AVX2
+static void MipLineAVX2(const unsigned char* line0, const unsigned char* line1,
+	unsigned int parentWidth, unsigned char* dst, unsigned int width)
 {
-	unsigned char *srcBuffer = (unsigned char *)source; // bgra source
-	unsigned char *dstBuffer = (unsigned char *)dest; // bgr dest
-
-	float x_ratio = (float)sourceWidth / (float)destWidth;
-	float y_ratio = (float)sourceHeight / (float)destHeight;
-	float px, py;
-	unsigned int i, j;
-	unsigned int pixel, nearestMatch;
-	for (i = 0; i < destHeight; i++) {
-		for (j = 0; j < destWidth; j++) {
-			px = std::floor((float)j*x_ratio);
-			py = std::floor((float)i*y_ratio);
-			if (bInvert)
-				pixel = (destHeight - i - 1)*destWidth * 3 + j * 3; // flip vertically
-			else
-				pixel = i * destWidth * 3 + j * 3;
-			nearestMatch = (unsigned int)(py*sourcePitch + px * 4);
-			dstBuffer[pixel + 2] = srcBuffer[nearestMatch + 0];
-			dstBuffer[pixel + 1] = srcBuffer[nearestMatch + 1];
-			dstBuffer[pixel + 0] = srcBuffer[nearestMatch + 2];
+	const __m256i two = _mm256_set1_epi16(2);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 0, 4, 1, 5);
+	unsigned int x = 0;
+	if (parentWidth >= 2) {
+		for (; x + 4 <= width; x += 4) {
+			const unsigned char* s0 = line0 + x * 8;
+			const unsigned char* s1 = line1 + x * 8;
+			// Vertical sums of source pixels 0-3 and 4-7, two pixels in each lane
+			const __m256i lo = _mm256_add_epi16(
+				_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s0))),
+				_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s1))));
+			const __m256i hi = _mm256_add_epi16(
+				_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s0 + 16))),
+				_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s1 + 16))));
+			// Horizontal sums in the low half of each lane, pixels 0, 1 and 2, 3
+			const __m256i p0 = _mm256_add_epi16(lo, _mm256_srli_si256(lo, 8));
+			const __m256i p1 = _mm256_add_epi16(hi, _mm256_srli_si256(hi, 8));
+			// Lanes of pixels 0, 2 and 1, 3
+			const __m256i sum = _mm256_srli_epi16(_mm256_add_epi16(_mm256_unpacklo_epi64(p0, p1), two), 2);
+			const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(sum, sum), order);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), _mm256_castsi256_si128(packed));
 		}
 	}
+	MipLineSSE2(line0 + x * 8, line1 + x * 8, parentWidth - x * 2, dst + x * 4, width - x);
+}
+
+unsigned int spoutCopy::MipLevels(unsigned int width, unsigned int height)
+{
+	unsigned int levels = 0;
+	while (width > 1 || height > 1) {
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+		levels++;
+	}
+	return levels;
+}
+
+size_t spoutCopy::MipOffset(unsigned int width, unsigned int height, unsigned int level,
+	unsigned int* levelWidth, unsigned int* levelHeight)
+{
+	size_t offset = 0;
+	for (unsigned int i = 1; i <= level; i++) {
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+		if (i < level)
+			offset += (size_t)width * height * 4;
+	}
+	if (levelWidth) *levelWidth = width;
+	if (levelHeight) *levelHeight = height;
+	return offset;
 }
 
+unsigned int spoutCopy::MipPyramid(const void* source, void* dest, unsigned int width, unsigned int height,
+	unsigned int levels, unsigned int sourcePitch) const
+{
+	if (!source || !dest || width == 0 || height == 0 || levels == 0)
+		return 0;
+
+	levels = std::min(levels, MipLevels(width, height));
+	if (levels == 0)
+		return 0;
+
+	if (sourcePitch == 0) sourcePitch = width * 4;
+
+	// Level 0 is the source
+	struct Level {
+		unsigned char* data;
+		unsigned int width;
+		unsigned int height;
+		size_t pitch;
+	};
+	std::vector<Level> level(levels + 1);
+	level[0] = { const_cast<unsigned char *>(static_cast<const unsigned char *>(source)), width, height, sourcePitch };
+	for (unsigned int k = 1; k <= levels; k++) {
+		Level& l = level[k];
+		l.data = static_cast<unsigned char *>(dest) + MipOffset(width, height, k, &l.width, &l.height);
+		l.pitch = (size_t)l.width * 4;
+	}
+
+	void (*line)(const unsigned char*, const unsigned char*, unsigned int, unsigned char*, unsigned int) = nullptr;
+	if (m_SIMD >= SPOUT_SIMD_AVX2)
+		line = MipLineAVX2;
+	else if (m_SIMD >= SPOUT_SIMD_SSE2)
+		line = MipLineSSE2;
+
+	// Make line y of level k, then the line below it if this completes the pair
+	std::function<void(unsigned int, unsigned int)> make = [&](unsigned int k, unsigned int y) {
+		const Level& parent = level[k - 1];
+		const Level& l = level[k];
+		const unsigned char* line0 = parent.data + (size_t)(2 * y) * parent.pitch;
+		const unsigned char* line1 = parent.data + (size_t)std::min(2 * y + 1, parent.height - 1) * parent.pitch;
+		unsigned char* dst = l.data + (size_t)y * l.pitch;
+		if (line)
+			line(line0, line1, parent.width, dst, l.width);
+		else
+			MipLineScalar(line0, line1, parent.width, dst, l.width);
+		if (k < levels && y / 2 < level[k + 1].height && y == std::min(y / 2 * 2 + 1, l.height - 1))
+			make(k + 1, y / 2);
+	};
+
+	// Bands of level 1 lines
+	const unsigned int band = 1u << (levels - 1);
+	const unsigned int bands = (level[1].height + band - 1) / band;
+	const std::function<void(unsigned int, unsigned int)> rows = [&](unsigned int b0, unsigned int b1) {
+		const unsigned int y1 = std::min(b1 * band, level[1].height);
+		for (unsigned int y = b0 * band; y < y1; y++)
+			make(1, y);
+	};
+
+	if (!(UseThreads((size_t)width * height * 4, bands) && m_pPool->Run(bands, rows)))
+		rows(0, bands);
+
+	return levels;
+}
@@ -33,14 +33,130 @@
 #ifndef __spoutCopy__ // standard way as well
 #define __spoutCopy__
 
+#if defined(_WIN32)
 #include "SpoutCommon.h"
 #include <windows.h>
 #include <stdio.h> // for debug printf
 #include <gl/gl.h> // For OpenGL definitions
 #include <intrin.h> // for cpuid to test for SSE2
+#else
+// spoutCopy alone for benchmark and test tools on other platforms
+#include <stdio.h>
+#include <stddef.h>
+#ifndef SPOUT_DLLEXP
+#define SPOUT_DLLEXP
+#endif
+#ifndef GL_RGBA
+typedef unsigned int GLenum;
+#define GL_RGB       0x1907
+#define GL_RGBA      0x1908
+#define GL_LUMINANCE 0x1909
+#define GL_BGR_EXT   0x80E0
+#define GL_BGRA_EXT  0x80E1
+#define GL_UNSIGNED_BYTE  0x1401
+#define GL_UNSIGNED_SHORT 0x1403
+#define GL_FLOAT          0x1406
+#endif
+#endif
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT 0x140B
+#endif
 #include <emmintrin.h> // for SSE2
 #include <tmmintrin.h> // for SSSE3
+#include <immintrin.h> // for AVX2 and AVX-512
 #include <cmath> // For compatibility with Clang. PR#81
+#include <cstdint>
+
+// SIMD instruction set levels for kernel selection
+enum SpoutSIMD
+{
+	SPOUT_SIMD_AUTO = -1, // Best available
+	SPOUT_SIMD_NONE = 0,
+	SPOUT_SIMD_SSE2,
+	SPOUT_SIMD_SSSE3,
+	SPOUT_SIMD_AVX2,
+	SPOUT_SIMD_AVX512, // AVX-512F and AVX-512BW
+};
+
+// Filter for the resample functions
+enum SpoutResample
+{
+	SPOUT_RESAMPLE_AUTO = 0, // Bilinear to enlarge, area average to reduce
+	SPOUT_RESAMPLE_NEAREST,
+	SPOUT_RESAMPLE_BILINEAR,
+	SPOUT_RESAMPLE_AREA,
+	SPOUT_RESAMPLE_CATMULLROM, // Bicubic with sharp edges and little ringing
+	SPOUT_RESAMPLE_LANCZOS3, // Windowed sinc, sharpest for non-integer ratios
+};
+
+// Transfer function for color conversion
+enum SpoutTransfer
+{
+	SPOUT_TRANSFER_SRGB = 0, // sRGB (IEC 61966-2-1), default
+	SPOUT_TRANSFER_LINEAR,
+};
+
+// Color primaries for color conversion, all with D65 white
+enum SpoutGamut
+{
+	SPOUT_GAMUT_709 = 0, // Rec.709 and sRGB, default
+	SPOUT_GAMUT_2020,    // Rec.2020
+	SPOUT_GAMUT_P3,      // Display P3
+};
+
+// Alpha conversion
+enum SpoutAlpha
+{
+	SPOUT_ALPHA_NONE = 0,         // Alpha copied unchanged, default
+	SPOUT_ALPHA_PREMULTIPLY,      // Straight to premultiplied
+	SPOUT_ALPHA_UNPREMULTIPLY,    // Premultiplied to straight
+};
+
+// Dither for high bit depth to 8 bit conversion
+enum SpoutDither
+{
+	SPOUT_DITHER_NONE = 0,      // Round to nearest, default
+	SPOUT_DITHER_BAYER,         // Ordered 8x8 Bayer matrix
+	SPOUT_DITHER_BLUENOISE,     // Tiled 64x64 blue noise mask
+};
+
+// Y'CbCr formats for rgba2yuv and yuv2rgba
+enum SpoutYUV
+{
+	SPOUT_YUV_UYVY = 0, // 4:2:2 8 bit, U Y0 V Y1 bytes for each pair of pixels
+	SPOUT_YUV_V210,     // 4:2:2 10 bit, 6 pixels in 16 bytes, lines of 48 pixels in 128 bytes
+	SPOUT_YUV_NV12,     // 4:2:0 8 bit, Y plane and half height plane of U V bytes
+	SPOUT_YUV_AYUV,     // 4:4:4 8 bit, V U Y A bytes (DXGI_FORMAT_AYUV)
+};
+
+// Rectangle of an image in pixels for the region functions
+// (the same layout as FrameRegion of the disguise RenderStream API)
+struct SpoutRegion
+{
+	unsigned int x;
+	unsigned int y;
+	unsigned int width;
+	unsigned int height;
+};
+
+// Tiles that differ between two frames, from DiffTiles
+struct SpoutTileStats
+{
+	unsigned int tiles;      // Tiles of the image
+	unsigned int dirtyTiles; // Tiles that differ
+	double dirtyArea;        // Fraction of the image area in the tiles that differ, 0-1
+};
+
+// Worker threads for parallel row copy
+class spoutCopyPool;
+// Color conversion tables and matrix
+struct spoutColor;
+// Line conversion functions of a high bit depth format pair
+struct spoutLineConvert;
+// 3D colour lookup table, see SpoutLUT.h
+class spoutLUT;
+// Resample weights kept between frames
+struct spoutResampleCache;
 
 
 class SPOUT_DLLEXP spoutCopy {
@@ -49,6 +165,80 @@ class SPOUT_DLLEXP spoutCopy {
 
 		spoutCopy();
 		~spoutCopy();
+		spoutCopy(const spoutCopy&) = delete;
+		spoutCopy& operator=(const spoutCopy&) = delete;
+
+		// Select the instruction set used by the copy functions
+		//   SPOUT_SIMD_AUTO selects the best available.
+		//   A level the CPU does not support is reduced to the best available
+		//   and the function returns false.
+		bool SetSIMD(SpoutSIMD level = SPOUT_SIMD_AUTO);
+		// Instruction set in use
+		SpoutSIMD GetSIMD() const;
+		// Best instruction set supported by the CPU
+		SpoutSIMD GetMaxSIMD() const;
+
+		// Copy large images in parallel row bands
+		//   nThreads - total threads including the caller
+		//              0 - one per hardware thread, 1 - single threaded (default)
+		//   minSize  - image size in bytes below which copies remain single threaded
+		//   Applies to CopyPixels, rgba2rgba and rgba2bgra
+		void SetThreads(unsigned int nThreads, size_t minSize = 4*1024*1024);
+		// Number of threads used for a parallel copy
+		unsigned int GetThreads() const;
+
+		// Copy large images with non-temporal (streaming) stores
+		//   Stores bypass the cache so that a large copy does not evict
+		//   the working data of the application and the receiver.
+		//   minSize - image size in bytes from which streaming stores are used
+		//             Default is half the last level cache (source and destination)
+		//             0 - always stream, SIZE_MAX - never stream
+		//   Applies to CopyPixels and rgba2rgba with AVX2 or AVX-512.
+		//   The SSE2 memcpy always streams.
+		void SetStreamSize(size_t minSize);
+		size_t GetStreamSize() const;
+		// Size in bytes of the last level cache, 0 if unknown
+		size_t GetCacheSize() const;
+
+		// Filter used by rgba2rgbaResample, rgba2rgbResample and rgba2bgrResample
+		//   Filters are separable with weights calculated once for each image
+		//   SPOUT_RESAMPLE_AUTO (default) is bilinear to enlarge and area average to reduce
+		//   SPOUT_RESAMPLE_CATMULLROM and SPOUT_RESAMPLE_LANCZOS3 widen the kernel
+		//   by the ratio to reduce. Results are clamped, so ringing does not wrap.
+		//   The weights of the last image size are kept for the next frame.
+		void SetResample(SpoutResample filter);
+		SpoutResample GetResample() const;
+
+		// Color conversion by CopyImage and the high bit depth functions
+		//   Source and destination transfer function and primaries.
+		//   Pixels are converted in the same pass as the copy.
+		//   8 bit images use tables. Float uses polynomials, with AVX2 if available.
+		//   Default is sRGB with Rec.709 primaries for both, without conversion.
+		//   Alpha is not changed. Luminance is copied without conversion.
+		//   Set for each sender or receiver with its own spoutCopy object.
+		void SetColor(SpoutTransfer sourceTransfer, SpoutGamut sourceGamut,
+			SpoutTransfer destTransfer, SpoutGamut destGamut);
+		void GetColor(SpoutTransfer& sourceTransfer, SpoutGamut& sourceGamut,
+			SpoutTransfer& destTransfer, SpoutGamut& destGamut) const;
+
+		// Alpha premultiply or unpremultiply
+		//   RGBA and BGRA pixels are converted in the same pass as the copy
+		//   by CopyPixels, rgba2rgba, CopyImage (4 byte source and destination)
+		//   and the high bit depth functions. SSE2 or AVX2 are used if available.
+		//   8 bit values are rounded. Unpremultiply does not change pixels
+		//   with zero alpha. Colors are converted by SetColor without
+		//   premultiplied alpha.
+		//   Set for each sender or receiver with its own spoutCopy object.
+		void SetAlpha(SpoutAlpha mode);
+		SpoutAlpha GetAlpha() const;
+
+		// Dither for the high bit depth to 8 bit functions
+		//   float2rgba, half2rgba, ushort2rgba and rgb10a2torgba.
+		//   Red, green and blue are dithered to avoid banding of gradients.
+		//   Alpha is rounded. The pattern is fixed to the image rows and columns.
+		//   The blue noise mask is made by the first call to select it.
+		void SetDither(SpoutDither mode);
+		SpoutDither GetDither() const;
 
 		// Copy image pixels and select fastest method based on image width
 		void CopyPixels(const unsigned char *src, unsigned char *dst,
@@ -95,9 +285,8 @@ class SPOUT_DLLEXP spoutCopy {
 			unsigned int width, unsigned int height,
 			unsigned int source_stride, GLenum glFormat) const;
 
-		// RGBA<>RGB conversion options 
-		// TODO : add RGBA pitch to all functions
-		// TODO : avoid redundancy
+		// RGBA<>RGB conversion options
+		// Wrappers for CopyImage. RGB to RGBA sets alpha to 255.
 		void rgb2rgba (const void* rgb_source,  void *rgba_dest, unsigned int width, unsigned int height, bool bInvert = false) const;
 		
 		// Copy RGB to RGBA allowing for destination pitch
@@ -138,16 +327,306 @@ class SPOUT_DLLEXP spoutCopy {
 			unsigned int sourceWidth, unsigned int sourceHeight, unsigned int sourcePitch,
 			unsigned int destWidth, unsigned int destHeight, bool bInvert = false) const;
 
+		// Copy and convert an image in a single pass
+		//   Formats GL_RGBA, GL_BGRA_EXT, GL_RGB, GL_BGR_EXT and GL_LUMINANCE (to GL_LUMINANCE only)
+		//   Red and blue are swapped if the source and destination order differ
+		//   and bSwapRB swaps them again. Alpha is 255 for RGB to RGBA.
+		//   Pitch is the line length in bytes, 0 for lines without padding.
+		//   bInvert flips the image vertically and bMirror horizontally.
+		//   Returns false for an unsupported format.
+		bool CopyImage(const void* source, void* dest, unsigned int width, unsigned int height,
+			GLenum sourceFormat, GLenum destFormat,
+			unsigned int sourcePitch = 0, unsigned int destPitch = 0,
+			bool bInvert = false, bool bMirror = false, bool bSwapRB = false) const;
+
+		//
+		// Copy, convert or resample a region of an image to a region of another
+		//
+		//   Each region is clipped to its image, so that a region partly outside
+		//   the image is safe. The top left of the source region is copied to the
+		//   top left of the destination region.
+		//   Pitch is the line length in bytes, 0 for lines without padding.
+		//   bInvert flips the region vertically and bMirror horizontally.
+		//   Returns false for an unsupported format or a region outside the image.
+		//
+		// CopyRegion - formats and options as for CopyImage
+		//   The copy is the width and height of the smaller clipped region.
+		bool CopyRegion(const void* source, unsigned int sourceWidth, unsigned int sourceHeight,
+			unsigned int sourcePitch, GLenum sourceFormat, const SpoutRegion& sourceRegion,
+			void* dest, unsigned int destWidth, unsigned int destHeight,
+			unsigned int destPitch, GLenum destFormat, const SpoutRegion& destRegion,
+			bool bInvert = false, bool bMirror = false, bool bSwapRB = false) const;
+		// ResampleRegion - GL_RGBA or GL_BGRA_EXT to GL_RGBA, GL_BGRA_EXT, GL_RGB or GL_BGR_EXT
+		//   The clipped source region is scaled to the clipped destination region
+		//   with the filter selected by SetResample.
+		bool ResampleRegion(const void* source, unsigned int sourceWidth, unsigned int sourceHeight,
+			unsigned int sourcePitch, GLenum sourceFormat, const SpoutRegion& sourceRegion,
+			void* dest, unsigned int destWidth, unsigned int destHeight,
+			unsigned int destPitch, GLenum destFormat, const SpoutRegion& destRegion,
+			bool bInvert = false, bool bMirror = false, bool bSwapRB = false) const;
+		// ConvertRegion - RGBA of dataType GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT,
+		//   GL_HALF_FLOAT or GL_FLOAT using the high bit depth functions below.
+		//   The same type is copied without conversion.
+		//   The copy is the width and height of the smaller clipped region.
+		bool ConvertRegion(const void* source, unsigned int sourceWidth, unsigned int sourceHeight,
+			unsigned int sourcePitch, GLenum sourceType, const SpoutRegion& sourceRegion,
+			void* dest, unsigned int destWidth, unsigned int destHeight,
+			unsigned int destPitch, GLenum destType, const SpoutRegion& destRegion,
+			bool bInvert = false) const;
+
+		//
+		// High bit depth RGBA conversion allowing for source and destination line pitch
+		//
+		//   float  - RGBA32F
+		//   half   - RGBA16F
+		//   ushort - RGBA16 unsigned normalized
+		//   rgba   - RGBA8 unsigned normalized
+		//
+		// Unsigned normalized destinations are clamped to 0-1 and half to +-65504.
+		// F16C and AVX2 are used if available.
+		//
+		void float2half(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void half2float(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void half2ushort(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void ushort2half(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void float2ushort(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void ushort2float(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void float2rgba(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void rgba2float(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void half2rgba(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void rgba2half(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void ushort2rgba(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void rgba2ushort(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+
+		// Apply a 3D lookup table to an RGBA image
+		//   dataType GL_UNSIGNED_BYTE (RGBA8), GL_UNSIGNED_SHORT (RGBA16),
+		//   GL_HALF_FLOAT (RGBA16F) or GL_FLOAT (RGBA32F).
+		//   Source and destination can be the same without invert.
+		//   Pitch is the line length in bytes, 0 for lines without padding.
+		//   Rows are divided between the copy threads and AVX2 is used if available.
+		//   Returns false for an unsupported type or if the table is not loaded.
+		bool ApplyLUT(const spoutLUT& lut, const void* source, void* dest,
+			unsigned int width, unsigned int height, GLenum dataType,
+			unsigned int sourcePitch = 0, unsigned int destPitch = 0, bool bInvert = false) const;
+
+		//
+		// Y'CbCr conversion with BT.709 coefficients
+		//
+		//   glFormat   - GL_RGBA, GL_BGRA_EXT, GL_RGB or GL_BGR_EXT 8 bit pixels
+		//   bFullRange - 0-255 (0-1023) instead of video range 16-235 (64-940)
+		//                and chroma 16-240 (64-960)
+		//
+		// Chroma of 4:2:2 is the average of each pair of pixels and for NV12
+		// also of each pair of lines. Converting back, chroma is repeated.
+		// An odd last pixel or line is paired with itself.
+		// NV12 lines of both planes have the same pitch and the chroma plane
+		// follows the Y plane, starting at pitch * height.
+		// Pitch is the line length in bytes, 0 for the default from YUVPitch.
+		// Alpha is 255 except for AYUV. SetColor, SetAlpha and SetDither do not apply.
+		// AVX2 is used if available. Rows are divided between the copy threads.
+		// Returns false for an unsupported format or a pitch that is too small.
+		//
+		bool rgba2yuv(const void* source, void* dest, unsigned int width, unsigned int height,
+			SpoutYUV format, bool bFullRange = false, GLenum glFormat = GL_RGBA,
+			unsigned int sourcePitch = 0, unsigned int destPitch = 0, bool bInvert = false) const;
+		bool yuv2rgba(const void* source, void* dest, unsigned int width, unsigned int height,
+			SpoutYUV format, bool bFullRange = false, GLenum glFormat = GL_RGBA,
+			unsigned int sourcePitch = 0, unsigned int destPitch = 0, bool bInvert = false) const;
+		// Default line pitch in bytes
+		static unsigned int YUVPitch(unsigned int width, SpoutYUV format);
+		// Image size in bytes, both planes for NV12
+		static size_t YUVSize(unsigned int width, unsigned int height, SpoutYUV format, unsigned int pitch = 0);
+
+		// Hash of the pixels of an image to detect a frame that has not changed
+		//   pixelBytes - bytes per pixel of any format, 4 for RGBA8 or 16 for RGBA32F
+		//   Pitch is the line length in bytes, 0 for lines without padding.
+		//   Padding is not included. Each line is hashed 64 bytes at a time with
+		//   SSE2 or AVX2 and lines are divided between the copy threads.
+		//   The hash is the same for all instruction sets and threads.
+		uint64_t HashImage(const void* source, unsigned int width, unsigned int height,
+			unsigned int pixelBytes = 4, unsigned int sourcePitch = 0) const;
+
+		//
+		// Dirty tiles for copying or uploading only the parts of a frame that change
+		//
+		//   The image is divided into square tiles of tileSize pixels, smaller at
+		//   the right and bottom edges. The map has one bit for each tile and
+		//   each row of tiles starts a new byte : tile (x, y) is bit (x % 8) of
+		//   byte y * ((TilesX + 7) / 8) + x / 8. TileMapSize gives the bytes.
+		//   pixelBytes is the bytes per pixel of any format.
+		//   Pitch is the line length in bytes, 0 for lines without padding.
+		//   Rows of tiles are divided between the copy threads.
+		//
+		// Compare two images and set the bits of the tiles that differ
+		//   Lines are compared with SSE2 or AVX2, a tile is not compared
+		//   further after the first difference.
+		//   Returns the number of tiles that differ, with details in stats.
+		unsigned int DiffTiles(const void* previous, const void* current,
+			unsigned int width, unsigned int height, unsigned int pixelBytes,
+			unsigned char* tileMap, unsigned int tileSize = 64,
+			unsigned int previousPitch = 0, unsigned int currentPitch = 0,
+			SpoutTileStats* stats = nullptr) const;
+		// Copy the tiles that are set in the map
+		//   Adjacent tiles of a row are copied together.
+		bool CopyTiles(const void* source, void* dest,
+			unsigned int width, unsigned int height, unsigned int pixelBytes,
+			const unsigned char* tileMap, unsigned int tileSize = 64,
+			unsigned int sourcePitch = 0, unsigned int destPitch = 0) const;
+		// Bytes of the tile map of an image
+		static size_t TileMapSize(unsigned int width, unsigned int height, unsigned int tileSize = 64);
+
+		//
+		// Mip pyramid for previews and thumbnails
+		//
+		//   8 bit pixels of four channels, RGBA, BGRA or RGBX.
+		//   Each level is half the size of the level above, rounded down and
+		//   at least 1. A pixel is the rounded average of 2x2 pixels of the level
+		//   above. An odd last line or column is left out unless it is the only one.
+		//   Levels 1 to levels are written one after the other to dest without
+		//   padding. MipOffset gives the position and size of each level.
+		//   All levels are made in one pass down the source. A line of each level
+		//   is made as soon as the two lines above it are ready, while they are
+		//   still in the cache. SSE2 or AVX2 is used if available. Bands of lines
+		//   that make whole lines of every level are divided between the copy threads.
+		//   Returns the number of levels made, 0 for invalid arguments.
+		unsigned int MipPyramid(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int levels, unsigned int sourcePitch = 0) const;
+		// Number of levels below the image down to 1x1
+		static unsigned int MipLevels(unsigned int width, unsigned int height);
+		// Bytes from the start of dest to a level, 1 to levels,
+		// and the width and height of the level.
+		// MipOffset for levels + 1 is the size of dest.
+		static size_t MipOffset(unsigned int width, unsigned int height, unsigned int level,
+			unsigned int* levelWidth = nullptr, unsigned int* levelHeight = nullptr);
+
+		//
+		// Packed 10 bit RGB with 2 bit alpha
+		//
+		//   rgb10a2 - R10G10B10A2 unsigned normalized, red in the low bits
+		//             (DXGI_FORMAT_R10G10B10A2_UNORM, GL_RGB10_A2 / GL_UNSIGNED_INT_2_10_10_10_REV)
+		//
+		// 4 bytes per pixel, the same as RGBA8. Conversion is as for the functions above.
+		//
+		void rgb10a2toushort(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void ushorttorgb10a2(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void rgb10a2torgba(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void rgbatorgb10a2(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void rgb10a2tofloat(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+		void floattorgb10a2(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert = false) const;
+
 	protected :
 
 		void CheckSSE();
 		bool m_bSSE2;
 		bool m_bSSE3;
 		bool m_bSSSE3;
+		bool m_bAVX2;
+		bool m_bAVX512BW;
+		bool m_bF16C;
+
+		// Kernel dispatch table selected by SetSIMD
+		SpoutSIMD m_SIMD;
+		void (spoutCopy::*m_pMemcpy)(void* dst, const void* src, size_t size) const;
+		void (spoutCopy::*m_pMemcpyStream)(void* dst, const void* src, size_t size) const;
+		void (spoutCopy::*m_pSwapRB)(const void* source, void* dest, unsigned int width, unsigned int height, bool bInvert) const;
+
+		// Parallel row copy
+		spoutCopyPool* m_pPool;
+		size_t m_ThreadSize;
+		bool UseThreads(size_t size, unsigned int height) const;
+
+		// Streaming copy
+		size_t m_CacheSize;
+		size_t m_StreamSize;
+		void CopyPixels(const unsigned char *src, unsigned char *dst,
+			unsigned int width, unsigned int height,
+			GLenum glFormat, bool bInvert, bool bStream) const;
+		void FlipBuffer(const unsigned char *src, unsigned char *dst,
+			unsigned int width, unsigned int height,
+			GLenum glFormat, bool bStream) const;
+		void CopyLines(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert, bool bStream) const;
+
+		// Single pass copy and conversion of 8 bit formats
+		void CopyImageLines(const unsigned char* source, unsigned char* dest,
+			unsigned int width, unsigned int height,
+			unsigned int sourceBytes, unsigned int destBytes,
+			unsigned int sourcePitch, unsigned int destPitch,
+			bool bInvert, bool bMirror, bool bSwap, bool bDestBGR, bool bStream) const;
+
+		// Color conversion
+		SpoutTransfer m_ColorSourceTransfer;
+		SpoutTransfer m_ColorDestTransfer;
+		SpoutGamut m_ColorSourceGamut;
+		SpoutGamut m_ColorDestGamut;
+		spoutColor* m_pColor; // null without conversion
+		void ColorLine(unsigned char* line, unsigned int width, unsigned int pixelBytes, bool bBGR) const;
+		void ColorLine(float* line, unsigned int width) const;
+
+		// Alpha conversion
+		SpoutAlpha m_Alpha;
+		void AlphaLine(const unsigned char* source, unsigned char* dest, unsigned int width) const;
+		void AlphaLine(float* line, unsigned int width) const;
+
+		// Dither
+		SpoutDither m_Dither;
+		const float* m_pDither; // Thresholds, 4 floats for each entry
+		unsigned int m_DitherSize; // Entries on each side
+		void DitherLine(const float* line, unsigned char* dest, unsigned int width, unsigned int y) const;
+
+		// Resample filter
+		SpoutResample m_Resample;
+		spoutResampleCache* m_pResampleCache;
+		// Resample RGBA to 4 or 3 byte pixels, destPitch 0 for lines without padding
+		void Resample(const void* source, void* dest,
+			unsigned int sourceWidth, unsigned int sourceHeight, unsigned int sourcePitch,
+			unsigned int destWidth, unsigned int destHeight, unsigned int destBytes,
+			bool bInvert, bool bMirror, bool bSwapRB, unsigned int destPitch = 0) const;
+
+		// Clip a region to an image, false if nothing is left
+		static bool ClipRegion(const SpoutRegion& region, unsigned int width, unsigned int height,
+			SpoutRegion& clipped);
+
+		// Convert lines with pitch and invert using the AVX2 or the scalar functions
+		//   firstRow - destination row of the first line for the dither pattern
+		void ConvertLines(const void* source, void* dest, unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert,
+			const spoutLineConvert& convert, unsigned int firstRow = 0) const;
+
+		// Apply a lookup table to lines with pitch and invert
+		void ApplyLUTLines(const spoutLUT& lut, const void* source, void* dest,
+			unsigned int width, unsigned int height,
+			unsigned int sourcePitch, unsigned int destPitch, bool bInvert, GLenum dataType) const;
+
+		void memcpy_avx2(void* dst, const void* src, size_t size) const;
+		void memcpy_avx512(void* dst, const void* src, size_t size) const;
+		void memcpy_avx2_stream(void* dst, const void* src, size_t size) const;
+		void memcpy_avx512_stream(void* dst, const void* src, size_t size) const;
 
+		bool SwapRBSIMD(const void* source, const void* dest, unsigned int width) const;
 		void rgba_bgra(const void *rgba_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert = false) const;
 		void rgba_bgra_sse2(const void *rgba_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert = false) const;
 		void rgba_bgra_sse3(const void *rgba_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert = false) const;
+		void rgba_bgra_avx2(const void *rgba_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert = false) const;
+		void rgba_bgra_avx512(const void *rgba_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert = false) const;
 
 };
 
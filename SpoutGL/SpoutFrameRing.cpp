@@ -0,0 +1,589 @@
+//
+//		SpoutFrameRing
+//
+//		Ring of frame slots in shared memory
+//
+// ====================================================================================
+//		Revisions :
+//
+//		17.10.26	- project start
+//					- Add spoutFrameLease to use a frame in place
+//					- Record reader pins in a reader entry with the process id
+//					  so that the writer can reclaim slots of readers that end
+//					- Leases share a link to the ring so that a lease that outlives
+//					  the ring is not valid instead of using it
+//
+// ====================================================================================
+//
+/*
+	Copyright (c) 2026. Lynn Jarvis. All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification,
+	are permitted provided that the following conditions are met:
+
+		1. Redistributions of source code must retain the above copyright notice,
+		   this list of conditions and the following disclaimer.
+
+		2. Redistributions in binary form must reproduce the above copyright notice,
+		   this list of conditions and the following disclaimer in the documentation
+		   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+	OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED.
+	IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+	INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+	PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+	LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "SpoutFrameRing.h"
+#include <atomic>
+#include <new>
+#if !defined(_WIN32)
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+//
+// Class: spoutFrameRing
+//
+// Ring of frame slots in shared memory.
+//
+// Refer to source code for documentation.
+//
+
+// Header identifier "SPRG"
+#define SPOUT_RING_ID 0x47525053
+
+// Slot state while the writer has the slot
+#define SPOUT_RING_WRITING 0x80000000u
+
+// Reader entry owner while the entry of a reader that ended is cleared
+#define SPOUT_RING_RECLAIM 0xFFFFFFFFu
+
+// Header and slots start on a page
+#define SPOUT_RING_ALIGN 4096
+
+// One cache line for each slot
+struct spoutRingSlot {
+	std::atomic<uint32_t> state; // SPOUT_RING_WRITING or 0
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+	uint32_t format;
+	uint32_t reserved;
+	std::atomic<uint64_t> frame; // Frame number written, 0 if none
+	uint8_t pad[32];
+};
+
+// One cache line for each reader
+struct spoutRingReader {
+	std::atomic<uint32_t> owner; // Process id of the reader, 0 if the entry is free
+	uint32_t reserved;
+	std::atomic<uint64_t> pins; // Pins of each slot, 8 bits for each
+	uint8_t pad[48];
+};
+
+struct spoutRingHeader {
+	uint32_t id; // SPOUT_RING_ID when the ring is set up
+	uint32_t slots;
+	uint64_t slotSize;
+	// Newest complete frame, the frame number shifted left 8 bits and the slot
+	std::atomic<uint64_t> latest;
+	uint8_t pad[40];
+	spoutRingSlot slot[SPOUT_RING_MAXSLOTS];
+	spoutRingReader reader[SPOUT_RING_MAXREADERS];
+};
+
+static_assert(sizeof(spoutRingSlot) == 64, "spoutRingSlot is one cache line");
+static_assert(sizeof(spoutRingReader) == 64, "spoutRingReader is one cache line");
+static_assert(sizeof(spoutRingHeader) <= SPOUT_RING_ALIGN, "spoutRingHeader fits the first page");
+
+static size_t RingAlign(size_t size)
+{
+	return (size + SPOUT_RING_ALIGN - 1) & ~(size_t)(SPOUT_RING_ALIGN - 1);
+}
+
+// Pins of a slot in the pins of a reader entry
+static uint64_t RingPin(unsigned int slot)
+{
+	return (uint64_t)1 << (slot * 8);
+}
+
+static unsigned int RingPins(uint64_t pins, unsigned int slot)
+{
+	return (unsigned int)((pins >> (slot * 8)) & 0xFF);
+}
+
+static uint32_t RingProcessId()
+{
+#if defined(_WIN32)
+	return (uint32_t)GetCurrentProcessId();
+#else
+	return (uint32_t)getpid();
+#endif
+}
+
+// Whether the process of a reader entry is still running.
+// A process that cannot be queried is taken to be running.
+static bool RingProcessAlive(uint32_t pid)
+{
+#if defined(_WIN32)
+	HANDLE hProcess = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+	if (!hProcess)
+		return (GetLastError() != ERROR_INVALID_PARAMETER);
+	const bool bAlive = (WaitForSingleObject(hProcess, 0) == WAIT_TIMEOUT);
+	CloseHandle(hProcess);
+	return bAlive;
+#else
+	return (kill((pid_t)pid, 0) == 0 || errno != ESRCH);
+#endif
+}
+
+// -----------------------------------------------
+spoutFrameRing::spoutFrameRing()
+{
+	m_pHeader = nullptr;
+	m_pSlots = nullptr;
+	m_Slots = 0;
+	m_SlotSize = 0;
+	m_WriteSlot = -1;
+	m_Reader = -1;
+	m_Frame = 0;
+	m_Dropped = 0;
+	m_Reclaimed = 0;
+	m_Attach = 0;
+	m_pLink = std::make_shared<spoutFrameRing*>(this);
+}
+
+// -----------------------------------------------
+// Leases of the ring expire with the link
+spoutFrameRing::~spoutFrameRing()
+{
+	Detach();
+	m_pLink.reset();
+}
+
+// -----------------------------------------------
+// Bytes of a map for a ring of slots of the given size
+size_t spoutFrameRing::MapSize(unsigned int slots, size_t slotSize)
+{
+	if (slots < 2) slots = 2;
+	if (slots > SPOUT_RING_MAXSLOTS) slots = SPOUT_RING_MAXSLOTS;
+	return RingAlign(sizeof(spoutRingHeader)) + RingAlign(slotSize) * slots;
+}
+
+// -----------------------------------------------
+// Writer - set up a ring in a new map of MapSize bytes.
+// The slots take the map after the header.
+bool spoutFrameRing::Create(void* map, size_t mapSize, unsigned int slots)
+{
+	Detach();
+
+	if (!map || slots < 2 || slots > SPOUT_RING_MAXSLOTS)
+		return false;
+
+	const size_t headerSize = RingAlign(sizeof(spoutRingHeader));
+	if (mapSize < headerSize + (size_t)slots * SPOUT_RING_ALIGN)
+		return false;
+
+	// Value initialization zeros the atomics and the frame details
+	spoutRingHeader* header = new (map) spoutRingHeader();
+	header->slots = slots;
+	header->slotSize = (uint64_t)(((mapSize - headerSize) / slots) & ~(size_t)(SPOUT_RING_ALIGN - 1));
+	// The id last, for a reader that opens the map before it is set up
+	std::atomic_thread_fence(std::memory_order_release);
+	header->id = SPOUT_RING_ID;
+
+	m_pHeader = header;
+	m_pSlots = reinterpret_cast<unsigned char *>(map) + headerSize;
+	m_Slots = slots;
+	m_SlotSize = (size_t)header->slotSize;
+	m_Frame = 0;
+	m_Dropped = 0;
+	m_Reclaimed = 0;
+
+	return true;
+}
+
+// -----------------------------------------------
+// Reader - attach to the ring set up by the writer
+bool spoutFrameRing::Attach(void* map)
+{
+	Detach();
+
+	if (!map)
+		return false;
+
+	spoutRingHeader* header = reinterpret_cast<spoutRingHeader *>(map);
+	if (header->id != SPOUT_RING_ID)
+		return false;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (header->slots < 2 || header->slots > SPOUT_RING_MAXSLOTS || header->slotSize == 0)
+		return false;
+
+	// Register a reader entry for the pins
+	const uint32_t pid = RingProcessId();
+	int reader = -1;
+	for (int i = 0; i < SPOUT_RING_MAXREADERS && reader < 0; i++) {
+		uint32_t owner = 0;
+		if (header->reader[i].owner.compare_exchange_strong(owner, pid,
+			std::memory_order_acq_rel, std::memory_order_relaxed))
+			reader = i;
+	}
+	if (reader < 0)
+		return false;
+
+	m_pHeader = header;
+	m_Reader = reader;
+	m_pSlots = reinterpret_cast<unsigned char *>(map) + RingAlign(sizeof(spoutRingHeader));
+	m_Slots = header->slots;
+	m_SlotSize = (size_t)header->slotSize;
+
+	return true;
+}
+
+// -----------------------------------------------
+void spoutFrameRing::Detach()
+{
+	// A slot claimed and not published is left free
+	if (m_pHeader && m_WriteSlot >= 0)
+		m_pHeader->slot[m_WriteSlot].state.store(0, std::memory_order_release);
+
+	// Slots still pinned, including those of leases,
+	// are released and the reader entry is free again
+	if (m_pHeader && m_Reader >= 0) {
+		spoutRingReader& reader = m_pHeader->reader[m_Reader];
+		reader.pins.store(0, std::memory_order_release);
+		reader.owner.store(0, std::memory_order_release);
+	}
+
+	m_pHeader = nullptr;
+	m_pSlots = nullptr;
+	m_Slots = 0;
+	m_SlotSize = 0;
+	m_WriteSlot = -1;
+	m_Reader = -1;
+	m_Attach++; // Leases of the map are no longer valid
+}
+
+// -----------------------------------------------
+bool spoutFrameRing::IsAttached() const
+{
+	return (m_pHeader != nullptr);
+}
+
+// -----------------------------------------------
+unsigned int spoutFrameRing::GetSlots() const
+{
+	return m_Slots;
+}
+
+// -----------------------------------------------
+size_t spoutFrameRing::GetSlotSize() const
+{
+	return m_SlotSize;
+}
+
+// -----------------------------------------------
+// Writer - claim a free slot for the next frame.
+//
+// Slots are taken in turn after the newest frame, which is never
+// claimed so that readers always have a complete frame. A slot is
+// claimed by an exchange of the state from 0 and then kept if no
+// reader has it pinned. A reader pins the slot and then checks the
+// state, so either the writer finds the pin or the reader finds the
+// slot claimed and tries again.
+//
+// If every other slot is pinned, readers that have ended without
+// detaching are reclaimed and the slots are tried once more.
+//
+unsigned char* spoutFrameRing::BeginWrite()
+{
+	if (!m_pHeader)
+		return nullptr;
+
+	if (m_WriteSlot >= 0)
+		return m_pSlots + m_SlotSize * m_WriteSlot;
+
+	const uint64_t latest = m_pHeader->latest.load(std::memory_order_relaxed);
+	const unsigned int newest = (unsigned int)(latest & 0xFF);
+	for (int pass = 0; pass < 2; pass++) {
+		for (unsigned int i = 1; i <= m_Slots; i++) {
+			const unsigned int s = (newest + i) % m_Slots;
+			if (s == newest && (latest >> 8) != 0)
+				continue;
+			std::atomic<uint32_t>& state = m_pHeader->slot[s].state;
+			uint32_t value = 0;
+			if (!state.compare_exchange_strong(value, SPOUT_RING_WRITING))
+				continue;
+			if (!IsPinned(s)) {
+				m_WriteSlot = (int)s;
+				return m_pSlots + m_SlotSize * s;
+			}
+			state.store(0, std::memory_order_release);
+		}
+		if (ReclaimReaders() == 0)
+			break;
+	}
+
+	// Every other slot is pinned by a reader
+	m_Dropped++;
+	return nullptr;
+}
+
+// -----------------------------------------------
+// Writer - publish the claimed slot as the newest frame.
+//
+// The slot is released before it is published, so a reader that
+// finds it as the newest frame can always pin it unless the writer
+// has claimed it again for a later frame.
+//
+uint64_t spoutFrameRing::EndWrite(unsigned int width, unsigned int height, unsigned int pitch, unsigned int format)
+{
+	if (!m_pHeader || m_WriteSlot < 0)
+		return 0;
+
+	spoutRingSlot& slot = m_pHeader->slot[m_WriteSlot];
+	slot.width = width;
+	slot.height = height;
+	slot.pitch = pitch;
+	slot.format = format;
+	m_Frame++;
+	slot.frame.store(m_Frame, std::memory_order_relaxed);
+	slot.state.store(0, std::memory_order_release);
+	m_pHeader->latest.store((m_Frame << 8) | (uint64_t)m_WriteSlot, std::memory_order_release);
+	m_WriteSlot = -1;
+
+	return m_Frame;
+}
+
+// -----------------------------------------------
+uint64_t spoutFrameRing::GetDropped() const
+{
+	return m_Dropped;
+}
+
+// -----------------------------------------------
+uint64_t spoutFrameRing::GetReclaimed() const
+{
+	return m_Reclaimed;
+}
+
+// -----------------------------------------------
+// Writer - a reader has the slot pinned
+bool spoutFrameRing::IsPinned(unsigned int slot) const
+{
+	for (int i = 0; i < SPOUT_RING_MAXREADERS; i++) {
+		if (RingPins(m_pHeader->reader[i].pins.load(), slot) != 0)
+			return true;
+	}
+	return false;
+}
+
+// -----------------------------------------------
+// Writer - clear the entries of readers whose process has ended.
+//
+// The owner is changed to SPOUT_RING_RECLAIM first so that only one
+// writer clears an entry, and a reader that registers the entry
+// again after it is free cannot have its pins cleared.
+//
+unsigned int spoutFrameRing::ReclaimReaders()
+{
+	unsigned int reclaimed = 0;
+	for (int i = 0; i < SPOUT_RING_MAXREADERS; i++) {
+		spoutRingReader& reader = m_pHeader->reader[i];
+		uint32_t owner = reader.owner.load(std::memory_order_acquire);
+		if (owner == 0 || owner == SPOUT_RING_RECLAIM || RingProcessAlive(owner))
+			continue;
+		if (!reader.owner.compare_exchange_strong(owner, SPOUT_RING_RECLAIM,
+			std::memory_order_acq_rel, std::memory_order_relaxed))
+			continue;
+		reader.pins.store(0, std::memory_order_release);
+		reader.owner.store(0, std::memory_order_release);
+		reclaimed++;
+	}
+	m_Reclaimed += reclaimed;
+	return reclaimed;
+}
+
+// -----------------------------------------------
+// Reader - pin the slot of the newest frame if it is newer than lastFrame.
+//
+// The pin is recorded in the reader entry and the slot is then checked
+// in case the writer has claimed it. The writer then has published
+// a later frame or soon will, so the pin is removed and the newest
+// frame is found again. Once pinned, the slot holds a complete frame
+// until it is released.
+//
+int spoutFrameRing::Acquire(uint64_t lastFrame, SpoutRingFrame* frame)
+{
+	if (!m_pHeader || m_Reader < 0)
+		return -1;
+
+	std::atomic<uint64_t>& pins = m_pHeader->reader[m_Reader].pins;
+
+	for (int attempt = 0; attempt < 4; attempt++) {
+
+		const uint64_t latest = m_pHeader->latest.load(std::memory_order_acquire);
+		if ((latest >> 8) == 0 || (latest >> 8) <= lastFrame)
+			return -1; // No new frame
+
+		const unsigned int s = (unsigned int)(latest & 0xFF);
+		if (s >= m_Slots)
+			return -1;
+
+		// 255 pins of one slot at most
+		if (RingPins(pins.load(std::memory_order_relaxed), s) == 0xFF)
+			return -1;
+
+		spoutRingSlot& slot = m_pHeader->slot[s];
+		pins.fetch_add(RingPin(s));
+		if (slot.state.load() & SPOUT_RING_WRITING) {
+			pins.fetch_sub(RingPin(s), std::memory_order_relaxed);
+			continue; // Claimed by the writer, find the newest frame again
+		}
+
+		// The slot may have been written again since it was found,
+		// which can only be with a later frame
+		const uint64_t number = slot.frame.load(std::memory_order_relaxed);
+		if (number <= lastFrame) {
+			Release((int)s);
+			return -1;
+		}
+
+		if (frame) {
+			frame->frame = number;
+			frame->width = slot.width;
+			frame->height = slot.height;
+			frame->pitch = slot.pitch;
+			frame->format = slot.format;
+		}
+		return (int)s;
+	}
+
+	return -1;
+}
+
+// -----------------------------------------------
+const unsigned char* spoutFrameRing::Pixels(int slot) const
+{
+	if (!m_pHeader || slot < 0 || slot >= (int)m_Slots)
+		return nullptr;
+	return m_pSlots + m_SlotSize * slot;
+}
+
+// -----------------------------------------------
+// Reader - unpin a slot.
+// The writer claims the slot only after the reads are complete.
+void spoutFrameRing::Release(int slot)
+{
+	if (!m_pHeader || m_Reader < 0 || slot < 0 || slot >= (int)m_Slots)
+		return;
+	std::atomic<uint64_t>& pins = m_pHeader->reader[m_Reader].pins;
+	if (RingPins(pins.load(std::memory_order_relaxed), (unsigned int)slot) != 0)
+		pins.fetch_sub(RingPin((unsigned int)slot), std::memory_order_release);
+}
+
+// -----------------------------------------------
+// Reader - lease the newest frame if it is newer than lastFrame.
+// The slot is pinned until the lease is released.
+bool spoutFrameRing::Acquire(uint64_t lastFrame, spoutFrameLease& lease)
+{
+	lease.Release();
+
+	SpoutRingFrame frame;
+	const int slot = Acquire(lastFrame, &frame);
+	if (slot < 0)
+		return false;
+
+	lease.m_pRing = m_pLink;
+	lease.m_Slot = slot;
+	lease.m_Attach = m_Attach;
+	lease.m_Frame = frame;
+
+	return true;
+}
+
+//
+// Class: spoutFrameLease
+//
+// Read-only view of a frame in a ring slot, pinned until released.
+//
+
+// -----------------------------------------------
+spoutFrameLease::spoutFrameLease()
+{
+	m_Slot = -1;
+	m_Attach = 0;
+	m_Frame = SpoutRingFrame{};
+}
+
+// -----------------------------------------------
+spoutFrameLease::~spoutFrameLease()
+{
+	Release();
+}
+
+// -----------------------------------------------
+spoutFrameLease::spoutFrameLease(spoutFrameLease&& other)
+{
+	m_pRing = std::move(other.m_pRing);
+	m_Slot = other.m_Slot;
+	m_Attach = other.m_Attach;
+	m_Frame = other.m_Frame;
+	other.m_pRing.reset();
+	other.m_Slot = -1;
+}
+
+// -----------------------------------------------
+spoutFrameLease& spoutFrameLease::operator=(spoutFrameLease&& other)
+{
+	if (this != &other) {
+		Release();
+		m_pRing = std::move(other.m_pRing);
+		m_Slot = other.m_Slot;
+		m_Attach = other.m_Attach;
+		m_Frame = other.m_Frame;
+		other.m_pRing.reset();
+		other.m_Slot = -1;
+	}
+	return *this;
+}
+
+// -----------------------------------------------
+// The ring still exists and has not been detached since the frame was leased
+bool spoutFrameLease::IsValid() const
+{
+	const std::shared_ptr<spoutFrameRing*> link = m_pRing.lock();
+	return (link && m_Slot >= 0 && (*link)->m_Attach == m_Attach && (*link)->IsAttached());
+}
+
+// -----------------------------------------------
+const unsigned char* spoutFrameLease::Pixels() const
+{
+	if (!IsValid())
+		return nullptr;
+	return (*m_pRing.lock())->Pixels(m_Slot);
+}
+
+// -----------------------------------------------
+const SpoutRingFrame& spoutFrameLease::Frame() const
+{
+	return m_Frame;
+}
+
+// -----------------------------------------------
+// Unpin the slot if the ring has not been detached since it was leased.
+// Otherwise Detach has released it already.
+void spoutFrameLease::Release()
+{
+	if (IsValid())
+		(*m_pRing.lock())->Release(m_Slot);
+	m_pRing.reset();
+	m_Slot = -1;
+}
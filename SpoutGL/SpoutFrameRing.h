@@ -0,0 +1,221 @@
+/*
+
+					SpoutFrameRing.h
+
+				Ring of frame slots in shared memory
+
+	Copyright (c) 2026. Lynn Jarvis. All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification,
+	are permitted provided that the following conditions are met:
+
+		1. Redistributions of source code must retain the above copyright notice,
+		   this list of conditions and the following disclaimer.
+
+		2. Redistributions in binary form must reproduce the above copyright notice,
+		   this list of conditions and the following disclaimer in the documentation
+		   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+	OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED.
+	IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+	INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+	PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+	LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#ifndef __spoutFrameRing__
+#define __spoutFrameRing__
+
+//
+// A memory map divided into a header and a number of frame slots.
+//
+// The header has an atomic state for each slot and the number and slot of
+// the newest complete frame. One writer and any number of readers share
+// the map without a lock :
+//
+//   Writer - BeginWrite claims a slot that is not the newest frame and is
+//            not being read, the frame is copied to it, and EndWrite
+//            publishes it as the newest frame.
+//   Reader - Acquire pins the slot of the newest frame so that the writer
+//            cannot claim it, the frame is copied or used in place,
+//            and Release unpins it.
+//
+// Each reader registers an entry in the header with its process id when
+// it attaches, and records its pins there. Detach clears the entry and
+// any pins it still holds. If every slot is pinned, the writer reclaims
+// the entries of readers whose process has ended without detaching, so
+// that a reader that crashes cannot hold a slot forever.
+//
+// A spoutFrameLease keeps a slot pinned for a reader that uses the
+// frame in place, such as for an upload or a hash, instead of copying it.
+//
+// The latest frame wins. A reader that is slower than the writer misses
+// frames but never holds up the writer or reads a frame being written.
+// With 3 slots a single reader always leaves a free slot for the writer.
+// Each reader that holds an older frame while the writer moves on pins
+// another slot, and if all are in use BeginWrite fails and the frame
+// is dropped rather than waiting.
+//
+// Slot states are std::atomic in the map, which are lock-free
+// and address-free for 32 and 64 bit values on x86 and x64.
+//
+#if defined(_WIN32)
+#include "SpoutCommon.h"
+#else
+#ifndef SPOUT_DLLEXP
+#define SPOUT_DLLEXP
+#endif
+#endif
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+
+// Maximum number of slots
+#define SPOUT_RING_MAXSLOTS 8
+
+// Maximum number of readers attached at the same time
+#define SPOUT_RING_MAXREADERS 16
+
+// Header of a ring at the start of the map, see SpoutFrameRing.cpp
+struct spoutRingHeader;
+
+// Frame held by a slot
+struct SpoutRingFrame {
+	uint64_t frame;      // Frame number, from 1
+	unsigned int width;  // Pixels
+	unsigned int height;
+	unsigned int pitch;  // Bytes per line
+	unsigned int format; // Set by the writer, see spoutGL::WriteMemoryPixels
+};
+
+class spoutFrameRing;
+
+// Read-only view of a frame in a ring slot, pinned until released.
+// The lease is released when it is destroyed or another frame is leased
+// to it. It cannot be copied, only moved. Detaching the ring releases
+// the slots of its leases, so a lease of a ring that has been detached
+// or destroyed since is no longer valid and releasing it does nothing.
+class SPOUT_DLLEXP spoutFrameLease {
+
+	public:
+
+	spoutFrameLease();
+	~spoutFrameLease();
+	spoutFrameLease(spoutFrameLease&& other);
+	spoutFrameLease& operator=(spoutFrameLease&& other);
+	spoutFrameLease(const spoutFrameLease&) = delete;
+	spoutFrameLease& operator=(const spoutFrameLease&) = delete;
+
+	// A frame is leased and the ring is attached
+	bool IsValid() const;
+
+	// Pixels of the frame, null if not valid
+	const unsigned char* Pixels() const;
+
+	// Frame number, size, pitch and format
+	const SpoutRingFrame& Frame() const;
+
+	// Unpin the slot
+	void Release();
+
+	protected:
+
+	friend class spoutFrameRing;
+	std::weak_ptr<spoutFrameRing*> m_pRing; // Ring of the slot, expired when it is destroyed
+	int m_Slot;
+	uint32_t m_Attach; // Attach count of the ring when leased
+	SpoutRingFrame m_Frame;
+
+};
+
+class SPOUT_DLLEXP spoutFrameRing {
+
+	public:
+
+	spoutFrameRing();
+	~spoutFrameRing();
+	spoutFrameRing(const spoutFrameRing&) = delete;
+	spoutFrameRing& operator=(const spoutFrameRing&) = delete;
+
+	// Bytes of a map for a ring of slots of the given size
+	static size_t MapSize(unsigned int slots, size_t slotSize);
+
+	// Writer - set up a ring in a new map of MapSize bytes
+	bool Create(void* map, size_t mapSize, unsigned int slots);
+
+	// Reader - attach to the ring set up by the writer
+	//   False if the map does not start with a ring header
+	//   or SPOUT_RING_MAXREADERS readers are attached
+	bool Attach(void* map);
+
+	// Detach from the map, releasing any slots still pinned
+	void Detach();
+
+	// A ring is created or attached
+	bool IsAttached() const;
+
+	// Number of slots
+	unsigned int GetSlots() const;
+
+	// Bytes available for each slot
+	size_t GetSlotSize() const;
+
+	// Writer - claim a free slot for the next frame
+	//   Returns the slot pixels or null if all slots are in use
+	unsigned char* BeginWrite();
+
+	// Writer - publish the claimed slot as the newest frame
+	//   Returns the frame number
+	uint64_t EndWrite(unsigned int width, unsigned int height, unsigned int pitch, unsigned int format);
+
+	// Writer - frames dropped because no slot was free
+	uint64_t GetDropped() const;
+
+	// Writer - readers reclaimed because their process ended while attached
+	uint64_t GetReclaimed() const;
+
+	// Reader - pin the slot of the newest frame if it is newer than lastFrame
+	//   Returns the slot and frame details, or -1 if there is no newer frame
+	//   The slot must be released when the frame is no longer used
+	int Acquire(uint64_t lastFrame, SpoutRingFrame* frame);
+
+	// Pixels of a pinned slot
+	const unsigned char* Pixels(int slot) const;
+
+	// Reader - unpin a slot
+	void Release(int slot);
+
+	// Reader - lease the newest frame if it is newer than lastFrame
+	//   Any frame already leased to it is released first
+	//   Returns false if there is no newer frame
+	bool Acquire(uint64_t lastFrame, spoutFrameLease& lease);
+
+	protected:
+
+	friend class spoutFrameLease;
+
+	spoutRingHeader* m_pHeader; // Start of the map, null if not attached
+	unsigned char* m_pSlots; // Pixels of the first slot
+	unsigned int m_Slots;
+	size_t m_SlotSize;
+	int m_WriteSlot; // Slot claimed by BeginWrite, -1 if none
+	int m_Reader; // Reader entry in the header, -1 for the writer
+	uint64_t m_Frame; // Last frame written
+	uint64_t m_Dropped;
+	uint64_t m_Reclaimed;
+
+	// Writer - a reader has the slot pinned
+	bool IsPinned(unsigned int slot) const;
+	// Writer - clear the entries of readers that have ended
+	unsigned int ReclaimReaders();
+	uint32_t m_Attach; // Incremented when detached, for leases
+	std::shared_ptr<spoutFrameRing*> m_pLink; // Shared with leases while the ring exists
+
+};
+
+#endif
@@ -89,6 +89,19 @@
 //					  Pending implementation of glFencSync for glMapBufferRange method
 //		16.03.22	- Use m_hInteropObject in LinkGLDXtextures so that CleanupInterp releases the imterop object
 //					- Allow for success test in GLDXReady();
+//		17.10.26	- Use spoutCopy::CopyImage for pixel data and memory share conversion
+//					  Read/WriteMemoryPixels accept RGBA, BGRA, RGB and BGR pixels
+//					- Add SetMemoryShareYUV for UYVY, v210, NV12 or AYUV memoryshare frames
+//					  WriteMemoryPixels - create the map with the "_map" name read by the receiver
+//					  and lock the buffer for every frame
+//					- Add SetMemoryShareTiles to copy and upload only the tiles of
+//					  memoryshare frames that change
+//					- Add SetMemoryShareRing to send memoryshare frames through a ring
+//					  of slots so that senders and receivers do not wait for each other
+//					- Add ReadMemoryLease to use a memoryshare ring frame in place
+//					- Add SetMemoryShareLargePages for memoryshare maps with large pages
+//					- WriteMemoryPixels returns false if a ring frame is dropped
+//					- Name ring maps "_ring" so that receivers do not detect a ring from pixels
 // ====================================================================================
 /*
 	Copyright (c) 2021-2022, Lynn Jarvis. All rights reserved.
@@ -216,6 +229,23 @@ spoutGL::spoutGL()
 	// Only set if 2.006 SpoutSettings has been used
 	// Removed by 2.007 SpoutSettings
 	m_bMemoryShare = GetMemoryShareMode();
+	m_bMemoryYUV = false;
+	m_MemoryYUV = SPOUT_YUV_UYVY;
+	m_bMemoryYUVfull = false;
+	m_pMemoryRGBA = nullptr;
+	m_MemoryRGBAsize = 0;
+	m_bMemoryTiles = false;
+	m_MemoryTileSize = 64;
+	m_MemoryTileWidth = 0;
+	m_MemoryTileHeight = 0;
+	m_pMemoryTileMap = nullptr;
+	m_MemoryTileMapSize = 0;
+	m_pMemoryPrevious = nullptr;
+	m_MemoryPreviousSize = 0;
+	m_MemoryTileStats = SpoutTileStats{};
+	m_bMemoryRing = false;
+	m_MemoryRingSlots = 3;
+	m_MemoryRingFrame = 0;
 
 	// Extensions are loaded in OpenSpout() if a context is not available here
 	LoadGLextensions();
@@ -240,12 +270,14 @@ spoutGL::~spoutGL()
 	}
 
 	// Close 2.006 or buffer shared memory if used
+	memoryring.Detach();
 	memoryshare.Close();
 
 	// Release event if used
 	frame.CloseFrameSync();
 
 	// Close shared memory and sync event if used
+	memoryring.Detach();
 	memoryshare.Close();
 	frame.CloseFrameSync();
 
@@ -256,6 +288,10 @@ spoutGL::~spoutGL()
 	// Finally release DirectX resources and device
 	CleanupDX11();
 
+	delete[] m_pMemoryRGBA;
+	delete[] m_pMemoryTileMap;
+	delete[] m_pMemoryPrevious;
+
 }
 
 //
@@ -2262,6 +2298,7 @@ bool spoutGL::DeleteMemoryBuffer()
 		return false;
 	}
 
+	memoryring.Detach();
 	memoryshare.Close();
 
 	return true;
@@ -2532,38 +2569,9 @@ bool spoutGL::WritePixelData(const unsigned char* pixels, ID3D11Texture2D* pStag
 		// If the texture format is BGRA and the receiving pixel buffer is RGBA/RGB or vice-versa,
 		// the data has to be converted from BGRA to RGBA/RGB or RGBA to BGRA/BGR during the pixel copy.
 		//
-		if (glFormat == GL_RGBA) { // RGBA pixel buffer
-			if (m_dwFormat == 28) // RGBA staging textures
-				spoutcopy.rgba2rgba((const void *)pixels, mappedSubResource.pData,
-					width, height, width*4, mappedSubResource.RowPitch, bInvert);
-			else
-				spoutcopy.rgba2bgra((const void *)pixels, mappedSubResource.pData, 
-					width, height, width*4, mappedSubResource.RowPitch, bInvert);
-		}
-		else if (glFormat == GL_BGRA_EXT) { // BGRA pixel buffer
-			if (m_dwFormat == 28)
-				spoutcopy.rgba2bgra((const void *)pixels, mappedSubResource.pData,
-					width, height, width * 4, mappedSubResource.RowPitch, bInvert);
-			else
-				spoutcopy.rgba2rgba((const void *)pixels, mappedSubResource.pData,
-					width, height, width*4, mappedSubResource.RowPitch, bInvert);
-		}
-		else if (glFormat == GL_RGB) { // RGB pixel buffer
-			if (m_dwFormat == 28)
-				spoutcopy.rgb2rgba((const void *)pixels, mappedSubResource.pData, 
-					width, height, mappedSubResource.RowPitch, bInvert);
-			else
-				spoutcopy.rgb2bgra((const void *)pixels, mappedSubResource.pData,
-					width, height, mappedSubResource.RowPitch, bInvert);
-		}
-		else if (glFormat == GL_BGR_EXT) { // BGR pixel buffer
-			if (m_dwFormat == 28)
-				spoutcopy.bgr2rgba((const void *)pixels, mappedSubResource.pData,
-					width, height, mappedSubResource.RowPitch, bInvert);
-			else
-				spoutcopy.rgb2rgba((const void *)pixels, mappedSubResource.pData,
-					width, height, mappedSubResource.RowPitch, bInvert);
-		}
+		spoutcopy.CopyImage((const void *)pixels, mappedSubResource.pData, width, height,
+			glFormat, (m_dwFormat == 28) ? GL_RGBA : GL_BGRA_EXT,
+			0, mappedSubResource.RowPitch, bInvert);
 		spoutdx.GetDX11Context()->Unmap(pStagingTexture, 0);
 
 		return true;
@@ -2606,30 +2614,9 @@ bool spoutGL::ReadPixelData(ID3D11Texture2D* pStagingTexture, unsigned char* pix
 		// If the texture format is BGRA and the receiving pixel buffer is RGBA/RGB or vice-versa,
 		// the data has to be converted from BGRA to RGBA/RGB or RGBA to BGRA/BGR during the pixel copy.
 		//
-		if (glFormat == GL_RGBA) { // RGBA pixel buffer
-			if (m_dwFormat == 28) // RGBA staging textures
-				spoutcopy.rgba2rgba(mappedSubResource.pData, pixels, width, height, mappedSubResource.RowPitch, bInvert);
-			else
-				spoutcopy.rgba2bgra(mappedSubResource.pData, pixels, width, height, mappedSubResource.RowPitch, bInvert);
-		}
-		else if (glFormat == GL_BGRA_EXT) { // BGRA pixel buffer
-			if (m_dwFormat == 28)
-				spoutcopy.rgba2bgra(mappedSubResource.pData, pixels, width, height, mappedSubResource.RowPitch, bInvert);
-			else
-				spoutcopy.rgba2rgba(mappedSubResource.pData, pixels, width, height, mappedSubResource.RowPitch, bInvert);
-		}
-		else if (glFormat == GL_RGB) { // RGB pixel buffer
-			if (m_dwFormat == 28)
-				spoutcopy.rgba2rgb(mappedSubResource.pData, pixels, m_Width, m_Height, mappedSubResource.RowPitch, bInvert);
-			else
-				spoutcopy.rgba2bgr(mappedSubResource.pData, pixels, m_Width, m_Height, mappedSubResource.RowPitch, bInvert);
-		}
-		else if (glFormat == GL_BGR_EXT) { // BGR pixel buffer
-			if (m_dwFormat == 28)
-				spoutcopy.rgba2bgr(mappedSubResource.pData, pixels, m_Width, m_Height, mappedSubResource.RowPitch, bInvert);
-			else
-				spoutcopy.rgba2rgb(mappedSubResource.pData, pixels, m_Width, m_Height, mappedSubResource.RowPitch, bInvert);
-		}
+		spoutcopy.CopyImage(mappedSubResource.pData, pixels, width, height,
+			(m_dwFormat == 28) ? GL_RGBA : GL_BGRA_EXT, glFormat,
+			mappedSubResource.RowPitch, 0, bInvert);
 
 		spoutdx.GetDX11Context()->Unmap(pStagingTexture, 0);
 
@@ -2705,52 +2692,123 @@ bool spoutGL::CheckStagingTextures(unsigned int width, unsigned int height, int
 //
 
 //
-// Read rgba shared memory to texture pixel data
+// Format of memoryshare ring frames, GL_RGBA or the FOURCC of a Y'CbCr format
 //
-bool spoutGL::ReadMemoryTexture(const char* sendername, GLuint TexID, GLuint TextureTarget,
-	unsigned int width, unsigned int height, bool bInvert, GLuint HostFBO)
+static const unsigned int MemoryRingFourCC[4] = {
+	0x59565955, // 'UYVY'
+	0x30313276, // 'v210'
+	0x3231564E, // 'NV12'
+	0x56555941, // 'AYUV'
+};
+
+static unsigned int MemoryRingFormat(bool bYUV, SpoutYUV format)
 {
-	// Open a shared memory map if it not already
-	if (!memoryshare.Name()) {
-		// Create a name for the map from the sender name
-		std::string namestring = sendername;
-		namestring += "_map";
-		// Open the shared memory map.
-		if (!memoryshare.Open(namestring.c_str())) {
-			return false;
+	if (!bYUV || (unsigned int)format > SPOUT_YUV_AYUV)
+		return GL_RGBA;
+	return MemoryRingFourCC[format];
+}
+
+// Returns true and the Y'CbCr format, or false for RGBA
+static bool MemoryRingYUV(unsigned int ringformat, SpoutYUV &format)
+{
+	for (unsigned int i = 0; i < 4; i++) {
+		if (ringformat == MemoryRingFourCC[i]) {
+			format = (SpoutYUV)i;
+			return true;
 		}
-		SpoutLogNotice("SpoutSharedMemory::ReadMemoryTexture - opened sender memory map [%s]", memoryshare.Name());
 	}
+	return false;
+}
 
-	char* pBuffer = memoryshare.Lock();
-	if (!pBuffer) {
-		SpoutLogError("SpoutSharedMemory::ReadMemoryTexture - no buffer lock");
+//
+// Read rgba shared memory to texture pixel data
+//
+bool spoutGL::ReadMemoryTexture(const char* sendername, GLuint TexID, GLuint TextureTarget,
+	unsigned int width, unsigned int height, bool bInvert, GLuint HostFBO)
+{
+	// Open the sender memory map if it is not open already
+	if (!OpenMemoryShare(sendername))
 		return false;
-	}
 
 	bool bRet = true; // Error only if pixel read fails
+	bool bYUV = m_bMemoryYUV;
+	SpoutYUV yuv = m_MemoryYUV;
+	const char* pBuffer = nullptr;
+	int slot = -1;
+
+	if (CheckMemoryRing()) {
+		// Pin the newest frame of the ring and read it without the lock
+		SpoutRingFrame ringframe;
+		slot = memoryring.Acquire(m_MemoryRingFrame, &ringframe);
+		if (slot < 0)
+			return true; // No new frame
+		if (ringframe.width != width || ringframe.height != height) {
+			// Read after the receiver is updated for the new size
+			memoryring.Release(slot);
+			return true;
+		}
+		m_MemoryRingFrame = ringframe.frame;
+		bYUV = MemoryRingYUV(ringframe.format, yuv);
+		pBuffer = reinterpret_cast<const char *>(memoryring.Pixels(slot));
+	}
+	else {
+		char* pLocked = memoryshare.Lock();
+		if (!pLocked) {
+			SpoutLogError("SpoutSharedMemory::ReadMemoryTexture - no buffer lock");
+			return false;
+		}
+		// Query a new frame and read pixels while the buffer is locked
+		if (!frame.GetNewFrame()) {
+			memoryshare.Unlock();
+			return true;
+		}
+		pBuffer = pLocked;
+	}
 
-	// Query a new frame and read pixels while the buffer is locked
-	if (frame.GetNewFrame()) {
-		if (bInvert) {
-			// Create or resize a local OpenGL texture
-			CheckOpenGLTexture(m_TexID, GL_RGBA, width, height);
-			// Read the memory pixels into it
-			glBindTexture(GL_TEXTURE_2D, m_TexID);
-			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGRA_EXT, GL_UNSIGNED_BYTE, (GLvoid *)pBuffer);
-			glBindTexture(GL_TEXTURE_2D, 0);
-			// Copy to the user texture, inverting at the same time
-			bRet = CopyTexture(m_TexID, GL_TEXTURE_2D, TexID, TextureTarget, width, height, true, HostFBO);
+	if (bYUV) {
+		// Convert to RGBA, inverting at the same time
+		const size_t size = (size_t)width * height * 4;
+		if (size > m_MemoryRGBAsize) {
+			delete[] m_pMemoryRGBA;
+			m_pMemoryRGBA = new unsigned char[size];
+			m_MemoryRGBAsize = size;
+		}
+		spoutcopy.yuv2rgba(pBuffer, m_pMemoryRGBA, width, height, yuv, m_bMemoryYUVfull, GL_RGBA, 0, 0, bInvert);
+		if (m_bMemoryTiles) {
+			UploadMemoryTiles(m_pMemoryRGBA, TexID, TextureTarget, width, height);
 		}
 		else {
-			// No invert - copy memory pixels directly to the user texture
 			glBindTexture(TextureTarget, TexID);
-			glTexSubImage2D(TextureTarget, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid *)pBuffer);
+			glTexSubImage2D(TextureTarget, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid *)m_pMemoryRGBA);
 			glBindTexture(TextureTarget, 0);
 		}
-	} // No new frame
+	}
+	else if (bInvert) {
+		// Create or resize a local OpenGL texture
+		CheckOpenGLTexture(m_TexID, GL_RGBA, width, height);
+		// Read the memory pixels into it
+		glBindTexture(GL_TEXTURE_2D, m_TexID);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGRA_EXT, GL_UNSIGNED_BYTE, (GLvoid *)pBuffer);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		// Copy to the user texture, inverting at the same time
+		bRet = CopyTexture(m_TexID, GL_TEXTURE_2D, TexID, TextureTarget, width, height, true, HostFBO);
+		m_MemoryTileWidth = 0; // Tiles compared from the next frame
+	}
+	else if (m_bMemoryTiles) {
+		// Upload only the tiles that changed since the last frame
+		UploadMemoryTiles(reinterpret_cast<const unsigned char *>(pBuffer), TexID, TextureTarget, width, height);
+	}
+	else {
+		// No invert - copy memory pixels directly to the user texture
+		glBindTexture(TextureTarget, TexID);
+		glTexSubImage2D(TextureTarget, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid *)pBuffer);
+		glBindTexture(TextureTarget, 0);
+	}
 
-	memoryshare.Unlock();
+	if (slot >= 0)
+		memoryring.Release(slot);
+	else
+		memoryshare.Unlock();
 
 	return bRet;
 
@@ -2762,21 +2820,32 @@ bool spoutGL::ReadMemoryTexture(const char* sendername, GLuint TexID, GLuint Tex
 bool spoutGL::ReadMemoryPixels(const char* sendername, unsigned char* pixels,
 	unsigned int width, unsigned int height, GLenum glFormat, bool bInvert)
 {
-	if (!pixels || glFormat != GL_RGBA) {
+	if (!pixels || (glFormat != GL_RGBA && glFormat != GL_BGRA_EXT && glFormat != GL_RGB && glFormat != GL_BGR_EXT)) {
 		SpoutLogError("spoutGLDXinterop::ReadMemoryPixels - no data or incorrect format");
 		return false;
 	}
 
-	// Open a shared memory map if it not already
-	if (!memoryshare.Name()) {
-		// Create a name for the map from the sender name
-		std::string namestring = sendername;
-		namestring += "_map";
-		// Open the shared memory map.
-		if (!memoryshare.Open(namestring.c_str())) {
-			return false;
+	// Open the sender memory map if it is not open already
+	if (!OpenMemoryShare(sendername))
+		return false;
+
+	if (CheckMemoryRing()) {
+		// Pin the newest frame of the ring and copy it without the lock
+		SpoutRingFrame ringframe;
+		const int slot = memoryring.Acquire(m_MemoryRingFrame, &ringframe);
+		if (slot < 0)
+			return true; // No new frame
+		if (ringframe.width == width && ringframe.height == height) {
+			SpoutYUV yuv = m_MemoryYUV;
+			if (MemoryRingYUV(ringframe.format, yuv))
+				spoutcopy.yuv2rgba(memoryring.Pixels(slot), pixels, width, height, yuv, m_bMemoryYUVfull, glFormat, 0, 0, bInvert);
+			else
+				spoutcopy.CopyImage(memoryring.Pixels(slot), pixels, width, height, GL_RGBA, glFormat, 0, 0, bInvert);
+			m_MemoryRingFrame = ringframe.frame;
 		}
-		SpoutLogNotice("SpoutSharedMemory::ReadMemoryPixels - opened sender memory map [%s]", memoryshare.Name());
+		// A frame of a different size is read after the receiver is updated
+		memoryring.Release(slot);
+		return true;
 	}
 
 	char* pBuffer = memoryshare.Lock();
@@ -2788,7 +2857,11 @@ bool spoutGL::ReadMemoryPixels(const char* sendername, unsigned char* pixels,
 	// Query a new frame and read pixels while the buffer is locked
 	if (frame.GetNewFrame()) {
 		// Read pixels from shared memory
-		spoutcopy.CopyPixels(reinterpret_cast<unsigned char *>(pBuffer), pixels, width, height, glFormat, bInvert);
+		// The memory map is RGBA or Y'CbCr and is converted in the same pass
+		if (m_bMemoryYUV)
+			spoutcopy.yuv2rgba(pBuffer, pixels, width, height, m_MemoryYUV, m_bMemoryYUVfull, glFormat, 0, 0, bInvert);
+		else
+			spoutcopy.CopyImage(pBuffer, pixels, width, height, GL_RGBA, glFormat, 0, 0, bInvert);
 	}
 
 	memoryshare.Unlock();
@@ -2797,35 +2870,124 @@ bool spoutGL::ReadMemoryPixels(const char* sendername, unsigned char* pixels,
 
 }
 
+//
+// Lease the newest frame of a memoryshare ring to use in place.
+// The lease is a read-only view of the frame in shared memory and the
+// slot is kept until the lease is released. Any frame leased before
+// is released. False if there is no new frame or the sender map is
+// not a ring.
+//
+bool spoutGL::ReadMemoryLease(const char* sendername, spoutFrameLease& lease)
+{
+	lease.Release();
+
+	// Open the sender memory map if it is not open already
+	if (!OpenMemoryShare(sendername))
+		return false;
+
+	if (!CheckMemoryRing())
+		return false;
+
+	if (!memoryring.Acquire(m_MemoryRingFrame, lease))
+		return false; // No new frame
+
+	m_MemoryRingFrame = lease.Frame().frame;
+
+	return true;
+
+}
+
 //
 // Write image pixels to shared memory
 //
 bool spoutGL::WriteMemoryPixels(const char *sendername, const unsigned char* pixels, unsigned int width, unsigned int height, GLenum glFormat, bool bInvert)
 {
-	if (!pixels || glFormat != GL_RGBA) {
+	if (!pixels || (glFormat != GL_RGBA && glFormat != GL_BGRA_EXT && glFormat != GL_RGB && glFormat != GL_BGR_EXT)) {
 		SpoutLogError("spoutGLDXinterop::WriteMemoryPixels - no data or incorrect format");
 		return false;
 	}
 
+	const size_t size = m_bMemoryYUV ? spoutCopy::YUVSize(width, height, m_MemoryYUV) : (size_t)width*4*height;
+
 	// Create a shared memory map if it does not exist yet
-	char* pBuffer = nullptr;
 	if (memoryshare.Size() == 0) {
-		// Create a name for the map from the sender name
+		// Create a name for the map from the sender name.
+		// A ring map has a different name so that receivers
+		// know it is a ring without reading the map.
 		std::string namestring = sendername;
-		namestring += "_map";
-		if (!memoryshare.Create(sendername, width*4*height)) {
+		namestring += m_bMemoryRing ? "_ring" : "_map";
+		// A ring has a header and a slot for each frame
+		const size_t mapsize = m_bMemoryRing ? spoutFrameRing::MapSize(m_MemoryRingSlots, size) : size;
+		if (!memoryshare.Create(namestring.c_str(), (int)mapsize)) {
 			SpoutLogError("SpoutSharedMemory::WriteMemoryPixels - could not create shared memory");
 			return false;
 		}
-		pBuffer = memoryshare.Lock();
-		if (!pBuffer) {
-			SpoutLogError("SpoutSharedMemory::WriteMemoryPixels - no buffer lock");
+		if (m_bMemoryRing) {
+			if (!memoryring.Create(memoryshare.Buffer(), mapsize, m_MemoryRingSlots)) {
+				SpoutLogError("SpoutSharedMemory::WriteMemoryPixels - could not create frame ring");
+				memoryshare.Close();
+				return false;
+			}
+			SpoutLogNotice("SpoutSharedMemory::WriteMemoryPixels - frame ring of %u slots", m_MemoryRingSlots);
+		}
+		else {
+			memoryring.Detach();
+		}
+		m_MemoryTileWidth = 0; // No frame to compare
+	}
+
+	if (memoryring.IsAttached()) {
+		if (size > memoryring.GetSlotSize()) {
+			SpoutLogError("SpoutSharedMemory::WriteMemoryPixels - frame larger than the ring slots");
+			return false;
+		}
+		// Write to a free slot and publish it as the newest frame.
+		// If receivers hold every other slot, the frame is dropped
+		// rather than waiting for them.
+		unsigned char* pSlot = memoryring.BeginWrite();
+		if (!pSlot) {
+			SpoutLogWarning("SpoutSharedMemory::WriteMemoryPixels - frame dropped, all ring slots in use (%llu dropped)",
+				(unsigned long long)memoryring.GetDropped());
 			return false;
 		}
+		if (m_bMemoryYUV)
+			spoutcopy.rgba2yuv(pixels, pSlot, width, height, m_MemoryYUV, m_bMemoryYUVfull, glFormat, 0, 0, bInvert);
+		else
+			spoutcopy.CopyImage(pixels, pSlot, width, height, glFormat, GL_RGBA, 0, 0, bInvert);
+		memoryring.EndWrite(width, height,
+			m_bMemoryYUV ? spoutCopy::YUVPitch(width, m_MemoryYUV) : width * 4,
+			MemoryRingFormat(m_bMemoryYUV, m_MemoryYUV));
+		return true;
+	}
+
+	char* pBuffer = memoryshare.Lock();
+	if (!pBuffer) {
+		SpoutLogError("SpoutSharedMemory::WriteMemoryPixels - no buffer lock");
+		return false;
 	}
 
 	// Write pixel data to shared memory
-	spoutcopy.CopyPixels(pixels, reinterpret_cast<unsigned char *>(pBuffer), width, height, glFormat, bInvert);
+	// The memory map is RGBA or Y'CbCr and is converted in the same pass
+	if (m_bMemoryYUV) {
+		spoutcopy.rgba2yuv(pixels, pBuffer, width, height, m_MemoryYUV, m_bMemoryYUVfull, glFormat, 0, 0, bInvert);
+	}
+	else if (m_bMemoryTiles && glFormat == GL_RGBA && !bInvert) {
+		// The map holds the last frame, so only the tiles that differ are copied
+		if (CheckMemoryTiles(width, height, false)) {
+			if (spoutcopy.DiffTiles(pBuffer, pixels, width, height, 4, m_pMemoryTileMap, m_MemoryTileSize,
+				0, 0, &m_MemoryTileStats) > 0)
+				spoutcopy.CopyTiles(pixels, pBuffer, width, height, 4, m_pMemoryTileMap, m_MemoryTileSize);
+		}
+		else {
+			spoutcopy.CopyImage(pixels, pBuffer, width, height, GL_RGBA, GL_RGBA);
+			m_MemoryTileWidth = width;
+			m_MemoryTileHeight = height;
+		}
+	}
+	else {
+		spoutcopy.CopyImage(pixels, pBuffer, width, height, glFormat, GL_RGBA, 0, 0, bInvert);
+		m_MemoryTileWidth = 0; // Tiles compared from the next RGBA frame
+	}
 
 	memoryshare.Unlock();
 
@@ -2833,6 +2995,136 @@ bool spoutGL::WriteMemoryPixels(const char *sendername, const unsigned char* pix
 
 }
 
+//
+// Open the memory map of a sender if it is not open already.
+// A sender that uses a ring of frame slots creates the map with the
+// "_ring" name instead of "_map", so it is tried first.
+//
+bool spoutGL::OpenMemoryShare(const char* sendername)
+{
+	if (memoryshare.Name())
+		return true;
+
+	memoryring.Detach(); // Attached again for the new map
+
+	// Create a name for the map from the sender name
+	std::string namestring = sendername;
+	if (!memoryshare.Open((namestring + "_ring").c_str())
+		&& !memoryshare.Open((namestring + "_map").c_str()))
+		return false;
+
+	SpoutLogNotice("spoutGL::OpenMemoryShare - opened sender memory map [%s]", memoryshare.Name());
+
+	return true;
+}
+
+//
+// Attach to the frame ring of the memory map if the sender uses one.
+// The map name shows whether it is a ring, not the map contents.
+// The sender sets up the ring after creating the map, so a ring that
+// is not set up yet is checked again for the next frame.
+// Returns true if the map is a ring, whether or not it is attached.
+//
+bool spoutGL::CheckMemoryRing()
+{
+	const char* name = memoryshare.Name();
+	const size_t len = name ? strlen(name) : 0;
+	if (len < 5 || strcmp(name + len - 5, "_ring") != 0)
+		return false;
+
+	if (memoryring.IsAttached() || !memoryring.Attach(memoryshare.Buffer()))
+		return true;
+
+	m_MemoryRingFrame = 0;
+	SpoutLogNotice("spoutGL::CheckMemoryRing - frame ring of %u slots", memoryring.GetSlots());
+
+	return true;
+}
+
+//
+// Check the tile map and previous frame for the frame size.
+// Returns true if the last frame is the same size and can be compared.
+// Otherwise the stats are set for the whole frame.
+//
+bool spoutGL::CheckMemoryTiles(unsigned int width, unsigned int height, bool bPrevious)
+{
+	const size_t mapSize = spoutCopy::TileMapSize(width, height, m_MemoryTileSize);
+	if (mapSize > m_MemoryTileMapSize) {
+		delete[] m_pMemoryTileMap;
+		m_pMemoryTileMap = new unsigned char[mapSize];
+		m_MemoryTileMapSize = mapSize;
+	}
+
+	if (bPrevious) {
+		const size_t size = (size_t)width * height * 4;
+		if (size > m_MemoryPreviousSize) {
+			delete[] m_pMemoryPrevious;
+			m_pMemoryPrevious = new unsigned char[size];
+			m_MemoryPreviousSize = size;
+			m_MemoryTileWidth = 0;
+		}
+	}
+
+	if (width == m_MemoryTileWidth && height == m_MemoryTileHeight)
+		return true;
+
+	const unsigned int tiles = ((width + m_MemoryTileSize - 1) / m_MemoryTileSize)
+		* ((height + m_MemoryTileSize - 1) / m_MemoryTileSize);
+	m_MemoryTileStats.tiles = tiles;
+	m_MemoryTileStats.dirtyTiles = tiles;
+	m_MemoryTileStats.dirtyArea = 1.0;
+	return false;
+}
+
+//
+// Upload the tiles of RGBA pixels that differ from the last frame.
+// Adjacent tiles of a row are uploaded together.
+//
+void spoutGL::UploadMemoryTiles(const unsigned char* pixels, GLuint TexID, GLuint TextureTarget,
+	unsigned int width, unsigned int height)
+{
+	glBindTexture(TextureTarget, TexID);
+
+	if (!CheckMemoryTiles(width, height, true)) {
+		glTexSubImage2D(TextureTarget, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid *)pixels);
+		memcpy(m_pMemoryPrevious, pixels, (size_t)width * height * 4);
+		m_MemoryTileWidth = width;
+		m_MemoryTileHeight = height;
+	}
+	else if (spoutcopy.DiffTiles(m_pMemoryPrevious, pixels, width, height, 4, m_pMemoryTileMap,
+		m_MemoryTileSize, 0, 0, &m_MemoryTileStats) > 0) {
+		const unsigned int tileSize = m_MemoryTileSize;
+		const unsigned int tilesX = (width + tileSize - 1) / tileSize;
+		const unsigned int tilesY = (height + tileSize - 1) / tileSize;
+		const size_t mapPitch = (tilesX + 7) / 8;
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, width); // row length in pixels
+		for (unsigned int ty = 0; ty < tilesY; ty++) {
+			const unsigned char* map = m_pMemoryTileMap + ty * mapPitch;
+			unsigned int tx = 0;
+			while (tx < tilesX) {
+				if (!(map[tx / 8] & (1 << (tx % 8)))) {
+					tx++;
+					continue;
+				}
+				unsigned int end = tx + 1;
+				while (end < tilesX && (map[end / 8] & (1 << (end % 8))))
+					end++;
+				const unsigned int x = tx * tileSize;
+				const unsigned int y = ty * tileSize;
+				const unsigned int w = (end * tileSize < width ? end * tileSize : width) - x;
+				const unsigned int h = (tileSize < height - y ? tileSize : height - y);
+				glTexSubImage2D(TextureTarget, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE,
+					(GLvoid *)(pixels + ((size_t)y * width + x) * 4));
+				tx = end;
+			}
+		}
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		spoutcopy.CopyTiles(pixels, m_pMemoryPrevious, width, height, 4, m_pMemoryTileMap, tileSize);
+	}
+
+	glBindTexture(TextureTarget, 0);
+}
+
 //
 // Directx 11
 //
@@ -3399,6 +3691,108 @@ void spoutGL::SetShareMode(int mode)
 	}
 }
 
+//---------------------------------------------------------
+// Function: SetMemoryShareYUV
+// Set memory share frames in Y'CbCr instead of RGBA
+//  UYVY - 4:2:2 8 bit, half the size of RGBA
+//  V210 - 4:2:2 10 bit
+//  NV12 - 4:2:0 8 bit, 3/8 the size of RGBA
+//  AYUV - 4:4:4 8 bit with alpha
+//  BT.709 with video range 16-235, or full range 0-255.
+//  Sender and receiver must select the same format.
+void spoutGL::SetMemoryShareYUV(bool bYUV, SpoutYUV format, bool bFullRange)
+{
+	m_bMemoryYUV = bYUV;
+	m_MemoryYUV = format;
+	m_bMemoryYUVfull = bFullRange;
+}
+
+//---------------------------------------------------------
+// Function: GetMemoryShareYUV
+// Get memory share Y'CbCr format, false for RGBA
+bool spoutGL::GetMemoryShareYUV(SpoutYUV &format, bool &bFullRange)
+{
+	format = m_MemoryYUV;
+	bFullRange = m_bMemoryYUVfull;
+	return m_bMemoryYUV;
+}
+
+//---------------------------------------------------------
+// Function: SetMemoryShareTiles
+// Copy and upload only the tiles of memory share frames that change
+//  The sender compares RGBA frames with the memory map and copies
+//  the tiles that differ. The receiver keeps the last frame and
+//  uploads the tiles that differ to the texture.
+//  Tiles are 64x64 pixels by default.
+void spoutGL::SetMemoryShareTiles(bool bTiles, unsigned int tileSize)
+{
+	m_bMemoryTiles = bTiles;
+	if (tileSize > 0)
+		m_MemoryTileSize = tileSize;
+	m_MemoryTileWidth = 0; // Whole frame next
+	m_MemoryTileHeight = 0;
+	m_MemoryTileStats = SpoutTileStats{};
+}
+
+//---------------------------------------------------------
+// Function: GetMemoryShareTileStats
+// Tiles that changed in the last memory share frame, false if not enabled
+bool spoutGL::GetMemoryShareTileStats(SpoutTileStats &stats)
+{
+	stats = m_MemoryTileStats;
+	return m_bMemoryTiles;
+}
+
+//---------------------------------------------------------
+// Function: SetMemoryShareRing
+// Send memory share frames through a ring of slots instead of a locked buffer
+//  The sender writes each frame to a slot that no receiver is reading
+//  and receivers copy the newest frame without the lock, so neither
+//  waits for the other. A slow receiver misses frames.
+//  2 to 8 slots, 3 by default. Set before the first frame is sent.
+//  Tiles are uploaded by receivers but the sender copies whole frames.
+//  Receivers find the ring and read it without a setting.
+void spoutGL::SetMemoryShareRing(bool bRing, unsigned int slots)
+{
+	m_bMemoryRing = bRing;
+	if (slots < 2) slots = 2;
+	if (slots > SPOUT_RING_MAXSLOTS) slots = SPOUT_RING_MAXSLOTS;
+	m_MemoryRingSlots = slots;
+}
+
+//---------------------------------------------------------
+// Function: GetMemoryShareRing
+// Get memory share ring slots and frames dropped by the sender
+// because no slot was free, false if not enabled or found
+bool spoutGL::GetMemoryShareRing(unsigned int &slots, unsigned long long &dropped)
+{
+	slots = memoryring.IsAttached() ? memoryring.GetSlots() : m_MemoryRingSlots;
+	dropped = (unsigned long long)memoryring.GetDropped();
+	return (m_bMemoryRing || memoryring.IsAttached());
+}
+
+//---------------------------------------------------------
+// Function: SetMemoryShareLargePages
+// Create memory share maps with large pages if available
+//  A 6K RGBA32F frame is hundreds of MB and large pages reduce
+//  the TLB misses of every copy to and from the map.
+//  Large pages need the "Lock pages in memory" user right.
+//  Default pages are used if they are not available.
+//  Set before the first frame is sent.
+void spoutGL::SetMemoryShareLargePages(bool bLarge)
+{
+	memoryshare.SetLargePages(bLarge);
+}
+
+//---------------------------------------------------------
+// Function: GetMemorySharePages
+// Pages of the memory share map, default if not open
+//  See also SpoutSharedMemory::GetPageStats for all segments
+SpoutPageMode spoutGL::GetMemorySharePages()
+{
+	return memoryshare.GetPageMode();
+}
+
 //
 // Group: Information
 //
@@ -39,6 +39,7 @@
 #include "SpoutDirectX.h" // for DX11 shared textures
 #include "SpoutFrameCount.h" // for mutex lock and new frame signal
 #include "SpoutCopy.h" // for pixel copy
+#include "SpoutFrameRing.h" // for memoryshare frame slots
 #include "SpoutUtils.h" // Registry utiities
 #include "SpoutGLextensions.h" // include last due to redefinition problems with OpenCL
 
@@ -121,6 +122,28 @@ class SPOUT_DLLEXP spoutGL {
 	// Set user share mode
 	//  0 - texture, 1 - memory, 2 - CPU
 	void SetShareMode(int mode);
+	// Set memory share frames in Y'CbCr instead of RGBA
+	//  UYVY frames are half the size and NV12 frames 3/8
+	//  Sender and receiver must select the same format
+	void SetMemoryShareYUV(bool bYUV, SpoutYUV format = SPOUT_YUV_UYVY, bool bFullRange = false);
+	// Get memory share Y'CbCr format, false for RGBA
+	bool GetMemoryShareYUV(SpoutYUV &format, bool &bFullRange);
+	// Copy and upload only the tiles of memory share frames that change
+	//  tileSize - width and height of the tiles in pixels
+	void SetMemoryShareTiles(bool bTiles, unsigned int tileSize = 64);
+	// Tiles that changed in the last memory share frame, false if not enabled
+	bool GetMemoryShareTileStats(SpoutTileStats &stats);
+	// Send memory share frames through a ring of slots instead of a locked buffer
+	//  slots - 2 to 8, 3 by default
+	//  Receivers find the ring and read it without a setting
+	void SetMemoryShareRing(bool bRing, unsigned int slots = 3);
+	// Get memory share ring slots and frames dropped, false if not enabled
+	bool GetMemoryShareRing(unsigned int &slots, unsigned long long &dropped);
+	// Create memory share maps with large pages if available
+	//  Fewer TLB misses in the copies of very large frames
+	void SetMemoryShareLargePages(bool bLarge = true);
+	// Pages of the memory share map, default if not open
+	SpoutPageMode GetMemorySharePages();
 
 	//
 	// Information
@@ -268,6 +291,8 @@ protected :
 	
 	// For 2.006(receive only) / WriteMemoryBuffer / ReadMemoryBuffer
 	SpoutSharedMemory memoryshare;
+	// Frame slots in the memoryshare map if the sender uses a ring
+	spoutFrameRing memoryring;
 
 	// GL/DX functions
 	bool CreateInterop(unsigned int width, unsigned int height, DWORD dwFormat, bool bReceive);
@@ -321,6 +346,14 @@ protected :
 	bool ReadMemoryTexture(const char* sendername, GLuint TexID, GLuint TextureTarget, unsigned int width, unsigned int height, bool bInvert = false, GLuint HostFBO = 0);
 	bool ReadMemoryPixels(const char* sendername, unsigned char* pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert = false);
 	bool WriteMemoryPixels(const char *sendername, const unsigned char* pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert = false);
+	bool ReadMemoryLease(const char* sendername, spoutFrameLease& lease);
+	// Sender memoryshare map, "_ring" or "_map"
+	bool OpenMemoryShare(const char* sendername);
+	// Ring of memoryshare frame slots
+	bool CheckMemoryRing();
+	// Changed tiles of memoryshare frames
+	bool CheckMemoryTiles(unsigned int width, unsigned int height, bool bPrevious);
+	void UploadMemoryTiles(const unsigned char* pixels, GLuint TexID, GLuint TextureTarget, unsigned int width, unsigned int height);
 
 	// Utility
 	bool OpenDeviceKey(const char* key, int maxsize, char* description, char* version);
@@ -378,6 +411,23 @@ protected :
 	bool m_bTextureShare; // Using texture sharing methods
 	bool m_bCPUshare;     // Using CPU sharing methods
 	bool m_bMemoryShare;  // Using 2.006 memoryshare methods
+	bool m_bMemoryYUV;    // Memoryshare frames in Y'CbCr
+	SpoutYUV m_MemoryYUV;
+	bool m_bMemoryYUVfull;
+	unsigned char* m_pMemoryRGBA; // RGBA pixels of a Y'CbCr frame for ReadMemoryTexture
+	size_t m_MemoryRGBAsize;
+	bool m_bMemoryTiles;  // Memoryshare copy and upload of changed tiles
+	unsigned int m_MemoryTileSize;
+	unsigned int m_MemoryTileWidth;  // Size of the last frame, 0 if none
+	unsigned int m_MemoryTileHeight;
+	unsigned char* m_pMemoryTileMap;
+	size_t m_MemoryTileMapSize;
+	unsigned char* m_pMemoryPrevious; // Last RGBA frame uploaded by ReadMemoryTexture
+	size_t m_MemoryPreviousSize;
+	SpoutTileStats m_MemoryTileStats;
+	bool m_bMemoryRing;   // Memoryshare frames sent through a ring of slots
+	unsigned int m_MemoryRingSlots;
+	uint64_t m_MemoryRingFrame; // Last ring frame received
 	
 	// Sender sharing modes
 	bool m_bSenderCPU;    // Sender using CPU sharing methods
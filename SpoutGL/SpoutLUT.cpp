@@ -0,0 +1,572 @@
+/*
+
+					SpoutLUT.cpp
+
+		3D colour lookup table with tetrahedral interpolation
+
+	Each pixel is located in a cell of the table and the cell is divided
+	into six tetrahedra along the diagonal from the first to the last corner.
+	The order of the red, green and blue fractions selects the tetrahedron
+	and the result is weighted from its four corners. This is the method of
+	DaVinci Resolve and OpenColorIO and gives a neutral grey axis.
+
+	The AVX2 and scalar functions use the same operations in the same order
+	and give the same result, so that the line remainder can be scalar.
+
+	- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+	17.10.26 - Create file
+			 - .cube parser, AVX2 and scalar interpolation for RGBA float and 8 bit
+
+	- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+	Distributed under the same terms as the Spout SDK (see SpoutLicense).
+
+*/
+#include "SpoutLUT.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+// As SpoutCopy.cpp
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SPOUT_TARGET_AVX2
+#else
+#define SPOUT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+//
+// Class: spoutLUT
+//
+// Refer to SpoutLUT.h for documentation.
+//
+
+spoutLUT::spoutLUT() {
+	m_Size = 0;
+	m_pTable = nullptr;
+	for (int c = 0; c < 3; c++) {
+		m_Scale[c] = 1.0f;
+		m_Offset[c] = 0.0f;
+	}
+	m_Title[0] = 0;
+	m_Error[0] = 0;
+}
+
+spoutLUT::~spoutLUT() {
+	Clear();
+}
+
+void spoutLUT::Clear()
+{
+	if (m_pTable)
+		_mm_free(m_pTable);
+	m_pTable = nullptr;
+	m_Size = 0;
+	m_Title[0] = 0;
+}
+
+bool spoutLUT::IsLoaded() const
+{
+	return (m_pTable != nullptr);
+}
+
+unsigned int spoutLUT::GetSize() const
+{
+	return m_Size;
+}
+
+const char* spoutLUT::GetTitle() const
+{
+	return m_Title;
+}
+
+const char* spoutLUT::GetError() const
+{
+	return m_Error;
+}
+
+bool spoutLUT::Fail(unsigned int line, const char* reason)
+{
+	if (line > 0)
+		snprintf(m_Error, 256, "line %u : %s", line, reason);
+	else
+		snprintf(m_Error, 256, "%s", reason);
+	return false;
+}
+
+//---------------------------------------------------------
+// Function: Set
+//   Build the RGBA table from size x size x size RGB values.
+//   The current table is kept if the values are not valid.
+bool spoutLUT::Set(unsigned int size, const float* rgb,
+	const float* domainMin, const float* domainMax)
+{
+	if (!rgb)
+		return Fail(0, "no table values");
+	if (size < 2 || size > 256)
+		return Fail(0, "table size must be 2 to 256");
+
+	float scale[3]{};
+	float offset[3]{};
+	for (int c = 0; c < 3; c++) {
+		const float dmin = domainMin ? domainMin[c] : 0.0f;
+		const float dmax = domainMax ? domainMax[c] : 1.0f;
+		if (!(dmax > dmin) || !std::isfinite(dmin) || !std::isfinite(dmax))
+			return Fail(0, "domain maximum must be greater than minimum");
+		// Table coordinate = (input - min) * (size - 1) / (max - min)
+		scale[c] = (float)((double)(size - 1) / ((double)dmax - (double)dmin));
+		offset[c] = (float)(-(double)dmin * (double)scale[c]);
+	}
+
+	const size_t entries = (size_t)size * size * size;
+	auto table = static_cast<float *>(_mm_malloc(entries * 4 * sizeof(float), 64));
+	if (!table)
+		return Fail(0, "not enough memory for the table");
+	for (size_t i = 0; i < entries; i++) {
+		table[i * 4 + 0] = rgb[i * 3 + 0];
+		table[i * 4 + 1] = rgb[i * 3 + 1];
+		table[i * 4 + 2] = rgb[i * 3 + 2];
+		table[i * 4 + 3] = 0.0f;
+	}
+
+	Clear();
+	m_pTable = table;
+	m_Size = size;
+	for (int c = 0; c < 3; c++) {
+		m_Scale[c] = scale[c];
+		m_Offset[c] = offset[c];
+	}
+	m_Error[0] = 0;
+	return true;
+}
+
+//---------------------------------------------------------
+// Function: Load
+//   Read a .cube file and parse it
+bool spoutLUT::Load(const char* path)
+{
+	if (!path || !*path)
+		return Fail(0, "no file name");
+
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		return Fail(0, "cannot open the file");
+
+	std::stringstream text;
+	text << file.rdbuf();
+	if (file.bad())
+		return Fail(0, "cannot read the file");
+
+	return Parse(text.str().c_str());
+}
+
+// Read up to count floats separated by white space.
+// The rest of the line must be empty or a comment.
+static bool ParseFloats(const char* p, float* values, int count)
+{
+	for (int i = 0; i < count; i++) {
+		char* end = nullptr;
+		values[i] = strtof(p, &end);
+		if (end == p || !std::isfinite(values[i]))
+			return false;
+		p = end;
+	}
+	while (*p == ' ' || *p == '\t')
+		p++;
+	return (*p == 0 || *p == '#');
+}
+
+//---------------------------------------------------------
+// Function: Parse
+//   Parse .cube text
+//
+//   TITLE, LUT_3D_SIZE, DOMAIN_MIN, DOMAIN_MAX and LUT_3D_INPUT_RANGE
+//   are used. Other keywords are ignored. 1D tables are not supported.
+//   Lines of table values follow the keywords, red changing fastest.
+//   The current table is kept if the text is not valid.
+bool spoutLUT::Parse(const char* text)
+{
+	if (!text)
+		return Fail(0, "no text");
+
+	std::string title;
+	unsigned int size = 0;
+	float domainMin[3] = { 0.0f, 0.0f, 0.0f };
+	float domainMax[3] = { 1.0f, 1.0f, 1.0f };
+	std::vector<float> rgb;
+	size_t entries = 0;
+	unsigned int line = 0;
+
+	const char* p = text;
+	while (*p) {
+		line++;
+		// One line without the line end
+		const size_t length = strcspn(p, "\r\n");
+		std::string s(p, length);
+		p += length;
+		if (*p == '\r') p++;
+		if (*p == '\n') p++;
+
+		const char* q = s.c_str();
+		while (*q == ' ' || *q == '\t')
+			q++;
+		if (*q == 0 || *q == '#')
+			continue;
+
+		// Table values
+		if ((*q >= '0' && *q <= '9') || *q == '-' || *q == '+' || *q == '.') {
+			if (size == 0)
+				return Fail(line, "table values before LUT_3D_SIZE");
+			if (rgb.size() >= entries * 3)
+				return Fail(line, "more table values than LUT_3D_SIZE");
+			float value[3]{};
+			if (!ParseFloats(q, value, 3))
+				return Fail(line, "expected three numbers");
+			rgb.push_back(value[0]);
+			rgb.push_back(value[1]);
+			rgb.push_back(value[2]);
+			continue;
+		}
+
+		// Keyword and arguments
+		const size_t keyLength = strcspn(q, " \t");
+		const std::string key(q, keyLength);
+		q += keyLength;
+		while (*q == ' ' || *q == '\t')
+			q++;
+
+		if (key == "TITLE") {
+			if (*q == '"') {
+				const char* end = strchr(q + 1, '"');
+				if (!end)
+					return Fail(line, "TITLE without closing quote");
+				title.assign(q + 1, end);
+			}
+			else {
+				title = q;
+			}
+		}
+		else if (key == "LUT_3D_SIZE") {
+			char* end = nullptr;
+			const unsigned long n = strtoul(q, &end, 10);
+			if (end == q || n < 2 || n > 256)
+				return Fail(line, "LUT_3D_SIZE must be 2 to 256");
+			if (size != 0)
+				return Fail(line, "more than one LUT_3D_SIZE");
+			size = (unsigned int)n;
+			entries = (size_t)size * size * size;
+			rgb.reserve(entries * 3);
+		}
+		else if (key == "LUT_1D_SIZE") {
+			return Fail(line, "1D tables are not supported");
+		}
+		else if (key == "DOMAIN_MIN") {
+			if (!ParseFloats(q, domainMin, 3))
+				return Fail(line, "DOMAIN_MIN requires three numbers");
+		}
+		else if (key == "DOMAIN_MAX") {
+			if (!ParseFloats(q, domainMax, 3))
+				return Fail(line, "DOMAIN_MAX requires three numbers");
+		}
+		else if (key == "LUT_3D_INPUT_RANGE") {
+			float range[2]{};
+			if (!ParseFloats(q, range, 2))
+				return Fail(line, "LUT_3D_INPUT_RANGE requires two numbers");
+			for (int c = 0; c < 3; c++) {
+				domainMin[c] = range[0];
+				domainMax[c] = range[1];
+			}
+		}
+		// Other keywords are ignored
+	}
+
+	if (size == 0)
+		return Fail(0, "no LUT_3D_SIZE");
+	if (rgb.size() != entries * 3) {
+		char reason[128]{};
+		snprintf(reason, 128, "%u table values for LUT_3D_SIZE %u, expected %u",
+			(unsigned int)(rgb.size() / 3), size, (unsigned int)entries);
+		return Fail(0, reason);
+	}
+
+	if (!Set(size, rgb.data(), domainMin, domainMax))
+		return false;
+
+	snprintf(m_Title, 256, "%s", title.c_str());
+	return true;
+}
+
+//
+// Interpolation
+//
+// The table coordinate of each channel is clamped to the table.
+// The cell index k is limited to size-2 so that the last entry is
+// reached with a fraction of 1. Corners are offset from the first
+// by 1 for red, size for green and size*size for blue.
+//
+
+// Interpolate one RGB value
+static inline void LutPixel(const float* table, int size,
+	const float* scale, const float* offset, float* rgb)
+{
+	const float top = (float)(size - 1);
+	int k[3]{};
+	float f[3]{};
+	for (int c = 0; c < 3; c++) {
+		float v = rgb[c] * scale[c] + offset[c];
+		v = v > 0.0f ? v : 0.0f; // NaN to 0
+		v = v < top ? v : top;
+		const int i = (int)v;
+		k[c] = i < size - 2 ? i : size - 2;
+		f[c] = v - (float)k[c];
+	}
+
+	const float fr = f[0];
+	const float fg = f[1];
+	const float fb = f[2];
+
+	// Corners of the tetrahedron
+	const int sr = 1;
+	const int sg = size;
+	const int sb = size * size;
+	int offA = 0;
+	int offB = 0;
+	if (fr > fg) {
+		offA = (fg > fb || fr > fb) ? sr : sb;
+		offB = (fg > fb) ? sr + sg : sr + sb;
+	}
+	else {
+		offA = (fb > fg) ? sb : sg;
+		offB = (fb > fg || fb > fr) ? sg + sb : sg + sr;
+	}
+
+	// Weights from the sorted fractions
+	const float fmax = std::max(std::max(fr, fg), fb);
+	const float fmin = std::min(std::min(fr, fg), fb);
+	const float fmid = std::max(std::min(fr, fg), std::min(std::max(fr, fg), fb));
+	const float w0 = 1.0f - fmax;
+	const float wA = fmax - fmid;
+	const float wB = fmid - fmin;
+
+	const float* c0 = table + (size_t)((k[2] * size + k[1]) * size + k[0]) * 4;
+	const float* cA = c0 + offA * 4;
+	const float* cB = c0 + offB * 4;
+	const float* c1 = c0 + (sr + sg + sb) * 4;
+	for (int c = 0; c < 3; c++)
+		rgb[c] = c0[c] * w0 + cA[c] * wA + cB[c] * wB + c1[c] * fmin;
+}
+
+// Cells of 8 pixels held as separate red, green and blue.
+// The float index of the four corners of each tetrahedron
+// and their weights are stored for LutPairAVX2.
+struct spoutLutCells {
+	alignas(32) int index[4][8];
+	alignas(32) float weight[4][8];
+};
+
+SPOUT_TARGET_AVX2 static inline void LutCellsAVX2(int size,
+	const float* scale, const float* offset, __m256 r, __m256 g, __m256 b, spoutLutCells& cells)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 top = _mm256_set1_ps((float)(size - 1));
+	const __m256i kmax = _mm256_set1_epi32(size - 2);
+
+	const __m256 v[3] = { r, g, b };
+	__m256i k[3];
+	__m256 f[3];
+	for (int c = 0; c < 3; c++) {
+		__m256 x = _mm256_add_ps(_mm256_mul_ps(v[c], _mm256_set1_ps(scale[c])), _mm256_set1_ps(offset[c]));
+		x = _mm256_min_ps(_mm256_max_ps(x, zero), top); // max returns 0 for NaN
+		k[c] = _mm256_min_epi32(_mm256_cvttps_epi32(x), kmax);
+		f[c] = _mm256_sub_ps(x, _mm256_cvtepi32_ps(k[c]));
+	}
+	const __m256 fr = f[0];
+	const __m256 fg = f[1];
+	const __m256 fb = f[2];
+
+	// Corners of the tetrahedron
+	const __m256i sr = _mm256_set1_epi32(1);
+	const __m256i sg = _mm256_set1_epi32(size);
+	const __m256i sb = _mm256_set1_epi32(size * size);
+	const __m256i srg = _mm256_add_epi32(sr, sg);
+	const __m256i srb = _mm256_add_epi32(sr, sb);
+	const __m256i sgb = _mm256_add_epi32(sg, sb);
+	const __m256i rg = _mm256_castps_si256(_mm256_cmp_ps(fr, fg, _CMP_GT_OQ));
+	const __m256i gb = _mm256_castps_si256(_mm256_cmp_ps(fg, fb, _CMP_GT_OQ));
+	const __m256i rb = _mm256_castps_si256(_mm256_cmp_ps(fr, fb, _CMP_GT_OQ));
+	const __m256i bg = _mm256_castps_si256(_mm256_cmp_ps(fb, fg, _CMP_GT_OQ));
+	const __m256i br = _mm256_castps_si256(_mm256_cmp_ps(fb, fr, _CMP_GT_OQ));
+	const __m256i offA = _mm256_blendv_epi8(
+		_mm256_blendv_epi8(sg, sb, bg),
+		_mm256_blendv_epi8(sb, sr, _mm256_or_si256(gb, rb)), rg);
+	const __m256i offB = _mm256_blendv_epi8(
+		_mm256_blendv_epi8(srg, sgb, _mm256_or_si256(bg, br)),
+		_mm256_blendv_epi8(srb, srg, gb), rg);
+
+	// Weights from the sorted fractions
+	const __m256 fmax = _mm256_max_ps(_mm256_max_ps(fr, fg), fb);
+	const __m256 fmin = _mm256_min_ps(_mm256_min_ps(fr, fg), fb);
+	const __m256 fmid = _mm256_max_ps(_mm256_min_ps(fr, fg), _mm256_min_ps(_mm256_max_ps(fr, fg), fb));
+	_mm256_store_ps(cells.weight[0], _mm256_sub_ps(_mm256_set1_ps(1.0f), fmax));
+	_mm256_store_ps(cells.weight[1], _mm256_sub_ps(fmax, fmid));
+	_mm256_store_ps(cells.weight[2], _mm256_sub_ps(fmid, fmin));
+	_mm256_store_ps(cells.weight[3], fmin);
+
+	// Float index of each corner entry
+	const __m256i base = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(
+		_mm256_mullo_epi32(k[2], sg), k[1]), sg), k[0]);
+	_mm256_store_si256(reinterpret_cast<__m256i *>(cells.index[0]), _mm256_slli_epi32(base, 2));
+	_mm256_store_si256(reinterpret_cast<__m256i *>(cells.index[1]), _mm256_slli_epi32(_mm256_add_epi32(base, offA), 2));
+	_mm256_store_si256(reinterpret_cast<__m256i *>(cells.index[2]), _mm256_slli_epi32(_mm256_add_epi32(base, offB), 2));
+	_mm256_store_si256(reinterpret_cast<__m256i *>(cells.index[3]), _mm256_slli_epi32(
+		_mm256_add_epi32(base, _mm256_add_epi32(srg, sb)), 2));
+}
+
+// Interpolate two pixels of the cells, RGBA in each 128 bit lane.
+// Each corner is a single 16 byte load, which is faster than a gather
+// for each channel. Alpha of the table is 0 and so is the result.
+SPOUT_TARGET_AVX2 static inline __m256 LutPairAVX2(const float* table, const spoutLutCells& cells,
+	unsigned int i, unsigned int j)
+{
+	__m256 sum = _mm256_setzero_ps();
+	for (int n = 0; n < 4; n++) {
+		const __m256 corner = _mm256_insertf128_ps(_mm256_castps128_ps256(
+			_mm_load_ps(table + cells.index[n][i])), _mm_load_ps(table + cells.index[n][j]), 1);
+		const __m256 weight = _mm256_insertf128_ps(_mm256_castps128_ps256(
+			_mm_set1_ps(cells.weight[n][i])), _mm_set1_ps(cells.weight[n][j]), 1);
+		sum = n == 0 ? _mm256_mul_ps(corner, weight) : _mm256_add_ps(sum, _mm256_mul_ps(corner, weight));
+	}
+	return sum;
+}
+
+// 4 x 4 transpose in each 128 bit lane. 8 RGBA pixels to red, green,
+// blue and alpha, with pixels 0, 2, 4, 6 in the low lane and 1, 3, 5, 7 in the high lane.
+SPOUT_TARGET_AVX2 static inline void LutTranspose(__m256& p0, __m256& p1, __m256& p2, __m256& p3)
+{
+	const __m256 t0 = _mm256_unpacklo_ps(p0, p1);
+	const __m256 t1 = _mm256_unpackhi_ps(p0, p1);
+	const __m256 t2 = _mm256_unpacklo_ps(p2, p3);
+	const __m256 t3 = _mm256_unpackhi_ps(p2, p3);
+	p0 = _mm256_shuffle_ps(t0, t2, 0x44);
+	p1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+	p2 = _mm256_shuffle_ps(t1, t3, 0x44);
+	p3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+}
+
+SPOUT_TARGET_AVX2 static unsigned int LutLineAVX2(const float* table, int size,
+	const float* scale, const float* offset,
+	const float* source, float* dest, unsigned int width)
+{
+	spoutLutCells cells;
+	unsigned int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		const __m256 p[4] = {
+			_mm256_loadu_ps(source + x * 4),
+			_mm256_loadu_ps(source + x * 4 + 8),
+			_mm256_loadu_ps(source + x * 4 + 16),
+			_mm256_loadu_ps(source + x * 4 + 24) };
+		__m256 r = p[0];
+		__m256 g = p[1];
+		__m256 b = p[2];
+		__m256 a = p[3];
+		LutTranspose(r, g, b, a);
+		LutCellsAVX2(size, scale, offset, r, g, b, cells);
+		// Pixels 2n and 2n + 1 are cells n and n + 4
+		for (unsigned int n = 0; n < 4; n++) {
+			const __m256 q = _mm256_blend_ps(LutPairAVX2(table, cells, n, n + 4), p[n], 0x88);
+			_mm256_storeu_ps(dest + x * 4 + n * 8, q);
+		}
+	}
+	return x;
+}
+
+SPOUT_TARGET_AVX2 static unsigned int LutLineAVX2(const float* table, int size,
+	const float* scale, const float* offset,
+	const unsigned char* source, unsigned char* dest, unsigned int width)
+{
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	const __m256 normal = _mm256_set1_ps(1.0f / 255.0f);
+	const __m256 full = _mm256_set1_ps(255.0f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	spoutLutCells cells;
+	unsigned int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + x * 4));
+		const __m256 r = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(p, mask)), normal);
+		const __m256 g = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p, 8), mask)), normal);
+		const __m256 b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p, 16), mask)), normal);
+		LutCellsAVX2(size, scale, offset, r, g, b, cells);
+		// Clamp, scale and round to nearest even
+		__m256i q[4];
+		for (unsigned int n = 0; n < 4; n++) {
+			const __m256 v = LutPairAVX2(table, cells, n * 2, n * 2 + 1);
+			q[n] = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(v, zero), one), full));
+		}
+		// Pack to bytes, pixels 0, 2, 4, 6 in the low lane and 1, 3, 5, 7 in the high lane
+		__m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(q[0], q[1]), _mm256_packus_epi32(q[2], q[3]));
+		bytes = _mm256_permutevar8x32_epi32(bytes, order);
+		bytes = _mm256_or_si256(bytes, _mm256_and_si256(p, alpha));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + x * 4), bytes);
+	}
+	return x;
+}
+
+void spoutLUT::ApplyLine(const float* source, float* dest, unsigned int width, bool bAVX2) const
+{
+	if (!source || !dest)
+		return;
+	if (!m_pTable) {
+		if (source != dest)
+			memmove(dest, source, (size_t)width * 16);
+		return;
+	}
+
+	const int size = (int)m_Size;
+	unsigned int x = 0;
+	if (bAVX2)
+		x = LutLineAVX2(m_pTable, size, m_Scale, m_Offset, source, dest, width);
+	for (; x < width; x++) {
+		float rgb[3] = { source[x * 4], source[x * 4 + 1], source[x * 4 + 2] };
+		LutPixel(m_pTable, size, m_Scale, m_Offset, rgb);
+		dest[x * 4 + 0] = rgb[0];
+		dest[x * 4 + 1] = rgb[1];
+		dest[x * 4 + 2] = rgb[2];
+		dest[x * 4 + 3] = source[x * 4 + 3];
+	}
+}
+
+void spoutLUT::ApplyLine(const unsigned char* source, unsigned char* dest, unsigned int width, bool bAVX2) const
+{
+	if (!source || !dest)
+		return;
+	if (!m_pTable) {
+		if (source != dest)
+			memmove(dest, source, (size_t)width * 4);
+		return;
+	}
+
+	const int size = (int)m_Size;
+	unsigned int x = 0;
+	if (bAVX2)
+		x = LutLineAVX2(m_pTable, size, m_Scale, m_Offset, source, dest, width);
+	for (; x < width; x++) {
+		float rgb[3]{};
+		for (int c = 0; c < 3; c++)
+			rgb[c] = (float)source[x * 4 + c] * (1.0f / 255.0f);
+		LutPixel(m_pTable, size, m_Scale, m_Offset, rgb);
+		for (int c = 0; c < 3; c++) {
+			float v = rgb[c] > 0.0f ? rgb[c] : 0.0f;
+			v = v < 1.0f ? v : 1.0f;
+			dest[x * 4 + c] = (unsigned char)std::lrint(v * 255.0f);
+		}
+		dest[x * 4 + 3] = source[x * 4 + 3];
+	}
+}
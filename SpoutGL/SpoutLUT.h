@@ -0,0 +1,80 @@
+/*
+
+					SpoutLUT.h
+
+		3D colour lookup table with tetrahedral interpolation
+
+	Loads .cube files (Adobe Cube LUT Specification 1.0, DaVinci Resolve)
+	and applies them to RGBA pixels. Images are converted by
+	spoutCopy::ApplyLUT, which divides the rows between threads
+	and converts 8 bit, 16 bit, half float and float formats.
+
+	The table is held as RGBA float entries of 16 bytes, red changing fastest,
+	so that each corner of an interpolation cell is a single aligned load.
+	AVX2 locates the cells of 8 pixels at a time and interpolates two pixels
+	in each register, which is faster than a gather for each channel.
+
+	Distributed under the same terms as the Spout SDK (see SpoutLicense).
+
+*/
+#pragma once
+
+#ifndef __spoutLUT__
+#define __spoutLUT__
+
+#include "SpoutCopy.h"
+
+class SPOUT_DLLEXP spoutLUT {
+
+	public:
+
+		spoutLUT();
+		~spoutLUT();
+		spoutLUT(const spoutLUT&) = delete;
+		spoutLUT& operator=(const spoutLUT&) = delete;
+
+		// Load a .cube file
+		//   3D tables from 2 to 256 entries on each side.
+		//   Returns false for a file that cannot be read or is not valid,
+		//   with the reason and line number from GetError.
+		//   The current table is kept if the new one fails.
+		bool Load(const char* path);
+		// Load .cube text from memory
+		bool Parse(const char* text);
+		// Set a table of size x size x size RGB values, red changing fastest
+		//   domainMin, domainMax - input range of red, green and blue (default 0-1)
+		bool Set(unsigned int size, const float* rgb,
+			const float* domainMin = nullptr, const float* domainMax = nullptr);
+		// Remove the table
+		void Clear();
+
+		bool IsLoaded() const;
+		// Entries on each side of the table, 0 if not loaded
+		unsigned int GetSize() const;
+		// TITLE of the .cube file
+		const char* GetTitle() const;
+		// Reason the last Load, Parse or Set failed
+		const char* GetError() const;
+
+		// Apply to a line of RGBA pixels
+		//   Alpha is not changed. Source and destination can be the same.
+		//   Float results are not clamped. 8 bit results are clamped and rounded.
+		//   The AVX2 and scalar functions give the same result.
+		void ApplyLine(const float* source, float* dest, unsigned int width, bool bAVX2) const;
+		void ApplyLine(const unsigned char* source, unsigned char* dest, unsigned int width, bool bAVX2) const;
+
+	protected :
+
+		unsigned int m_Size;
+		float* m_pTable; // RGBA entries, 64 byte aligned
+		float m_Scale[3]; // Input to table coordinate
+		float m_Offset[3];
+		// Character arrays to avoid C4251 warnings in SpoutLibrary
+		char m_Title[256];
+		char m_Error[256];
+
+		bool Fail(unsigned int line, const char* reason);
+
+};
+
+#endif
@@ -67,6 +67,7 @@
 //		24.04.21	- Add OpenGL shared texture access functions
 //		03.06.21	- Add GetMemoryBufferSize
 //		15.10.21	- Allow no argument for SetReceiverName
+//		17.10.26	- Add ReceiveImage overload for a memoryshare frame lease
 //
 // ====================================================================================
 //
@@ -595,6 +596,12 @@ bool SpoutReceiver::ReceiveImage(unsigned char *pixels, GLenum glFormat, bool bI
 	return spout.ReceiveImage(pixels, glFormat, bInvert, HostFbo);
 }
 
+//---------------------------------------------------------
+bool SpoutReceiver::ReceiveImage(spoutFrameLease& lease)
+{
+	return spout.ReceiveImage(lease);
+}
+
 //---------------------------------------------------------
 bool SpoutReceiver::SelectSenderPanel(const char *message)
 {
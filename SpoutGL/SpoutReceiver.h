@@ -60,6 +60,9 @@ class SPOUT_DLLEXP SpoutReceiver {
 	//   the receiving buffer if it has changed dimensions
 	//   For no change, copy the sender shared texture to the pixel buffer
 	bool ReceiveImage(unsigned char* pixels, GLenum glFormat = GL_RGBA, bool bInvert = false, GLuint HostFbo = 0);
+	// Receive a memory share frame in place
+	//   Lease the newest frame of a sender memory share ring, see Spout.h
+	bool ReceiveImage(spoutFrameLease& lease);
 	// Query whether the sender has changed
 	//   Checked at every cycle before receiving data
 	bool IsUpdated();
@@ -79,6 +79,8 @@
 			   testing function
 	31.07.21 - Add m_senders size check in UpdateSender
 	15.12.21 - Remove noisy SpoutLogNotice from SetSenderID
+	17.10.26 - Add a sequence after the texture info in sender maps so that
+			   getSharedInfo reads without the map mutex. Writers hold the mutex.
 
 
 	- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -108,6 +110,7 @@
 */
 #include "SpoutSenderNames.h"
 #include <assert.h>
+#include <atomic>
 
 //
 // Class: spoutSenderNames
@@ -553,7 +556,7 @@ bool spoutSenderNames::SetSenderInfo(const char* sendername, unsigned int width,
 	memcpy((void *)info.description, (void *)exepath, 256); // wchar 128
 
 	// Set data to the memory map
-	__movsd((unsigned long *)pBuf, (unsigned long const *)&info, sizeof(SharedTextureInfo) / 4); // 280 bytes
+	WriteSharedInfo(pBuf, &info);
 
 	senderInfoMap->Unlock();
 	
@@ -741,7 +744,8 @@ bool spoutSenderNames::UpdateSender(const char *sendername, unsigned int width,
 
 		// Create or open a shared memory map for this sender - allocate enough for the texture info
 		SpoutSharedMemory *senderInfoMem = new SpoutSharedMemory();
-		SpoutCreateResult result = senderInfoMem->Create(sendername, sizeof(SharedTextureInfo));
+		// and the sequence for readers without the mutex
+		SpoutCreateResult result = senderInfoMem->Create(sendername, sizeof(SharedTextureInfo) + sizeof(SharedTextureSequence));
 
 		if (result == SPOUT_CREATE_FAILED) {
 			delete senderInfoMem;
@@ -1078,6 +1082,9 @@ bool spoutSenderNames::getSharedInfo(const char* sharedMemoryName, SharedTexture
 
 	// Possibly faster because the function is called all the time
 	if(mem.Open(sharedMemoryName)) {
+		// Without the mutex if the sender writes the sequence
+		if (ReadSharedInfo(mem.Buffer(), info))
+			return true;
 		char *pBuf = mem.Lock();
 		if(pBuf) {
 			__movsd((unsigned long *)info, (unsigned long const *)pBuf, sizeof(SharedTextureInfo) / 4); // 280 bytes
@@ -1089,6 +1096,53 @@ bool spoutSenderNames::getSharedInfo(const char* sharedMemoryName, SharedTexture
 
 } // end getSharedInfo
 
+//
+// Texture info with the sequence
+//
+// Views of a map are whole pages, so the sequence can be read
+// following the 280 bytes of a map created by an earlier sender.
+// Earlier senders do not write the id and the map is read with the mutex.
+//
+
+// Write the info and the sequence while holding the map mutex
+void spoutSenderNames::WriteSharedInfo(char* pBuf, const SharedTextureInfo* info)
+{
+	SharedTextureSequence* seq = reinterpret_cast<SharedTextureSequence *>(pBuf + sizeof(SharedTextureInfo));
+	// Odd while writing, also after a writer that did not finish
+	const LONG sequence = seq->sequence | 1;
+	InterlockedExchange(&seq->sequence, sequence);
+	__movsd((unsigned long *)pBuf, (unsigned long const *)info, sizeof(SharedTextureInfo) / 4); // 280 bytes
+	InterlockedExchange(&seq->sequence, sequence + 1);
+	seq->id = SPOUT_SEQUENCE_ID;
+}
+
+// Read the info without the mutex, false if the map has no sequence
+// or a writer is still busy after the retries
+bool spoutSenderNames::ReadSharedInfo(const char* pBuf, SharedTextureInfo* info)
+{
+	if (!pBuf)
+		return false;
+
+	const SharedTextureSequence* seq = reinterpret_cast<const SharedTextureSequence *>(pBuf + sizeof(SharedTextureInfo));
+	if (seq->id != SPOUT_SEQUENCE_ID)
+		return false;
+
+	for (int i = 0; i < 64; i++) {
+		const LONG before = seq->sequence;
+		if (before & 1) {
+			YieldProcessor(); // writing
+			continue;
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		__movsd((unsigned long *)info, (unsigned long const *)pBuf, sizeof(SharedTextureInfo) / 4); // 280 bytes
+		// The copy is complete before the sequence is read again
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (seq->sequence == before)
+			return true;
+	}
+	return false;
+}
+
 // 12.06.15 - Added to allow direct modification of a sender's information in shared memory
 bool spoutSenderNames::setSharedInfo(const char* sharedMemoryName, SharedTextureInfo* info) 
 {
@@ -1105,7 +1159,7 @@ bool spoutSenderNames::setSharedInfo(const char* sharedMemoryName, SharedTexture
 		return false;
 	}
 
-	__movsd((unsigned long *)pBuf, (unsigned long const *)info, sizeof(SharedTextureInfo) / 4); // 280 bytes
+	WriteSharedInfo(pBuf, info);
 
 	mem.Unlock();
 	
@@ -80,6 +80,20 @@ struct SharedTextureInfo {			// 280 bytes total
 	unsigned __int32 partnerId;		// 4 bytes : Wyphon id of partner that shared it with us (not used)
 };
 
+// Sequence following SharedTextureInfo in a sender memory map
+//
+// Receivers read the texture info without the map mutex. A writer holds
+// the mutex, makes the sequence odd, writes the info and makes it even.
+// A reader copies the info between two reads of the sequence and tries
+// again if it was odd or has changed. The 280 byte layout is unchanged.
+// Maps of earlier senders have zero in place of the id, and are read
+// with the mutex as before.
+#define SPOUT_SEQUENCE_ID 0x51455053 // "SPEQ"
+struct SharedTextureSequence {		// 8 bytes following SharedTextureInfo
+	unsigned __int32 id;			// SPOUT_SEQUENCE_ID after the first write with the sequence
+	volatile LONG sequence;			// odd while the info is being written
+};
+
 
 class SPOUT_DLLEXP spoutSenderNames {
 
@@ -178,6 +192,10 @@ class SPOUT_DLLEXP spoutSenderNames {
 
 protected:
 
+		// Texture info with the sequence for reads without the mutex
+		static void WriteSharedInfo(char* pBuf, const SharedTextureInfo* info);
+		static bool ReadSharedInfo(const char* pBuf, SharedTextureInfo* info);
+
 		// Sender name set management
 		bool CreateSenderSet();
 		bool GetSenderSet (std::set<std::string>& SenderNames);
@@ -32,12 +32,43 @@
 	LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 	- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+	17.10.26 - Add POSIX backend with shm_open, mmap and a process-shared
+			   robust mutex for benchmark and soak tests on Linux
+			 - Add Buffer for reads without the lock
+			 - Add SetLargePages for segments with large pages, GetPageMode
+			   and GetPageStats for the pages each segment has
+			 - POSIX Create - a segment smaller than requested that was left
+			   by a process that ended is created again, otherwise Create fails
+			 - POSIX - do not attach to a segment whose last object has closed
+			   and is removing the name, Create waits and creates a new one
 	
 */
 
 #include "SpoutSharedMemory.h"
 #include <assert.h>
 #include <string>
+#include <atomic>
+#if defined(_WIN32)
+#include <psapi.h> // for QueryWorkingSetEx
+#pragma comment (lib, "psapi.lib")
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <thread>
+#include <chrono>
+#endif
 
 
 //
@@ -52,11 +83,19 @@
 SpoutSharedMemory::SpoutSharedMemory()
 {
 	m_pBuffer = NULL;
+#if defined(_WIN32)
 	m_hMutex = NULL;
 	m_hMap = NULL;
+#else
+	m_pHeader = NULL;
+	m_mapSize = 0;
+	m_pObjectName = NULL;
+#endif
 	m_pName = NULL;
 	m_size = 0;
 	m_lockCount = 0;
+	m_bLargePages = false;
+	m_PageMode = SPOUT_PAGES_DEFAULT;
 }
 
 SpoutSharedMemory::~SpoutSharedMemory()
@@ -64,10 +103,115 @@ SpoutSharedMemory::~SpoutSharedMemory()
 	Close();
 }
 
+const char* SpoutSharedMemory::Name()
+{
+	return m_pName;
+}
+
+int SpoutSharedMemory::Size()
+{
+	return m_size;
+}
+
+char* SpoutSharedMemory::Buffer()
+{
+	return m_pBuffer;
+}
+
+// Segments created by the process with each page mode
+static std::atomic<unsigned int> spoutPagesDefault(0);
+static std::atomic<unsigned int> spoutPagesLarge(0);
+static std::atomic<unsigned int> spoutPagesAdvised(0);
+static std::atomic<unsigned int> spoutPagesFallback(0);
+
+static void CountPages(SpoutPageMode mode, bool bRequested)
+{
+	if (mode == SPOUT_PAGES_LARGE)
+		spoutPagesLarge++;
+	else if (mode == SPOUT_PAGES_ADVISED)
+		spoutPagesAdvised++;
+	else
+		spoutPagesDefault++;
+	if (bRequested && mode != SPOUT_PAGES_LARGE)
+		spoutPagesFallback++;
+}
+
+void SpoutSharedMemory::SetLargePages(bool bLarge)
+{
+	m_bLargePages = bLarge;
+}
+
+SpoutPageMode SpoutSharedMemory::GetPageMode()
+{
+	return m_PageMode;
+}
+
+void SpoutSharedMemory::GetPageStats(SpoutPageStats &stats)
+{
+	stats.defaultPages = spoutPagesDefault.load();
+	stats.largePages = spoutPagesLarge.load();
+	stats.advisedPages = spoutPagesAdvised.load();
+	stats.fallback = spoutPagesFallback.load();
+}
+
+#if defined(_WIN32)
+
+// Enable the "Lock pages in memory" privilege needed for large pages.
+// Returns the large page size, or 0 if large pages are not available.
+static SIZE_T EnableLargePages()
+{
+	const SIZE_T largePage = GetLargePageMinimum();
+	if (largePage == 0)
+		return 0;
+
+	HANDLE hToken = NULL;
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken))
+		return 0;
+
+	TOKEN_PRIVILEGES tp = {};
+	tp.PrivilegeCount = 1;
+	tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	const BOOL bEnabled = LookupPrivilegeValueA(NULL, "SeLockMemoryPrivilege", &tp.Privileges[0].Luid)
+		&& AdjustTokenPrivileges(hToken, FALSE, &tp, 0, NULL, NULL);
+	// AdjustTokenPrivileges succeeds if the user does not have the privilege
+	const DWORD err = GetLastError();
+	CloseHandle(hToken);
+
+	if (!bEnabled || err == ERROR_NOT_ALL_ASSIGNED)
+		return 0;
+
+	return largePage;
+}
+
+// Large page size, enabled once for the process
+static SIZE_T LargePageSize()
+{
+	static const SIZE_T largePage = EnableLargePages();
+	return largePage;
+}
+
+// Whether a view is mapped with large pages
+static bool IsLargePageView(const char* pBuffer)
+{
+	// The page must be in the working set for its attributes.
+	// Large pages are locked in memory and always are.
+	volatile char touch = *pBuffer;
+	(void)touch;
+	PSAPI_WORKING_SET_EX_INFORMATION info = {};
+	info.VirtualAddress = (PVOID)pBuffer;
+	if (!QueryWorkingSetEx(GetCurrentProcess(), &info, sizeof(info)))
+		return false;
+	return (info.VirtualAttributes.Valid && info.VirtualAttributes.LargePage);
+}
+
+#ifndef FILE_MAP_LARGE_PAGES
+#define FILE_MAP_LARGE_PAGES 0x20000000
+#endif
+
 // Create a new memory segment, or attach to an existing one
 SpoutCreateResult SpoutSharedMemory::Create(const char* name, int size)
 {
-	DWORD err;
+	DWORD err = 0;
 
 	// Don't call open twice on the same object without a Close()
 	assert(name);
@@ -86,12 +230,36 @@ SpoutCreateResult SpoutSharedMemory::Create(const char* name, int size)
 	// In this scenario, CreateFileMapping creates a file mapping object of a specified size
 	// that is backed by the system paging file instead of by a file in the file system.
 
-	m_hMap = CreateFileMappingA ( INVALID_HANDLE_VALUE,
-									NULL,
-									PAGE_READWRITE,
-									0,
-									(DWORD)size,
-									(LPCSTR)name);
+	// Large pages are committed and locked when the section is created.
+	// The size must be a multiple of the large page size.
+	bool bLarge = false;
+	if (m_bLargePages) {
+		const unsigned long long largePage = (unsigned long long)LargePageSize();
+		if (largePage > 0) {
+			const unsigned long long mapSize = ((unsigned long long)size + largePage - 1) / largePage * largePage;
+			m_hMap = CreateFileMappingA(INVALID_HANDLE_VALUE,
+										NULL,
+										PAGE_READWRITE | SEC_COMMIT | SEC_LARGE_PAGES,
+										(DWORD)(mapSize >> 32),
+										(DWORD)(mapSize & 0xFFFFFFFF),
+										(LPCSTR)name);
+			err = GetLastError();
+			bLarge = (m_hMap != NULL);
+		}
+		if (!bLarge) {
+			SpoutLogWarning("SpoutSharedMemory::Create - large pages not available for %s", name);
+		}
+	}
+
+	if (!m_hMap) {
+		m_hMap = CreateFileMappingA ( INVALID_HANDLE_VALUE,
+										NULL,
+										PAGE_READWRITE,
+										0,
+										(DWORD)size,
+										(LPCSTR)name);
+		err = GetLastError();
+	}
 
 	if (m_hMap == NULL)	{
 		return SPOUT_CREATE_FAILED;
@@ -100,7 +268,6 @@ SpoutCreateResult SpoutSharedMemory::Create(const char* name, int size)
 	// If the object exists before the function call, the function returns a handle
 	// to the existing object (with its current size, not the specified size),
 	// and GetLastError returns ERROR_ALREADY_EXISTS.
-	err = GetLastError();
 	bool alreadyExists = false;
 	if (err == ERROR_ALREADY_EXISTS) {
 		alreadyExists = true;
@@ -116,7 +283,12 @@ SpoutCreateResult SpoutSharedMemory::Create(const char* name, int size)
 	// We can depend on the mapping object to be initially zeros.
 	// https://docs.microsoft.com/en-us/windows/win32/api/winbase/nf-winbase-createfilemappinga
 
-	m_pBuffer = (char*)MapViewOfFile(m_hMap, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	// Windows 10 1703 and later map views of a large page section
+	// with FILE_MAP_LARGE_PAGES. Earlier versions do not need it.
+	if (bLarge)
+		m_pBuffer = (char*)MapViewOfFile(m_hMap, FILE_MAP_ALL_ACCESS | FILE_MAP_LARGE_PAGES, 0, 0, 0);
+	if (!m_pBuffer)
+		m_pBuffer = (char*)MapViewOfFile(m_hMap, FILE_MAP_ALL_ACCESS, 0, 0, 0);
 
 	if (!m_pBuffer)	{
 		Close();
@@ -138,6 +310,11 @@ SpoutCreateResult SpoutSharedMemory::Create(const char* name, int size)
 	m_pName = _strdup(name);
 	m_size = size;
 
+	// The pages the view has, whether created or attached
+	m_PageMode = IsLargePageView(m_pBuffer) ? SPOUT_PAGES_LARGE : SPOUT_PAGES_DEFAULT;
+	if (!alreadyExists)
+		CountPages(m_PageMode, m_bLargePages);
+
 	return alreadyExists ? SPOUT_ALREADY_EXISTS : SPOUT_CREATE_SUCCESS;
 
 }
@@ -160,6 +337,9 @@ bool SpoutSharedMemory::Open(const char* name)
 	}
 
 	m_pBuffer = (char*)MapViewOfFile(m_hMap, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	// A large page section may need FILE_MAP_LARGE_PAGES for the view
+	if (!m_pBuffer)
+		m_pBuffer = (char*)MapViewOfFile(m_hMap, FILE_MAP_ALL_ACCESS | FILE_MAP_LARGE_PAGES, 0, 0, 0);
 	if (!m_pBuffer)	{
 		Close();
 		return false;
@@ -180,6 +360,9 @@ bool SpoutSharedMemory::Open(const char* name)
 	// Only the process that creates the shared memory can save it's size.
 	m_size = 0;
 
+	// A view of a large page section has large pages
+	m_PageMode = IsLargePageView(m_pBuffer) ? SPOUT_PAGES_LARGE : SPOUT_PAGES_DEFAULT;
+
 	return true;
 
 }
@@ -207,6 +390,7 @@ void SpoutSharedMemory::Close()
 	}
 
 	m_size = 0;
+	m_PageMode = SPOUT_PAGES_DEFAULT;
 
 }
 
@@ -257,23 +441,515 @@ void SpoutSharedMemory::Unlock()
 	}
 }
 
-const char* SpoutSharedMemory::Name()
+void SpoutSharedMemory::Debug()
 {
-	return m_pName;
+	if (m_pName) {
+		SpoutLogNotice("SpoutSharedMemory::Debug : (%s) m_hMap = [0x%.7X], m_pBuffer = [0x%.7X], %s pages", m_pName, LOWORD(m_hMap), PtrToUint(m_pBuffer),
+			m_PageMode == SPOUT_PAGES_LARGE ? "large" : "default");
+	}
+	else {
+		SpoutLogNotice("SpoutSharedMemory::Debug : Shared Memory Map is not open\n");
+	}
+
 }
 
-int SpoutSharedMemory::Size()
+#else
+
+//
+// POSIX backend
+//
+// The segment starts with a page for the header, so that the buffer
+// is page aligned as MapViewOfFile returns it. The creator sizes the
+// object, initialises the mutex and then sets the ready value.
+// Other processes wait for it before using the mutex.
+//
+
+static const uint32_t spoutSharedReady = 0x53505348; // "SPSH"
+static const size_t spoutSharedHeaderSize = 4096;
+
+struct spoutSharedHeader {
+	std::atomic<uint32_t> ready; // spoutSharedReady once the mutex is initialised
+	std::atomic<uint32_t> attached; // Objects using the segment
+	uint32_t creator; // Process id of the creator
+	uint32_t reserved;
+	uint64_t size; // Buffer bytes requested by the creator
+	pthread_mutex_t mutex; // Process-shared and robust
+};
+
+static_assert(sizeof(spoutSharedHeader) <= spoutSharedHeaderSize, "Shared memory header larger than a page");
+
+// shm_open names start with a slash and have no others
+static std::string SharedObjectName(const char* name)
 {
-	return m_size;
+	std::string object = "/";
+	object += name;
+	for (size_t i = 1; i < object.size(); i++) {
+		if (object[i] == '/')
+			object[i] = '_';
+	}
+	if (object.size() > 250)
+		object.resize(250);
+	return object;
+}
+
+// Wait up to a second for the creator to initialise the header
+static bool WaitSharedReady(const spoutSharedHeader* header)
+{
+	for (int i = 0; i < 1000; i++) {
+		if (header->ready.load(std::memory_order_acquire) == spoutSharedReady)
+			return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return false;
+}
+
+// Wait up to a second for the creator to size the object
+static size_t WaitSharedSize(int fd)
+{
+	for (int i = 0; i < 1000; i++) {
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+			return 0;
+		if ((size_t)st.st_size > spoutSharedHeaderSize)
+			return (size_t)st.st_size;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return 0;
+}
+
+bool SpoutSharedMemory::Map(int fd, size_t mapSize)
+{
+	void* map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		return false;
+	m_pHeader = static_cast<spoutSharedHeader *>(map);
+	m_mapSize = mapSize;
+	m_pBuffer = static_cast<char *>(map) + spoutSharedHeaderSize;
+	return true;
+}
+
+// Set up the header of a new segment after it is mapped
+bool SpoutSharedMemory::InitHeader(int size)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	const int err = pthread_mutex_init(&m_pHeader->mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	if (err != 0) {
+		munmap(m_pHeader, m_mapSize);
+		m_pHeader = NULL;
+		m_pBuffer = NULL;
+		return false;
+	}
+	m_pHeader->creator = (uint32_t)getpid();
+	m_pHeader->size = (uint64_t)size;
+	m_pHeader->attached.store(1);
+	m_pHeader->ready.store(spoutSharedReady, std::memory_order_release);
+	return true;
+}
+
+// Map a segment created by another process and close the descriptor.
+// The last object to close a segment removes its name after the count
+// is zero, so a segment with no objects is not attached. bRemoved is
+// then true and the name is soon removed.
+bool SpoutSharedMemory::Attach(int fd, bool& bRemoved)
+{
+	bRemoved = false;
+	const size_t mapSize = WaitSharedSize(fd);
+	if (mapSize == 0 || !Map(fd, mapSize)) {
+		close(fd);
+		return false;
+	}
+	close(fd);
+	if (WaitSharedReady(m_pHeader)) {
+		uint32_t count = m_pHeader->attached.load();
+		while (count != 0) {
+			if (m_pHeader->attached.compare_exchange_weak(count, count + 1))
+				return true;
+		}
+		bRemoved = true;
+	}
+	munmap(m_pHeader, m_mapSize);
+	m_pHeader = NULL;
+	m_pBuffer = NULL;
+	m_mapSize = 0;
+	return false;
+}
+
+// Remove the name of a segment with no objects attached. Used if the
+// last object closed it and did not remove the name, as for a process
+// that ended before it could.
+static void UnlinkRemovedSegment(const std::string& path, bool bFile)
+{
+	const int fd = bFile ? open(path.c_str(), O_RDONLY) : shm_open(path.c_str(), O_RDONLY, 0);
+	if (fd < 0)
+		return;
+	uint32_t count = 1;
+	const bool bRead = pread(fd, &count, sizeof(count), offsetof(spoutSharedHeader, attached)) == (ssize_t)sizeof(count);
+	close(fd);
+	if (bRead && count == 0) {
+		if (bFile)
+			unlink(path.c_str());
+		else
+			shm_unlink(path.c_str());
+	}
+}
+
+//
+// Huge pages
+//
+// A hugetlbfs file is mapped with huge pages reserved when it is mapped,
+// so mmap fails if there are not enough. A shm_open object can only have
+// transparent huge pages, if shmem_enabled allows them for madvise.
+//
+
+// First hugetlbfs mount, empty if none
+static std::string FindHugePageMount()
+{
+	std::string mount;
+	FILE* file = fopen("/proc/mounts", "r");
+	if (!file)
+		return mount;
+	char device[256], dir[1024], type[64];
+	while (fscanf(file, "%255s %1023s %63s %*[^\n]", device, dir, type) == 3) {
+		if (strcmp(type, "hugetlbfs") == 0) {
+			mount = dir;
+			break;
+		}
+	}
+	fclose(file);
+	return mount;
+}
+
+// File on the hugetlbfs mount for a shm_open name, empty if there is no mount
+static std::string HugePageFile(const std::string& object)
+{
+	static const std::string mount = FindHugePageMount();
+	if (mount.empty())
+		return mount;
+	return mount + object;
+}
+
+// Transparent huge pages are allowed for shared memory with madvise
+static bool FindSharedHugePages()
+{
+	FILE* file = fopen("/sys/kernel/mm/transparent_hugepage/shmem_enabled", "r");
+	if (!file)
+		return false;
+	char line[256] = {};
+	const bool bRead = (fgets(line, sizeof(line), file) != NULL);
+	fclose(file);
+	if (!bRead)
+		return false;
+	// The setting in use is in brackets
+	const char* start = strchr(line, '[');
+	const char* end = start ? strchr(start, ']') : NULL;
+	if (!end)
+		return false;
+	const std::string setting(start + 1, end);
+	return (setting == "always" || setting == "within_size" || setting == "advise" || setting == "force");
+}
+
+static bool AdviseHugePages(void* map, size_t mapSize)
+{
+#ifdef MADV_HUGEPAGE
+	static const bool bAllowed = FindSharedHugePages();
+	return (bAllowed && madvise(map, mapSize, MADV_HUGEPAGE) == 0);
+#else
+	(void)map;
+	(void)mapSize;
+	return false;
+#endif
+}
+
+// Create a new memory segment, or attach to an existing one
+SpoutCreateResult SpoutSharedMemory::Create(const char* name, int size)
+{
+	// Don't call open twice on the same object without a Close()
+	assert(name);
+	assert(size);
+
+	if (m_pHeader) {
+		assert(strcmp(name, m_pName) == 0);
+		assert(m_pBuffer);
+		return SPOUT_ALREADY_CREATED;
+	}
+
+	if (!name || size <= 0)
+		return SPOUT_CREATE_FAILED;
+
+	// A segment of the name may be closed by its last object, which then
+	// removes the name. Wait up to a second for that, and create a new one.
+	bool bRemoved = false;
+	for (int i = 0; i < 1000; i++) {
+		const SpoutCreateResult result = CreateSegment(name, size, bRemoved);
+		if (!bRemoved)
+			return result;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// The name was not removed
+	const std::string object = SharedObjectName(name);
+	const std::string hugefile = HugePageFile(object);
+	UnlinkRemovedSegment(object, false);
+	if (!hugefile.empty())
+		UnlinkRemovedSegment(hugefile, true);
+	return CreateSegment(name, size, bRemoved);
+}
+
+// Create a new segment or attach to an existing one.
+// bRemoved is true if an existing segment is being removed.
+SpoutCreateResult SpoutSharedMemory::CreateSegment(const char* name, int size, bool& bRemoved)
+{
+	bRemoved = false;
+
+	const std::string object = SharedObjectName(name);
+	const std::string hugefile = HugePageFile(object);
+	std::string path = object; // Removed by the last Close
+	SpoutPageMode mode = SPOUT_PAGES_DEFAULT;
+	bool alreadyExists = false;
+	int fd = -1;
+
+	// A segment with huge pages created by another process
+	if (!hugefile.empty()) {
+		fd = open(hugefile.c_str(), O_RDWR);
+		if (fd >= 0) {
+			if (!Attach(fd, bRemoved))
+				return SPOUT_CREATE_FAILED;
+			path = hugefile;
+			mode = SPOUT_PAGES_LARGE;
+			alreadyExists = true;
+		}
+	}
+
+	// A new segment with huge pages unless there is a shm_open object of the name
+	if (!m_pHeader && m_bLargePages && !hugefile.empty()) {
+		fd = shm_open(object.c_str(), O_RDONLY, 0);
+		if (fd >= 0) {
+			close(fd);
+		}
+		else {
+			fd = open(hugefile.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+			if (fd >= 0) {
+				// The file size must be a multiple of the huge page size
+				struct statvfs vfs;
+				const size_t hugePage = (fstatvfs(fd, &vfs) == 0) ? (size_t)vfs.f_bsize : 0;
+				const size_t mapSize = hugePage > 0
+					? (spoutSharedHeaderSize + (size_t)size + hugePage - 1) / hugePage * hugePage : 0;
+				const bool bMapped = mapSize > 0 && ftruncate(fd, (off_t)mapSize) == 0 && Map(fd, mapSize);
+				close(fd);
+				if (bMapped && InitHeader(size)) {
+					path = hugefile;
+					mode = SPOUT_PAGES_LARGE;
+				}
+				else {
+					// No huge pages free, or none reserved
+					unlink(hugefile.c_str());
+				}
+			}
+		}
+	}
+
+	if (!m_pHeader) {
+		fd = shm_open(object.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+		if (fd >= 0) {
+			// New objects are zeros, as for a paging file section
+			const size_t mapSize = spoutSharedHeaderSize + (size_t)size;
+			if (ftruncate(fd, (off_t)mapSize) != 0 || !Map(fd, mapSize)) {
+				close(fd);
+				shm_unlink(object.c_str());
+				return SPOUT_CREATE_FAILED;
+			}
+			close(fd);
+			if (!InitHeader(size)) {
+				shm_unlink(object.c_str());
+				return SPOUT_CREATE_FAILED;
+			}
+		}
+		else if (errno == EEXIST) {
+			// The size of the map is the size when it was created
+			fd = shm_open(object.c_str(), O_RDWR, 0);
+			if (fd < 0) {
+				// Removed since, try again
+				bRemoved = (errno == ENOENT);
+				return SPOUT_CREATE_FAILED;
+			}
+			if (!Attach(fd, bRemoved))
+				return SPOUT_CREATE_FAILED;
+			alreadyExists = true;
+		}
+		else {
+			return SPOUT_CREATE_FAILED;
+		}
+		if (m_bLargePages && AdviseHugePages(m_pHeader, m_mapSize))
+			mode = SPOUT_PAGES_ADVISED;
+	}
+
+	// A process that ends without Close leaves its segment, which may be
+	// smaller than requested. If the process that created it has ended,
+	// it is removed and created again. Otherwise the size cannot be used.
+	if (alreadyExists && m_mapSize - spoutSharedHeaderSize < (size_t)size) {
+		const pid_t creator = (pid_t)m_pHeader->creator;
+		const bool bStale = (creator > 0 && kill(creator, 0) != 0 && errno == ESRCH);
+		m_pHeader->attached.fetch_sub(1);
+		munmap(m_pHeader, m_mapSize);
+		m_pHeader = NULL;
+		m_pBuffer = NULL;
+		m_mapSize = 0;
+		if (!bStale)
+			return SPOUT_CREATE_FAILED;
+		if (mode == SPOUT_PAGES_LARGE)
+			unlink(path.c_str());
+		else
+			shm_unlink(path.c_str());
+		return Create(name, size);
+	}
+
+	// Set the name and size
+	m_pName = strdup(name);
+	m_pObjectName = strdup(path.c_str());
+	m_size = size;
+	m_PageMode = mode;
+	if (!alreadyExists)
+		CountPages(mode, m_bLargePages);
+
+	return alreadyExists ? SPOUT_ALREADY_EXISTS : SPOUT_CREATE_SUCCESS;
+}
+
+bool SpoutSharedMemory::Open(const char* name)
+{
+	// Don't call open twice on the same object without a Close()
+	assert(name);
+
+	if (m_pHeader) {
+		assert(strcmp(name, m_pName) == 0);
+		assert(m_pBuffer);
+		return true;
+	}
+
+	if (!name)
+		return false;
+
+	// A shm_open object, or a file with huge pages
+	std::string path = SharedObjectName(name);
+	SpoutPageMode mode = SPOUT_PAGES_DEFAULT;
+	int fd = shm_open(path.c_str(), O_RDWR, 0);
+	if (fd < 0) {
+		const std::string hugefile = HugePageFile(path);
+		if (hugefile.empty())
+			return false;
+		fd = open(hugefile.c_str(), O_RDWR);
+		if (fd < 0)
+			return false;
+		path = hugefile;
+		mode = SPOUT_PAGES_LARGE;
+	}
+
+	// A segment being removed is not found
+	bool bRemoved = false;
+	if (!Attach(fd, bRemoved))
+		return false;
+
+	if (mode == SPOUT_PAGES_DEFAULT && m_bLargePages && AdviseHugePages(m_pHeader, m_mapSize))
+		mode = SPOUT_PAGES_ADVISED;
+
+	m_pName = strdup(name);
+	m_pObjectName = strdup(path.c_str());
+	// As for Windows, only the process that creates the map records the size
+	m_size = 0;
+	m_PageMode = mode;
+
+	return true;
+}
+
+void SpoutSharedMemory::Close()
+{
+	if (m_pHeader) {
+		// The last object attached removes the name
+		const bool bLast = (m_pHeader->attached.fetch_sub(1) == 1);
+		munmap(m_pHeader, m_mapSize);
+		m_pHeader = NULL;
+		m_pBuffer = NULL;
+		m_mapSize = 0;
+		if (bLast && m_pObjectName) {
+			if (m_PageMode == SPOUT_PAGES_LARGE)
+				unlink(m_pObjectName); // hugetlbfs file
+			else
+				shm_unlink(m_pObjectName);
+		}
+	}
+
+	if (m_pObjectName) {
+		free(m_pObjectName);
+		m_pObjectName = NULL;
+	}
+
+	if (m_pName) {
+		free((void*)m_pName);
+		m_pName = NULL;
+	}
+
+	m_size = 0;
+	m_lockCount = 0;
+	m_PageMode = SPOUT_PAGES_DEFAULT;
+}
+
+char* SpoutSharedMemory::Lock()
+{
+	assert(m_lockCount >= 0);
+
+	if (m_lockCount < 0 || !m_pHeader || !m_pBuffer)
+		return NULL;
+
+	if (m_lockCount > 0) {
+		m_lockCount++;
+		return m_pBuffer;
+	}
+
+	// Same wait as for the Windows mutex
+	struct timespec t;
+	clock_gettime(CLOCK_REALTIME, &t);
+	t.tv_nsec += 67 * 1000000L;
+	if (t.tv_nsec >= 1000000000L) {
+		t.tv_sec++;
+		t.tv_nsec -= 1000000000L;
+	}
+	int err = pthread_mutex_timedlock(&m_pHeader->mutex, &t);
+	if (err == EOWNERDEAD) {
+		// The owner exited while holding the lock
+		pthread_mutex_consistent(&m_pHeader->mutex);
+		err = 0;
+	}
+	if (err != 0)
+		return NULL;
+
+	m_lockCount++;
+	return m_pBuffer;
+}
+
+void SpoutSharedMemory::Unlock()
+{
+	assert(m_pHeader);
+
+	m_lockCount--;
+	assert(m_lockCount >= 0);
+
+	if (m_lockCount == 0 && m_pHeader)
+		pthread_mutex_unlock(&m_pHeader->mutex);
 }
 
 void SpoutSharedMemory::Debug()
 {
 	if (m_pName) {
-		SpoutLogNotice("SpoutSharedMemory::Debug : (%s) m_hMap = [0x%.7X], m_pBuffer = [0x%.7X]", m_pName, LOWORD(m_hMap), PtrToUint(m_pBuffer));
+		printf("SpoutSharedMemory::Debug : (%s) object = %s, m_pBuffer = [%p], %zu bytes mapped, %s pages\n",
+			m_pName, m_pObjectName, (void*)m_pBuffer, m_mapSize,
+			m_PageMode == SPOUT_PAGES_LARGE ? "huge" : (m_PageMode == SPOUT_PAGES_ADVISED ? "advised" : "default"));
 	}
 	else {
-		SpoutLogNotice("SpoutSharedMemory::Debug : Shared Memory Map is not open\n");
+		printf("SpoutSharedMemory::Debug : Shared Memory Map is not open\n");
 	}
-
 }
+
+#endif
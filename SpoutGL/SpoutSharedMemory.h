@@ -35,12 +35,51 @@
 #ifndef __SpoutSharedMemory_ // standard way as well
 #define __SpoutSharedMemory_
 
+//
+// Backends
+//
+//   Windows - CreateFileMapping paging file section with a named mutex
+//   POSIX   - shm_open and mmap with a process-shared robust pthread mutex
+//             in a header page before the buffer, so that a lock held by a
+//             process that exits is recovered by the next Lock. The object
+//             is unlinked when the last SpoutSharedMemory attached to it
+//             is closed, as a section is released with its last handle.
+//             An object left by a process that exits without Close
+//             is attached to by the next Create with the same name.
+//             For benchmark and soak tests of the memory share path on Linux.
+//
+// The backend is selected at build time and the class API is the same.
+//
+// Large pages
+//
+//   Segments of large frames can be created with large pages (SetLargePages)
+//   for fewer page table entries and TLB misses in each copy. If they are not
+//   available the segment has default pages. GetPageMode shows the pages of
+//   a segment and GetPageStats counts the segments created with each.
+//
+//   Windows - a SEC_LARGE_PAGES section, which needs the "Lock pages in
+//             memory" user right (SeLockMemoryPrivilege). The section size
+//             is rounded up to a multiple of the large page size.
+//   POSIX   - a file on a hugetlbfs mount such as /dev/hugepages, found by
+//             receivers with the same name, which needs huge pages reserved
+//             in /proc/sys/vm/nr_hugepages. Otherwise a shm_open object with
+//             transparent huge pages advised if shmem_enabled allows them.
+//
+#if defined(_WIN32)
 #include "SpoutCommon.h"
 #include <windowsx.h>
 #include <d3d9.h>
 #include <wingdi.h>
 
 using namespace spoututils;
+#else
+#include <stddef.h>
+#ifndef SPOUT_DLLEXP
+#define SPOUT_DLLEXP
+#endif
+// Header of a POSIX segment, see SpoutSharedMemory.cpp
+struct spoutSharedHeader;
+#endif
 
 // Result of memory segment creation
 enum SpoutCreateResult
@@ -51,6 +90,23 @@ enum SpoutCreateResult
 	SPOUT_ALREADY_CREATED,
 };
 
+// Pages of a memory segment
+enum SpoutPageMode
+{
+	SPOUT_PAGES_DEFAULT = 0, // System page size, 4 KB on x86
+	SPOUT_PAGES_LARGE,       // Large pages, 2 MB on x64
+	SPOUT_PAGES_ADVISED,     // POSIX - default pages advised for transparent huge pages
+};
+
+// Segments created by the process with each page mode
+struct SpoutPageStats
+{
+	unsigned int defaultPages;
+	unsigned int largePages;
+	unsigned int advisedPages;
+	unsigned int fallback; // Large pages requested but not available
+};
+
 class SPOUT_DLLEXP SpoutSharedMemory {
 
 public:
@@ -73,20 +129,48 @@ public:
 	// Unlock a map
 	void Unlock();
 
+	// Buffer of an open map without the lock
+	//   For readers that check the data themselves,
+	//   such as the sequence of sender texture info
+	char* Buffer();
+
 	// Name of an existing map
 	const char* Name();
 	
 	// Size of an existing map
+	//   Only the process that creates the map records the size, 0 after Open
 	int Size();
 
+	// Create segments with large pages if available
+	//   Set before Create. Default pages if not available.
+	void SetLargePages(bool bLarge = true);
+
+	// Pages of the open segment
+	SpoutPageMode GetPageMode();
+
+	// Segments created by the process with each page mode
+	static void GetPageStats(SpoutPageStats &stats);
+
 	// Print map information for debugging
 	void Debug();
 
 private:
 
 	char*  m_pBuffer; // Buffer pointer
+#if defined(_WIN32)
 	HANDLE m_hMap; // Map handle
 	HANDLE m_hMutex; // Mutex for map access
+#else
+	spoutSharedHeader* m_pHeader; // Mapped segment with the mutex, null if not open
+	size_t m_mapSize; // Bytes mapped including the header
+	char* m_pObjectName; // shm_open name, or the path of a hugetlbfs file
+	bool Map(int fd, size_t mapSize);
+	bool InitHeader(int size);
+	bool Attach(int fd, bool& bRemoved);
+	SpoutCreateResult CreateSegment(const char* name, int size, bool& bRemoved);
+#endif
+	bool m_bLargePages; // Create with large pages
+	SpoutPageMode m_PageMode; // Pages of the open segment
 	int m_lockCount; // Map access lock count
 	const char*	m_pName; // Map name
 	int m_size; // Map size
@@ -7,8 +7,10 @@
 #define NOMINMAX
 
 #include <GLFW/glfw3native.h>
+#include <cstdint>
 #include <cstdio>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "../SpoutGL/SpoutReceiver.h"
@@ -88,6 +90,35 @@ GLenum toGlType(RSPixelFormat format)
     }
 }
 
+SpoutSIMD toSpoutSIMD(const std::string& name)
+{
+    if (name == "auto")
+        return SPOUT_SIMD_AUTO;
+    if (name == "none")
+        return SPOUT_SIMD_NONE;
+    if (name == "sse2")
+        return SPOUT_SIMD_SSE2;
+    if (name == "ssse3")
+        return SPOUT_SIMD_SSSE3;
+    if (name == "avx2")
+        return SPOUT_SIMD_AVX2;
+    if (name == "avx512")
+        return SPOUT_SIMD_AVX512;
+    throw std::runtime_error("Unknown SIMD level " + name);
+}
+
+SpoutResample toSpoutResample(const std::string& name)
+{
+    if (name == "nearest")
+        return SPOUT_RESAMPLE_NEAREST;
+    if (name == "linear")
+        return SPOUT_RESAMPLE_BILINEAR;
+    if (name == "catmullrom")
+        return SPOUT_RESAMPLE_CATMULLROM;
+    if (name == "lanczos3")
+        return SPOUT_RESAMPLE_LANCZOS3;
+    throw std::runtime_error("Unknown scale filter " + name);
+}
 
 
 float randomFloat()
@@ -277,8 +308,26 @@ int main(int argc, char* argv[])
         .default_value(false)
         .implicit_value(true);
 
+    program.add_argument("--simd").help("Instruction set for CPU pixel copies (auto, none, sse2, ssse3, avx2, avx512).")
+        .default_value(std::string("auto"));
+
+    program.add_argument("--copy_threads").help("Threads for CPU pixel copies of large frames (0 for one per hardware thread).")
+        .default_value(1)
+        .scan<'i', int>();
+
+    program.add_argument("--skip_duplicates").help("Receive Spout frames to memory and skip the upload and stream copies of frames that have not changed.")
+        .default_value(false)
+        .implicit_value(true);
+
+    program.add_argument("--scale").help("Filter to scale the Spout frame to each stream (nearest, linear, catmullrom, lanczos3). catmullrom and lanczos3 scale on the CPU.")
+        .default_value(std::string("nearest"));
+
+    SpoutSIMD simd = SPOUT_SIMD_AUTO;
+    SpoutResample scaleFilter = SPOUT_RESAMPLE_NEAREST;
     try {
         program.parse_args(argc, argv);
+        simd = toSpoutSIMD(program.get<std::string>("--simd"));
+        scaleFilter = toSpoutResample(program.get<std::string>("--scale"));
     }
     catch (const std::runtime_error& err) {
         //PNL(err.what());
@@ -293,6 +342,18 @@ int main(int argc, char* argv[])
     SpoutSender sSend;
     sSend.SetSenderName("RenderStream");
 
+    // Force the CPU copy instruction set for comparison between render nodes.
+    sSend.spout.spoutcopy.SetSIMD(simd);
+    if (!sRecv.spout.spoutcopy.SetSIMD(simd))
+        std::printf("SIMD level not supported, using %d\n", sRecv.spout.spoutcopy.GetSIMD());
+
+    // Split large CPU share copies into row bands on a worker pool.
+    const int copyThreads = program.get<int>("--copy_threads");
+    if (copyThreads >= 0) {
+        sRecv.spout.spoutcopy.SetThreads(copyThreads);
+        sSend.spout.spoutcopy.SetThreads(copyThreads);
+    }
+
     // Setup Opengl
 
     // Enable experimental extensions
@@ -342,6 +403,23 @@ int main(int argc, char* argv[])
         isOutputDisabled = true;
     }
 
+    // Sources rendering slower than disguise requests frames send the same content again.
+    // With the CPU path, the content hash of each received frame is compared with the last
+    // and the texture upload and the copies to the stream targets are skipped if it is the same.
+    bool isSkipDuplicates = false;
+    if (program["--skip_duplicates"] == true) {
+        isSkipDuplicates = true;
+    }
+
+    // Nearest and linear scale the Spout frame to each stream with a blit.
+    // Canvas to stream ratios that are not whole numbers alias with a blit, so Catmull-Rom
+    // and Lanczos-3 receive the frame to memory and resample it on the CPU for each stream.
+    const bool isCpuScale = scaleFilter == SPOUT_RESAMPLE_CATMULLROM || scaleFilter == SPOUT_RESAMPLE_LANCZOS3;
+    const GLenum blitFilter = scaleFilter == SPOUT_RESAMPLE_BILINEAR ? GL_LINEAR : GL_NEAREST;
+    if (isCpuScale)
+        sRecv.spout.spoutcopy.SetResample(scaleFilter);
+    const bool isCpuReceive = isSkipDuplicates || isCpuScale;
+
 
     // A modern (and possibly messy) window pointer setup.
     // void(*)(GLFWwindow*) is a placeholder (any) type for the last arguments which is what will be called when the pointer needs to be released.
@@ -428,6 +506,25 @@ int main(int argc, char* argv[])
     // Generate Map for render targets.
     std::unordered_map<StreamHandle, RenderTarget> renderTargets;
 
+    // CPU path frame and the content hash of the last upload.
+    std::vector<unsigned char> SpoutPixels;
+    uint64_t SpoutHash = 0;
+    bool isSpoutUploaded = false;
+    // Hash of the frame last copied to each render target.
+    std::unordered_map<StreamHandle, uint64_t> renderTargetHashes;
+    // CPU scaled frame for the current stream.
+    std::vector<unsigned char> StreamPixels;
+
+    // With the CPU path, the window preview is the first mip level of the frame
+    // that fits the window, so that a large canvas is averaged instead of skipped.
+    RenderTarget PreviewTarget = {};
+    std::vector<unsigned char> PreviewPixels;
+    unsigned int PreviewLevel = 0;
+    unsigned int PreviewWidth = 0;
+    unsigned int PreviewHeight = 0;
+    if (isWindowed && isCpuReceive)
+        generateGlTexture(PreviewTarget, 1280, 720, RS_FMT_RGBA8);
+
     // Spout Incoming texture target
     RenderTarget SpoutIncomingTarget;
 
@@ -501,10 +598,59 @@ int main(int argc, char* argv[])
                 glBindTexture(GL_TEXTURE_2D, 0);
                 SpoutWidth = sRecv.GetSenderWidth();
                 SpoutHeight = sRecv.GetSenderHeight();
+
+                // The new texture is empty until the next frame is uploaded.
+                SpoutPixels.resize((size_t)SpoutWidth * SpoutHeight * 4);
+                isSpoutUploaded = false;
+                renderTargetHashes.clear();
+
+                if (PreviewTarget.texture)
+                {
+                    PreviewLevel = 0;
+                    PreviewWidth = SpoutWidth;
+                    PreviewHeight = SpoutHeight;
+                    const unsigned int levels = spoutCopy::MipLevels(SpoutWidth, SpoutHeight);
+                    while (PreviewLevel < levels && (PreviewWidth > 1280 || PreviewHeight > 720))
+                        spoutCopy::MipOffset(SpoutWidth, SpoutHeight, ++PreviewLevel, &PreviewWidth, &PreviewHeight);
+                    if (PreviewLevel > 0)
+                    {
+                        PreviewPixels.resize(spoutCopy::MipOffset(SpoutWidth, SpoutHeight, PreviewLevel + 1));
+                        glBindTexture(GL_TEXTURE_2D, PreviewTarget.texture);
+                        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, PreviewWidth, PreviewHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                        glBindTexture(GL_TEXTURE_2D, 0);
+                        if (glGetError() != GL_NO_ERROR)
+                            throw std::runtime_error("Failed to generate preview texture");
+                    }
+                }
+            }
+            if (isCpuReceive)
+            {
+                // Receive to memory and upload only frames with new content.
+                if (!SpoutPixels.empty() && sRecv.ReceiveImage(SpoutPixels.data(), GL_RGBA, false))
+                {
+                    const uint64_t hash = isSkipDuplicates ? sRecv.spout.spoutcopy.HashImage(SpoutPixels.data(), SpoutWidth, SpoutHeight) : 0;
+                    if (!isSkipDuplicates || !isSpoutUploaded || hash != SpoutHash)
+                    {
+                        glBindTexture(GL_TEXTURE_2D, SpoutTarget.texture);
+                        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SpoutWidth, SpoutHeight, GL_RGBA, GL_UNSIGNED_BYTE, SpoutPixels.data());
+                        glBindTexture(GL_TEXTURE_2D, 0);
+                        SpoutHash = hash;
+                        isSpoutUploaded = true;
+
+                        if (PreviewLevel > 0)
+                        {
+                            sRecv.spout.spoutcopy.MipPyramid(SpoutPixels.data(), PreviewPixels.data(), SpoutWidth, SpoutHeight, PreviewLevel);
+                            glBindTexture(GL_TEXTURE_2D, PreviewTarget.texture);
+                            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, PreviewWidth, PreviewHeight, GL_RGBA, GL_UNSIGNED_BYTE,
+                                PreviewPixels.data() + spoutCopy::MipOffset(SpoutWidth, SpoutHeight, PreviewLevel));
+                            glBindTexture(GL_TEXTURE_2D, 0);
+                        }
+                    }
+                }
             }
             // Need to create a spout specific texture to read into.
             // Putting true in the function fixes the inverted texture display which I'm too much of a n00b to solve.
-            if (sRecv.ReceiveTexture(SpoutTarget.texture, GL_TEXTURE_2D, false))
+            else if (sRecv.ReceiveTexture(SpoutTarget.texture, GL_TEXTURE_2D, false))
             {
 #ifdef DEBUG
                 std::printf("frame received\n");
@@ -524,7 +670,8 @@ int main(int argc, char* argv[])
 
             if (isWindowed) {
 
-                glBindFramebuffer(GL_READ_FRAMEBUFFER, SpoutTarget.frameBuffer);
+                const bool isPreviewMip = PreviewLevel > 0 && isSpoutUploaded;
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, isPreviewMip ? PreviewTarget.frameBuffer : SpoutTarget.frameBuffer);
                 {
                     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
                     {
@@ -533,8 +680,12 @@ int main(int argc, char* argv[])
 
                         glViewport(0, 0, SpoutWidth, SpoutHeight);
 
-                        glBlitFramebuffer(0, 0, SpoutWidth, SpoutHeight, 0, 720, 1280, 0,
-                            GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                        if (isPreviewMip)
+                            glBlitFramebuffer(0, 0, PreviewWidth, PreviewHeight, 0, 720, 1280, 0,
+                                GL_COLOR_BUFFER_BIT, GL_LINEAR);
+                        else
+                            glBlitFramebuffer(0, 0, SpoutWidth, SpoutHeight, 0, 720, 1280, 0,
+                                GL_COLOR_BUFFER_BIT, GL_NEAREST);
                         if (glGetError() != GL_NO_ERROR)
                             throw std::runtime_error("Failed to bind render target texture for stream");
                     }
@@ -560,6 +711,7 @@ int main(int argc, char* argv[])
                         RenderTarget& target = renderTargets[description.handle];
 						generateGlTexture(target, description.width, description.height, description.format);
                     }
+                    renderTargetHashes.clear();
 
                     std::printf("Found %d Streams\n", header->nStreams);
                     // PNL(fmt::sprintf("Found %d Streams\n", header->nStreams))
@@ -646,37 +798,64 @@ int main(int argc, char* argv[])
 
                         const RenderTarget& target = renderTargets.at(description.handle);
 
-                        glBindFramebuffer(GL_FRAMEBUFFER, target.frameBuffer);
+                        // The target already has this frame.
+                        bool isTargetCurrent = false;
+                        if (isSkipDuplicates && isSpoutUploaded) {
+                            auto found = renderTargetHashes.find(description.handle);
+                            isTargetCurrent = found != renderTargetHashes.end() && found->second == SpoutHash;
+                            renderTargetHashes[description.handle] = SpoutHash;
+                        }
+
+                        if (!isTargetCurrent && isCpuScale)
                         {
-                            if (glGetError() != GL_NO_ERROR)
-                                throw std::runtime_error("Failed to bind xxx read fbo");
-                            //  glClear(GL_COLOR_BUFFER_BIT);
+                            // Resample the received frame to the stream and upload it.
+                            if (isSpoutUploaded)
+                            {
+                                StreamPixels.resize((size_t)description.width * description.height * 4);
+                                sRecv.spout.spoutcopy.rgba2rgbaResample(SpoutPixels.data(), StreamPixels.data(),
+                                    SpoutWidth, SpoutHeight, SpoutWidth * 4, description.width, description.height);
+                                glBindTexture(GL_TEXTURE_2D, target.texture);
+                                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, description.width, description.height,
+                                    GL_RGBA, GL_UNSIGNED_BYTE, StreamPixels.data());
+                                glBindTexture(GL_TEXTURE_2D, 0);
+                                if (glGetError() != GL_NO_ERROR)
+                                    throw std::runtime_error("Failed to upload scaled frame.");
+                            }
                         }
+                        else if (!isTargetCurrent)
+                        {
+                            glBindFramebuffer(GL_FRAMEBUFFER, target.frameBuffer);
+                            {
+                                if (glGetError() != GL_NO_ERROR)
+                                    throw std::runtime_error("Failed to bind xxx read fbo");
+                                //  glClear(GL_COLOR_BUFFER_BIT);
+                            }
 
-                        glClearColor(0.f, 0.f, 0.f, 0.f);
-                        glClear(GL_COLOR_BUFFER_BIT);
-                        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                            glClearColor(0.f, 0.f, 0.f, 0.f);
+                            glClear(GL_COLOR_BUFFER_BIT);
+                            glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-                        //   glViewport(0, 0, SpoutWidth, SpoutHeight);
+                            //   glViewport(0, 0, SpoutWidth, SpoutHeight);
 
-                           // Set this back to 0
-                        glBindFramebuffer(GL_READ_FRAMEBUFFER, SpoutTarget.frameBuffer);
-                        {
-                            if (glGetError() != GL_NO_ERROR)
-                                throw std::runtime_error("Failed to bind 1111 read fbo");
-                            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.frameBuffer);
+                               // Set this back to 0
+                            glBindFramebuffer(GL_READ_FRAMEBUFFER, SpoutTarget.frameBuffer);
                             {
                                 if (glGetError() != GL_NO_ERROR)
-                                    throw std::runtime_error("Failed to bind read fbo");
-                                glBlitFramebuffer(0, 0, SpoutWidth, SpoutHeight, 0, 0, description.width, description.height,
-                                    GL_COLOR_BUFFER_BIT, GL_NEAREST);
-                                if (glGetError() != GL_NO_ERROR)
-                                    throw std::runtime_error("Failed to blit.");
+                                    throw std::runtime_error("Failed to bind 1111 read fbo");
+                                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.frameBuffer);
+                                {
+                                    if (glGetError() != GL_NO_ERROR)
+                                        throw std::runtime_error("Failed to bind read fbo");
+                                    glBlitFramebuffer(0, 0, SpoutWidth, SpoutHeight, 0, 0, description.width, description.height,
+                                        GL_COLOR_BUFFER_BIT, blitFilter);
+                                    if (glGetError() != GL_NO_ERROR)
+                                        throw std::runtime_error("Failed to blit.");
+                                }
                             }
+                            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                            if (glGetError() != GL_NO_ERROR)
+                                throw std::runtime_error("Failed to bind 000 read fbo");
                         }
-                        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-                        if (glGetError() != GL_NO_ERROR)
-                            throw std::runtime_error("Failed to bind 000 read fbo");
 
                         //glFinish();
 